@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef CONCURRENTHASHTABLE_H
+#define CONCURRENTHASHTABLE_H
+
+#include "HashTable.h"
+
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+
+#include <stdint.h>
+
+namespace mjl {
+namespace homebrew {
+
+/**
+ * A HashTable that can be shared between threads. The keys are split over
+ * ShardCount independent HashTables (shards), each with its own reader/writer
+ * lock, so threads working on different shards never wait for each other and
+ * readers of the same shard do not wait for each other either.
+ *
+ * The shard is chosen by the highest bits of the hash, the table inside the
+ * shard uses the lower bits, so the two choices do not interfere.
+ *
+ * Values are returned by copy. A reference into a shard would not be safe to
+ * use once the shard's lock has been released.
+ */
+template<typename K, typename V, typename HashGenerator = DefaultHashGenerator<K>, unsigned int ShardCount = 64>
+class ConcurrentHashTable {
+    static_assert(ShardCount > 0 && (ShardCount & (ShardCount - 1)) == 0, "ShardCount must be a power of two");
+
+ public:
+
+    // The table inside each shard. With the default (stop the world) rehash policy get() and
+    // contains() never modify it, which is what allows readers to share a lock.
+    typedef HashTable<K, V, HashGenerator> ShardTable;
+
+    ConcurrentHashTable()
+                    : shards(new Shard[ShardCount]) {
+    }
+
+    // Sharing a table between threads is the whole point, so it is neither copied nor moved
+    ConcurrentHashTable(const ConcurrentHashTable& from) = delete;
+    ConcurrentHashTable& operator=(const ConcurrentHashTable& from) = delete;
+
+    virtual ~ConcurrentHashTable() {
+        delete[] shards;
+    }
+
+    V get(const K& key) const {
+        Shard& shard = shardFor(key);
+        std::shared_lock<std::shared_timed_mutex> lock(shard.lock);
+        return shard.table.get(key);
+    }
+
+    bool contains(const K& key) const {
+        Shard& shard = shardFor(key);
+        std::shared_lock<std::shared_timed_mutex> lock(shard.lock);
+        return shard.table.contains(key);
+    }
+
+    // Will delete any element that is already there and insert new one
+    void insert(const K& key, const V& value) {
+        Shard& shard = shardFor(key);
+        std::unique_lock<std::shared_timed_mutex> lock(shard.lock);
+        shard.table.insert(key, value);
+    }
+
+    /**
+     * Same as insert, but reports whether the key was newly inserted (true) or
+     * an existing value was replaced (false). The check and the insert happen
+     * under the same lock.
+     */
+    bool insertOrAssign(const K& key, const V& value) {
+        Shard& shard = shardFor(key);
+        std::unique_lock<std::shared_timed_mutex> lock(shard.lock);
+        bool inserted = !shard.table.contains(key);
+        shard.table.insert(key, value);
+        return inserted;
+    }
+
+    /**
+     * Return the value for key. If there is none, makeValue(key) is called to
+     * create it and it is inserted. No matter how many threads race on the same
+     * key, makeValue is called only once and every thread gets the same value.
+     *
+     * makeValue is called with the shard locked, so it must not use this table.
+     */
+    template<typename MakeValue> V computeIfAbsent(const K& key, MakeValue makeValue) {
+        Shard& shard = shardFor(key);
+
+        // Most calls find the value already there, so try with a shared lock first
+        {
+            std::shared_lock<std::shared_timed_mutex> lock(shard.lock);
+            if (shard.table.contains(key)) {
+                return shard.table.get(key);
+            }
+        }
+
+        std::unique_lock<std::shared_timed_mutex> lock(shard.lock);
+
+        // Another thread may have inserted the key between the two locks
+        if (!shard.table.contains(key)) {
+            shard.table.insert(key, makeValue(key));
+        }
+
+        return shard.table.get(key);
+    }
+
+    bool remove(const K& key) {
+        Shard& shard = shardFor(key);
+        std::unique_lock<std::shared_timed_mutex> lock(shard.lock);
+        return shard.table.remove(key);
+    }
+
+ private:
+
+    struct Shard {
+        std::shared_timed_mutex lock;
+        ShardTable table;
+        char padding[64];       // Keep the locks of neighbouring shards off the same cache line
+    };
+
+    // log2(ShardCount)
+    static constexpr unsigned int shardBits(unsigned int count) {
+        return count <= 1 ? 0 : 1 + shardBits(count / 2);
+    }
+
+    Shard& shardFor(const K& key) const {
+        uint64_t hash = HashOf<HashGenerator, K>::hash(key);
+
+        // A size_t hash may only be 32 bits wide
+        unsigned int hashBits = sizeof(size_t) * 8;
+
+        if (shardBits(ShardCount) == 0) {
+            return shards[0];
+        }
+
+        return shards[(hash >> (hashBits - shardBits(ShardCount))) & (ShardCount - 1)];
+    }
+
+    Shard* shards;
+};
+
+} /* namespace homebrew */
+} /* namespace mjl */
+
+#endif /* CONCURRENTHASHTABLE_H */
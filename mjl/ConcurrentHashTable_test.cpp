@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "ConcurrentHashTable.h"
+#include "ConcurrentHashTable_test.h"
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace mjl::homebrew;
+
+static const int THREAD_COUNT = 8;
+static const int KEYS_PER_THREAD = 20000;
+
+bool runConcurrentHashTableTests(void) {
+    ConcurrentHashTable<int, int> table;
+    vector<thread> threads;
+
+    // Each thread inserts its own range of keys, removes every fourth one, and reads keys
+    // written by the other threads while they are still writing.
+    cout << "Inserting and removing from " << THREAD_COUNT << " threads at once.\n";
+    for (int t = 0; t < THREAD_COUNT; t++) {
+        threads.push_back(thread([&table, t]() {
+            for (int i = 0; i < KEYS_PER_THREAD; i++) {
+                int key = t * KEYS_PER_THREAD + i;
+                table.insert(key, key * 2);
+                if (i % 4 == 0) {
+                    table.remove(key);
+                }
+                table.contains((key + KEYS_PER_THREAD) % (THREAD_COUNT * KEYS_PER_THREAD));
+            }
+        }));
+    }
+    for (unsigned int t = 0; t < threads.size(); t++) {
+        threads[t].join();
+    }
+    threads.clear();
+
+    for (int key = 0; key < THREAD_COUNT * KEYS_PER_THREAD; key++) {
+        bool expected = (key % KEYS_PER_THREAD) % 4 != 0;
+        if (table.contains(key) != expected) {
+            cerr << "Key " << key << " was " << (expected ? "lost" : "not removed") << ".\n";
+            return false;
+        }
+        if (expected && table.get(key) != key * 2) {
+            cerr << "Key " << key << " has the wrong value.\n";
+            return false;
+        }
+    }
+
+    // Every thread races to create the same keys, each key must only be created once
+    cout << "Racing computeIfAbsent from " << THREAD_COUNT << " threads.\n";
+    ConcurrentHashTable<int, int> computed;
+    atomic<int> creations(0);
+    atomic<int> mismatches(0);
+    for (int t = 0; t < THREAD_COUNT; t++) {
+        threads.push_back(thread([&computed, &creations, &mismatches, t]() {
+            for (int key = 0; key < KEYS_PER_THREAD; key++) {
+                int value = computed.computeIfAbsent(key, [&creations, t](const int& k) {
+                    creations++;
+                    return k * THREAD_COUNT + t;
+                });
+                if (value / THREAD_COUNT != key) {
+                    mismatches++;
+                }
+            }
+        }));
+    }
+    for (unsigned int t = 0; t < threads.size(); t++) {
+        threads[t].join();
+    }
+    threads.clear();
+
+    if (creations != KEYS_PER_THREAD || mismatches != 0) {
+        cerr << "computeIfAbsent created " << creations << " values for " << KEYS_PER_THREAD << " keys, "
+                        << mismatches << " calls got the wrong value.\n";
+        return false;
+    }
+
+    cout << "Testing insertOrAssign\n";
+    if (computed.insertOrAssign(-1, 1) != true || computed.insertOrAssign(-1, 2) != false || computed.get(-1) != 2) {
+        cerr << "insertOrAssign did not report insert vs. assign correctly.\n";
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,509 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef CUCKOOHASHTABLE_H
+#define CUCKOOHASHTABLE_H
+
+#include "HashGenerator.h"
+#include "HashSizePolicy.h"
+
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+namespace mjl {
+namespace homebrew {
+
+#define CUCKOO_SLOTS_PER_BUCKET 4
+#define CUCKOO_CACHE_LINE 64
+
+/**
+ * One bucket of a CuckooHashTable: four keys, then four values, then a bit
+ * per slot saying whether it is in use. A zeroed bucket is empty. Buckets
+ * start on a cache line, so for keys and values of up to 12 bytes together
+ * (an int to int entry takes 8) a bucket is exactly one cache line.
+ */
+template<typename K, typename V> struct alignas(CUCKOO_CACHE_LINE) CuckooBucket {
+ public:
+    K& key(unsigned int slot) {
+        return reinterpret_cast<K*>(keyStorage)[slot];
+    }
+
+    const K& key(unsigned int slot) const {
+        return reinterpret_cast<const K*>(keyStorage)[slot];
+    }
+
+    V& value(unsigned int slot) {
+        return reinterpret_cast<V*>(valueStorage)[slot];
+    }
+
+    const V& value(unsigned int slot) const {
+        return reinterpret_cast<const V*>(valueStorage)[slot];
+    }
+
+    bool used(unsigned int slot) const {
+        return (occupied & (1u << slot)) != 0;
+    }
+
+    // The first free slot, or CUCKOO_SLOTS_PER_BUCKET if there is none
+    unsigned int freeSlot(void) const {
+        for (unsigned int slot = 0; slot < CUCKOO_SLOTS_PER_BUCKET; slot++) {
+            if (!used(slot)) {
+                return slot;
+            }
+        }
+        return CUCKOO_SLOTS_PER_BUCKET;
+    }
+
+    template<typename KeyArg, typename ValueArg> void fill(unsigned int slot, KeyArg&& theKey, ValueArg&& theValue) {
+        new (&key(slot)) K(std::forward<KeyArg>(theKey));
+        try {
+            new (&value(slot)) V(std::forward<ValueArg>(theValue));
+        } catch (...) {
+            key(slot).~K();
+            throw;
+        }
+        occupied |= (unsigned char) (1u << slot);
+    }
+
+    void empty(unsigned int slot) {
+        key(slot).~K();
+        value(slot).~V();
+        occupied &= (unsigned char) ~(1u << slot);
+    }
+
+    alignas(K) unsigned char keyStorage[CUCKOO_SLOTS_PER_BUCKET * sizeof(K)];
+    alignas(V) unsigned char valueStorage[CUCKOO_SLOTS_PER_BUCKET * sizeof(V)];
+    unsigned char occupied;
+};
+
+/**
+ * A bucketized cuckoo hash table, with the same get/insert/remove interface
+ * as HashTable. Every key can live in one of two buckets, picked by two
+ * different hashes of it, and each bucket holds four entries. A lookup reads
+ * those two buckets and nothing else, so however the keys are spread, get
+ * and contains never touch more than two buckets (two cache lines for small
+ * entries). That bound is the point of the table: HashTable's chains have no
+ * length limit when a HashGenerator spreads keys badly.
+ *
+ * When both buckets of a new key are full, a breadth first search looks for
+ * the shortest chain of entries that can each move to their other bucket,
+ * ending in a bucket with a free slot, and the entries are moved along it
+ * from the free end. The search looks at no more than MAX_SEARCH_BUCKETS
+ * buckets. If it finds nothing the table grows and every entry is placed
+ * again. With four slots per bucket this doesn't happen until the table is
+ * well over 90% full.
+ *
+ * The two bucket indices come from the size policy, applied to the hash and
+ * to a remix of it. They need independent bits, so the hash generator has to
+ * spread keys well. A bad one never makes lookups slower, but it does make
+ * inserts fail and the table grow early. Keys with the same hash share both
+ * buckets, so no more than eight of them fit at any size. When a few growths
+ * in a row still leave no room, insert gives up and throws std::length_error
+ * with the table as it was.
+ */
+template<typename K, typename V, typename HashGenerator = DefaultHashGenerator<K>,
+                typename SizePolicy = PowerOfTwoSizePolicy> class CuckooHashTable {
+ public:
+
+    typedef CuckooBucket<K, V> Bucket;
+
+    // Default constructor
+    CuckooHashTable(void)
+                    : sizing(),
+                      size(0),
+                      table(allocateTable(sizing.size())) {
+    }
+
+    // Copy constructor
+    CuckooHashTable(const CuckooHashTable& from)
+                    : sizing(from.sizing),
+                      size(0),
+                      table(allocateTable(from.sizing.size())) {
+        commonCopy(from);
+    }
+
+    // Move constructor
+    CuckooHashTable(CuckooHashTable&& from) noexcept
+                    : sizing(from.sizing),
+                      size(from.size),
+                      table(from.table) {
+        from.table = nullptr;
+    }
+
+    // Assignment operator
+    CuckooHashTable& operator=(const CuckooHashTable& from) {
+
+        if (this == &from) {
+            return *this;
+        }
+
+        commonDelete();
+        sizing = from.sizing;
+        size = 0;
+        table = allocateTable(from.sizing.size());
+        commonCopy(from);
+        return *this;
+    }
+
+    // Move assignment operator
+    CuckooHashTable& operator=(CuckooHashTable&& from) noexcept {
+
+        if (this == &from) {
+            return *this;
+        }
+
+        commonDelete();
+
+        sizing = from.sizing;
+        size = from.size;
+        table = from.table;
+
+        from.table = nullptr;
+
+        return *this;
+    }
+
+    // Destructor
+    virtual ~CuckooHashTable() {
+        commonDelete();
+    }
+
+    V& get(const K& key) {
+
+        unsigned int slot = 0;
+        Bucket* bucket = findSlot(key, slot);
+
+        if (bucket == nullptr) {
+            throw std::out_of_range("Tried to get entry that does not exist.");
+        }
+
+        return bucket->value(slot);
+    }
+
+    bool contains(const K& key) {
+        unsigned int slot = 0;
+        return findSlot(key, slot) != nullptr;
+    }
+
+    // Will replace any value that is already there with a copy of the new one
+    void insert(const K& key, const V& value) {
+
+        unsigned int slot = 0;
+        Bucket* bucket = findSlot(key, slot);
+
+        if (bucket != nullptr) {
+            bucket->value(slot) = value;
+            return;
+        }
+
+        K carriedKey(key);
+        V carriedValue(value);
+
+        if (!place(carriedKey, carriedValue)) {
+            growAndPlace(carriedKey, carriedValue);
+        }
+
+        size++;
+    }
+
+    bool remove(const K& key) {
+
+        unsigned int slot = 0;
+        Bucket* bucket = findSlot(key, slot);
+
+        if (bucket == nullptr) {
+            return false;
+        }
+
+        bucket->empty(slot);
+        size--;
+        return true;
+    }
+
+    // The number of buckets, each of which holds CUCKOO_SLOTS_PER_BUCKET entries
+    unsigned int bucketCount(void) const {
+        return sizing.size();
+    }
+
+    float loadFactor(void) const {
+        return (float) size / ((float) sizing.size() * CUCKOO_SLOTS_PER_BUCKET);
+    }
+
+ private:
+
+    // One bucket visited by the breadth first search of place
+    struct SearchStep {
+        unsigned int bucket;
+        int parent;                 // Index of the step this one came from, -1 for the key's own buckets
+        unsigned int parentSlot;    // The slot of the parent bucket whose entry would move here
+    };
+
+    // How many buckets place looks at before giving up: the key's two, then four more per bucket
+    static const unsigned int MAX_SEARCH_BUCKETS = 2 + 8 + 32 + 128;
+
+    // How many times in a row insert grows the table looking for room. Past the first, the load factor is under 50%.
+    static const unsigned int MAX_GROWTHS = 4;
+
+    // The bucket key would be in, and the slot in it, or nullptr if key isn't in the table
+    Bucket* findSlot(const K& key, unsigned int& slot) const {
+
+        size_t hash = HashOf<HashGenerator, K>::hash(key);
+        Bucket* first = &table[sizing.index(hash)];
+        Bucket* second = &table[secondBucket(hash, sizing.index(hash))];
+
+        // Ask for the second cache line before comparing anything, so the two misses overlap
+#if defined(__GNUC__)
+        __builtin_prefetch(second);
+#endif
+
+        for (slot = 0; slot < CUCKOO_SLOTS_PER_BUCKET; slot++) {
+            if (first->used(slot) && first->key(slot) == key) {
+                return first;
+            }
+        }
+
+        for (slot = 0; slot < CUCKOO_SLOTS_PER_BUCKET; slot++) {
+            if (second->used(slot) && second->key(slot) == key) {
+                return second;
+            }
+        }
+
+        return nullptr;
+    }
+
+    /**
+     * Put an entry that is not in the table yet into one of its two buckets,
+     * moving other entries to their other bucket to make room if need be.
+     * Returns false, with nothing moved and the carried key and value
+     * untouched, if no room was found. Otherwise they are left moved from.
+     */
+    bool place(K& carriedKey, V& carriedValue) {
+
+        size_t hash = HashOf<HashGenerator, K>::hash(carriedKey);
+        SearchStep steps[MAX_SEARCH_BUCKETS];
+        unsigned int stepCount = 0;
+
+        unsigned int first = sizing.index(hash);
+        steps[stepCount++] = { first, -1, 0 };
+        steps[stepCount++] = { secondBucket(hash, first), -1, 0 };
+
+        for (unsigned int current = 0; current < stepCount; current++) {
+
+            Bucket& bucket = table[steps[current].bucket];
+            unsigned int freeSlot = bucket.freeSlot();
+
+            if (freeSlot != CUCKOO_SLOTS_PER_BUCKET) {
+                unsigned int rootSlot = movePath(steps, current, freeSlot);
+                table[steps[rootOf(steps, current)].bucket].fill(rootSlot, std::move(carriedKey),
+                                std::move(carriedValue));
+                return true;
+            }
+
+            // Queue up the other bucket of every entry here, unless the path already went through it
+            for (unsigned int slot = 0; slot < CUCKOO_SLOTS_PER_BUCKET
+                            && stepCount < MAX_SEARCH_BUCKETS; slot++) {
+                unsigned int other = otherBucket(bucket.key(slot), steps[current].bucket);
+                if (!onPath(steps, current, other)) {
+                    steps[stepCount++] = { other, (int) current, slot };
+                }
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     * Move the entries along the path ending at step last, starting from its
+     * free end: the entry of the parent bucket moves into the free slot, which
+     * frees a slot in the parent, and so on. Returns the slot freed in the
+     * bucket the path started from.
+     */
+    unsigned int movePath(const SearchStep* steps, unsigned int last, unsigned int freeSlot) {
+
+        for (unsigned int current = last; steps[current].parent != -1; current = steps[current].parent) {
+            Bucket& from = table[steps[steps[current].parent].bucket];
+            unsigned int fromSlot = steps[current].parentSlot;
+
+            table[steps[current].bucket].fill(freeSlot, std::move(from.key(fromSlot)),
+                            std::move(from.value(fromSlot)));
+            from.empty(fromSlot);
+            freeSlot = fromSlot;
+        }
+
+        return freeSlot;
+    }
+
+    static unsigned int rootOf(const SearchStep* steps, unsigned int current) {
+        while (steps[current].parent != -1) {
+            current = steps[current].parent;
+        }
+        return current;
+    }
+
+    // Whether bucket is already on the path to step current, where moving into it could undo an earlier move
+    static bool onPath(const SearchStep* steps, unsigned int current, unsigned int bucket) {
+        for (int step = (int) current; step != -1; step = steps[step].parent) {
+            if (steps[step].bucket == bucket) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // The second hash of a key, independent of the first. The xor keeps a hash of 0 from mixing to 0.
+    static size_t alternateHash(size_t hash) {
+        return (size_t) hashMix(hash ^ HASH_SECRET_2, HASH_SECRET_3);
+    }
+
+    // The second bucket of a key, never the same as its first, so every key has eight slots to go in
+    unsigned int secondBucket(size_t hash, unsigned int first) const {
+        unsigned int second = sizing.index(alternateHash(hash));
+        return (second != first) ? second : (first + 1) % sizing.size();
+    }
+
+    // The bucket a key could be in, other than the one it is in
+    unsigned int otherBucket(const K& key, unsigned int bucket) const {
+        size_t hash = HashOf<HashGenerator, K>::hash(key);
+        unsigned int first = sizing.index(hash);
+        return (first == bucket) ? secondBucket(hash, first) : first;
+    }
+
+    // Buckets have to start on a cache line, which plain new doesn't promise before C++17
+    static Bucket* allocateTable(unsigned int theSize) {
+        void* memory = nullptr;
+        if (posix_memalign(&memory, CUCKOO_CACHE_LINE, theSize * sizeof(Bucket)) != 0) {
+            throw std::bad_alloc();
+        }
+        memset(memory, 0, theSize * sizeof(Bucket));
+        return static_cast<Bucket*>(memory);
+    }
+
+    void commonCopy(const CuckooHashTable& from) {
+
+        // Both tables have the same size, so every entry can go to the same slot
+        for (unsigned int i = 0; i < from.sizing.size(); i++) {
+            for (unsigned int slot = 0; slot < CUCKOO_SLOTS_PER_BUCKET; slot++) {
+                if (from.table[i].used(slot)) {
+                    table[i].fill(slot, from.table[i].key(slot), from.table[i].value(slot));
+                }
+            }
+        }
+
+        size = from.size;
+    }
+
+    // Destroy every entry of theTable and free it
+    static void deleteTable(Bucket* theTable, unsigned int theSize) {
+
+        for (unsigned int i = 0; i < theSize; i++) {
+            for (unsigned int slot = 0; slot < CUCKOO_SLOTS_PER_BUCKET; slot++) {
+                if (theTable[i].used(slot)) {
+                    theTable[i].empty(slot);
+                }
+            }
+        }
+
+        free(theTable);
+    }
+
+    void commonDelete(void) {
+
+        // If the object has been moved (via move constructor or move assignment
+        // operator) then there's no need to delete the memory here.
+        if (table == nullptr) {
+            return;
+        }
+
+        deleteTable(table, sizing.size());
+    }
+
+    /**
+     * Grow the table until every entry and the carried one fit, at most
+     * MAX_GROWTHS times. Entries are copied rather than moved, so the old
+     * table is intact if a size doesn't work out. If none does the old table
+     * is put back and std::length_error thrown: growing can't separate keys
+     * whose hashes are equal, however large the table gets.
+     */
+    void growAndPlace(K& carriedKey, V& carriedValue) {
+
+        Bucket* oldTable = table;
+        SizePolicy oldSizing = sizing;
+
+        try {
+            for (unsigned int growth = 0; growth < MAX_GROWTHS; growth++) {
+
+                sizing.grow();
+                table = allocateTable(sizing.size());
+
+                if (placeAll(oldTable, oldSizing) && place(carriedKey, carriedValue)) {
+                    deleteTable(oldTable, oldSizing.size());
+                    return;
+                }
+
+                deleteTable(table, sizing.size());
+                table = oldTable;
+            }
+        } catch (...) {
+            if (table != oldTable) {
+                deleteTable(table, sizing.size());
+            }
+            table = oldTable;
+            sizing = oldSizing;
+            throw;
+        }
+
+        sizing = oldSizing;
+        throw std::length_error("CuckooHashTable found no room for a key, even after growing. "
+                        "Too many keys have the same hash.");
+    }
+
+    // Place a copy of every entry of fromTable in the table, false as soon as one doesn't fit
+    bool placeAll(const Bucket* fromTable, const SizePolicy& fromSizing) {
+
+        for (unsigned int i = 0; i < fromSizing.size(); i++) {
+            for (unsigned int slot = 0; slot < CUCKOO_SLOTS_PER_BUCKET; slot++) {
+                if (fromTable[i].used(slot)) {
+                    K key(fromTable[i].key(slot));
+                    V value(fromTable[i].value(slot));
+                    if (!place(key, value)) {
+                        return false;
+                    }
+                }
+            }
+        }
+
+        return true;
+    }
+
+    SizePolicy sizing;
+    unsigned int size;
+    Bucket* table;
+};
+
+} /* namespace homebrew */
+} /* namespace mjl */
+
+#endif /* CUCKOOHASHTABLE_H */
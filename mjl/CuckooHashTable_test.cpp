@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "CuckooHashTable.h"
+#include "CuckooHashTable_test.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include <stdlib.h>
+
+using namespace std;
+using namespace mjl::homebrew;
+
+// Every key in the reference map must be found with the same value, and a
+// handful of keys known to be absent must not be found.
+static bool matchesReference(CuckooHashTable<int, int>& table, unordered_map<int, int>& reference, int keyRange) {
+
+    for (int key = 0; key < keyRange; key++) {
+
+        bool expected = reference.find(key) != reference.end();
+        bool found = true;
+        int value = 0;
+
+        try {
+            value = table.get(key);
+        } catch (std::out_of_range&) {
+            found = false;
+        }
+
+        if (found != expected || table.contains(key) != expected) {
+            cerr << "Key " << key << " was " << (found ? "" : "not ") << "found but should "
+                            << (expected ? "" : "not ") << "have been.\n";
+            return false;
+        }
+        if (found && value != reference[key]) {
+            cerr << "Key " << key << " has value " << value << " but should be " << reference[key] << ".\n";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// As bad as a hash generator gets: every even key hashes to 0 and every odd one to 1
+class ParityHashGenerator {
+ public:
+    static size_t hash(const int& k) {
+        return (size_t) (k % 2);
+    }
+};
+
+/**
+ * Insert keys from first, step apart, until the table runs out of room. The
+ * table must throw std::length_error within limit keys, without losing or
+ * growing anything. Returns the number of keys that fit, or 0 on a failure.
+ */
+static unsigned int fillUntilFull(CuckooHashTable<int, int, ParityHashGenerator>& table, int first, int step,
+                unsigned int limit) {
+
+    unsigned int inserted = 0;
+    for (; inserted < limit; inserted++) {
+        unsigned int bucketsBefore = table.bucketCount();
+        int key = first + (int) inserted * step;
+        try {
+            table.insert(key, key * 3);
+        } catch (std::length_error&) {
+            if (table.contains(key) || table.bucketCount() != bucketsBefore) {
+                cerr << "A failed insert changed the table.\n";
+                return 0;
+            }
+            break;
+        }
+    }
+    if (inserted == limit) {
+        cerr << "Inserting " << limit << " keys with two hashes between them never failed.\n";
+        return 0;
+    }
+
+    for (unsigned int i = 0; i < inserted; i++) {
+        int key = first + (int) i * step;
+        if (!table.contains(key) || table.get(key) != key * 3) {
+            cerr << "Key " << key << " was lost while looking for room.\n";
+            return 0;
+        }
+    }
+    return inserted;
+}
+
+bool runCuckooHashTableTests(void) {
+    const int TEST_SIZE = 1000;
+    const int KEY_RANGE = 2000;
+
+    CuckooHashTable<int, int> myHash;
+    unordered_map<int, int> stdHash;
+
+    cout << "Inserting " << TEST_SIZE << " entries into cuckoo hash table.\n";
+    for (int i = 0; i < TEST_SIZE; i++) {
+        myHash.insert(i, i * 3);
+        stdHash[i] = i * 3;
+    }
+    if (!matchesReference(myHash, stdHash, KEY_RANGE)) {
+        return false;
+    }
+
+    cout << "Replacing the value of existing entries.\n";
+    for (int i = 0; i < TEST_SIZE; i += 7) {
+        myHash.insert(i, -i);
+        stdHash[i] = -i;
+    }
+    if (!matchesReference(myHash, stdHash, KEY_RANGE)) {
+        return false;
+    }
+
+    cout << "Removing every other entry, and entries that are not there.\n";
+    for (int i = 0; i < KEY_RANGE; i += 2) {
+        bool removed = myHash.remove(i);
+        bool expected = stdHash.erase(i) == 1;
+        if (removed != expected) {
+            cerr << "remove(" << i << ") returned " << removed << " but should be " << expected << ".\n";
+            return false;
+        }
+    }
+    if (!matchesReference(myHash, stdHash, KEY_RANGE)) {
+        return false;
+    }
+
+    // Random inserts and removes in a range the table fills up on, so entries keep getting displaced
+    cout << "Mixed random inserts and removes.\n";
+    CuckooHashTable<int, int> mixedHash;
+    unordered_map<int, int> mixedStdHash;
+    srand(1234);
+    for (int i = 0; i < 100000; i++) {
+        int key = rand() % KEY_RANGE;
+        if (rand() % 3 != 0) {
+            mixedHash.insert(key, i);
+            mixedStdHash[key] = i;
+        } else {
+            mixedHash.remove(key);
+            mixedStdHash.erase(key);
+        }
+    }
+    if (!matchesReference(mixedHash, mixedStdHash, KEY_RANGE)) {
+        return false;
+    }
+
+    // The table only grows when displacing fails, which with 4 way buckets is well past 90% full
+    cout << "Checking the load factor the table grows at.\n";
+    CuckooHashTable<int, int> loadHash;
+    unsigned int growths = 0;
+    for (int i = 0; i < 200000; i++) {
+        float loadBefore = loadHash.loadFactor();
+        unsigned int bucketsBefore = loadHash.bucketCount();
+        loadHash.insert(i, i);
+        if (loadHash.bucketCount() != bucketsBefore) {
+            cout << "Grew from " << bucketsBefore << " buckets at load factor " << loadBefore << "\n";
+            if (loadBefore < 0.85f) {
+                cerr << "Cuckoo hash table grew at load factor " << loadBefore << ".\n";
+                return false;
+            }
+            growths++;
+        }
+    }
+    for (int i = 0; i < 200000; i++) {
+        if (loadHash.get(i) != i) {
+            cerr << "Key " << i << " was lost while growing.\n";
+            return false;
+        }
+    }
+    if (growths == 0) {
+        cerr << "Cuckoo hash table never grew.\n";
+        return false;
+    }
+
+    // Keys with the same hash share both buckets, and no size tells them apart
+    cout << "Testing a hash generator that gives every key one of two hashes\n";
+    CuckooHashTable<int, int, ParityHashGenerator> zeroHash;
+    unsigned int zeroCount = fillUntilFull(zeroHash, 0, 2, 100);
+    if (zeroCount != 2 * CUCKOO_SLOTS_PER_BUCKET) {
+        cerr << zeroCount << " keys with a hash of 0 fit, rather than both buckets' worth.\n";
+        return false;
+    }
+    CuckooHashTable<int, int, ParityHashGenerator> parityHash;
+    unsigned int parityCount = fillUntilFull(parityHash, 0, 1, 100);
+    if (parityCount < 2 * CUCKOO_SLOTS_PER_BUCKET) {
+        cerr << "Only " << parityCount << " keys with two hashes between them fit.\n";
+        return false;
+    }
+
+    cout << "Testing string keys\n";
+    CuckooHashTable<string, string> stringHash;
+    for (int i = 0; i < 1000; i++) {
+        stringHash.insert(to_string(i), string(i % 50, 'x'));
+    }
+    for (int i = 0; i < 1000; i += 3) {
+        stringHash.remove(to_string(i));
+    }
+    for (int i = 0; i < 1000; i++) {
+        if (stringHash.contains(to_string(i)) != (i % 3 != 0)
+                        || (i % 3 != 0 && stringHash.get(to_string(i)) != string(i % 50, 'x'))) {
+            cerr << "String key " << i << " is wrong.\n";
+            return false;
+        }
+    }
+
+    cout << "Testing copy constructor and assignment operator\n";
+    CuckooHashTable<int, int> myHash2(myHash);
+    if (!matchesReference(myHash2, stdHash, KEY_RANGE)) {
+        return false;
+    }
+    CuckooHashTable<int, int> myHash3;
+    myHash3 = myHash2;
+    if (!matchesReference(myHash3, stdHash, KEY_RANGE)) {
+        return false;
+    }
+
+    cout << "Testing move constructor and move assignment operator\n";
+    CuckooHashTable<int, int> myHash4(std::move(myHash2));
+    if (!matchesReference(myHash4, stdHash, KEY_RANGE)) {
+        return false;
+    }
+    CuckooHashTable<int, int> myHash5;
+    myHash5 = std::move(myHash3);
+    if (!matchesReference(myHash5, stdHash, KEY_RANGE)) {
+        return false;
+    }
+
+    return true;
+}
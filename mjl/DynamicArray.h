@@ -21,12 +21,23 @@
  */
 #ifndef DYNAMIC_ARRAY_H
 #define DYNAMIC_ARRAY_H
+
+#include "DynamicArrayGrowthPolicy.h"
+#include "DynamicArrayStoragePolicy.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
 #include <limits>
-#include <sstream>
+#include <new>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
+#include <utility>
+
+#include <stdlib.h>
 
-using std::ostringstream;
 using std::string;
 
 namespace mjl {
@@ -36,197 +47,279 @@ namespace homebrew {
  * Table of contents *
  *********************
  *
- * DynamicArray<T>::iterator class
+ * IsTriviallyRelocatable<T> class
  *
- *     DynamicArray<T>::iterator(DynamicArray<T>& theParent, unsigned int index)
- *     iterator& operator=(const iterator& rhs)
- *     T& operator*()
- *     iterator& operator++()
- *     iterator operator++(int)
- *     bool operator==(const iterator& it) const
- *     bool operator!=(const iterator& it) const
+ * DynamicArrayIterator<Element> class
  *
- * DynamicArray<T> class
+ *     DynamicArrayIterator(Element* element)
+ *     DynamicArrayIterator(const DynamicArrayIterator<Other>& from)
+ *     Element& operator*() const
+ *     Element* operator->() const
+ *     Element& operator[](difference_type n) const
+ *     ++, --, +=, -=, +, - (prefix and postfix, iterator and distance)
+ *     ==, !=, <, >, <=, >=
  *
+ * DynamicArray<T, GrowthPolicy, StoragePolicy> class
+ *
+ *     DynamicArray()
+ *     DynamicArray(unsigned int count, const T& data)
  *     DynamicArray(const DynamicArray& from)
  *     DynamicArray(DynamicArray&& from)
  *     DynamicArray& operator=(const DynamicArray& from)
  *     DynamicArray& operator=(DynamicArray&& from)
- *     DynamicArray(DynamicArray<T>::iterator& start, DynamicArray<T>::iterator& end)
+ *     DynamicArray(const_iterator start, const_iterator end)
  *     virtual ~DynamicArray()
  *
- *     DynamicArray<T>::iterator begin(void)
- *     DynamicArray<T>::iterator end(void)
+ *     iterator begin(void)
+ *     iterator end(void)
+ *     const_iterator begin(void) const
+ *     const_iterator end(void) const
+ *     const_iterator cbegin(void) const
+ *     const_iterator cend(void) const
+ *     T* data(void)
+ *     const T* data(void) const
  *     T& operator[](unsigned int i)
  *     const T& operator[](unsigned int i) const
- *     void append(T data)
- *	   int size(void)
- *     int capacity(void)
+ *     void append(const T& data)
+ *     void append(T&& data)
+ *     void push_back(const T& data)
+ *     void push_back(T&& data)
+ *     T& emplace_back(Args&&... args)
+ *     void append(InputIterator start, InputIterator end)
+ *     void reserve(unsigned int count)
+ *     unsigned int size(void) const
+ *     unsigned int capacity(void) const
  *     void clear(void)
  *
  */
 
-template<typename T> class DynamicArray {
+/**
+ * A type is trivially relocatable if moving an object to a new address and
+ * forgetting the old one is the same as copying its bytes. Every trivially
+ * copyable type is. Many others are too, like std::unique_ptr or a class
+ * that owns a heap buffer, and can say so by specializing this class. A
+ * DynamicArray of a trivially relocatable type grows with its storage
+ * policy's reallocate (realloc, by default), which can often extend the block
+ * in place and never runs a constructor.
+ *
+ * A type that stores a pointer into itself (like a std::string holding a
+ * short string inline, in some standard libraries) is not trivially
+ * relocatable.
+ */
+template<typename T> struct IsTriviallyRelocatable : std::is_trivially_copyable<T> {
+};
+
+/**
+ * An iterator over the elements of a DynamicArray. The elements are
+ * contiguous, so the iterator is just a pointer to one of them with the
+ * random access iterator operations wrapped around it: it costs nothing
+ * over a raw pointer, the standard algorithms can jump around with it, and
+ * the compiler can vectorize loops over it. Element is const T for a
+ * const_iterator, and an iterator converts to a const_iterator.
+ *
+ * Like a pointer, it is not bounds checked and is invalidated when the
+ * array reallocates.
+ */
+template<typename Element> class DynamicArrayIterator {
  public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef typename std::remove_const<Element>::type value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef Element* pointer;
+    typedef Element& reference;
+
+    DynamicArrayIterator()
+                    : current(nullptr) {
+    }
 
-    // FIXME: Is this really the best way to get the range constructor to work?
-    friend class iterator;
+    explicit DynamicArrayIterator(Element* element)
+                    : current(element) {
+    }
 
-    class iterator {
-     public:
+    // An iterator converts to a const_iterator, but not the other way around
+    template<typename Other, typename = typename std::enable_if<std::is_convertible<Other*, Element*>::value>::type>
+    DynamicArrayIterator(const DynamicArrayIterator<Other>& from)
+                    : current(from.operator->()) {
+    }
 
-        iterator(DynamicArray<T>& theParent, unsigned int index)
-                        : parent(theParent),
-                          currentIndex(0) {
+    reference operator*() const {
+        return *current;
+    }
 
-            ostringstream oss;
+    pointer operator->() const {
+        return current;
+    }
 
-            if (index <= theParent.theSize) {
-                currentIndex = index;
-            } else {
-                oss << "Attempted to create iterator to element " << index << " but DynamicArray has theSize="
-                                << theParent.theSize;
-                throw std::out_of_range(string(oss.str()));
-            }
-        }
+    reference operator[](difference_type n) const {
+        return current[n];
+    }
 
-        // Copy assignment operator
-        iterator& operator=(const iterator& rhs) {
-            this->parent = rhs.parent;
-            this->currentIndex = rhs.currentIndex;
-            return *this;
-        }
+    // Prefix increment operator (++c)
+    DynamicArrayIterator& operator++() {
+        ++current;
+        return *this;
+    }
 
-        // Dereference operator
-        T& operator*() {
-            return parent.array[currentIndex];
-        }
+    // Postfix increment operator (c++), which returns where the iterator was
+    DynamicArrayIterator operator++(int) {
+        DynamicArrayIterator before(*this);
+        ++current;
+        return before;
+    }
 
-        // Prefix increment operator (++c)
-        iterator& operator++() {
-            if (currentIndex < parent.theSize)
-                currentIndex++;
-            return *this;
-        }
+    DynamicArrayIterator& operator--() {
+        --current;
+        return *this;
+    }
 
-        // Postfix increment operator (c++)
-        iterator operator++(int) {
-            if (currentIndex < parent.theSize)
-                currentIndex++;
-            return *this;
-        }
+    DynamicArrayIterator operator--(int) {
+        DynamicArrayIterator before(*this);
+        --current;
+        return before;
+    }
 
-        bool operator==(const iterator& it) const {
-            // If iterator points to same spot of same object they are equal
-            if (&it.parent == &this->parent && it.currentIndex == this->currentIndex)
-                return true;
-            else
-                return false;
-        }
+    DynamicArrayIterator& operator+=(difference_type n) {
+        current += n;
+        return *this;
+    }
 
-        bool operator!=(const iterator& it) const {
-            if (&it.parent == &this->parent && it.currentIndex == this->currentIndex)
-                return false;
-            else
-                return true;
-        }
+    DynamicArrayIterator& operator-=(difference_type n) {
+        current -= n;
+        return *this;
+    }
+
+    friend DynamicArrayIterator operator+(DynamicArrayIterator it, difference_type n) {
+        return it += n;
+    }
+
+    friend DynamicArrayIterator operator+(difference_type n, DynamicArrayIterator it) {
+        return it += n;
+    }
+
+    friend DynamicArrayIterator operator-(DynamicArrayIterator it, difference_type n) {
+        return it -= n;
+    }
+
+    // The comparisons take any mix of iterator and const_iterator
+    template<typename Other> difference_type operator-(const DynamicArrayIterator<Other>& rhs) const {
+        return current - rhs.operator->();
+    }
+
+    template<typename Other> bool operator==(const DynamicArrayIterator<Other>& rhs) const {
+        return current == rhs.operator->();
+    }
+
+    template<typename Other> bool operator!=(const DynamicArrayIterator<Other>& rhs) const {
+        return current != rhs.operator->();
+    }
+
+    template<typename Other> bool operator<(const DynamicArrayIterator<Other>& rhs) const {
+        return current < rhs.operator->();
+    }
+
+    template<typename Other> bool operator>(const DynamicArrayIterator<Other>& rhs) const {
+        return current > rhs.operator->();
+    }
+
+    template<typename Other> bool operator<=(const DynamicArrayIterator<Other>& rhs) const {
+        return current <= rhs.operator->();
+    }
+
+    template<typename Other> bool operator>=(const DynamicArrayIterator<Other>& rhs) const {
+        return current >= rhs.operator->();
+    }
+
+ private:
+    Element* current;
+};
 
-     private:
-        DynamicArray<T>& parent;
-        unsigned int currentIndex;
-    };
+/**
+ * An array that grows as elements are appended. Storage is raw memory, and
+ * only the elements that are in the array are ever constructed: appending
+ * constructs the new element in place, and growing moves the elements over
+ * (or, for trivially relocatable types, reallocates the block) without
+ * constructing anything else. How much the storage grows by is decided by
+ * the GrowthPolicy (see DynamicArrayGrowthPolicy.h), and where it comes from
+ * by the StoragePolicy (see DynamicArrayStoragePolicy.h).
+ */
+template<typename T, typename GrowthPolicy = DoublingGrowthPolicy, typename StoragePolicy = MallocStorage>
+class DynamicArray {
+ public:
+    static_assert(alignof(T) <= StoragePolicy::ALIGNMENT, "The storage policy can't align storage for T");
+
+    typedef DynamicArrayIterator<T> iterator;
+    typedef DynamicArrayIterator<const T> const_iterator;
 
     DynamicArray()
-                    : theSize(0),
-                      theCapacity(initialArrayCapacity) {
-        array = new T[initialArrayCapacity];
-        theCapacity = initialArrayCapacity;    // FIXME: why is initializer list failing making this necessary?
+                    : array(nullptr),
+                      theSize(0),
+                      theCapacity(0) {
     }
 
     // Initialize count copies of data
     DynamicArray(unsigned int count, const T& data)
                     : array(nullptr),
-                      theSize(count),
-                      theCapacity(initialArrayCapacity) {
-
-        // The number of bits in an int - the number of bits required to represent initialArrayCapacity = 8;
-        const unsigned int shiftLimit = std::numeric_limits<unsigned int>::digits - 4;
+                      theSize(0),
+                      theCapacity(0) {
 
-        // Find next power of two that is >= count
-        unsigned int n = theCapacity;
-        unsigned int shifts = 0;
+        reserve(count);
 
-        // The shift limit is used to avoid overflow
-        while (n < count && shifts < shiftLimit) {
-            n = n << 1;    // Left shift 1 in order to multiply by 2
-            shifts++;    // Keep track of how many times we have shifted
-        }
-
-        // Allocate n T with default constructor
-        array = new T[n];
-
-        // Copy data to newly allocated objects (object T's copy assignment operator is used)
         for (unsigned int i = 0; i < count; i++) {
-            array[i] = data;
+            push_back(data);
         }
     }
 
-    // Range constructor
-    DynamicArray(DynamicArray<T>::iterator& start, DynamicArray<T>::iterator& end) {
-
-        theSize = end.currentIndex - start.currentIndex + 1;
-        theCapacity = start.parent.capacity();
+    // Range constructor, copies the elements from start up to (but not including) end
+    DynamicArray(const_iterator start, const_iterator end)
+                    : array(nullptr),
+                      theSize(0),
+                      theCapacity(0) {
 
-        array = new T[size];
+        reserve(end - start);
 
-        for (int i = 0; start != end; start++) {
-            array[i] = *start;
+        for (; start != end; ++start) {
+            push_back(*start);
         }
     }
 
     // Copy constructor
-    DynamicArray(const DynamicArray& from) {
-
-        this->theSize = from.theSize;
-        this->theCapacity = from.theCapacity;
+    DynamicArray(const DynamicArray& from)
+                    : array(nullptr),
+                      theSize(0),
+                      theCapacity(0) {
 
-        array = new T[from.theCapacity];
+        reserve(from.theSize);
 
         for (unsigned int i = 0; i < from.theSize; i++) {
-            array[i] = from.array[i];
+            push_back(from.array[i]);
         }
     }
 
     // Move constructor
-    DynamicArray(DynamicArray&& from) noexcept {
-
-        theSize = from.theSize;
-        theCapacity = from.theCapacity;
-        array = from.array;
+    DynamicArray(DynamicArray&& from) noexcept
+                    : array(from.array),
+                      theSize(from.theSize),
+                      theCapacity(from.theCapacity) {
         from.array = nullptr;
+        from.theSize = 0;
+        from.theCapacity = 0;
     }
 
     // Copy assignment operator
     DynamicArray& operator=(const DynamicArray& from) {
 
-        // Case 1: from.theSize < this.theSize
-        // Case 2: from.theSize == this.theSize
-        // Case 3: from.size > this.theSize
+        if (this == &from) {
+            return *this;
+        }
 
-        // Allocate enough memory to hold new array
-        T* temp = new T[from.theCapacity];
+        // Keep the storage if it is large enough already
+        clear();
+        reserve(from.theSize);
 
-        // Copy over the data
         for (unsigned int i = 0; i < from.theSize; i++) {
-            temp[i] = from.array[i];
+            push_back(from.array[i]);
         }
 
-        // Free up the old memory
-        delete[] array;
-
-        // Assign new memory
-        array = temp;
-
         return *this;
     }
 
@@ -234,29 +327,57 @@ template<typename T> class DynamicArray {
     DynamicArray& operator=(DynamicArray&& from) noexcept {
 
         if (this == &from) {
-            return *from;
+            return *this;
         }
 
+        commonDelete();
+
+        array = from.array;
         theSize = from.theSize;
         theCapacity = from.theCapacity;
 
-        delete[] array;
-        array = from.array;
         from.array = nullptr;
+        from.theSize = 0;
+        from.theCapacity = 0;
 
         return *this;
     }
 
     virtual ~DynamicArray() {
-        delete array;
+        commonDelete();
+    }
+
+    iterator begin(void) {
+        return iterator(array);
+    }
+
+    iterator end(void) {
+        return iterator(array + theSize);
+    }
+
+    const_iterator begin(void) const {
+        return const_iterator(array);
+    }
+
+    const_iterator end(void) const {
+        return const_iterator(array + theSize);
+    }
+
+    const_iterator cbegin(void) const {
+        return begin();
     }
 
-    DynamicArray<T>::iterator begin(void) {
-        return DynamicArray<T>::iterator(*this, 0);
+    const_iterator cend(void) const {
+        return end();
     }
 
-    DynamicArray<T>::iterator end(void) {
-        return DynamicArray<T>::iterator(*this, theSize);
+    // The elements are contiguous, starting here. nullptr if nothing was ever allocated.
+    T* data(void) {
+        return array;
+    }
+
+    const T* data(void) const {
+        return array;
     }
 
     T& operator[](unsigned int i) {
@@ -267,42 +388,221 @@ template<typename T> class DynamicArray {
         return array[i];
     }
 
-    void append(T data) {
+    void append(const T& data) {
+        emplace_back(data);
+    }
 
-        if (theSize + 1 > theCapacity) {
+    void append(T&& data) {
+        emplace_back(std::move(data));
+    }
 
-            // Expand the array if necessary
-            theCapacity *= 2;
-            T* oldArray = array;
-            array = new T[theCapacity];
-            for (unsigned int i = 0; i < theSize; i++) {
-                array[i] = oldArray[i];
-            }
-            delete[] oldArray;
+    void push_back(const T& data) {
+        emplace_back(data);
+    }
+
+    void push_back(T&& data) {
+        emplace_back(std::move(data));
+    }
+
+    /**
+     * Construct a new element at the end from whatever arguments its
+     * constructor takes, and return it. The arguments may refer to elements
+     * of the array itself.
+     */
+    template<typename... Args> T& emplace_back(Args&&... args) {
+
+        if (theSize == theCapacity) {
+            return growAndEmplace(IsTriviallyRelocatable<T>(), std::forward<Args>(args)...);
         }
 
-        array[theSize] = data;
-        theSize++;
+        new (&array[theSize]) T(std::forward<Args>(args)...);
+        return array[theSize++];
+    }
+
+    /**
+     * Append copies of the elements from start up to (but not including)
+     * end. When the length of the range is known up front the storage grows
+     * at most once, by at least as much as the growth policy would, so
+     * appending many short ranges stays cheap. The range must not come from
+     * the array itself.
+     */
+    template<typename InputIterator> void append(InputIterator start, InputIterator end) {
+        appendRange(start, end, typename std::iterator_traits<InputIterator>::iterator_category());
+    }
+
+    // Make room for count elements in total, so appending up to there never reallocates
+    void reserve(unsigned int count) {
+        if (count > theCapacity) {
+            reallocate(count, IsTriviallyRelocatable<T>());
+        }
     }
 
-    unsigned int size(void) {
+    unsigned int size(void) const {
         return theSize;
     }
 
-    unsigned int capacity(void) {
+    unsigned int capacity(void) const {
         return theCapacity;
     }
 
+    // Destroy every element, but keep the storage for reuse
     void clear(void) {
-        delete[] array;
-        array = new T[theCapacity];
+        destroyElements();
+        theSize = 0;
     }
 
  private:
+
+    template<typename InputIterator> void appendRange(InputIterator start, InputIterator end,
+                    std::input_iterator_tag) {
+        for (; start != end; ++start) {
+            emplace_back(*start);
+        }
+    }
+
+    template<typename ForwardIterator> void appendRange(ForwardIterator start, ForwardIterator end,
+                    std::forward_iterator_tag) {
+
+        unsigned int needed = theSize + (unsigned int) std::distance(start, end);
+        if (needed > theCapacity) {
+            reallocate(std::max(needed, nextCapacity()), IsTriviallyRelocatable<T>());
+        }
+
+        // Working in locals, which the new elements can't alias, lets a copy of plain values become a memcpy
+        T* elements = array;
+        unsigned int size = theSize;
+        try {
+            for (; start != end; ++start) {
+                new (&elements[size]) T(*start);
+                size++;
+            }
+        } catch (...) {
+            theSize = size;
+            throw;
+        }
+        theSize = size;
+    }
+
+    // The capacity after the next growth. An empty array starts with initialArrayCapacity.
+    unsigned int nextCapacity(void) const {
+        return (theCapacity < initialArrayCapacity) ? initialArrayCapacity : GrowthPolicy::grow(theCapacity);
+    }
+
+    /**
+     * The arguments may refer to an element, which realloc is about to move,
+     * so the new element is built on the side first and its bytes moved into
+     * place afterwards.
+     */
+    template<typename... Args> T& growAndEmplace(std::true_type, Args&&... args) {
+
+        alignas(T) unsigned char pending[sizeof(T)];
+        T* element = new (pending) T(std::forward<Args>(args)...);
+
+        try {
+            reallocate(nextCapacity(), std::true_type());
+        } catch (...) {
+            element->~T();
+            throw;
+        }
+
+        memcpy(static_cast<void*>(&array[theSize]), pending, sizeof(T));
+        return array[theSize++];
+    }
+
+    // The new element is built in the new storage before the old elements move out from under the arguments
+    template<typename... Args> T& growAndEmplace(std::false_type, Args&&... args) {
+
+        unsigned int newCapacity = nextCapacity();
+        T* newArray = allocate(newCapacity);
+
+        try {
+            new (&newArray[theSize]) T(std::forward<Args>(args)...);
+        } catch (...) {
+            deallocate(newArray, newCapacity);
+            throw;
+        }
+
+        try {
+            relocateTo(newArray);
+        } catch (...) {
+            newArray[theSize].~T();
+            deallocate(newArray, newCapacity);
+            throw;
+        }
+
+        theCapacity = newCapacity;
+        return array[theSize++];
+    }
+
+    // A trivially relocatable array can be handed to the storage policy to grow as it is, like realloc
+    void reallocate(unsigned int newCapacity, std::true_type) {
+        array = static_cast<T*>(StoragePolicy::reallocate(static_cast<void*>(array), (size_t) theCapacity * sizeof(T),
+                        (size_t) newCapacity * sizeof(T), (size_t) theSize * sizeof(T)));
+        theCapacity = newCapacity;
+    }
+
+    void reallocate(unsigned int newCapacity, std::false_type) {
+
+        T* newArray = allocate(newCapacity);
+
+        try {
+            relocateTo(newArray);
+        } catch (...) {
+            deallocate(newArray, newCapacity);
+            throw;
+        }
+
+        theCapacity = newCapacity;
+    }
+
+    static T* allocate(unsigned int count) {
+        return static_cast<T*>(StoragePolicy::allocate((size_t) count * sizeof(T)));
+    }
+
+    static void deallocate(T* block, unsigned int count) {
+        StoragePolicy::deallocate(static_cast<void*>(block), (size_t) count * sizeof(T));
+    }
+
+    /**
+     * Move every element into newArray, then destroy and free the old storage.
+     * Elements whose move constructor might throw are copied instead, so if
+     * anything throws the array is left as it was.
+     */
+    void relocateTo(T* newArray) {
+
+        unsigned int i = 0;
+
+        try {
+            for (; i < theSize; i++) {
+                new (&newArray[i]) T(std::move_if_noexcept(array[i]));
+            }
+        } catch (...) {
+            while (i > 0) {
+                newArray[--i].~T();
+            }
+            throw;
+        }
+
+        destroyElements();
+        deallocate(array, theCapacity);
+        array = newArray;
+    }
+
+    void destroyElements(void) {
+        for (unsigned int i = 0; i < theSize; i++) {
+            array[i].~T();
+        }
+    }
+
+    void commonDelete(void) {
+        destroyElements();
+        deallocate(array, theCapacity);
+    }
+
     T* array;
     unsigned int theSize;						// How many elements is the array holding
     unsigned int theCapacity;					// How many elements can be held without resizing
-    static const int initialArrayCapacity = 8;
+    static const unsigned int initialArrayCapacity = 8;
 };
 
 }    // end namespace homebrew
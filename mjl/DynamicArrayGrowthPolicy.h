@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef DYNAMICARRAYGROWTHPOLICY_H
+#define DYNAMICARRAYGROWTHPOLICY_H
+
+#include <limits>
+#include <stdexcept>
+
+namespace mjl {
+namespace homebrew {
+
+/**
+ * A growth policy decides how much larger a DynamicArray's storage gets when
+ * it runs out of room: grow(capacity) returns the next capacity, which is
+ * always larger than capacity. Growing geometrically keeps appends amortized
+ * constant time. A factor of 2 reallocates least often. A factor of 1.5 wastes
+ * less memory, and lets a reallocating allocator reuse the space freed by
+ * earlier, smaller blocks.
+ */
+template<unsigned int Numerator, unsigned int Denominator> class GeometricGrowthPolicy {
+ public:
+    static_assert(Numerator > Denominator, "The array has to get larger when it grows");
+
+    static unsigned int grow(unsigned int capacity) {
+
+        const unsigned int largest = std::numeric_limits<unsigned int>::max();
+
+        if (capacity == largest) {
+            throw std::length_error("DynamicArray can't hold any more elements.");
+        }
+
+        unsigned long long larger = (unsigned long long) capacity * Numerator / Denominator;
+
+        // Small capacities might not grow at all once rounded down
+        if (larger <= capacity) {
+            larger = capacity + 1;
+        }
+
+        return (larger > largest) ? largest : (unsigned int) larger;
+    }
+};
+
+typedef GeometricGrowthPolicy<2, 1> DoublingGrowthPolicy;
+typedef GeometricGrowthPolicy<3, 2> OneAndAHalfGrowthPolicy;
+
+} /* namespace homebrew */
+} /* namespace mjl */
+
+#endif /* DYNAMICARRAYGROWTHPOLICY_H */
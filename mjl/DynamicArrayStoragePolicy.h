@@ -0,0 +1,264 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef DYNAMICARRAYSTORAGEPOLICY_H
+#define DYNAMICARRAYSTORAGEPOLICY_H
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(__linux__)
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace mjl {
+namespace homebrew {
+
+/*********************
+ * Table of contents *
+ *********************
+ *
+ * A storage policy decides where a DynamicArray's elements live. Every
+ * storage policy has the same static interface, which deals in bytes:
+ *
+ *     void* allocate(size_t bytes)             Uninitialized memory, or throw std::bad_alloc
+ *     void* reallocate(void* block, size_t bytes, size_t newBytes, size_t keptBytes)
+ *                                              Grow a block, keeping its first keptBytes
+ *     void deallocate(void* block, size_t bytes)   Give a block back, nullptr is fine
+ *     static const size_t ALIGNMENT            Every block starts on a multiple of this
+ *
+ * MallocStorage                    malloc, realloc and free, the default
+ * AlignedStorage<Alignment>        Blocks aligned to Alignment bytes, like a cache line
+ *
+ * On Linux, for arrays large enough to be worth whole pages of their own:
+ *
+ * MappedStorage<HugePages, Placement>  Anonymous mappings, optionally on 2 MB pages
+ * FirstTouchPlacement              A page goes to the NUMA node of the thread that first writes it
+ * NumaNodePlacement<Node>          Every page goes to NUMA node Node
+ * PageMappedStorage                MappedStorage on ordinary pages, placed by first touch
+ * HugePageStorage                  MappedStorage on huge pages, placed by first touch
+ */
+
+class MallocStorage {
+ public:
+    static const size_t ALIGNMENT = alignof(std::max_align_t);
+
+    static void* allocate(size_t bytes) {
+        void* block = malloc(bytes);
+        if (block == nullptr) {
+            throw std::bad_alloc();
+        }
+        return block;
+    }
+
+    // realloc can often extend the block where it is
+    static void* reallocate(void* block, size_t, size_t newBytes, size_t) {
+        void* newBlock = realloc(block, newBytes);
+        if (newBlock == nullptr) {
+            throw std::bad_alloc();
+        }
+        return newBlock;
+    }
+
+    static void deallocate(void* block, size_t) {
+        free(block);
+    }
+};
+
+/**
+ * Every block starts on a multiple of Alignment bytes. 64 puts the first
+ * element at the start of a cache line, so a vector loop over the elements
+ * never loads across two lines. realloc doesn't keep the alignment, so
+ * growing always copies.
+ */
+template<size_t Alignment> class AlignedStorage {
+ public:
+    static_assert((Alignment & (Alignment - 1)) == 0, "The alignment has to be a power of two");
+    static_assert(Alignment >= sizeof(void*), "posix_memalign can't align to less than a pointer");
+
+    static const size_t ALIGNMENT = Alignment;
+
+    static void* allocate(size_t bytes) {
+        void* block = nullptr;
+        if (posix_memalign(&block, Alignment, bytes) != 0) {
+            throw std::bad_alloc();
+        }
+        return block;
+    }
+
+    static void* reallocate(void* block, size_t, size_t newBytes, size_t keptBytes) {
+        void* newBlock = allocate(newBytes);
+        if (block != nullptr) {
+            memcpy(newBlock, block, keptBytes);
+            free(block);
+        }
+        return newBlock;
+    }
+
+    static void deallocate(void* block, size_t) {
+        free(block);
+    }
+};
+
+typedef AlignedStorage<64> CacheLineAlignedStorage;
+
+#if defined(__linux__)
+
+/**
+ * The kernel doesn't give a page any memory until it is first written, and
+ * then gives it memory on the NUMA node of the CPU doing the writing. So an
+ * array that is filled in by the threads that are going to use it ends up
+ * next to them.
+ */
+class FirstTouchPlacement {
+ public:
+    static void place(void*, size_t) {
+    }
+};
+
+/**
+ * Bind every page to NUMA node Node with mbind, whoever touches it first.
+ * This is a request like any other madvise: if the kernel turns it down (no
+ * such node, or a container that doesn't allow mbind) the array still works,
+ * and its pages go wherever first touch puts them.
+ */
+template<unsigned int Node> class NumaNodePlacement {
+ public:
+    static void place(void* block, size_t bytes) {
+
+        const size_t bitsPerWord = sizeof(unsigned long) * 8;
+        unsigned long nodes[Node / bitsPerWord + 1] = { };
+        nodes[Node / bitsPerWord] = 1UL << (Node % bitsPerWord);
+
+        // The kernel reads one bit fewer than the maximum node it is told
+        syscall(SYS_mbind, block, bytes, MPOL_BIND, nodes, sizeof(nodes) * 8 + 1, 0);
+    }
+};
+
+/**
+ * Every block is its own anonymous mapping, which the kernel fills in a page
+ * at a time as it is first written, wherever Placement says. Growing a block
+ * asks the kernel to move its pages to a larger mapping (with mremap), which
+ * doesn't copy any elements however large the array is. Block sizes are
+ * rounded up to whole pages, so this is only for arrays of at least tens of
+ * kilobytes.
+ *
+ * With HugePages, blocks are also rounded and aligned to 2 MB and marked
+ * with madvise(MADV_HUGEPAGE), so that the kernel backs them with
+ * transparent huge pages where it can. One TLB entry then covers 512 times
+ * as much of the array, which matters when it is gigabytes large and read in
+ * no particular order. Whether the kernel obliges is up to how transparent
+ * huge pages are set up (see /sys/kernel/mm/transparent_hugepage); if it
+ * doesn't, the block is simply made of ordinary pages.
+ */
+template<bool HugePages, typename Placement = FirstTouchPlacement> class MappedStorage {
+ public:
+    static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+    static const size_t ALIGNMENT = HugePages ? HUGE_PAGE_SIZE : 4096;
+
+    static void* allocate(size_t bytes) {
+
+        size_t size = roundUp(bytes);
+        size_t extra = HugePages ? HUGE_PAGE_SIZE : 0;
+
+        char* mapping = static_cast<char*>(mmap(nullptr, size + extra, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if (mapping == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+
+        // mmap only aligns to a page, so map one huge page more than needed and unmap what sticks out either side
+        char* block = mapping;
+        if (HugePages) {
+            uintptr_t aligned = ((uintptr_t) mapping + HUGE_PAGE_SIZE - 1) & ~(uintptr_t) (HUGE_PAGE_SIZE - 1);
+            block = reinterpret_cast<char*>(aligned);
+            if (block != mapping) {
+                munmap(mapping, block - mapping);
+            }
+            if (block + size != mapping + size + extra) {
+                munmap(block + size, (mapping + size + extra) - (block + size));
+            }
+            madvise(block, size, MADV_HUGEPAGE);
+        }
+
+        Placement::place(block, size);
+        return block;
+    }
+
+    static void* reallocate(void* block, size_t bytes, size_t newBytes, size_t keptBytes) {
+
+        if (block == nullptr) {
+            return allocate(newBytes);
+        }
+
+        size_t size = roundUp(bytes);
+        size_t newSize = roundUp(newBytes);
+        if (newSize <= size) {
+            return block;
+        }
+
+        // Extending the mapping where it is keeps the block's address, and its advice and placement
+        if (mremap(block, size, newSize, 0) != MAP_FAILED) {
+            return block;
+        }
+
+        /*
+         * Otherwise map a new block, already advised and placed, and move the
+         * old pages over its start. The pages themselves are only remapped,
+         * so huge pages stay huge and nothing is copied.
+         */
+        void* newBlock = allocate(newBytes);
+        if (mremap(block, size, size, MREMAP_MAYMOVE | MREMAP_FIXED, newBlock) == MAP_FAILED) {
+            memcpy(newBlock, block, keptBytes);
+            munmap(block, size);
+        }
+        return newBlock;
+    }
+
+    static void deallocate(void* block, size_t bytes) {
+        if (block != nullptr) {
+            munmap(block, roundUp(bytes));
+        }
+    }
+
+ private:
+    static size_t roundUp(size_t bytes) {
+        static const size_t pageSize = HugePages ? HUGE_PAGE_SIZE : (size_t) sysconf(_SC_PAGESIZE);
+        return (bytes + pageSize - 1) & ~(pageSize - 1);
+    }
+};
+
+typedef MappedStorage<false> PageMappedStorage;
+typedef MappedStorage<true> HugePageStorage;
+
+#endif // __linux__
+
+} /* namespace homebrew */
+} /* namespace mjl */
+
+#endif /* DYNAMICARRAYSTORAGEPOLICY_H */
@@ -0,0 +1,767 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "Benchmark.h"
+#include "DynamicArray.h"
+#include "DynamicArray_benchmark.h"
+#include "MappedDynamicArray.h"
+#include "ParallelAlgorithms.h"
+#include "SimdKernels.h"
+#include "SmallDynamicArray.h"
+#include "SoADynamicArray.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <malloc.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace mjl::homebrew;
+
+// As many elements as fit in this machine's memory several times over, while the array grows
+static const unsigned int SMALL_ELEMENTS = 100000000;
+static const unsigned int LARGE_ELEMENTS = 10000000;
+
+// A gigabyte of 8 byte numbers, to be much larger than the caches and than what the TLB covers
+static const unsigned int STORAGE_ELEMENTS = 128 * 1024 * 1024;
+
+/**
+ * The mapped file benchmark only runs when it is told where to write and
+ * how much: the file named by MJL_MAPPED_ARRAY_PATH, which is overwritten
+ * and then removed, and MJL_MAPPED_ARRAY_MB megabytes of 8 byte numbers,
+ * which should be more than fits in the machine's memory. The element count
+ * is an unsigned int, so no more than 32767, just under 32 GB.
+ */
+static const char* MAPPED_PATH_VARIABLE = "MJL_MAPPED_ARRAY_PATH";
+static const char* MAPPED_MB_VARIABLE = "MJL_MAPPED_ARRAY_MB";
+static const unsigned long long MAX_MAPPED_MB = 32767;
+
+// MallocStorage that counts its allocations in allocationCount, the way operator new counts std::vector's
+class CountingMallocStorage : public MallocStorage {
+ public:
+    static void* allocate(size_t bytes) {
+        allocationCount.fetch_add(1, memory_order_relaxed);
+        return MallocStorage::allocate(bytes);
+    }
+
+    static void* reallocate(void* block, size_t bytes, size_t newBytes, size_t keptBytes) {
+        allocationCount.fetch_add(1, memory_order_relaxed);
+        return MallocStorage::reallocate(block, bytes, newBytes, keptBytes);
+    }
+};
+
+// A trivially copyable element too large to copy for free
+struct LargeElement {
+    LargeElement(void) {
+    }
+
+    explicit LargeElement(unsigned int i) {
+        for (unsigned int word = 0; word < 16; word++) {
+            words[word] = i + word;
+        }
+    }
+
+    unsigned int words[16];
+};
+
+/**
+ * How DynamicArray::append worked before it used raw storage: the element is
+ * passed by value, and every growth default constructs a whole new array and
+ * copy assigns the old elements into it.
+ */
+template<typename T> class LegacyDynamicArray {
+ public:
+    LegacyDynamicArray(void)
+                    : array(new T[8]),
+                      theSize(0),
+                      theCapacity(8) {
+    }
+
+    ~LegacyDynamicArray() {
+        delete[] array;
+    }
+
+    void push_back(T data) {
+        if (theSize + 1 > theCapacity) {
+            theCapacity *= 2;
+            T* oldArray = array;
+            array = new T[theCapacity];
+            for (unsigned int i = 0; i < theSize; i++) {
+                array[i] = oldArray[i];
+            }
+            delete[] oldArray;
+        }
+        array[theSize] = data;
+        theSize++;
+    }
+
+    T& operator[](unsigned int i) {
+        return array[i];
+    }
+
+    unsigned int size(void) const {
+        return theSize;
+    }
+
+ private:
+    T* array;
+    unsigned int theSize;
+    unsigned int theCapacity;
+};
+
+static unsigned int elementValue(const unsigned int& element) {
+    return element;
+}
+
+static unsigned int elementValue(const LargeElement& element) {
+    return element.words[15];
+}
+
+static unsigned int elementValue(const string& element) {
+    return (unsigned int) element.size();
+}
+
+template<typename T> static T makeElement(unsigned int i) {
+    return T(i);
+}
+
+// Short enough to be stored inside the string itself, which is what keeps std::string from being relocated by memcpy
+template<> string makeElement<string>(unsigned int i) {
+    return "element " + to_string(i % 1000);
+}
+
+// Append count elements to an empty Array, and report the time per element
+template<typename Array, typename T> static void benchmarkAppend(const char* name, unsigned int count) {
+    malloc_trim(0);
+    unsigned long long checksum = 0;
+
+    auto start = chrono::steady_clock::now();
+    {
+        Array array;
+        for (unsigned int i = 0; i < count; i++) {
+            array.push_back(makeElement<T>(i));
+        }
+        checksum = array.size() + elementValue(array[count - 1]);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "  " << name << ": " << seconds * 1e9 / count << " ns per element, " << seconds * 1000
+                    << " ms (checksum " << checksum << ")\n";
+}
+
+/**
+ * Build and throw away count arrays of 1 to 15 ints each, summing every
+ * element. Reports the time per array, how many of the arrays allocated at
+ * all, and how many allocations (and reallocations) they made in total. The
+ * arrays have to allocate through operator new or CountingMallocStorage for
+ * that to be counted.
+ */
+template<typename Array> static void benchmarkShortLived(const char* name, unsigned int count) {
+    vector<unsigned int> lengths;
+    srand(1234);
+    for (unsigned int i = 0; i < 4096; i++) {
+        lengths.push_back(1 + rand() % 15);
+    }
+
+    unsigned long long checksum = 0;
+    unsigned int heapArrays = 0;
+    unsigned long long allocationsBefore = allocationCount.load();
+
+    auto start = chrono::steady_clock::now();
+    for (unsigned int i = 0; i < count; i++) {
+        unsigned long long arrayAllocationsBefore = allocationCount.load(memory_order_relaxed);
+        Array array;
+        unsigned int length = lengths[i % lengths.size()];
+        for (unsigned int j = 0; j < length; j++) {
+            array.push_back(i + j);
+        }
+        for (unsigned int j = 0; j < length; j++) {
+            checksum += array[j];
+        }
+        heapArrays += allocationCount.load(memory_order_relaxed) != arrayAllocationsBefore;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "  " << name << ": " << seconds * 1e9 / count << " ns per array, " << heapArrays
+                    << " arrays on the heap, " << allocationCount.load() - allocationsBefore
+                    << " allocations (checksum " << checksum << ")\n";
+}
+
+/**
+ * How DynamicArray::iterator worked before it was a pointer: a reference to
+ * the array and an index, with a bounds check on every increment. Only
+ * forward iteration, so there is no sorting with it.
+ */
+template<typename T> class LegacyIterator {
+ public:
+    LegacyIterator(DynamicArray<T>& theParent, unsigned int index)
+                    : parent(theParent),
+                      currentIndex(index) {
+    }
+
+    T& operator*() {
+        return parent[currentIndex];
+    }
+
+    LegacyIterator& operator++() {
+        if (currentIndex < parent.size())
+            currentIndex++;
+        return *this;
+    }
+
+    bool operator!=(const LegacyIterator& it) const {
+        return &it.parent != &parent || it.currentIndex != currentIndex;
+    }
+
+ private:
+    DynamicArray<T>& parent;
+    unsigned int currentIndex;
+};
+
+// Written against iterators so the same loop runs over every kind of iterator being compared
+template<typename Iterator> static unsigned int sumRange(Iterator start, Iterator end) {
+    unsigned int sum = 0;
+    for (; start != end; ++start) {
+        sum += *start;
+    }
+    return sum;
+}
+
+template<typename Iterator> static void transformRange(Iterator start, Iterator end, Iterator out) {
+    for (; start != end; ++start, ++out) {
+        *out = *start * 3 + 1;
+    }
+}
+
+static void reportPasses(const char* name, chrono::steady_clock::time_point start, unsigned long long elements,
+                unsigned long long checksum) {
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "  " << name << ": " << seconds * 1e9 / elements << " ns per element, " << seconds * 1000
+                    << " ms (checksum " << checksum << ")\n";
+}
+
+/**
+ * Sum and transform an array small enough to stay in cache, over and over,
+ * through a raw pointer, through the DynamicArray iterators and through the
+ * old index based iterator. The loop body is the same for all of them, so
+ * any difference is whether the compiler could see through the iterator and
+ * vectorize it.
+ */
+static void benchmarkIteration(unsigned int count, unsigned int passes) {
+    DynamicArray<unsigned int> input;
+    DynamicArray<unsigned int> output(count, 0);
+    for (unsigned int i = 0; i < count; i++) {
+        input.push_back(i);
+    }
+    unsigned long long elements = (unsigned long long) count * passes;
+
+    // Each pass changes the first element so that no pass can be skipped as a repeat of the last one
+    unsigned long long checksum = 0;
+    auto start = chrono::steady_clock::now();
+    for (unsigned int pass = 0; pass < passes; pass++) {
+        input[0] = pass;
+        checksum += sumRange(input.data(), input.data() + input.size());
+    }
+    reportPasses("sum, raw pointer", start, elements, checksum);
+
+    checksum = 0;
+    start = chrono::steady_clock::now();
+    for (unsigned int pass = 0; pass < passes; pass++) {
+        input[0] = pass;
+        checksum += sumRange(input.cbegin(), input.cend());
+    }
+    reportPasses("sum, DynamicArray::const_iterator", start, elements, checksum);
+
+    checksum = 0;
+    start = chrono::steady_clock::now();
+    for (unsigned int pass = 0; pass < passes; pass++) {
+        input[0] = pass;
+        checksum += sumRange(LegacyIterator<unsigned int>(input, 0), LegacyIterator<unsigned int>(input, count));
+    }
+    reportPasses("sum, old iterator", start, elements, checksum);
+
+    start = chrono::steady_clock::now();
+    for (unsigned int pass = 0; pass < passes; pass++) {
+        input[0] = pass;
+        transformRange(input.data(), input.data() + input.size(), output.data());
+    }
+    reportPasses("transform, raw pointer", start, elements, output[0] + output[count - 1]);
+
+    start = chrono::steady_clock::now();
+    for (unsigned int pass = 0; pass < passes; pass++) {
+        input[0] = pass;
+        transformRange(input.begin(), input.end(), output.begin());
+    }
+    reportPasses("transform, DynamicArray::iterator", start, elements, output[0] + output[count - 1]);
+
+    start = chrono::steady_clock::now();
+    for (unsigned int pass = 0; pass < passes; pass++) {
+        input[0] = pass;
+        transformRange(LegacyIterator<unsigned int>(input, 0), LegacyIterator<unsigned int>(input, count),
+                        LegacyIterator<unsigned int>(output, 0));
+    }
+    reportPasses("transform, old iterator", start, elements, output[0] + output[count - 1]);
+}
+
+// std::sort the same random numbers through a raw pointer, the DynamicArray iterators and a std::vector
+static void benchmarkSort(unsigned int count) {
+    DynamicArray<unsigned int> random;
+    srand(1234);
+    for (unsigned int i = 0; i < count; i++) {
+        random.push_back((unsigned int) rand());
+    }
+
+    DynamicArray<unsigned int> array(random);
+    auto start = chrono::steady_clock::now();
+    sort(array.data(), array.data() + array.size());
+    reportPasses("raw pointer", start, count, array[count / 2]);
+
+    array = random;
+    start = chrono::steady_clock::now();
+    sort(array.begin(), array.end());
+    reportPasses("DynamicArray::iterator", start, count, array[count / 2]);
+
+    vector<unsigned int> numbers(random.begin(), random.end());
+    start = chrono::steady_clock::now();
+    sort(numbers.begin(), numbers.end());
+    reportPasses("std::vector", start, count, numbers[count / 2]);
+}
+
+// Milliseconds since start, and how many times faster than the one thread time (the first one measured)
+static void reportScaling(const char* name, chrono::steady_clock::time_point start, double& oneThread,
+                unsigned long long checksum) {
+    double milliseconds = chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1000;
+    if (oneThread == 0) {
+        oneThread = milliseconds;
+    }
+    cout << "    " << name << ": " << milliseconds << " ms, " << oneThread / milliseconds << "x (checksum " << checksum
+                    << ")\n";
+}
+
+/**
+ * Run each parallel algorithm over count random unsigned ints on pools of
+ * 1, 2, 4... threads up to one per hardware thread, and report how much
+ * faster each pool is than one thread.
+ */
+static void benchmarkParallelScaling(unsigned int count) {
+    DynamicArray<unsigned int> random;
+    srand(1234);
+    for (unsigned int i = 0; i < count; i++) {
+        random.push_back((unsigned int) rand());
+    }
+
+    vector<unsigned int> threadCounts;
+    for (unsigned int threads = 1; threads < ThreadPool::defaultThreadCount(); threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(ThreadPool::defaultThreadCount());
+
+    double sortOneThread = 0, reduceOneThread = 0, transformOneThread = 0, scanOneThread = 0, forEachOneThread = 0;
+    for (unsigned int threads : threadCounts) {
+        ThreadPool pool(threads);
+        cout << "  " << threads << " threads\n";
+
+        DynamicArray<unsigned int> array(random);
+        auto start = chrono::steady_clock::now();
+        parallelSort(array, less<unsigned int>(), pool);
+        reportScaling("sort", start, sortOneThread, array[count / 2]);
+
+        array = random;
+        start = chrono::steady_clock::now();
+        unsigned long long sum = parallelReduce(array, 0ULL, plus<unsigned long long>(), pool);
+        reportScaling("reduce", start, reduceOneThread, sum);
+
+        start = chrono::steady_clock::now();
+        parallelTransform(random, array, [](unsigned int value) {
+            return value * 3 + 1;
+        }, pool);
+        reportScaling("transform", start, transformOneThread, array[count - 1]);
+
+        start = chrono::steady_clock::now();
+        parallelInclusiveScan(random, array, plus<unsigned int>(), pool);
+        reportScaling("inclusive scan", start, scanOneThread, array[count - 1]);
+
+        start = chrono::steady_clock::now();
+        parallelForEach(array, [](unsigned int& value) {
+            value ^= value >> 7;
+        }, pool);
+        reportScaling("for each", start, forEachOneThread, array[count - 1]);
+    }
+}
+
+// A sales record of the kind an analytics pass goes through, 56 bytes of which a typical pass reads 8 or 12
+struct SaleRecord {
+    uint64_t id;
+    double price;
+    uint32_t quantity;
+    uint32_t category;
+    uint64_t timestamp;
+    uint64_t customer;
+    double discount;
+    uint32_t region;
+    uint32_t flags;
+};
+
+// The same records one column per field, in the order of the SaleRecord members
+typedef SoADynamicArray<uint64_t, double, uint32_t, uint32_t, uint64_t, uint64_t, double, uint32_t, uint32_t>
+                SaleColumns;
+
+/**
+ * Sum one field (the quantity), and sum it over only the rows of one category,
+ * with the records stored as rows (a DynamicArray of structs) and as columns
+ * (a SoADynamicArray). Each is run passes times over count records, too many
+ * to stay in cache, so the time is mostly what it takes to bring the bytes
+ * in from memory. The field is an integer so that the sums vectorize, and
+ * what's left is the memory traffic.
+ */
+static void benchmarkColumnScan(unsigned int count, unsigned int passes) {
+    DynamicArray<SaleRecord> rows;
+    SaleColumns columns;
+    rows.reserve(count);
+    columns.reserve(count);
+    srand(1234);
+    for (unsigned int i = 0; i < count; i++) {
+        SaleRecord record = { i, (double) (rand() % 10000) / 100, (uint32_t) (rand() % 10), (uint32_t) (rand() % 16),
+                        1600000000ULL + i, (uint64_t) rand(), 0.0, (uint32_t) (rand() % 8), 0 };
+        rows.push_back(record);
+        columns.append(record.id, record.price, record.quantity, record.category, record.timestamp, record.customer,
+                        record.discount, record.region, record.flags);
+    }
+    unsigned long long elements = (unsigned long long) count * passes;
+
+    unsigned long long checksum = 0;
+    auto start = chrono::steady_clock::now();
+    for (unsigned int pass = 0; pass < passes; pass++) {
+        const SaleRecord* records = rows.data();
+        unsigned long long sum = 0;
+        for (unsigned int i = 0; i < count; i++) {
+            sum += records[i].quantity;
+        }
+        checksum += sum;
+    }
+    reportPasses("sum of one field, rows", start, elements, checksum);
+
+    checksum = 0;
+    start = chrono::steady_clock::now();
+    for (unsigned int pass = 0; pass < passes; pass++) {
+        ArraySpan<const uint32_t> quantities = static_cast<const SaleColumns&>(columns).column<2>();
+        unsigned long long sum = 0;
+        for (uint32_t quantity : quantities) {
+            sum += quantity;
+        }
+        checksum += sum;
+    }
+    reportPasses("sum of one field, columns", start, elements, checksum);
+
+    checksum = 0;
+    start = chrono::steady_clock::now();
+    for (unsigned int pass = 0; pass < passes; pass++) {
+        const SaleRecord* records = rows.data();
+        unsigned long long sum = 0;
+        for (unsigned int i = 0; i < count; i++) {
+            sum += (records[i].category == 3) ? records[i].quantity : 0;
+        }
+        checksum += sum;
+    }
+    reportPasses("filtered sum, rows", start, elements, checksum);
+
+    checksum = 0;
+    start = chrono::steady_clock::now();
+    for (unsigned int pass = 0; pass < passes; pass++) {
+        const SaleColumns& constColumns = columns;
+        const uint32_t* quantities = constColumns.column<2>().data();
+        const uint32_t* categories = constColumns.column<3>().data();
+        unsigned long long sum = 0;
+        for (unsigned int i = 0; i < count; i++) {
+            sum += (categories[i] == 3) ? quantities[i] : 0;
+        }
+        checksum += sum;
+    }
+    reportPasses("filtered sum, columns", start, elements, checksum);
+}
+
+/**
+ * Run each SIMD kernel over count random numbers from -1000 to 1000, passes
+ * times, at every level this CPU has. The array fits in the L2 cache, so the
+ * times are the kernels' and not the memory's. find looks for a number that
+ * isn't there, so it reads the whole array, and the filter keeps about half.
+ * The scalar level is the plain loops, which the compiler may vectorize on
+ * its own for the instruction set it is building for.
+ */
+template<typename T> static void benchmarkSimdKernels(const char* typeName, unsigned int count, unsigned int passes) {
+    DynamicArray<T> random;
+    srand(1234);
+    for (unsigned int i = 0; i < count; i++) {
+        random.push_back((T) (rand() % 2001 - 1000));
+    }
+    DynamicArray<T> filtered;
+    filtered.reserve(count);
+    unsigned long long elements = (unsigned long long) count * passes;
+
+    for (int level = SIMD_SCALAR; level <= supportedSimdLevel(); level++) {
+        SimdLevel simdLevel = (SimdLevel) level;
+        cout << "  " << typeName << ", " << simdLevelName(simdLevel) << "\n";
+
+        // minmax and sum change an element each pass, so every level starts from the same numbers
+        DynamicArray<T> array(random);
+
+        unsigned long long checksum = 0;
+        auto start = chrono::steady_clock::now();
+        for (unsigned int pass = 0; pass < passes; pass++) {
+            checksum += simdFind(array, (T) (5000 + pass), simdLevel);
+        }
+        reportPasses("  find", start, elements, checksum);
+
+        checksum = 0;
+        start = chrono::steady_clock::now();
+        for (unsigned int pass = 0; pass < passes; pass++) {
+            checksum += simdCount(array, (T) (pass % 100), simdLevel);
+        }
+        reportPasses("  count", start, elements, checksum);
+
+        checksum = 0;
+        start = chrono::steady_clock::now();
+        for (unsigned int pass = 0; pass < passes; pass++) {
+            array[pass % count] = (T) (pass % 1000);
+            pair<T, T> minMax = simdMinMax(array, simdLevel);
+            checksum += (unsigned long long) (minMax.second - minMax.first);
+        }
+        reportPasses("  minmax", start, elements, checksum);
+
+        checksum = 0;
+        start = chrono::steady_clock::now();
+        for (unsigned int pass = 0; pass < passes; pass++) {
+            array[pass % count] = (T) (pass % 1000);
+            checksum += (unsigned long long) simdSum(array, simdLevel);
+        }
+        reportPasses("  sum", start, elements, checksum);
+
+        checksum = 0;
+        start = chrono::steady_clock::now();
+        for (unsigned int pass = 0; pass < passes; pass++) {
+            filtered.clear();
+            simdFilter(array, SIMD_GREATER, (T) (pass % 100), filtered, simdLevel);
+            checksum += filtered.size();
+        }
+        reportPasses("  filter", start, elements, checksum);
+    }
+}
+
+// Whether an array's elements ended up on the heap
+/**
+ * Fill an array of count 8 byte numbers with each storage policy, then read
+ * it from start to end passes times and read count elements at random. The
+ * array is far larger than the caches, so streaming measures memory
+ * bandwidth. Random reads mostly miss the TLB as well as the caches, which
+ * is what huge pages are for, and filling the array includes taking a page
+ * fault for every page of it.
+ */
+template<typename StoragePolicy> static void benchmarkStorage(const char* name, unsigned int count,
+                unsigned int passes) {
+    cout << "  " << name << "\n";
+
+    auto start = chrono::steady_clock::now();
+    DynamicArray<uint64_t, DoublingGrowthPolicy, StoragePolicy> array;
+    for (unsigned int i = 0; i < count; i++) {
+        array.push_back(i);
+    }
+    reportPasses("fill", start, count, array[count - 1]);
+
+    unsigned long long checksum = 0;
+    start = chrono::steady_clock::now();
+    for (unsigned int pass = 0; pass < passes; pass++) {
+        const uint64_t* elements = array.data();
+        unsigned long long sum = 0;
+        for (unsigned int i = 0; i < count; i++) {
+            sum += elements[i];
+        }
+        checksum += sum;
+    }
+    reportPasses("stream", start, (unsigned long long) count * passes, checksum);
+
+    // The indexes come from a xorshift generator, so there is no array of them to read as well
+    checksum = 0;
+    uint32_t state = 2463534242u;
+    start = chrono::steady_clock::now();
+    const uint64_t* elements = array.data();
+    for (unsigned int i = 0; i < count; i++) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        checksum += elements[(uint64_t) state * count >> 32];
+    }
+    reportPasses("random", start, count, checksum);
+}
+
+// Drop whatever the page cache holds of the file at path, so that reading it has to go to the disk
+static void dropFromPageCache(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+/**
+ * Open the file at path read only, with the given access advice, and read
+ * it: from start to end when reads is 0, otherwise reads elements picked at
+ * random. Nothing of the file is cached beforehand.
+ */
+static void readMappedArray(const char* name, const char* path, MappedAccess access, unsigned int reads) {
+    dropFromPageCache(path);
+    MappedDynamicArray<uint64_t> array(path, true);
+    array.adviseAccess(access);
+    const uint64_t* elements = array.data();
+    unsigned int count = array.size();
+
+    unsigned long long checksum = 0;
+    auto start = chrono::steady_clock::now();
+    if (reads == 0) {
+        for (unsigned int i = 0; i < count; i++) {
+            checksum += elements[i];
+        }
+        reads = count;
+    } else {
+        uint32_t state = 2463534242u;
+        for (unsigned int i = 0; i < reads; i++) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            checksum += elements[(uint64_t) state * count >> 32];
+        }
+    }
+    reportPasses(name, start, reads, checksum);
+}
+
+/**
+ * Append bytes worth of 8 byte numbers to a MappedDynamicArray and flush
+ * them to disk, then read the file back from start to end, and read
+ * randomReads elements at random with and without MAPPED_RANDOM. The file
+ * is larger than memory and dropped from the page cache before each read,
+ * so everything comes from the disk. Reading in order, the kernel reads
+ * ahead a large block at a time, while every random read waits for the disk.
+ * By default that wait also reads the pages around the one that is needed,
+ * which MAPPED_RANDOM turns off.
+ */
+static void benchmarkMappedArray(const char* path, unsigned long long bytes, unsigned int randomReads) {
+    unsigned int count = (unsigned int) (bytes / sizeof(uint64_t));
+    remove(path);
+
+    auto start = chrono::steady_clock::now();
+    {
+        MappedDynamicArray<uint64_t> array(path);
+        for (unsigned int i = 0; i < count; i++) {
+            array.push_back(i);
+        }
+        reportPasses("append", start, count, array[count - 1]);
+
+        start = chrono::steady_clock::now();
+        array.flush();
+        reportPasses("flush", start, count, array.size());
+    }
+
+    readMappedArray("sequential, MAPPED_SEQUENTIAL", path, MAPPED_SEQUENTIAL, 0);
+    readMappedArray("random, MAPPED_NORMAL", path, MAPPED_NORMAL, randomReads);
+    readMappedArray("random, MAPPED_RANDOM", path, MAPPED_RANDOM, randomReads);
+
+    remove(path);
+}
+
+// Run benchmarkMappedArray on the file and size given by the environment, see MAPPED_PATH_VARIABLE
+static void benchmarkMappedArrayIfConfigured(void) {
+    const char* mappedPath = getenv(MAPPED_PATH_VARIABLE);
+    const char* mappedMb = getenv(MAPPED_MB_VARIABLE);
+    unsigned long long megabytes = (mappedMb != nullptr) ? strtoull(mappedMb, nullptr, 10) : 0;
+    if (mappedPath == nullptr || megabytes == 0 || megabytes > MAX_MAPPED_MB) {
+        cout << "Skipping the mapped file benchmark. Set " << MAPPED_PATH_VARIABLE << " to a file it may overwrite and "
+                        << MAPPED_MB_VARIABLE << " to a size in MB, from 1 to " << MAX_MAPPED_MB
+                        << ", larger than this machine's memory.\n";
+        return;
+    }
+    cout << "Writing and reading back " << megabytes << " MB of uint64_ts in " << mappedPath << "\n";
+    benchmarkMappedArray(mappedPath, megabytes * 1024 * 1024, 10000);
+}
+
+void runDynamicArrayBenchmarks(void) {
+    cout << "Appending " << SMALL_ELEMENTS << " unsigned ints\n";
+    benchmarkAppend<LegacyDynamicArray<unsigned int>, unsigned int>("old append", SMALL_ELEMENTS);
+    benchmarkAppend<DynamicArray<unsigned int>, unsigned int>("DynamicArray, 2x", SMALL_ELEMENTS);
+    benchmarkAppend<DynamicArray<unsigned int, OneAndAHalfGrowthPolicy>, unsigned int>("DynamicArray, 1.5x",
+                    SMALL_ELEMENTS);
+    benchmarkAppend<vector<unsigned int>, unsigned int>("std::vector", SMALL_ELEMENTS);
+
+    cout << "Appending " << LARGE_ELEMENTS << " 64 byte structs\n";
+    benchmarkAppend<LegacyDynamicArray<LargeElement>, LargeElement>("old append", LARGE_ELEMENTS);
+    benchmarkAppend<DynamicArray<LargeElement>, LargeElement>("DynamicArray, 2x", LARGE_ELEMENTS);
+    benchmarkAppend<DynamicArray<LargeElement, OneAndAHalfGrowthPolicy>, LargeElement>("DynamicArray, 1.5x",
+                    LARGE_ELEMENTS);
+    benchmarkAppend<vector<LargeElement>, LargeElement>("std::vector", LARGE_ELEMENTS);
+
+    cout << "Appending " << LARGE_ELEMENTS << " std::strings\n";
+    benchmarkAppend<LegacyDynamicArray<string>, string>("old append", LARGE_ELEMENTS);
+    benchmarkAppend<DynamicArray<string>, string>("DynamicArray, 2x", LARGE_ELEMENTS);
+    benchmarkAppend<DynamicArray<string, OneAndAHalfGrowthPolicy>, string>("DynamicArray, 1.5x", LARGE_ELEMENTS);
+    benchmarkAppend<vector<string>, string>("std::vector", LARGE_ELEMENTS);
+
+    cout << "Creating and destroying " << SMALL_ELEMENTS / 10 << " arrays of 1 to 15 unsigned ints\n";
+    benchmarkShortLived<DynamicArray<unsigned int, DoublingGrowthPolicy, CountingMallocStorage>>("DynamicArray",
+                    SMALL_ELEMENTS / 10);
+    benchmarkShortLived<SmallDynamicArray<unsigned int, 16, DoublingGrowthPolicy, CountingMallocStorage>>(
+                    "SmallDynamicArray<16>", SMALL_ELEMENTS / 10);
+    benchmarkShortLived<SmallDynamicArray<unsigned int, 8, DoublingGrowthPolicy, CountingMallocStorage>>(
+                    "SmallDynamicArray<8>", SMALL_ELEMENTS / 10);
+    benchmarkShortLived<vector<unsigned int>>("std::vector", SMALL_ELEMENTS / 10);
+
+    cout << "Summing and transforming 65536 unsigned ints 2000 times\n";
+    benchmarkIteration(65536, 2000);
+
+    cout << "Sorting " << LARGE_ELEMENTS << " random unsigned ints\n";
+    benchmarkSort(LARGE_ELEMENTS);
+
+    cout << "Parallel algorithms over " << LARGE_ELEMENTS << " random unsigned ints\n";
+    benchmarkParallelScaling(LARGE_ELEMENTS);
+
+    cout << "Scanning " << LARGE_ELEMENTS / 2 << " 56 byte records 10 times, stored as rows and as columns\n";
+    benchmarkColumnScan(LARGE_ELEMENTS / 2, 10);
+
+    cout << "SIMD kernels over 32768 numbers 20000 times, at each instruction set this CPU has\n";
+    benchmarkSimdKernels<int>("int", 32768, 20000);
+    benchmarkSimdKernels<float>("float", 32768, 20000);
+
+    cout << "Filling, streaming and reading at random " << STORAGE_ELEMENTS << " uint64_ts with each storage policy\n";
+    benchmarkStorage<MallocStorage>("MallocStorage", STORAGE_ELEMENTS, 5);
+    benchmarkStorage<CacheLineAlignedStorage>("CacheLineAlignedStorage", STORAGE_ELEMENTS, 5);
+#if defined(__linux__)
+    benchmarkStorage<PageMappedStorage>("PageMappedStorage", STORAGE_ELEMENTS, 5);
+    benchmarkStorage<HugePageStorage>("HugePageStorage", STORAGE_ELEMENTS, 5);
+    benchmarkStorage<MappedStorage<true, NumaNodePlacement<0>>>("HugePageStorage on NUMA node 0", STORAGE_ELEMENTS, 5);
+#endif
+
+    benchmarkMappedArrayIfConfigured();
+}
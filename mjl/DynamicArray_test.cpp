@@ -22,12 +22,318 @@
 #include "DynamicArray.h"
 #include "DynamicArray_test.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <iterator>
+#include <numeric>
+#include <memory>
+#include <string>
 #include <vector>
 
 using namespace std;
 using namespace mjl::homebrew;
 
+// A unique_ptr only holds a pointer, so its bytes can be moved like any other pointer
+namespace mjl {
+namespace homebrew {
+template<> struct IsTriviallyRelocatable<unique_ptr<int>> : std::true_type {
+};
+}
+}
+
+// Counts how elements are made, to check that growing moves them and nothing is left behind
+class LifetimeCounter {
+ public:
+    LifetimeCounter(int theId)
+                    : id(theId) {
+        live++;
+    }
+    LifetimeCounter(const LifetimeCounter& from)
+                    : id(from.id) {
+        live++;
+        copies++;
+    }
+    LifetimeCounter(LifetimeCounter&& from) noexcept
+                    : id(from.id) {
+        live++;
+    }
+    ~LifetimeCounter() {
+        live--;
+    }
+    LifetimeCounter& operator=(const LifetimeCounter& from) {
+        id = from.id;
+        copies++;
+        return *this;
+    }
+    bool operator==(const LifetimeCounter& other) const {
+        return id == other.id;
+    }
+    int id;
+    static int live;
+    static int copies;
+};
+
+int LifetimeCounter::live = 0;
+int LifetimeCounter::copies = 0;
+
+// Appending an element of the array itself has to work even when that append moves the array
+template<typename T> static bool testSelfAppend(const char* name, const T& first) {
+    DynamicArray<T> array;
+
+    array.push_back(first);
+    while (array.size() < 1000) {
+        array.push_back(array[0]);
+        array.emplace_back(array[array.size() - 1]);
+    }
+    for (unsigned int i = 0; i < array.size(); i++) {
+        if (!(array[i] == first)) {
+            cerr << "Appending an element of a DynamicArray<" << name << "> to itself corrupted element " << i
+                            << ".\n";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool testStorage(void) {
+
+    cout << "Testing DynamicArray push_back and emplace_back move instead of copying\n";
+    {
+        DynamicArray<LifetimeCounter> array;
+        for (int i = 0; i < 1000; i++) {
+            array.push_back(LifetimeCounter(i));
+            if (array.emplace_back(-i).id != -i) {
+                cerr << "emplace_back returned the wrong element.\n";
+                return false;
+            }
+        }
+        if (LifetimeCounter::copies != 0 || LifetimeCounter::live != 2000 || array.size() != 2000) {
+            cerr << LifetimeCounter::copies << " copies made, " << LifetimeCounter::live << " elements alive.\n";
+            return false;
+        }
+        for (int i = 0; i < 1000; i++) {
+            if (array[2 * i].id != i || array[2 * i + 1].id != -i) {
+                cerr << "Element " << 2 * i << " has the wrong value after growing.\n";
+                return false;
+            }
+        }
+
+        cout << "Testing DynamicArray clear, copy and move\n";
+        DynamicArray<LifetimeCounter> copy(array);
+        DynamicArray<LifetimeCounter> assigned;
+        assigned = copy;
+        DynamicArray<LifetimeCounter> moved(std::move(copy));
+        unsigned int capacity = array.capacity();
+        array.clear();
+        if (array.size() != 0 || array.capacity() != capacity || LifetimeCounter::live != 4000 || copy.size() != 0
+                        || moved.size() != 2000 || assigned[1999].id != -999) {
+            cerr << "Cleared, copied or moved DynamicArray has the wrong contents.\n";
+            return false;
+        }
+        array = std::move(moved);
+        if (array.size() != 2000 || array[1998].id != 999 || LifetimeCounter::live != 4000) {
+            cerr << "Move assigned DynamicArray has the wrong contents.\n";
+            return false;
+        }
+    }
+    if (LifetimeCounter::live != 0) {
+        cerr << LifetimeCounter::live << " elements were never destroyed.\n";
+        return false;
+    }
+
+    cout << "Testing DynamicArray appending its own elements\n";
+    if (!testSelfAppend<int>("int", 42) || !testSelfAppend<string>("string", string(100, 'x'))
+                    || !testSelfAppend<LifetimeCounter>("LifetimeCounter", LifetimeCounter(7))) {
+        return false;
+    }
+
+    cout << "Testing DynamicArray reserve and growth policies\n";
+    DynamicArray<int> reserved;
+    reserved.reserve(1000);
+    int* storage = &reserved.emplace_back(0);
+    for (int i = 1; i < 1000; i++) {
+        reserved.push_back(i);
+    }
+    if (reserved.capacity() != 1000 || &reserved[0] != storage) {
+        cerr << "Appending within the reserved capacity reallocated.\n";
+        return false;
+    }
+
+    DynamicArray<int, OneAndAHalfGrowthPolicy> slower;
+    unsigned int expected[] = { 8, 12, 18, 27, 40 };
+    for (unsigned int step = 0; step < 5; step++) {
+        while (slower.size() < slower.capacity() || slower.size() == 0) {
+            slower.push_back(slower.size());
+        }
+        if (slower.capacity() != expected[step]) {
+            cerr << "Capacity grew to " << slower.capacity() << ", expected " << expected[step] << ".\n";
+            return false;
+        }
+        slower.push_back(slower.size());
+    }
+    for (unsigned int i = 0; i < slower.size(); i++) {
+        if (slower[i] != (int) i) {
+            cerr << "Element " << i << " has the wrong value after growing by 1.5.\n";
+            return false;
+        }
+    }
+    if (GeometricGrowthPolicy<3, 2>::grow(1) != 2 || DoublingGrowthPolicy::grow(3000000000u) != 4294967295u) {
+        cerr << "Growth policy doesn't grow small capacities or overflows large ones.\n";
+        return false;
+    }
+
+    // Move-only elements, relocated by realloc because they say they can be
+    cout << "Testing DynamicArray of trivially relocatable unique_ptrs\n";
+    DynamicArray<unique_ptr<int>> pointers;
+    for (int i = 0; i < 10000; i++) {
+        pointers.push_back(unique_ptr<int>(new int(i)));
+    }
+    for (int i = 0; i < 10000; i++) {
+        if (*pointers[i] != i) {
+            cerr << "unique_ptr " << i << " points to the wrong value after growing.\n";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Grow, copy and move arrays of plain values and of classes whose storage comes from StoragePolicy
+template<typename StoragePolicy> static bool testStoragePolicy(const char* name, unsigned int count) {
+
+    cout << "Testing DynamicArray with " << name << "\n";
+    LifetimeCounter::copies = 0;
+    {
+        DynamicArray<unsigned int, DoublingGrowthPolicy, StoragePolicy> numbers;
+        for (unsigned int i = 0; i < count; i++) {
+            numbers.push_back(i);
+            if ((uintptr_t) numbers.data() % StoragePolicy::ALIGNMENT != 0) {
+                cerr << "Storage isn't aligned to " << StoragePolicy::ALIGNMENT << " bytes after growing to "
+                                << numbers.capacity() << " elements.\n";
+                return false;
+            }
+        }
+
+        DynamicArray<unsigned int, DoublingGrowthPolicy, StoragePolicy> copy(numbers);
+        DynamicArray<unsigned int, DoublingGrowthPolicy, StoragePolicy> moved(std::move(numbers));
+        for (unsigned int i = 0; i < count; i++) {
+            if (copy[i] != i || moved[i] != i) {
+                cerr << "Element " << i << " has the wrong value after growing, copying or moving.\n";
+                return false;
+            }
+        }
+
+        DynamicArray<LifetimeCounter, DoublingGrowthPolicy, StoragePolicy> counters;
+        DynamicArray<string, DoublingGrowthPolicy, StoragePolicy> strings;
+        for (int i = 0; i < 1000; i++) {
+            counters.emplace_back(i);
+            strings.push_back(string(50, 'a' + i % 26));
+        }
+        counters = DynamicArray<LifetimeCounter, DoublingGrowthPolicy, StoragePolicy>(counters);
+        if (counters[999].id != 999 || strings[999] != string(50, 'a' + 999 % 26)
+                        || LifetimeCounter::copies != 1000) {
+            cerr << "Elements that can't be relocated were lost or copied while growing.\n";
+            return false;
+        }
+    }
+    if (LifetimeCounter::live != 0) {
+        cerr << LifetimeCounter::live << " elements were never destroyed.\n";
+        return false;
+    }
+
+    return true;
+}
+
+static bool testStoragePolicies(void) {
+
+    if (!testStoragePolicy<MallocStorage>("MallocStorage", 100000)
+                    || !testStoragePolicy<CacheLineAlignedStorage>("CacheLineAlignedStorage", 100000)
+                    || !testStoragePolicy<AlignedStorage<4096>>("AlignedStorage<4096>", 100000)) {
+        return false;
+    }
+
+#if defined(__linux__)
+    // Enough elements to take several huge pages, so the mappings grow both in place and by moving
+    if (!testStoragePolicy<PageMappedStorage>("PageMappedStorage", 3000000)
+                    || !testStoragePolicy<HugePageStorage>("HugePageStorage", 3000000)
+                    || !testStoragePolicy<MappedStorage<true, NumaNodePlacement<0>>>("HugePageStorage on node 0",
+                                    3000000)) {
+        return false;
+    }
+#endif
+
+    return true;
+}
+
+// The iterators are random access, so the standard algorithms that jump around work on a DynamicArray
+static bool testIterators(void) {
+
+    cout << "Testing DynamicArray random access iterators\n";
+
+    static_assert(std::is_same<iterator_traits<DynamicArray<int>::iterator>::iterator_category,
+                    random_access_iterator_tag>::value, "DynamicArray iterators should be random access");
+    static_assert(std::is_same<DynamicArray<int>::const_iterator::reference, const int&>::value,
+                    "a const_iterator should not hand out writable elements");
+    static_assert(!std::is_convertible<DynamicArray<int>::const_iterator, DynamicArray<int>::iterator>::value,
+                    "a const_iterator should not convert to an iterator");
+
+    DynamicArray<int> numbers;
+    for (int i = 0; i < 100; i++) {
+        numbers.push_back((i * 37) % 100);
+    }
+
+    DynamicArray<int>::iterator it = numbers.begin();
+    DynamicArray<int>::iterator before = it++;
+    if (before != numbers.begin() || it != numbers.begin() + 1 || *it != 37) {
+        cerr << "Postfix ++ should return where the iterator was.\n";
+        return false;
+    }
+    it += 10;
+    if (it - numbers.begin() != 11 || numbers.end() - it != 89 || it[2] != numbers[13] || *(it - 11) != 0
+                    || *(2 + it) != numbers[13] || !(numbers.begin() < it) || !(it <= it) || !(numbers.end() > it)) {
+        cerr << "Iterator arithmetic and comparisons don't agree with indexing.\n";
+        return false;
+    }
+    --it;
+    if (*it-- != numbers[10] || *it != numbers[9]) {
+        cerr << "Decrementing an iterator went to the wrong element.\n";
+        return false;
+    }
+
+    sort(numbers.begin(), numbers.end());
+    for (unsigned int i = 0; i < numbers.size(); i++) {
+        if (numbers[i] != (int) i) {
+            cerr << "std::sort left " << numbers[i] << " at index " << i << ".\n";
+            return false;
+        }
+    }
+
+    const DynamicArray<int>& constNumbers = numbers;
+    DynamicArray<int>::const_iterator found = lower_bound(constNumbers.begin(), constNumbers.end(), 42);
+    if (found == constNumbers.end() || *found != 42 || found - numbers.begin() != 42) {
+        cerr << "std::lower_bound didn't find 42 through a const_iterator.\n";
+        return false;
+    }
+    if (accumulate(numbers.cbegin(), numbers.cend(), 0) != 4950 || distance(numbers.cbegin(), numbers.cend()) != 100) {
+        cerr << "Walking the array with cbegin() and cend() didn't visit every element.\n";
+        return false;
+    }
+    if (constNumbers.data() != &numbers[0] || &numbers.end()[-1] != &numbers[99]) {
+        cerr << "data() should point at the first element.\n";
+        return false;
+    }
+
+    DynamicArray<int> empty;
+    if (empty.begin() != empty.end() || empty.data() != nullptr) {
+        cerr << "An empty array should have begin() == end().\n";
+        return false;
+    }
+
+    return true;
+}
+
 bool runArrayTests(void) {
     int x = 4;
     int y = 1234;
@@ -83,22 +389,52 @@ bool runArrayTests(void) {
         return false;
     }
 
+    // Range constructor copies from start up to end
+    DynamicArray<int>::iterator start = db.begin();
+    DynamicArray<int>::iterator finish = db.end();
+    DynamicArray<int> dc(start, finish);
+    if (dc.size() != db.size() || dc[x - 1] != y) {
+        cerr << "Range constructor copied " << dc.size() << " elements, expected " << db.size() << ".\n";
+        return false;
+    }
+
+    // Appending a range adds to what is there, and grows the storage at least geometrically
+    DynamicArray<int> appended(2, -1);
+    appended.append(vb.begin(), vb.end());
+    unsigned int capacityBefore = appended.capacity();
+    appended.append(vb.begin(), vb.begin() + 1);
+    if (appended.size() != vb.size() + 3 || appended[2] != vb[0] || appended[appended.size() - 1] != vb[0]
+                    || (appended.capacity() != capacityBefore && appended.capacity() < 2 * capacityBefore)) {
+        cerr << "Appending a range gave " << appended.size() << " elements.\n";
+        return false;
+    }
+
+    if (!testStorage()) {
+        return false;
+    }
+
+    if (!testIterators()) {
+        return false;
+    }
+
+    if (!testStoragePolicies()) {
+        return false;
+    }
+
     /*
 
-     iterator(DynamicArray<T>& theParent, unsigned int index) : parent(theParent), currentIndex(0)
-     // Copy assignment operator
-     iterator& operator=(const iterator& rhs)
-     // Dereference operator
-     T& operator*()
+     *Tested* DynamicArrayIterator(Element* element)
+     *Tested* DynamicArrayIterator(const DynamicArrayIterator<Other>& from)
+     *Tested* Element& operator*() const
+     Element* operator->() const
+     *Tested* Element& operator[](difference_type n) const
 
-     *Tested* iterator& operator++()    	// Prefix increment operator (++c)
-     *Tested* iterator operator++(int)	// Postfix increment operator (c++)
-     *Tested* bool operator!=(const iterator& it) const
-     bool operator==(const iterator& it) const
+     *Tested* ++, --, +=, -=, +, -
+     *Tested* ==, !=, <, >, <=, >=
 
      *Tested* DynamicArray() : theSize(0), theCapacity(initialArrayCapacity)
      *Tested* DynamicArray(int count, const T& data) : array(nullptr), theSize(count), theCapacity(initialArrayCapacity)
-     DynamicArray(DynamicArray<T>::iterator& start, DynamicArray<T>::iterator& end)
+     *Tested* DynamicArray(const_iterator start, const_iterator end)
      // Copy constructor
      DynamicArray(const DynamicArray& from)
      // Move constructor
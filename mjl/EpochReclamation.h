@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef EPOCHRECLAMATION_H
+#define EPOCHRECLAMATION_H
+
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include <stdint.h>
+
+namespace mjl {
+namespace homebrew {
+
+/**
+ * Epoch based reclamation. Lets lock free readers keep using memory that a
+ * writer has already unlinked, by delaying the delete until no reader can
+ * still be looking at it.
+ *
+ * There is one global epoch number. A reader announces the epoch it saw when
+ * it started reading (EpochGuard), and withdraws the announcement when it is
+ * done. Unlinked memory is retired together with the epoch of the moment it
+ * was retired. The global epoch can only advance once every reader that is
+ * currently reading has announced the current epoch, so once it has advanced
+ * twice past the retire epoch, every reader that could have seen the memory
+ * is gone and it is deleted.
+ *
+ * A reader only ever writes to its own announcement slot, which sits on its
+ * own cache line, so readers never contend with each other or with writers.
+ *
+ * There is a single EpochDomain for the whole program, shared by every data
+ * structure that uses it.
+ */
+class EpochDomain {
+ public:
+
+    static const unsigned int MAX_THREADS = 128;
+
+    static EpochDomain& instance(void) {
+        static EpochDomain domain;
+        return domain;
+    }
+
+    /**
+     * Mark the calling thread as reading (enter) or done reading (exit). Nesting
+     * is allowed. The announcement is a sequentially consistent store, so
+     * the reader's loads of shared pointers must be sequentially consistent too
+     * (free on x86) for a writer checking the announcements to never miss it.
+     */
+    void enter(void) {
+        ThreadSlot& slot = threadSlot();
+        if (slot.depth++ == 0) {
+            slots[slot.index].epoch.store(globalEpoch.load(std::memory_order_acquire), std::memory_order_seq_cst);
+        }
+    }
+
+    void exit(void) {
+        ThreadSlot& slot = threadSlot();
+        if (--slot.depth == 0) {
+            slots[slot.index].epoch.store(INACTIVE, std::memory_order_release);
+        }
+    }
+
+    /**
+     * Delete pointer with deleter once no reader can be using it anymore. The
+     * pointer must already be unreachable for new readers.
+     */
+    void retire(void* pointer, void (*deleter)(void*)) {
+        std::lock_guard<std::mutex> lock(retireMutex);
+        retired.push_back(Retired { pointer, deleter, globalEpoch.load(std::memory_order_seq_cst) });
+        if (retired.size() % RECLAIM_INTERVAL == 0) {
+            reclaimRetired();
+        }
+    }
+
+    // Try to advance the epoch and delete everything that is safe to delete
+    void reclaim(void) {
+        std::lock_guard<std::mutex> lock(retireMutex);
+        reclaimRetired();
+    }
+
+ private:
+
+    static const uint64_t INACTIVE = UINT64_MAX;
+    static const unsigned int RECLAIM_INTERVAL = 64;
+
+    struct Retired {
+        void* pointer;
+        void (*deleter)(void*);
+        uint64_t epoch;
+    };
+
+    // One reader announcement, alone on its cache line
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch;
+        std::atomic<bool> claimed;
+    };
+
+    // Claims a slot the first time a thread reads, and releases it when the thread exits
+    struct ThreadSlot {
+        explicit ThreadSlot(EpochDomain& theDomain)
+                        : domain(theDomain),
+                          index(theDomain.claimSlot()),
+                          depth(0) {
+        }
+
+        ~ThreadSlot() {
+            domain.slots[index].claimed.store(false, std::memory_order_release);
+        }
+
+        EpochDomain& domain;
+        unsigned int index;
+        unsigned int depth;
+    };
+
+    EpochDomain()
+                    : globalEpoch(0) {
+        for (unsigned int i = 0; i < MAX_THREADS; i++) {
+            slots[i].epoch.store(INACTIVE);
+            slots[i].claimed.store(false);
+        }
+    }
+
+    // By the time the domain is destroyed the program is exiting, nobody is reading anymore
+    ~EpochDomain() {
+        for (unsigned int i = 0; i < retired.size(); i++) {
+            retired[i].deleter(retired[i].pointer);
+        }
+    }
+
+    static ThreadSlot& threadSlot(void) {
+        thread_local ThreadSlot slot(instance());
+        return slot;
+    }
+
+    unsigned int claimSlot(void) {
+        for (unsigned int i = 0; i < MAX_THREADS; i++) {
+            bool expected = false;
+            if (slots[i].claimed.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                return i;
+            }
+        }
+        throw std::runtime_error("More than EpochDomain::MAX_THREADS threads are reading at once.");
+    }
+
+    void reclaimRetired(void) {
+
+        tryAdvance();
+
+        uint64_t epoch = globalEpoch.load(std::memory_order_seq_cst);
+        unsigned int kept = 0;
+
+        for (unsigned int i = 0; i < retired.size(); i++) {
+            if (retired[i].epoch + 2 <= epoch) {
+                retired[i].deleter(retired[i].pointer);
+            } else {
+                retired[kept++] = retired[i];
+            }
+        }
+
+        retired.resize(kept);
+    }
+
+    // The epoch may advance once every thread that is reading has seen the current epoch
+    void tryAdvance(void) {
+        uint64_t epoch = globalEpoch.load(std::memory_order_seq_cst);
+
+        for (unsigned int i = 0; i < MAX_THREADS; i++) {
+            uint64_t announced = slots[i].epoch.load(std::memory_order_seq_cst);
+            if (announced != INACTIVE && announced != epoch) {
+                return;
+            }
+        }
+
+        globalEpoch.store(epoch + 1, std::memory_order_seq_cst);
+    }
+
+    std::atomic<uint64_t> globalEpoch;
+    Slot slots[MAX_THREADS];
+    std::mutex retireMutex;
+    std::vector<Retired> retired;
+};
+
+// Marks the calling thread as reading for as long as the guard is in scope
+class EpochGuard {
+ public:
+    EpochGuard() {
+        EpochDomain::instance().enter();
+    }
+
+    ~EpochGuard() {
+        EpochDomain::instance().exit();
+    }
+
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+};
+
+} /* namespace homebrew */
+} /* namespace mjl */
+
+#endif /* EPOCHRECLAMATION_H */
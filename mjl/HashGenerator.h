@@ -0,0 +1,345 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef HASHGENERATOR_H
+#define HASHGENERATOR_H
+
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace mjl {
+namespace homebrew {
+
+/*********************
+ * Table of contents *
+ *********************
+ *
+ * uint64_t hashMix(uint64_t a, uint64_t b)
+ * uint64_t hashInteger(uint64_t k)
+ * uint64_t hashBytes(const void* data, size_t length, uint64_t seed = 0)
+ *
+ * StringSlice class
+ *
+ * DefaultHashGenerator<K> class, and specializations for
+ *     - char, short, int, long, long long (signed and unsigned)
+ *     - float, double, long double
+ *     - std::string (transparent, also hashes const char* and StringSlice)
+ *
+ * HashOf<HashGenerator, K> class
+ * IsTransparentHash<HashGenerator> class
+ */
+
+// Secret constants used by the hash functions, odd and with well spread bits
+static const uint64_t HASH_SECRET_0 = 0xa0761d6478bd642fULL;
+static const uint64_t HASH_SECRET_1 = 0xe7037ed1a0b428dbULL;
+static const uint64_t HASH_SECRET_2 = 0x8ebc6af09c88c6e3ULL;
+static const uint64_t HASH_SECRET_3 = 0x589965cc75374cc3ULL;
+
+/**
+ * Multiply two 64 bit numbers to a 128 bit result and fold the two halves
+ * together. Every bit of the result depends on every bit of both inputs.
+ */
+inline uint64_t hashMix(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 r = (unsigned __int128) a * b;
+    return (uint64_t) r ^ (uint64_t) (r >> 64);
+#else
+    uint64_t aHigh = a >> 32, aLow = (uint32_t) a;
+    uint64_t bHigh = b >> 32, bLow = (uint32_t) b;
+    uint64_t highHigh = aHigh * bHigh, highLow = aHigh * bLow;
+    uint64_t lowHigh = aLow * bHigh, lowLow = aLow * bLow;
+    uint64_t middle = (lowLow >> 32) + (uint32_t) highLow + (uint32_t) lowHigh;
+    uint64_t low = (middle << 32) | (uint32_t) lowLow;
+    uint64_t high = highHigh + (highLow >> 32) + (lowHigh >> 32) + (middle >> 32);
+    return low ^ high;
+#endif
+}
+
+/**
+ * Finalizer for integer keys. Sequential keys, and keys that are all a
+ * multiple of some number (e.g. the hash table size), come out looking
+ * random.
+ */
+inline uint64_t hashInteger(uint64_t k) {
+    return hashMix(k ^ HASH_SECRET_0, HASH_SECRET_1);
+}
+
+inline uint64_t hashRead8(const unsigned char* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t hashRead4(const unsigned char* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/**
+ * Hash an arbitrary stream of bytes, in the style of wyhash. Every byte of the
+ * input is used (in 16 or 48 byte chunks) and mixed with a full 64x64 bit
+ * multiply, so reordering the bytes changes the hash.
+ */
+inline uint64_t hashBytes(const void* data, size_t length, uint64_t seed = 0) {
+
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    uint64_t a = 0;
+    uint64_t b = 0;
+
+    seed ^= hashMix(seed ^ HASH_SECRET_0, HASH_SECRET_1);
+
+    if (length <= 16) {
+        if (length >= 4) {
+            // Two (possibly overlapping) 4 byte reads from each end cover 4 to 16 bytes
+            size_t middle = (length >> 3) << 2;
+            a = (hashRead4(p) << 32) | hashRead4(p + middle);
+            b = (hashRead4(p + length - 4) << 32) | hashRead4(p + length - 4 - middle);
+        } else if (length > 0) {
+            a = ((uint64_t) p[0] << 16) | ((uint64_t) p[length >> 1] << 8) | p[length - 1];
+        }
+    } else {
+        size_t remaining = length;
+
+        // Three independent lanes for long inputs, so the multiplies can overlap
+        if (remaining > 48) {
+            uint64_t lane1 = seed;
+            uint64_t lane2 = seed;
+            do {
+                seed = hashMix(hashRead8(p) ^ HASH_SECRET_1, hashRead8(p + 8) ^ seed);
+                lane1 = hashMix(hashRead8(p + 16) ^ HASH_SECRET_2, hashRead8(p + 24) ^ lane1);
+                lane2 = hashMix(hashRead8(p + 32) ^ HASH_SECRET_3, hashRead8(p + 40) ^ lane2);
+                p += 48;
+                remaining -= 48;
+            } while (remaining > 48);
+            seed ^= lane1 ^ lane2;
+        }
+
+        while (remaining > 16) {
+            seed = hashMix(hashRead8(p) ^ HASH_SECRET_1, hashRead8(p + 8) ^ seed);
+            p += 16;
+            remaining -= 16;
+        }
+
+        // The last 16 bytes of the input, which may overlap bytes already consumed
+        a = hashRead8(p + remaining - 16);
+        b = hashRead8(p + remaining - 8);
+    }
+
+    return hashMix(hashMix(a ^ HASH_SECRET_1, b ^ seed) ^ HASH_SECRET_0 ^ length, HASH_SECRET_1);
+}
+
+/**
+ * Some characters of a string that are not a std::string of their own, like a
+ * token inside a buffer being parsed (much like C++17's std::string_view). It
+ * only offers what a hash table lookup needs: it hashes the same as a
+ * std::string with the same characters, and compares equal to one.
+ */
+class StringSlice {
+ public:
+    StringSlice(const char* theData, size_t theLength)
+                    : data(theData),
+                      length(theLength) {
+    }
+
+    StringSlice(const char* cString)
+                    : data(cString),
+                      length(strlen(cString)) {
+    }
+
+    const char* data;
+    size_t length;
+};
+
+inline bool operator==(const std::string& a, const StringSlice& b) {
+    return a.size() == b.length && memcmp(a.data(), b.data, b.length) == 0;
+}
+
+inline bool operator==(const StringSlice& a, const std::string& b) {
+    return b == a;
+}
+
+/**
+ * This is a generic hash function used to generate an index into a hash
+ * table. It is designed to work with any object type and treats the object
+ * as an opaque stream of bytes, all of which are hashed.
+ *
+ * Note that since we have no knowledge of what the object is made of, this is
+ * only correct for types where equal objects have equal bytes. Types with
+ * padding, pointers to data, or their own operator== should supply their own
+ * hash function instead.
+ *
+ * A user can supply their own hash function by implementing a template class
+ * just like this one, that takes their user-defined type (class) as a template
+ * parameter, and provides a static hash function returning a size_t. The bytes
+ * of the object can be passed to hashBytes(), or several fields can be hashed
+ * and combined with hashMix(). Within the hash table itself the value returned
+ * is reduced to an index into the table.
+ *
+ * Hash generators written for older versions of this library that provide
+ * chooseBucket instead of hash are still accepted, see HashOf below.
+ *
+ * A hash generator can also hash other types that compare equal to K, so
+ * tables can be searched without building a K first. It then declares
+ * "typedef void is_transparent;" and provides a hash overload for each type,
+ * which must return the same hash as for the equal K. See the std::string
+ * specialization below.
+ */
+template<typename K> class DefaultHashGenerator {
+ public:
+    static size_t hash(const K& k) {
+        return (size_t) hashBytes(&k, sizeof(k));
+    }
+};
+
+/**
+ * Integers are never returned as-is. Keys that are sequential, or that are all
+ * multiples of the table size, would otherwise fill a few buckets and leave
+ * the rest empty.
+ */
+template<typename T> class IntegerHashGenerator {
+ public:
+    static size_t hash(const T& k) {
+        return (size_t) hashInteger((uint64_t) k);
+    }
+};
+
+/**
+ * Floating point keys hash their value rather than their bytes. 0.0 and -0.0
+ * are equal but differ in the sign bit, so -0.0 is hashed as 0.0. An x87
+ * long double is 10 bytes of value padded to 12 or 16, and the padding holds
+ * anything, so only the value bytes are hashed. A NaN is never equal to
+ * anything, itself included, so a NaN key can be inserted but not found.
+ */
+template<typename T> class FloatingPointHashGenerator {
+ public:
+    static size_t hash(const T& k) {
+        T value = (k == 0) ? T(0) : k;
+        return (size_t) hashBytes(&value, valueBytes());
+    }
+
+ private:
+    static size_t valueBytes(void) {
+        return (std::numeric_limits<T>::digits == 64 && sizeof(T) > 10) ? 10 : sizeof(T);
+    }
+};
+
+template<> class DefaultHashGenerator<char> : public IntegerHashGenerator<char> {
+};
+
+template<> class DefaultHashGenerator<signed char> : public IntegerHashGenerator<signed char> {
+};
+
+template<> class DefaultHashGenerator<unsigned char> : public IntegerHashGenerator<unsigned char> {
+};
+
+template<> class DefaultHashGenerator<short> : public IntegerHashGenerator<short> {
+};
+
+template<> class DefaultHashGenerator<unsigned short> : public IntegerHashGenerator<unsigned short> {
+};
+
+template<> class DefaultHashGenerator<int> : public IntegerHashGenerator<int> {
+};
+
+template<> class DefaultHashGenerator<unsigned int> : public IntegerHashGenerator<unsigned int> {
+};
+
+template<> class DefaultHashGenerator<long> : public IntegerHashGenerator<long> {
+};
+
+template<> class DefaultHashGenerator<unsigned long> : public IntegerHashGenerator<unsigned long> {
+};
+
+template<> class DefaultHashGenerator<long long> : public IntegerHashGenerator<long long> {
+};
+
+template<> class DefaultHashGenerator<unsigned long long> : public IntegerHashGenerator<unsigned long long> {
+};
+
+template<> class DefaultHashGenerator<float> : public FloatingPointHashGenerator<float> {
+};
+
+template<> class DefaultHashGenerator<double> : public FloatingPointHashGenerator<double> {
+};
+
+template<> class DefaultHashGenerator<long double> : public FloatingPointHashGenerator<long double> {
+};
+
+// Strings hash their characters, not the std::string object (which holds a pointer)
+template<> class DefaultHashGenerator<std::string> {
+ public:
+    typedef void is_transparent;
+
+    static size_t hash(const std::string& k) {
+        return (size_t) hashBytes(k.data(), k.size());
+    }
+
+    static size_t hash(const char* k) {
+        return (size_t) hashBytes(k, strlen(k));
+    }
+
+    static size_t hash(const StringSlice& k) {
+        return (size_t) hashBytes(k.data, k.length);
+    }
+};
+
+/**
+ * This is how the hash tables call a HashGenerator. If the generator has a
+ * static hash function that is used, otherwise the generator's chooseBucket
+ * function is used.
+ */
+template<typename HashGenerator, typename K, typename = void> class HashOf {
+ public:
+    static size_t hash(const K& k) {
+        return (size_t) HashGenerator::chooseBucket(k);
+    }
+};
+
+template<typename HashGenerator, typename K> class HashOf<HashGenerator, K,
+                decltype((void) HashGenerator::hash(std::declval<const K&>()))> {
+ public:
+    static size_t hash(const K& k) {
+        return HashGenerator::hash(k);
+    }
+};
+
+/**
+ * Whether HashGenerator can hash types other than the key type (see
+ * DefaultHashGenerator above), which lets the hash tables look them up as is.
+ */
+template<typename HashGenerator, typename = void> class IsTransparentHash : public std::false_type {
+};
+
+template<typename HashGenerator> class IsTransparentHash<HashGenerator,
+                typename std::conditional<true, void, typename HashGenerator::is_transparent>::type> : public std::true_type {
+};
+
+} /* namespace homebrew */
+} /* namespace mjl */
+
+#endif /* HASHGENERATOR_H */
@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "HashGenerator.h"
+#include "HashGenerator_test.h"
+#include "HashTable.h"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <string.h>
+
+using namespace std;
+using namespace mjl::homebrew;
+
+// Largest prime in HASH_TABLE_SIZES, and a power of two of about the same size
+static const unsigned int PRIME_BUCKETS = 87583;
+static const unsigned int POWER_OF_TWO_BUCKETS = 65536;
+
+// No chain should come close to this for a load factor of 0.5, a good hash gives 7 or 8
+static const unsigned int MAX_ALLOWED_CHAIN = 16;
+
+/**
+ * Distribute the keys over bucketCount buckets the way a chained hash table
+ * would, print a histogram of how many buckets have a chain of each length,
+ * and return the length of the longest chain.
+ */
+template<typename K, typename HashGenerator> static unsigned int printChainLengths(const char* name,
+                                                                                const vector<K>& keys,
+                                                                                unsigned int bucketCount) {
+    vector<unsigned int> chainLengths(bucketCount, 0);
+    map<unsigned int, unsigned int> histogram;
+
+    for (unsigned int i = 0; i < keys.size(); i++) {
+        chainLengths[HashOf<HashGenerator, K>::hash(keys[i]) % bucketCount]++;
+    }
+    for (unsigned int i = 0; i < bucketCount; i++) {
+        histogram[chainLengths[i]]++;
+    }
+
+    cout << name << ", " << keys.size() << " keys in " << bucketCount << " buckets:";
+    for (auto it = histogram.begin(); it != histogram.end(); it++) {
+        cout << " " << it->first << ":" << it->second;
+    }
+    cout << "\n";
+
+    return *max_element(chainLengths.begin(), chainLengths.end());
+}
+
+template<typename K> static bool checkDistribution(const char* name, const vector<K>& keys) {
+
+    unsigned int primeChain = printChainLengths<K, DefaultHashGenerator<K>>(name, keys, PRIME_BUCKETS);
+    unsigned int powerOfTwoChain = printChainLengths<K, DefaultHashGenerator<K>>(name, keys, POWER_OF_TWO_BUCKETS);
+
+    if (primeChain > MAX_ALLOWED_CHAIN || powerOfTwoChain > MAX_ALLOWED_CHAIN) {
+        cerr << name << " has a chain of length " << max(primeChain, powerOfTwoChain) << ".\n";
+        return false;
+    }
+
+    return true;
+}
+
+// A hash generator written against the older chooseBucket interface
+class LegacyHashGenerator {
+ public:
+    static unsigned int chooseBucket(const int& k) {
+        return (unsigned int) k;
+    }
+};
+
+struct PlainOldData {
+    int a;
+    int b;
+    bool operator==(const PlainOldData& other) const {
+        return a == other.a && b == other.b;
+    }
+};
+
+bool runHashGeneratorTests(void) {
+    const unsigned int KEY_COUNT = PRIME_BUCKETS / 2;
+
+    vector<unsigned long long> sequential;
+    vector<unsigned long long> primeMultiples;
+    vector<unsigned long long> powerOfTwoMultiples;
+    vector<string> permutations;
+    vector<string> commonPrefix;
+    vector<PlainOldData> structs;
+
+    for (unsigned long long i = 0; i < KEY_COUNT; i++) {
+        sequential.push_back(i);
+        primeMultiples.push_back(i * PRIME_BUCKETS);
+        powerOfTwoMultiples.push_back(i << 16);
+        commonPrefix.push_back("a/long/common/path/prefix/for/every/key/" + to_string(i));
+        structs.push_back(PlainOldData { (int) i, (int) (i * 7) });
+    }
+
+    // A plain sum of the bytes puts every one of these in the same bucket
+    string letters = "abcdefgh";
+    do {
+        permutations.push_back(letters);
+    } while (next_permutation(letters.begin(), letters.end()));
+
+    if (!checkDistribution("Sequential integers", sequential)
+                    || !checkDistribution("Multiples of the table prime", primeMultiples)
+                    || !checkDistribution("Multiples of 65536", powerOfTwoMultiples)
+                    || !checkDistribution("Permutations of one string", permutations)
+                    || !checkDistribution("Strings with a common prefix", commonPrefix)
+                    || !checkDistribution("Structs hashed as bytes", structs)) {
+        return false;
+    }
+
+    // Every length up to and past the 16 and 48 byte boundaries must hash all of its bytes
+    cout << "Checking every byte of the input changes the hash.\n";
+    unsigned char bytes[100] = { 0 };
+    for (size_t length = 1; length < sizeof(bytes); length++) {
+        uint64_t original = hashBytes(bytes, length);
+        for (size_t i = 0; i < length; i++) {
+            bytes[i] = 1;
+            if (hashBytes(bytes, length) == original) {
+                cerr << "Changing byte " << i << " of " << length << " did not change the hash.\n";
+                return false;
+            }
+            bytes[i] = 0;
+        }
+    }
+
+    cout << "Testing hash generator with the older chooseBucket interface\n";
+    HashTable<int, int, LegacyHashGenerator> legacyHash;
+    for (int i = 0; i < 1000; i++) {
+        legacyHash.insert(i, i);
+    }
+    for (int i = 0; i < 1000; i++) {
+        if (legacyHash.get(i) != i) {
+            cerr << "Legacy hash generator lost entry " << i << ".\n";
+            return false;
+        }
+    }
+
+    cout << "Testing string keys\n";
+    HashTable<string, int> stringHash;
+    for (unsigned int i = 0; i < commonPrefix.size(); i++) {
+        stringHash.insert(commonPrefix[i], i);
+    }
+    for (unsigned int i = 0; i < commonPrefix.size(); i++) {
+        if (stringHash.get(commonPrefix[i]) != (int) i) {
+            cerr << "String key " << commonPrefix[i] << " has the wrong value.\n";
+            return false;
+        }
+    }
+
+    // 0.0 == -0.0, so they have to hash alike, and a long double's padding mustn't count
+    cout << "Testing floating point keys\n";
+    long double zeroPadded = 1.0L;
+    long double onesPadded = 1.0L;
+    if (numeric_limits<long double>::digits == 64 && sizeof(long double) > 10) {
+        memset(reinterpret_cast<unsigned char*>(&zeroPadded) + 10, 0x00, sizeof(long double) - 10);
+        memset(reinterpret_cast<unsigned char*>(&onesPadded) + 10, 0xff, sizeof(long double) - 10);
+    }
+    if (DefaultHashGenerator<float>::hash(-0.0f) != DefaultHashGenerator<float>::hash(0.0f)
+                    || DefaultHashGenerator<double>::hash(-0.0) != DefaultHashGenerator<double>::hash(0.0)
+                    || DefaultHashGenerator<long double>::hash(-0.0L) != DefaultHashGenerator<long double>::hash(0.0L)
+                    || DefaultHashGenerator<long double>::hash(zeroPadded)
+                                    != DefaultHashGenerator<long double>::hash(onesPadded)) {
+        cerr << "Equal floating point keys hash differently.\n";
+        return false;
+    }
+    HashTable<double, int> doubleHash;
+    doubleHash.insert(0.0, 1);
+    doubleHash.insert(-0.0, 2);
+    if (doubleHash.size() != 1 || !doubleHash.contains(-0.0) || doubleHash.get(0.0) != 2) {
+        cerr << "0.0 and -0.0 are different keys.\n";
+        return false;
+    }
+
+    // Transparent lookups only work if every form of the same string hashes the same
+    cout << "Checking const char* and StringSlice hash like std::string\n";
+    for (unsigned int i = 0; i < commonPrefix.size(); i++) {
+        const string& key = commonPrefix[i];
+        size_t expected = DefaultHashGenerator<string>::hash(key);
+        if (DefaultHashGenerator<string>::hash(key.c_str()) != expected
+                        || DefaultHashGenerator<string>::hash(StringSlice(key.data(), key.size())) != expected) {
+            cerr << "String key " << key << " hashes differently depending on its type.\n";
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef HASHREHASHPOLICY_H
+#define HASHREHASHPOLICY_H
+
+namespace mjl {
+namespace homebrew {
+
+/**
+ * A rehash policy decides how much of the old table a HashTable moves into
+ * the new (larger) table at a time. BUCKETS_PER_STEP buckets of the old table
+ * are moved on every insert, get, contains and remove until the old table is
+ * empty. Zero means the whole table is moved at once, the moment the rehash
+ * starts.
+ */
+
+// Move everything at once. The insert that triggers the rehash pays for it all.
+class StopTheWorldRehashPolicy {
+ public:
+    static const unsigned int BUCKETS_PER_STEP = 0;
+};
+
+/**
+ * Spread the cost of a rehash over the operations that follow it. Both tables
+ * stay alive until the move is finished, and lookups check both. If the move
+ * is still running when the new table needs to grow again (a small
+ * BucketsPerStep under a run of inserts), the rest of it is done at once by
+ * the insert that triggers the next growth, like StopTheWorldRehashPolicy.
+ */
+template<unsigned int BucketsPerStep = 8> class IncrementalRehashPolicy {
+ public:
+    static const unsigned int BUCKETS_PER_STEP = BucketsPerStep;
+};
+
+} /* namespace homebrew */
+} /* namespace mjl */
+
+#endif /* HASHREHASHPOLICY_H */
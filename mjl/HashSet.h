@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef HASHSET_H
+#define HASHSET_H
+
+#include "HashGenerator.h"
+#include "HashTable.h"
+#include "PackedHashTable.h"
+
+#include <cstddef>
+#include <iterator>
+
+namespace mjl {
+namespace homebrew {
+
+// The table a HashSet keeps its keys in: a HashTable in general, a PackedHashTable for small plain keys
+template<typename K, typename HashGenerator, bool Packed> struct HashSetTable {
+    typedef HashTable<K, NoValue, HashGenerator> type;
+};
+
+template<typename K, typename HashGenerator> struct HashSetTable<K, HashGenerator, true> {
+    typedef PackedHashTable<K, NoValue, HashGenerator> type;
+};
+
+/**
+ * A set of keys. Keys that are trivially copyable and at most 8 bytes (ints,
+ * pointers, small structs, but not floating point numbers, see IsPackedKey)
+ * are kept in a PackedHashTable
+ * without values, which is a bare array of keys with every bit set marking
+ * an empty slot. So that key value can't be inserted into such a set (insert
+ * throws std::invalid_argument). A set that needs it can ask for the chained
+ * table by passing false for Packed.
+ *
+ * Any other key is kept in a HashTable with no values.
+ */
+template<typename K, typename HashGenerator = DefaultHashGenerator<K>, bool Packed = IsPackedKey<K>::value> class HashSet {
+ public:
+
+    typedef typename HashSetTable<K, HashGenerator, Packed>::type Table;
+
+    // Forward iterator over the keys, in no particular order
+    class const_iterator {
+     public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef K value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const K& reference;
+        typedef const K* pointer;
+
+        // The end iterator
+        const_iterator(void)
+                        : position() {
+        }
+
+        reference operator*(void) const {
+            return position.key();
+        }
+
+        pointer operator->(void) const {
+            return &position.key();
+        }
+
+        const_iterator& operator++(void) {
+            ++position;
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            const_iterator before(*this);
+            ++position;
+            return before;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return position == other.position;
+        }
+
+        bool operator!=(const const_iterator& other) const {
+            return position != other.position;
+        }
+
+     private:
+        friend class HashSet;
+
+        explicit const_iterator(typename Table::const_iterator thePosition)
+                        : position(thePosition) {
+        }
+
+        typename Table::const_iterator position;
+    };
+
+    // Keys can't be changed in place, that would put them in the wrong slot
+    typedef const_iterator iterator;
+
+    // Default constructor
+    HashSet(void)
+                    : table() {
+    }
+
+    // Build a set from a range of keys
+    template<typename InputIterator> HashSet(InputIterator first, InputIterator last)
+                    : table() {
+        for (; first != last; ++first) {
+            insert(*first);
+        }
+    }
+
+    // Copying and moving the table is all there is to copying and moving the set
+
+    const_iterator begin(void) const {
+        return const_iterator(table.cbegin());
+    }
+
+    const_iterator end(void) const {
+        return const_iterator(table.cend());
+    }
+
+    const_iterator cbegin(void) const {
+        return begin();
+    }
+
+    const_iterator cend(void) const {
+        return end();
+    }
+
+    // Returns true if key was not in the set yet
+    bool insert(const K& key) {
+        return table.try_emplace(key);
+    }
+
+    bool contains(const K& key) {
+        return table.contains(key);
+    }
+
+    // Returns true if key was in the set
+    bool remove(const K& key) {
+        return table.remove(key);
+    }
+
+    unsigned int size(void) const {
+        return table.size();
+    }
+
+    // Make room for n keys without another rehash
+    void reserve(size_t n) {
+        table.reserve(n);
+    }
+
+ private:
+
+    Table table;
+};
+
+} /* namespace homebrew */
+} /* namespace mjl */
+
+#endif /* HASHSET_H */
@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "HashSet.h"
+#include "HashSet_test.h"
+#include "PackedHashTable.h"
+
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+using namespace std;
+using namespace mjl::homebrew;
+
+// Piles every key into the last few slots of a 64 slot table, so runs wrap around the end
+class WrappingHashGenerator {
+ public:
+    static size_t hash(const int& k) {
+        return 60 + k % 8;
+    }
+};
+
+// Zero can't be the empty key of a table of ids that start at 1
+class ZeroEmptyKey {
+ public:
+    static uint32_t value(void) {
+        return 0;
+    }
+};
+
+/**
+ * Insert, overwrite and remove random keys from a small range, so runs get
+ * long and removes have to shift a lot of entries back, and compare every key
+ * against a reference map after each round.
+ */
+template<typename Table> static bool testAgainstReference(const char* name, int keyRange) {
+    Table table;
+    unordered_map<int, int> reference;
+
+    cout << "Testing " << name << " against unordered_map\n";
+    srand(1234);
+    for (int round = 0; round < 20; round++) {
+        for (int i = 0; i < 2000; i++) {
+            int key = rand() % keyRange;
+            if (rand() % 3 == 0) {
+                if (table.remove(key) != (reference.erase(key) == 1)) {
+                    cerr << "Removing key " << key << " gave the wrong answer.\n";
+                    return false;
+                }
+            } else {
+                table.insert(key, i);
+                reference[key] = i;
+            }
+        }
+
+        for (int key = 0; key < keyRange; key++) {
+            bool expected = reference.find(key) != reference.end();
+            if (table.contains(key) != expected || (expected && table.get(key) != reference[key])) {
+                cerr << "Key " << key << " is wrong after round " << round << ".\n";
+                return false;
+            }
+        }
+        if (table.size() != reference.size()) {
+            cerr << "Table has " << table.size() << " entries, expected " << reference.size() << ".\n";
+            return false;
+        }
+    }
+
+    // Iterating has to visit every entry exactly once
+    unsigned int visited = 0;
+    for (auto it = table.cbegin(); it != table.cend(); ++it) {
+        if (reference[it.key()] != it.value()) {
+            cerr << "Iterating found key " << it.key() << " with the wrong value.\n";
+            return false;
+        }
+        visited++;
+    }
+    if (visited != reference.size()) {
+        cerr << "Iterating visited " << visited << " entries, expected " << reference.size() << ".\n";
+        return false;
+    }
+
+    return true;
+}
+
+static bool testPackedHashTable(void) {
+
+    if (!testAgainstReference<PackedHashTable<int, int>>("PackedHashTable", 5000)
+                    || !testAgainstReference<PackedHashTable<int, int, WrappingHashGenerator, DefaultEmptyKey<int>,
+                                    PowerOfTwoSizePolicy>>("PackedHashTable with wrapping runs", 40)) {
+        return false;
+    }
+
+    cout << "Testing PackedHashTable empty key, copies and custom empty key\n";
+    PackedHashTable<int, int> table;
+    bool threw = false;
+    try {
+        table.insert(-1, 1);
+    } catch (std::invalid_argument&) {
+        threw = true;
+    }
+    if (!threw || table.contains(-1) || table.size() != 0) {
+        cerr << "The empty key was inserted.\n";
+        return false;
+    }
+
+    for (int i = 0; i < 1000; i++) {
+        table.insert(i, i * 2);
+    }
+    PackedHashTable<int, int> copy(table);
+    table.remove(5);
+    PackedHashTable<int, int> moved(std::move(table));
+    table = copy;
+    if (!copy.contains(5) || moved.contains(5) || moved.get(999) != 1998 || !table.contains(5)
+                    || table.size() != 1000 || moved.size() != 999) {
+        cerr << "Copied or moved PackedHashTable has the wrong contents.\n";
+        return false;
+    }
+    if (copy.try_emplace(5, 0) || !copy.try_emplace(-5, 7) || copy.get(-5) != 7 || copy.get(5) != 10) {
+        cerr << "try_emplace on a PackedHashTable replaced or lost a value.\n";
+        return false;
+    }
+
+    PackedHashTable<uint32_t, uint32_t, DefaultHashGenerator<uint32_t>, ZeroEmptyKey> ids;
+    ids.insert(0xffffffff, 1);
+    if (ids.get(0xffffffff) != 1 || ids.contains(0)) {
+        cerr << "PackedHashTable with a custom empty key has the wrong contents.\n";
+        return false;
+    }
+
+    cout << "Testing PackedHashTable maximum load factors that would let the table fill up\n";
+    float badLoadFactors[] = { 1.0f, 1.5f, 0.0f, -0.5f };
+    for (float loadFactor : badLoadFactors) {
+        try {
+            PackedHashTable<int, int> full(loadFactor);
+            cerr << "A maximum load factor of " << loadFactor << " was accepted.\n";
+            return false;
+        } catch (std::invalid_argument&) {
+        }
+    }
+
+    return true;
+}
+
+// Both kinds of set have to hold the same keys as a std::set
+template<typename Set, typename K> static bool testSet(const char* name, const vector<K>& keys) {
+    Set hashSet;
+    set<K> reference;
+
+    cout << "Testing " << name << "\n";
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (hashSet.insert(keys[i]) != reference.insert(keys[i]).second) {
+            cerr << "Inserting a key gave the wrong answer.\n";
+            return false;
+        }
+    }
+    for (size_t i = 0; i < keys.size(); i += 3) {
+        if (hashSet.remove(keys[i]) != (reference.erase(keys[i]) == 1)) {
+            cerr << "Removing a key gave the wrong answer.\n";
+            return false;
+        }
+    }
+
+    set<K> iterated(hashSet.begin(), hashSet.end());
+    if (iterated != reference || hashSet.size() != reference.size()) {
+        cerr << "Set holds " << hashSet.size() << " keys, expected " << reference.size() << ".\n";
+        return false;
+    }
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (hashSet.contains(keys[i]) != (reference.count(keys[i]) == 1)) {
+            cerr << "Set membership is wrong.\n";
+            return false;
+        }
+    }
+
+    Set copy(reference.begin(), reference.end());
+    if (copy.size() != reference.size()) {
+        cerr << "Set built from a range has " << copy.size() << " keys, expected " << reference.size() << ".\n";
+        return false;
+    }
+
+    return true;
+}
+
+bool runHashSetTests(void) {
+
+    if (!testPackedHashTable()) {
+        return false;
+    }
+
+    vector<int> intKeys;
+    vector<string> stringKeys;
+    vector<double> doubleKeys;
+    vector<float> floatKeys;
+    srand(1234);
+    for (int i = 0; i < 20000; i++) {
+        intKeys.push_back(rand() % 10000);
+        stringKeys.push_back("key " + to_string(intKeys.back()));
+        doubleKeys.push_back(intKeys.back() * 0.5);
+        floatKeys.push_back(intKeys.back() * 0.25f);
+    }
+
+    static_assert(std::is_same<HashSet<int>::Table, PackedHashTable<int, NoValue>>::value, "int sets are packed");
+    static_assert(std::is_same<HashSet<string>::Table, HashTable<string, NoValue>>::value,
+                    "string sets are chained");
+    static_assert(std::is_same<HashSet<double>::Table, HashTable<double, NoValue>>::value,
+                    "floating point sets are chained, their empty key would be a NaN");
+
+    // A packed table's empty key, all bits set, is a NaN and never matched, so the first insert never finished
+    cout << "Testing sets of floating point numbers\n";
+    HashSet<double> one;
+    one.insert(1.5);
+    if (!one.contains(1.5) || one.contains(2.5)) {
+        cerr << "HashSet<double> lost its only key.\n";
+        return false;
+    }
+    HashSet<double> zeros;
+    zeros.insert(0.0);
+    if (!zeros.contains(-0.0) || zeros.insert(-0.0) || zeros.size() != 1) {
+        cerr << "HashSet<double> holds 0.0 and -0.0 as different keys.\n";
+        return false;
+    }
+
+    return testSet<HashSet<int>>("packed HashSet<int>", intKeys)
+                    && testSet<HashSet<int, DefaultHashGenerator<int>, false>>("chained HashSet<int>", intKeys)
+                    && testSet<HashSet<string>>("HashSet<string>", stringKeys)
+                    && testSet<HashSet<double>>("HashSet<double>", doubleKeys)
+                    && testSet<HashSet<float>>("HashSet<float>", floatKeys);
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef HASHSIZEPOLICY_H
+#define HASHSIZEPOLICY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace mjl {
+namespace homebrew {
+
+/*********************
+ * Table of contents *
+ *********************
+ *
+ * A size policy decides how many buckets a hash table has, how that number
+ * grows, and how a hash is reduced to a bucket index. Every policy has the
+ * same interface:
+ *
+ *     unsigned int size(void) const        Number of buckets
+ *     unsigned int index(size_t hash) const A bucket index in [0, size())
+ *     void grow(void)                      Move to the next larger size
+ *
+ * PrimeSizePolicy        Prime sizes, modulo by a precomputed magic divisor
+ * PowerOfTwoSizePolicy   Power of two sizes, bit mask
+ * FastRangeSizePolicy    Any size, multiply and shift (Lemire's fastrange)
+ */
+
+/* Note: C++ initialization of static constant arrays in template classes sucks
+ * so using the preprocessor is perhaps the best way.
+ */
+#define HASH_TABLE_SIZES 37, 79, 163, 331, 673, 1361, 2729, 5471, 10949, 21893, 43787, 87583
+#define INITIAL_HASH_TABLE_SIZE 37
+#define NUMBER_OF_SIZES 12
+
+// The upper 64 bits of the 128 bit product a * b
+inline uint64_t multiplyHigh(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+    return (uint64_t) (((unsigned __int128) a * b) >> 64);
+#else
+    uint64_t aHigh = a >> 32, aLow = (uint32_t) a;
+    uint64_t bHigh = b >> 32, bLow = (uint32_t) b;
+    uint64_t middle = ((aLow * bLow) >> 32) + (uint32_t) (aHigh * bLow) + (uint32_t) (aLow * bHigh);
+    return aHigh * bHigh + ((aHigh * bLow) >> 32) + ((aLow * bHigh) >> 32) + (middle >> 32);
+#endif
+}
+
+/**
+ * Walks the HASH_TABLE_SIZES list of primes, and once those run out simply
+ * doubles. A prime number of buckets forgives a hash function with poor low
+ * bits, but a modulo by a number only known at runtime is an integer division
+ * on every lookup.
+ *
+ * Instead, every time the size changes a "magic" number is precomputed (in the
+ * style of libdivide), which turns the modulo into two multiplies. For any 32
+ * bit n and divisor d, with magic = floor(2^64 / d) + 1:
+ *
+ *     n % d == high 64 bits of ((magic * n mod 2^64) * d)
+ *
+ * The hash is folded down to 32 bits first so this holds.
+ */
+class PrimeSizePolicy {
+ public:
+    PrimeSizePolicy()
+                    : sizesIndex(0),
+                      theSize(INITIAL_HASH_TABLE_SIZE),
+                      magic(computeMagic(INITIAL_HASH_TABLE_SIZE)) {
+    }
+
+    unsigned int size(void) const {
+        return theSize;
+    }
+
+    unsigned int index(size_t hash) const {
+        uint32_t folded = (uint32_t) ((uint64_t) hash ^ ((uint64_t) hash >> 32));
+        return (unsigned int) multiplyHigh(magic * folded, theSize);
+    }
+
+    void grow(void) {
+        static const unsigned int sizes[NUMBER_OF_SIZES] = { HASH_TABLE_SIZES };
+
+        if (sizesIndex + 1 < NUMBER_OF_SIZES) {
+            // If there is an existing prime number in our list left use that
+            sizesIndex++;
+            theSize = sizes[sizesIndex];
+        } else {
+            // Otherwise we are out of prime numbers, simply begin doubling hash table size
+            theSize = 2 * theSize;
+        }
+
+        magic = computeMagic(theSize);
+    }
+
+ private:
+    static uint64_t computeMagic(unsigned int divisor) {
+        return UINT64_MAX / divisor + 1;
+    }
+
+    unsigned int sizesIndex;
+    unsigned int theSize;
+    uint64_t magic;
+};
+
+/**
+ * Power of two sizes, so reducing a hash is a single AND with size() - 1. This
+ * only keeps the low bits of the hash, so it relies on the hash generator
+ * mixing all of its input into them (DefaultHashGenerator does).
+ */
+class PowerOfTwoSizePolicy {
+ public:
+    PowerOfTwoSizePolicy()
+                    : theSize(64) {
+    }
+
+    unsigned int size(void) const {
+        return theSize;
+    }
+
+    unsigned int index(size_t hash) const {
+        return (unsigned int) hash & (theSize - 1);
+    }
+
+    void grow(void) {
+        theSize = 2 * theSize;
+    }
+
+ private:
+    unsigned int theSize;
+};
+
+/**
+ * Lemire's "fastrange": for a 32 bit x, (x * size) >> 32 lands in [0, size)
+ * for any size, using a multiply and a shift instead of a division. The table
+ * sizes are the same as PrimeSizePolicy (any size works), which makes the two
+ * directly comparable. The upper 32 bits of the hash are used, so like
+ * PowerOfTwoSizePolicy this relies on a mixing hash generator.
+ */
+class FastRangeSizePolicy {
+ public:
+    FastRangeSizePolicy()
+                    : sizesIndex(0),
+                      theSize(INITIAL_HASH_TABLE_SIZE) {
+    }
+
+    unsigned int size(void) const {
+        return theSize;
+    }
+
+    unsigned int index(size_t hash) const {
+        uint64_t high = (sizeof(size_t) > 4) ? (uint64_t) hash >> 32 : (uint64_t) hash;
+        return (unsigned int) ((high * theSize) >> 32);
+    }
+
+    void grow(void) {
+        static const unsigned int sizes[NUMBER_OF_SIZES] = { HASH_TABLE_SIZES };
+
+        if (sizesIndex + 1 < NUMBER_OF_SIZES) {
+            sizesIndex++;
+            theSize = sizes[sizesIndex];
+        } else {
+            theSize = 2 * theSize;
+        }
+    }
+
+ private:
+    unsigned int sizesIndex;
+    unsigned int theSize;
+};
+
+} /* namespace homebrew */
+} /* namespace mjl */
+
+#endif /* HASHSIZEPOLICY_H */
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef HASHSTATISTICSPOLICY_H
+#define HASHSTATISTICSPOLICY_H
+
+#include <cstddef>
+#include <iostream>
+
+namespace mjl {
+namespace homebrew {
+
+/**
+ * A statistics policy is told what a HashTable does on its hot paths: every
+ * search of a chain and how many buckets it compared, every rehash and how
+ * long it took, and every allocation. ENABLED tells the table whether it
+ * should bother reading the clock for it.
+ *
+ * Statistics are updated as the table is used, so they are exactly as thread
+ * safe as the table itself.
+ */
+
+// Count nothing. Every hook is empty, so with this policy the table compiles to the same code as without one.
+class NoHashStatistics {
+ public:
+    static const bool ENABLED = false;
+
+    void lookedUp(bool found, unsigned int steps) {
+    }
+
+    void rehashed(void) {
+    }
+
+    void rehashWorked(unsigned long long nanoseconds) {
+    }
+
+    void allocated(size_t bytes) {
+    }
+
+    void print(std::ostream& out) const {
+    }
+};
+
+/**
+ * Count everything. A high mean chain walk with a low load factor points at a
+ * HashGenerator that spreads keys badly, a high mean chain walk with a high
+ * load factor at a table that needs to be reserved larger.
+ *
+ * Lookups include the search every insert does for an existing key, and the
+ * search remove does. A search that finds nothing is a miss. Chain walk steps
+ * count every bucket compared against the key, in both tables while a rehash
+ * is in progress.
+ */
+class CountingHashStatistics {
+ public:
+    static const bool ENABLED = true;
+
+    CountingHashStatistics(void)
+                    : lookups(0),
+                      hits(0),
+                      misses(0),
+                      chainSteps(0),
+                      rehashes(0),
+                      rehashNanoseconds(0),
+                      allocations(0),
+                      allocatedBytes(0) {
+    }
+
+    void lookedUp(bool found, unsigned int steps) {
+        lookups++;
+        if (found) {
+            hits++;
+        } else {
+            misses++;
+        }
+        chainSteps += steps;
+    }
+
+    void rehashed(void) {
+        rehashes++;
+    }
+
+    void rehashWorked(unsigned long long nanoseconds) {
+        rehashNanoseconds += nanoseconds;
+    }
+
+    void allocated(size_t bytes) {
+        allocations++;
+        allocatedBytes += bytes;
+    }
+
+    double meanChainSteps(void) const {
+        return lookups == 0 ? 0.0 : (double) chainSteps / lookups;
+    }
+
+    void print(std::ostream& out) const {
+        out << "lookups " << lookups << " (hits " << hits << ", misses " << misses << ")" << std::endl;
+        out << "chain walk steps " << chainSteps << " (mean " << meanChainSteps() << " per lookup)" << std::endl;
+        out << "rehashes " << rehashes << " taking " << rehashNanoseconds / 1000000.0 << " ms" << std::endl;
+        out << "allocations " << allocations << " totalling " << allocatedBytes << " bytes" << std::endl;
+    }
+
+    unsigned long long lookups;
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long chainSteps;
+    unsigned long long rehashes;
+    unsigned long long rehashNanoseconds;   // Allocating new tables and moving entries into them
+    unsigned long long allocations;         // Tables and the buckets chained behind their first buckets
+    unsigned long long allocatedBytes;
+};
+
+} /* namespace homebrew */
+} /* namespace mjl */
+
+#endif /* HASHSTATISTICSPOLICY_H */
@@ -22,207 +22,236 @@
 #ifndef HASHTABLE_H
 #define HASHTABLE_H
 
+#include "HashGenerator.h"
+#include "HashRehashPolicy.h"
+#include "HashSizePolicy.h"
+#include "HashStatisticsPolicy.h"
+#include "PoolAllocator.h"
+
+#include <chrono>
+#include <cstddef>
+#include <iterator>
+#include <new>
 #include <stdexcept>
 #include <iostream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <stdlib.h>
+
+// Ask for the cache line at address without waiting for it, where the compiler supports it
+#if defined(__GNUC__)
+#define HASH_PREFETCH(address) __builtin_prefetch(address)
+#else
+#define HASH_PREFETCH(address)
+#endif
 
 namespace mjl {
 namespace homebrew {
 
-template<typename K, typename V> struct Bucket {
+/**
+ * The full hash of a bucket's key. A lookup compares hashes before keys, so
+ * keys that merely share a chain (long strings, say) are almost never
+ * compared, and a rehash never has to hash a key again.
+ *
+ * Numbers and pointers are compared, and hashed, about as quickly as a stored
+ * hash can be read, so for them nothing is stored and buckets stay smaller.
+ */
+template<typename K, bool Cached = !std::is_arithmetic<K>::value && !std::is_pointer<K>::value> struct BucketHash {
  public:
-    Bucket(void)
-                    : key(nullptr),
-                      value(nullptr),
-                      next(nullptr) {
-    }
-    Bucket(const K& theKey, const V& theValue)
-                    : key(new K(theKey)),
-                      value(new V(theValue)),
-                      next(nullptr) {
-    }
-    K* key;
-    V* value;
-    struct Bucket<K, V>* next;
-};
-
-// This is a generic implementation of a hash function
-template<typename K> class DefaultHashGenerator {
-    static const unsigned int THRESHOLD = 32;
-
-    /**
-     * This is a generic hashing function used to generate an index into a hash
-     * table. It is designed to work with any object type and to treat the
-     * object as an opaque stream of bytes.
-     *
-     * Note that since we have no knowledge of what the object is made of, it
-     * is somewhat a matter of luck as to whether or not the function has the
-     * properties of a good hashing function. Obviously this is not good, so
-     * what a user should do instead is to supply their own hashing function
-     * appropriate for their user-defined type (class).
-     *
-     * A user can supply their own hash function by implementing a template
-     * class just like this one, that takes their user-defined type (class) as
-     * a template parameter, and provides their own implementation of the
-     * chooseBucket function. Within the HashTable itself, the value returned
-     * from the chooseBucket function will be divided by the hash table size,
-     * and the reminder will be used as an index into the table.
-     */
-    static unsigned int chooseBucket(const K& k) {
-        unsigned int sum = 0;
-        unsigned char* data = &k;
-        unsigned int objectSize = sizeof(k);
-
-        if (objectSize < THRESHOLD) {
-
-            // If object size is small enough do a simple sum
-            for (unsigned int i = 0; i < objectSize; i++)
-                sum += data[i];
-        } else {
+    static const bool CACHES_HASH = true;
 
-            // Otherwise sample data evenly distributed across object
-            unsigned int fractionSize = objectSize / THRESHOLD;
+    bool hashMatches(size_t theHash) const {
+        return hash == theHash;
+    }
 
-            for (unsigned int i = 0; i < THRESHOLD; i++) {
-                sum += data[i * fractionSize];
-            }
-        }
+    void setHash(size_t theHash) {
+        hash = theHash;
+    }
 
-        return sum;
+    void copyHash(const BucketHash& from) {
+        hash = from.hash;
     }
 
+    size_t hash;
 };
 
-// FIXME: Think about:
-//	casts from char/short to int
-//	casts from floating point types
-
-// signed & unsigned
-//char
-//short a;
-//int b;
-//long c;
-//long long d;
+template<typename K> struct BucketHash<K, false> {
+ public:
+    static const bool CACHES_HASH = false;
 
-//float e;
-//double f;
-//long double g;
+    bool hashMatches(size_t theHash) const {
+        return true;
+    }
 
-template<> class DefaultHashGenerator<char> {
- public:
-    static unsigned int chooseBucket(const char& k) {
-        return (unsigned int) k;
+    void setHash(size_t theHash) {
     }
-};
 
-template<> class DefaultHashGenerator<unsigned char> {
- public:
-    static unsigned int chooseBucket(const unsigned char& k) {
-        return (unsigned int) k;
+    void copyHash(const BucketHash& from) {
     }
 };
 
-template<> class DefaultHashGenerator<short> {
+/**
+ * One entry of a HashTable chain. The key and value live inline in the bucket,
+ * so an entry costs no allocations of its own. The storage for them is raw,
+ * and is only constructed while the bucket is occupied. A bucket that is all
+ * zero bytes is empty.
+ */
+template<typename K, typename V> struct Bucket : public BucketHash<K> {
  public:
-    static unsigned int chooseBucket(const short& k) {
-        return (unsigned int) k;
+    Bucket(void)
+                    : next(nullptr),
+                      occupied(false) {
     }
-};
 
-template<> class DefaultHashGenerator<unsigned short> {
- public:
-    static unsigned int chooseBucket(const unsigned short& k) {
-        return (unsigned int) k;
+    K& key(void) {
+        return *reinterpret_cast<K*>(keyStorage);
     }
-};
 
-template<> class DefaultHashGenerator<int> {
- public:
-    static unsigned int chooseBucket(const int& k) {
-        return (unsigned int) k;
+    const K& key(void) const {
+        return *reinterpret_cast<const K*>(keyStorage);
     }
-};
 
-template<> class DefaultHashGenerator<unsigned int> {
- public:
-    static unsigned int chooseBucket(const unsigned int& k) {
-        return (unsigned int) k;
+    V& value(void) {
+        return *reinterpret_cast<V*>(valueStorage);
     }
-};
 
-template<> class DefaultHashGenerator<long> {
- public:
-    static unsigned int chooseBucket(const long& k) {
-        return (unsigned int) k;
+    const V& value(void) const {
+        return *reinterpret_cast<const V*>(valueStorage);
     }
-};
 
-template<> class DefaultHashGenerator<unsigned long> {
- public:
-    static unsigned int chooseBucket(const unsigned long& k) {
-        return (unsigned int) k;
+    // Construct the key and value in place, the value from whatever arguments its constructor takes
+    template<typename KeyArg, typename... ValueArgs> void fill(size_t theHash, KeyArg&& theKey,
+                    ValueArgs&&... valueArgs) {
+        this->setHash(theHash);
+        new (keyStorage) K(std::forward<KeyArg>(theKey));
+        try {
+            new (valueStorage) V(std::forward<ValueArgs>(valueArgs)...);
+        } catch (...) {
+            key().~K();
+            throw;
+        }
+        occupied = true;
     }
-};
 
-template<> class DefaultHashGenerator<long long> {
- public:
-    static unsigned int chooseBucket(const long long& k) {
-        return (unsigned int) k;
+    // Move the entry out of from, leaving from empty
+    void moveFrom(Bucket& from) {
+        fill(0, std::move(from.key()), std::move(from.value()));
+        this->copyHash(from);
+        from.empty();
     }
-};
 
-template<> class DefaultHashGenerator<unsigned long long> {
- public:
-    static unsigned int chooseBucket(const unsigned long long& k) {
-        return (unsigned int) k;
+    void empty(void) {
+        key().~K();
+        value().~V();
+        occupied = false;
     }
+
+    struct Bucket<K, V>* next;
+    bool occupied;
+    alignas(K) unsigned char keyStorage[sizeof(K)];
+    alignas(V) unsigned char valueStorage[sizeof(V)];
 };
 
-/* Note: C++ initialization of static constant arrays in template classes sucks
- * so using the preprocessor is perhaps the best way.
+/**
+ * A hash table which resolves collisions by chaining. The first bucket of each
+ * chain lives in the table itself, further buckets are linked behind it.
+ *
+ * How many buckets there are and how a hash is turned into a bucket index is
+ * decided by the SizePolicy (see HashSizePolicy.h). Whether a rehash moves
+ * every entry at once or a few buckets at a time is decided by the
+ * RehashPolicy (see HashRehashPolicy.h). The buckets linked behind the first
+ * one come from the Allocator (see PoolAllocator.h).
+ *
+ * Keys and values are stored inside the buckets. insert copies or moves them
+ * in, emplace and try_emplace construct the value in place from arguments.
+ *
+ * getBatch and findMany look up many keys at once. All the keys are hashed
+ * and their buckets prefetched before any of them is compared, so the cache
+ * misses of the whole batch overlap instead of being waited on one by one.
+ *
+ * If the HashGenerator is transparent (see IsTransparentHash in
+ * HashGenerator.h), get, contains and remove also take any key type it can
+ * hash, and look it up as is. A HashTable<std::string, V> can be searched with
+ * a const char* or a StringSlice without building a std::string first.
+ *
+ * Iterating visits every entry once, in no particular order. Any change to
+ * the table, and any lookup while a rehash is in progress, invalidates the
+ * iterators. To fill a table with a known number of entries without growing
+ * it one step at a time, call reserve first or use the range constructor.
+ *
+ * The Statistics policy (see HashStatisticsPolicy.h) counts lookups, chain
+ * walks, rehashes and allocations. The default counts nothing and costs
+ * nothing. Together with occupancyHistogram it tells a HashGenerator that
+ * spreads keys badly apart from a table that is simply too full.
  */
-#define HASH_TABLE_SIZES 37, 79, 163, 331, 673, 1361, 2729, 5471, 10949, 21893, 43787, 87583
-#define INITIAL_HASH_TABLE_SIZE 37
-#define NUMBER_OF_SIZES 12
-
-template<typename K, typename V, typename HashGenerator = DefaultHashGenerator<K>> class HashTable {
+template<typename K, typename V, typename HashGenerator = DefaultHashGenerator<K>,
+                typename SizePolicy = PrimeSizePolicy, typename RehashPolicy = StopTheWorldRehashPolicy,
+                typename Allocator = NewDeleteAllocator, typename Statistics = NoHashStatistics> class HashTable
+                : private Statistics {
  public:
 
     // Default constructor
     HashTable()
                     : rehashThreshold(0.5f),
-                      hashTableSizesIndex(0),
-                      hashTableSize(INITIAL_HASH_TABLE_SIZE),
-                      size(0),
-                      table(new Bucket<K, V> [INITIAL_HASH_TABLE_SIZE]),
-                      hashTableSizes { HASH_TABLE_SIZES } {
+                      entryCount(0),
+                      sizing(),
+                      table(allocateTable(sizing.size())),
+                      oldSizing(),
+                      oldTable(nullptr),
+                      migrateIndex(0) {
+    }
+
+    /**
+     * Build a table from a range of pairs, like a std::vector<std::pair<K, V>>
+     * or a std::map<K, V>. If the range can be walked more than once the table
+     * is sized for all of it up front. When a key appears more than once, its
+     * last value wins.
+     */
+    template<typename InputIterator> HashTable(InputIterator first, InputIterator last)
+                    : HashTable() {
+        insertRange(first, last, typename std::iterator_traits<InputIterator>::iterator_category());
     }
 
     // Copy constructor
     HashTable(const HashTable& from)
                     : rehashThreshold(0.5f),
-                      hashTableSizesIndex(from.hashTableSizesIndex),
-                      hashTableSize(from.hashTableSize),
-                      size(from.size),
-                      table(new Bucket<K, V> [from.hashTableSize]),
-                      hashTableSizes { HASH_TABLE_SIZES } {
+                      entryCount(from.entryCount),
+                      sizing(from.sizing),
+                      table(allocateTable(from.sizing.size())),
+                      oldSizing(),
+                      oldTable(nullptr),
+                      migrateIndex(0) {
         commonCopy(*this, from);
     }
 
     // Move constructor
     HashTable(HashTable&& from) noexcept
-                    : rehashThreshold(0.5f),
-                      hashTableSizes { HASH_TABLE_SIZES } {
-        hashTableSizesIndex = from.hashTableSizesIndex;
-        hashTableSize = from.hashTableSize;
-        size = from.size;
+                    : Statistics(from.stats()),
+                      rehashThreshold(0.5f),
+                      allocator(std::move(from.allocator)) {
+        sizing = from.sizing;
+        entryCount = from.entryCount;
         table = from.table;
+        oldSizing = from.oldSizing;
+        oldTable = from.oldTable;
+        migrateIndex = from.migrateIndex;
         from.table = nullptr;
+        from.oldTable = nullptr;
     }
 
     // Assignment operator
     HashTable& operator=(const HashTable& from) {
+
+        if (this == &from) {
+            return *this;
+        }
+
         commonDelete();
-        table = new Bucket<K, V> [from.hashTableSize];
+        table = allocateTable(from.sizing.size());
+        oldTable = nullptr;
+        migrateIndex = 0;
         commonCopy(*this, from);
         return *this;
     }
@@ -230,14 +259,23 @@ template<typename K, typename V, typename HashGenerator = DefaultHashGenerator<K
     // Move assignment operator
     HashTable& operator=(HashTable&& from) noexcept {
 
+        if (this == &from) {
+            return *this;
+        }
+
         commonDelete();
 
-        hashTableSizesIndex = from.hashTableSizesIndex;
-        hashTableSize = from.hashTableSize;
-        size = from.size;
+        allocator = std::move(from.allocator);
+        stats() = from.stats();
+        sizing = from.sizing;
+        entryCount = from.entryCount;
         table = from.table;
+        oldSizing = from.oldSizing;
+        oldTable = from.oldTable;
+        migrateIndex = from.migrateIndex;
 
         from.table = nullptr;
+        from.oldTable = nullptr;
 
         return *this;
     }
@@ -247,109 +285,583 @@ template<typename K, typename V, typename HashGenerator = DefaultHashGenerator<K
         commonDelete();
     }
 
+    // Remove every entry and go back to the initial size
+    void clear(void) {
+        commonDelete();
+        sizing = SizePolicy();
+        entryCount = 0;
+        table = allocateTable(sizing.size());
+        oldTable = nullptr;
+        migrateIndex = 0;
+    }
+
+    /**
+     * Forward iterator over the entries. *it is a pair of references to the
+     * key and value, which are also available as it.key() and it.value().
+     */
+    template<bool IsConst> class Iterator {
+     public:
+        typedef typename std::conditional<IsConst, const V, V>::type MappedType;
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::pair<const K, V> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef std::pair<const K&, MappedType&> reference;
+        typedef void pointer;
+
+        // The end iterator
+        Iterator(void)
+                        : owner(nullptr),
+                          bucket(nullptr),
+                          index(0),
+                          inOldTable(false) {
+        }
+
+        // A const_iterator can be made from an iterator
+        Iterator(const Iterator<false>& from)
+                        : owner(from.owner),
+                          bucket(from.bucket),
+                          index(from.index),
+                          inOldTable(from.inOldTable) {
+        }
+
+        const K& key(void) const {
+            return bucket->key();
+        }
+
+        MappedType& value(void) const {
+            return bucket->value();
+        }
+
+        reference operator*(void) const {
+            return reference(bucket->key(), bucket->value());
+        }
+
+        Iterator& operator++(void) {
+            if (bucket->next != nullptr) {
+                // Buckets linked behind the first one are never empty
+                bucket = bucket->next;
+            } else {
+                index++;
+                seek();
+            }
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator before(*this);
+            ++(*this);
+            return before;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return bucket == other.bucket;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return bucket != other.bucket;
+        }
+
+     private:
+        friend class HashTable;
+        template<bool> friend class Iterator;
+
+        explicit Iterator(const HashTable* theOwner)
+                        : owner(theOwner),
+                          bucket(nullptr),
+                          index(0),
+                          inOldTable(false) {
+            seek();
+        }
+
+        /**
+         * Stop at the first full bucket of the table at or after index. After the
+         * current table comes the part of the old table that hasn't been moved yet.
+         */
+        void seek(void) {
+
+            if (!inOldTable) {
+                for (; index < owner->sizing.size(); index++) {
+                    if (owner->table[index].occupied) {
+                        bucket = &owner->table[index];
+                        return;
+                    }
+                }
+                if (owner->oldTable == nullptr) {
+                    bucket = nullptr;
+                    return;
+                }
+                inOldTable = true;
+                index = owner->migrateIndex;
+            }
+
+            for (; index < owner->oldSizing.size(); index++) {
+                if (owner->oldTable[index].occupied) {
+                    bucket = &owner->oldTable[index];
+                    return;
+                }
+            }
+            bucket = nullptr;
+        }
+
+        const HashTable* owner;
+        Bucket<K, V>* bucket;
+        unsigned int index;
+        bool inOldTable;
+    };
+
+    typedef Iterator<false> iterator;
+    typedef Iterator<true> const_iterator;
+
+    iterator begin(void) {
+        return iterator(this);
+    }
+
+    iterator end(void) {
+        return iterator();
+    }
+
+    const_iterator begin(void) const {
+        return const_iterator(this);
+    }
+
+    const_iterator end(void) const {
+        return const_iterator();
+    }
+
+    const_iterator cbegin(void) const {
+        return const_iterator(this);
+    }
+
+    const_iterator cend(void) const {
+        return const_iterator();
+    }
+
+    unsigned int size(void) const {
+        return entryCount;
+    }
+
+    // Buckets in the table itself, not counting the buckets chained behind them
+    unsigned int bucketCount(void) const {
+        return sizing.size();
+    }
+
+    float loadFactor(void) const {
+        return (float) entryCount / sizing.size();
+    }
+
+    const Statistics& statistics(void) const {
+        return stats();
+    }
+
+    /**
+     * How many chains hold how many entries: element i is the number of
+     * chains with exactly i entries. Chains of the old table that have not been
+     * moved yet during a rehash are counted as they are.
+     */
+    std::vector<unsigned int> occupancyHistogram(void) const {
+
+        std::vector<unsigned int> histogram;
+
+        for (unsigned int i = 0; i < sizing.size(); i++) {
+            countChain(histogram, &table[i]);
+        }
+
+        if (oldTable != nullptr) {
+            for (unsigned int i = migrateIndex; i < oldSizing.size(); i++) {
+                countChain(histogram, &oldTable[i]);
+            }
+        }
+
+        return histogram;
+    }
+
+    // Write the statistics counted so far and the occupancy histogram to out
+    void printStatistics(std::ostream& out) const {
+
+        out << "entries " << entryCount << " in " << sizing.size() << " buckets (load factor " << loadFactor()
+                        << ")" << std::endl;
+        stats().print(out);
+
+        std::vector<unsigned int> histogram = occupancyHistogram();
+        for (size_t i = 0; i < histogram.size(); i++) {
+            out << "chains of length " << i << ": " << histogram[i] << std::endl;
+        }
+    }
+
+    /**
+     * Grow the table, once, to a size that holds n entries without another
+     * rehash. Also finishes any rehash that is in progress.
+     */
+    void reserve(size_t n) {
+
+        SizePolicy target = sizing;
+        while ((double) n / target.size() >= rehashThreshold) {
+            target.grow();
+        }
+
+        if (target.size() != sizing.size()) {
+            rehashTo(target);
+        }
+
+        migrate(oldSizing.size());
+    }
+
+    // Enables the overloads that take a Q, when HashGenerator is transparent and Q isn't K anyway
+    template<typename Q> using OnlyIfTransparent = typename std::enable_if<IsTransparentHash<HashGenerator>::value
+                    && !std::is_same<Q, K>::value>::type;
+
     V& get(const K& key) {
+        return getValue(key);
+    }
 
-        unsigned int index = selectBucket(key);
-        Bucket<K, V>* current = nullptr;
+    // Only with a transparent HashGenerator: look up a key that is not a K, without converting it
+    template<typename Q, typename = OnlyIfTransparent<Q>> V& get(const Q& key) {
+        return getValue(key);
+    }
+
+    bool contains(const K& key) {
+        return containsKey(key);
+    }
+
+    template<typename Q, typename = OnlyIfTransparent<Q>> bool contains(const Q& key) {
+        return containsKey(key);
+    }
+
+    /**
+     * Look up keys[0..n), and set out[i] to the value of keys[i], or to nullptr
+     * if keys[i] is not in the table. Returns how many keys were found. The
+     * pointers stay valid until the table is next used.
+     */
+    size_t getBatch(const K* keys, size_t n, V** out) {
+
+        migrate(RehashPolicy::BUCKETS_PER_STEP);
+
+        size_t found = 0;
+        size_t hashes[BATCH_SIZE];
+
+        for (size_t start = 0; start < n; start += BATCH_SIZE) {
+            size_t count = (n - start < BATCH_SIZE) ? n - start : BATCH_SIZE;
+            prefetchBatch(keys + start, count, hashes);
+            for (size_t i = 0; i < count; i++) {
+                Bucket<K, V>* bucket = findBucket(keys[start + i], hashes[i]);
+                out[start + i] = (bucket != nullptr) ? &bucket->value() : nullptr;
+                found += (bucket != nullptr);
+            }
+        }
 
-        for (current = &table[index]; current != nullptr; current = current->next) {
-            if (current->key != nullptr && *current->key == key) {
-                return *current->value;
+        return found;
+    }
+
+    // The same as getBatch, for callers who only need to know whether each key is there
+    size_t findMany(const K* keys, size_t n, bool* out) {
+
+        migrate(RehashPolicy::BUCKETS_PER_STEP);
+
+        size_t found = 0;
+        size_t hashes[BATCH_SIZE];
+
+        for (size_t start = 0; start < n; start += BATCH_SIZE) {
+            size_t count = (n - start < BATCH_SIZE) ? n - start : BATCH_SIZE;
+            prefetchBatch(keys + start, count, hashes);
+            for (size_t i = 0; i < count; i++) {
+                out[start + i] = findBucket(keys[start + i], hashes[i]) != nullptr;
+                found += out[start + i];
             }
         }
 
-        throw std::out_of_range("Tried to get entry that does not exist.");
+        return found;
     }
 
-    // Will delete any element that is already there and insert new one
+    // Will replace any value that is already there with a copy of the new one
     void insert(const K& key, const V& value) {
+        assign(key, value);
+    }
 
-        unsigned int index = selectBucket(key);
-        unsigned int collisions = 0;
-        Bucket<K, V>* current = nullptr;
-        Bucket<K, V>* prev = nullptr;
-        bool inserted = false;
-
-        // Traverse the hash table list beginning to end
-        current = &table[index];
-        do {
-            if (current->key == nullptr) {
-                // If the current bucket is empty simply insert a new copy of the value
-                current->key = new K(key);
-                current->value = new V(value);
-                inserted = true;
-                size++;
-                break;
-            } else if (*current->key == key) {
-                // Otherwise if the bucket is full and we have a matching key. Delete
-                // the value there and replace it with a copy of the new value.
-                delete current->key;
-                delete current->value;
-                current->key = new K(key);
-                current->value = new V(value);
-                inserted = true;
-                size++;
-                break;
-            } else {
-                // We have a collision (handle this case below)
-                collisions++;
+    // The same, but moves the value in instead of copying it
+    void insert(const K& key, V&& value) {
+        assign(key, std::move(value));
+    }
+
+    // The same, but moves both the key and the value in
+    void insert(K&& key, V&& value) {
+        assign(std::move(key), std::move(value));
+    }
+
+    /**
+     * Construct the value in place from valueArgs. If the key is already in the
+     * table, its value is replaced by one built from valueArgs instead. Returns
+     * the value.
+     */
+    template<typename... ValueArgs> V& emplace(const K& key, ValueArgs&&... valueArgs) {
+        return emplaceValue(key, std::forward<ValueArgs>(valueArgs)...);
+    }
+
+    template<typename... ValueArgs> V& emplace(K&& key, ValueArgs&&... valueArgs) {
+        return emplaceValue(std::move(key), std::forward<ValueArgs>(valueArgs)...);
+    }
+
+    /**
+     * Construct the value in place from valueArgs, but only if key is not in
+     * the table yet. Otherwise nothing happens, and valueArgs are not touched.
+     * Returns true if the value was inserted.
+     */
+    template<typename... ValueArgs> bool try_emplace(const K& key, ValueArgs&&... valueArgs) {
+        return tryEmplaceValue(key, std::forward<ValueArgs>(valueArgs)...);
+    }
+
+    template<typename... ValueArgs> bool try_emplace(K&& key, ValueArgs&&... valueArgs) {
+        return tryEmplaceValue(std::move(key), std::forward<ValueArgs>(valueArgs)...);
+    }
+
+    bool remove(const K& key) {
+        return removeKey(key);
+    }
+
+    template<typename Q, typename = OnlyIfTransparent<Q>> bool remove(const Q& key) {
+        return removeKey(key);
+    }
+
+ private:
+
+    template<typename Q> V& getValue(const Q& key) {
+
+        migrate(RehashPolicy::BUCKETS_PER_STEP);
+
+        Bucket<K, V>* found = findBucket(key, HashOf<HashGenerator, Q>::hash(key));
+
+        if (found == nullptr) {
+            throw std::out_of_range("Tried to get entry that does not exist.");
+        }
+
+        return found->value();
+    }
+
+    template<typename Q> bool containsKey(const Q& key) {
+
+        migrate(RehashPolicy::BUCKETS_PER_STEP);
+
+        return findBucket(key, HashOf<HashGenerator, Q>::hash(key)) != nullptr;
+    }
+
+    template<typename Q> bool removeKey(const Q& key) {
+
+        migrate(RehashPolicy::BUCKETS_PER_STEP);
+
+        size_t hash = HashOf<HashGenerator, Q>::hash(key);
+        unsigned int steps = 0;
+        bool removed = removeFromList(&table[sizing.index(hash)], key, hash, steps);
+
+        if (!removed && oldTable != nullptr) {
+            unsigned int oldIndex = oldSizing.index(hash);
+            if (oldIndex >= migrateIndex) {
+                removed = removeFromList(&oldTable[oldIndex], key, hash, steps);
             }
-            prev = current;
-            current = current->next;
-        } while (current != nullptr);
+        }
+
+        stats().lookedUp(removed, steps);
+
+        if (removed) {
+            // Keep track of how many elements are stored
+            entryCount--;
+        }
+
+        return removed;
+    }
+
+    // KeyArg is always const K& or K, so the key can be copied or moved into the table
+    template<typename KeyArg, typename ValueArg> void assign(KeyArg&& key, ValueArg&& value) {
+
+        migrate(RehashPolicy::BUCKETS_PER_STEP);
+
+        size_t hash = HashOf<HashGenerator, K>::hash(key);
+        Bucket<K, V>* found = findBucket(key, hash);
+
+        if (found != nullptr) {
+            // We have a matching key, overwrite the value that is there
+            found->value() = std::forward<ValueArg>(value);
+            return;
+        }
+
+        insertNew(hash, std::forward<KeyArg>(key), std::forward<ValueArg>(value));
+    }
+
+    template<typename KeyArg, typename... ValueArgs> V& emplaceValue(KeyArg&& key, ValueArgs&&... valueArgs) {
+
+        migrate(RehashPolicy::BUCKETS_PER_STEP);
+
+        size_t hash = HashOf<HashGenerator, K>::hash(key);
+        Bucket<K, V>* found = findBucket(key, hash);
+
+        if (found != nullptr) {
+            // Build the new value before giving up the old one, in case its constructor throws
+            found->value() = V(std::forward<ValueArgs>(valueArgs)...);
+            return found->value();
+        }
+
+        return insertNew(hash, std::forward<KeyArg>(key), std::forward<ValueArgs>(valueArgs)...)->value();
+    }
+
+    template<typename KeyArg, typename... ValueArgs> bool tryEmplaceValue(KeyArg&& key, ValueArgs&&... valueArgs) {
+
+        migrate(RehashPolicy::BUCKETS_PER_STEP);
+
+        size_t hash = HashOf<HashGenerator, K>::hash(key);
+
+        if (findBucket(key, hash) != nullptr) {
+            return false;
+        }
+
+        insertNew(hash, std::forward<KeyArg>(key), std::forward<ValueArgs>(valueArgs)...);
+        return true;
+    }
+
+    // Add an entry for a key that is known not to be in the table yet
+    template<typename KeyArg, typename... ValueArgs> Bucket<K, V>* insertNew(size_t hash, KeyArg&& key,
+                    ValueArgs&&... valueArgs) {
+
+        float newLoadFactor = (entryCount + 1.0) / sizing.size();
+
+        if (newLoadFactor >= rehashThreshold) {
+            rehash();
+        }
+
+        return placeNew(hash, std::forward<KeyArg>(key), std::forward<ValueArgs>(valueArgs)...);
+    }
+
+    // Put a new entry in the current table, whether or not the table is getting full
+    template<typename KeyArg, typename... ValueArgs> Bucket<K, V>* placeNew(size_t hash, KeyArg&& key,
+                    ValueArgs&&... valueArgs) {
+
+        // New entries always go into the current table, never into a table being moved out of
+        Bucket<K, V>* first = &table[sizing.index(hash)];
+        Bucket<K, V>* inserted = first;
+
+        if (first->occupied) {
+            // If the first bucket is full link a new bucket in right behind it
+            inserted = createBucket(allocator);
+            try {
+                inserted->fill(hash, std::forward<KeyArg>(key), std::forward<ValueArgs>(valueArgs)...);
+            } catch (...) {
+                allocator.destroy(inserted);
+                throw;
+            }
+            inserted->next = first->next;
+            first->next = inserted;
+        } else {
+            first->fill(hash, std::forward<KeyArg>(key), std::forward<ValueArgs>(valueArgs)...);
+        }
+
+        entryCount++;
+        return inserted;
+    }
+
+    // A range that can only be walked once is simply inserted one entry at a time
+    template<typename InputIterator> void insertRange(InputIterator first, InputIterator last,
+                    std::input_iterator_tag) {
+        for (; first != last; ++first) {
+            insert(first->first, first->second);
+        }
+    }
 
-        // We have traversed the whole list but did not find a matching key, so insert
-        // at the end of the list.
-        if (inserted == false) {
+    // Otherwise size the table once, after which no entry needs a load check
+    template<typename ForwardIterator> void insertRange(ForwardIterator first, ForwardIterator last,
+                    std::forward_iterator_tag) {
 
-            float newLoadFactor = (size + 1.0) / hashTableSize;
+        reserve(entryCount + std::distance(first, last));
 
-            if (newLoadFactor < rehashThreshold) {
-                Bucket<K, V>* additionalBucket = new Bucket<K, V>;
-                additionalBucket->key = new K(key);
-                additionalBucket->value = new V(value);
-                prev->next = additionalBucket;
-                size++;
+        for (; first != last; ++first) {
+            size_t hash = HashOf<HashGenerator, K>::hash(first->first);
+            Bucket<K, V>* found = findBucket(first->first, hash);
+            if (found != nullptr) {
+                found->value() = first->second;
             } else {
-                rehash();
-                insert(key, value);
+                placeNew(hash, first->first, first->second);
             }
         }
     }
 
-    bool remove(const K& key) {
+    /**
+     * Hash count keys into hashes, and start loading the first bucket of each
+     * of them (from both tables, while a rehash is in progress).
+     */
+    void prefetchBatch(const K* keys, size_t count, size_t* hashes) const {
 
-        // Walk down the list from the front, searching for a matching key. When we find a match
-        // delete the data and update the list. Save temporary copy of the next pointer before
-        // traversing it so we can patch the list together properly.
+        for (size_t i = 0; i < count; i++) {
+            hashes[i] = HashOf<HashGenerator, K>::hash(keys[i]);
+            HASH_PREFETCH(&table[sizing.index(hashes[i])]);
+            if (oldTable != nullptr) {
+                HASH_PREFETCH(&oldTable[oldSizing.index(hashes[i])]);
+            }
+        }
+    }
+
+    /**
+     * Search the current table, and the part of the old table that has not been
+     * moved yet, for a bucket holding key.
+     */
+    template<typename Q> Bucket<K, V>* findBucket(const Q& key, size_t hash) {
 
-        unsigned int index = selectBucket(key);
         Bucket<K, V>* current = nullptr;
-        Bucket<K, V>* prev = nullptr;
-        bool removed = false;
+        unsigned int steps = 0;
+
+        for (current = &table[sizing.index(hash)]; current != nullptr; current = current->next) {
+            steps++;
+            if (current->occupied && current->hashMatches(hash) && current->key() == key) {
+                stats().lookedUp(true, steps);
+                return current;
+            }
+        }
+
+        if (oldTable != nullptr) {
+            unsigned int oldIndex = oldSizing.index(hash);
+            if (oldIndex >= migrateIndex) {
+                for (current = &oldTable[oldIndex]; current != nullptr; current = current->next) {
+                    steps++;
+                    if (current->occupied && current->hashMatches(hash) && current->key() == key) {
+                        stats().lookedUp(true, steps);
+                        return current;
+                    }
+                }
+            }
+        }
+
+        stats().lookedUp(false, steps);
+        return nullptr;
+    }
+
+    // Adds the number of buckets compared to steps
+    template<typename Q> bool removeFromList(Bucket<K, V>* first, const Q& key, size_t hash, unsigned int& steps) {
+
+        // Walk down the list from the front, searching for a matching key. When we find a match
+        // delete the data and update the list.
 
-        current = &table[index];
-        prev = &table[index];
+        Bucket<K, V>* current = first;
+        Bucket<K, V>* prev = nullptr;
 
         while (current != nullptr) {
 
+            steps++;
+
             // We found the value we were looking for
-            if (current->key != nullptr && *current->key == key) {
+            if (current->occupied && current->hashMatches(hash) && current->key() == key) {
 
                 // Delete the data
-                delete current->key;
-                current->key = nullptr;
-                delete current->value;
-                current->value = nullptr;
-
-                // If we are not at the front of the list delete the Bucket too
-                if (current != prev) {
-                    Bucket<K, V>* temp = current;
+                current->empty();
+
+                if (prev != nullptr) {
+                    // If we are not at the front of the list delete the Bucket too
                     prev->next = current->next;
-                    delete temp;
+                    allocator.destroy(current);
+                } else if (current->next != nullptr) {
+                    // Otherwise pull the second bucket forward so the first bucket is never
+                    // left empty in front of a non-empty list
+                    Bucket<K, V>* temp = current->next;
+                    current->moveFrom(*temp);
+                    current->next = temp->next;
+                    allocator.destroy(temp);
                 }
 
-                removed = true;
+                return true;
             }
 
             // Advance to next bucket in list
@@ -357,202 +869,305 @@ template<typename K, typename V, typename HashGenerator = DefaultHashGenerator<K
             current = current->next;
         }
 
-        // Keep track of how many elements are stored
-        size--;
+        return false;
+    }
 
-        // Construct and return a copy of the element removed
-        return removed;
+    // The hash of an occupied bucket's key, stored or not
+    static size_t hashOf(const Bucket<K, V>& bucket) {
+        return storedHash(bucket, std::integral_constant<bool, Bucket<K, V>::CACHES_HASH>());
     }
 
- private:
+    static size_t storedHash(const Bucket<K, V>& bucket, std::true_type) {
+        return bucket.hash;
+    }
+
+    static size_t storedHash(const Bucket<K, V>& bucket, std::false_type) {
+        return HashOf<HashGenerator, K>::hash(bucket.key());
+    }
+
+    /**
+     * A Bucket that is all zero bytes is an empty bucket, so a table can come
+     * straight from calloc. For large tables the operating system hands out
+     * zeroed pages lazily, so allocating a new table during a rehash does not
+     * stop to initialize every bucket up front.
+     */
+    Bucket<K, V>* allocateTable(unsigned int theSize) {
+        Bucket<K, V>* theTable = static_cast<Bucket<K, V>*>(calloc(theSize, sizeof(Bucket<K, V>)));
+        if (theTable == nullptr) {
+            throw std::bad_alloc();
+        }
+        stats().allocated(theSize * sizeof(Bucket<K, V>));
+        return theTable;
+    }
+
+    // A bucket to chain behind the first bucket of a list
+    Bucket<K, V>* createBucket(Allocator& from) {
+        Bucket<K, V>* bucket = from.template create<Bucket<K, V>>();
+        stats().allocated(sizeof(Bucket<K, V>));
+        return bucket;
+    }
+
+    // Add the entries of one chain to a histogram of chain lengths
+    static void countChain(std::vector<unsigned int>& histogram, const Bucket<K, V>* current) {
+
+        unsigned int length = 0;
+        for (; current != nullptr; current = current->next) {
+            if (current->occupied) {
+                length++;
+            }
+        }
+
+        if (histogram.size() <= length) {
+            histogram.resize(length + 1, 0);
+        }
+        histogram[length]++;
+    }
+
+    // Nanoseconds from some fixed point, but only when the statistics want to know
+    static unsigned long long statisticsClock(void) {
+        if (!Statistics::ENABLED) {
+            return 0;
+        }
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static void freeTable(Bucket<K, V>* theTable) {
+        free(theTable);
+    }
 
+    // Copy every entry of from (including any it has not moved out of its old table yet)
     void commonCopy(HashTable& to, const HashTable& from) {
 
-        // For each bucket in the hash table
-        for (unsigned int i = 0; i < from.hashTableSize; i++) {
+        to.sizing = from.sizing;
+        to.entryCount = from.entryCount;
 
-            Bucket<K, V>* fromCurrent = &from.table[i];
+        for (unsigned int i = 0; i < from.sizing.size(); i++) {
+            copyList(to, &from.table[i]);
+        }
+
+        if (from.oldTable != nullptr) {
+            for (unsigned int i = from.migrateIndex; i < from.oldSizing.size(); i++) {
+                copyList(to, &from.oldTable[i]);
+            }
+        }
+    }
 
-            // For each element in the linked list (at a given bucket)
-            while (fromCurrent != nullptr) {
+    void copyList(HashTable& to, const Bucket<K, V>* fromCurrent) {
 
-                // If there is data to copy from
-                if (fromCurrent->key != nullptr) {
+        // For each element in the linked list (at a given bucket)
+        while (fromCurrent != nullptr) {
 
-                    if (to.table[i].key == nullptr) {
-                        // If the current bucket is empty simply copy the data
-                        to.table[i].key = new K(*fromCurrent->key);
-                        to.table[i].value = new V(*fromCurrent->value);
-                    } else {
-                        // Otherwise go to the end of the list, allocate and append another bucket
-                        // then fill the bucket.
-                        Bucket<K, V>* toCurrent = nullptr;
-                        for (toCurrent = &to.table[i]; toCurrent->next != nullptr; toCurrent = toCurrent->next) {
-                            // Do nothing, simply advancing to the end of the list.
-                        }
+            // If there is data to copy from
+            if (fromCurrent->occupied) {
 
-                        toCurrent->next = new Bucket<K, V>(*fromCurrent->key, *fromCurrent->value);
-                    }
+                size_t hash = hashOf(*fromCurrent);
+                Bucket<K, V>* first = &to.table[to.sizing.index(hash)];
+
+                if (!first->occupied) {
+                    // If the current bucket is empty simply copy the data
+                    first->fill(hash, fromCurrent->key(), fromCurrent->value());
+                } else {
+                    // Otherwise allocate another bucket and link it in behind the first bucket
+                    Bucket<K, V>* additionalBucket = to.createBucket(to.allocator);
+                    additionalBucket->fill(hash, fromCurrent->key(), fromCurrent->value());
+                    additionalBucket->next = first->next;
+                    first->next = additionalBucket;
                 }
-                fromCurrent = fromCurrent->next;
             }
+            fromCurrent = fromCurrent->next;
         }
-
-        to.hashTableSizesIndex = from.hashTableSizesIndex;
-        to.hashTableSize = from.hashTableSize;
-        to.size = from.size;
     }
 
-    void commonDelete(void) {
+    void deleteTable(Bucket<K, V>* theTable, unsigned int theSize) {
 
-        // If the object has been moved (via move constructor or move assignment
-        // operator) then there's no need to delete the memory here.
-        if (table == nullptr) {
+        // If nothing in the table needs its destructor run, and the allocator is about to free
+        // everything at once anyway, there's no need to visit every bucket
+        if (RELEASE_IN_BULK) {
+            freeTable(theTable);
             return;
         }
 
-        for (unsigned int i = 0; i < hashTableSize; i++) {
+        for (unsigned int i = 0; i < theSize; i++) {
 
             Bucket<K, V>* temp = nullptr;
-            Bucket<K, V>* current = &table[i];
+            Bucket<K, V>* current = &theTable[i];
 
             while (current != nullptr) {
 
                 temp = current->next;
 
-                if (current->key != nullptr) {
-
-                    // Delete the data inside the bucket
-                    delete current->key;
-                    delete current->value;
-
-                    // Then delete the bucket itself, unless it's the first bucket which must be
-                    // deleted using delete[]
-                    if (current != &table[i])
-                        delete current;
+                // Delete the data inside the bucket
+                if (current->occupied) {
+                    current->empty();
                 }
 
+                // Then delete the bucket itself, unless it's the first bucket which is part
+                // of the table
+                if (current != &theTable[i])
+                    allocator.destroy(current);
+
                 current = temp;
             }
         }
 
-        delete[] table;
+        freeTable(theTable);
     }
 
-    /**
-     * Use the default hashing function, or the user-defined version.
-     */
-    unsigned int selectBucket(const K& k) {
-        return HashGenerator::chooseBucket(k) % hashTableSize;
+    void commonDelete(void) {
+
+        // If the object has been moved (via move constructor or move assignment
+        // operator) then there's no need to delete the memory here.
+        if (table == nullptr) {
+            return;
+        }
+
+        deleteTable(table, sizing.size());
+
+        if (oldTable != nullptr) {
+            deleteTable(oldTable, oldSizing.size());
+        }
+
+        allocator.releaseAll();
     }
 
+    // Move to the next larger size
     void rehash(void) {
+        SizePolicy larger = sizing;
+        larger.grow();
+        rehashTo(larger);
+    }
 
-        unsigned int newSize = 0;
+    /**
+     * Allocate a table of newSizing and start moving entries into it. Depending
+     * on the RehashPolicy the old table is either emptied right here, or a few
+     * buckets at a time by the operations that follow.
+     */
+    void rehashTo(const SizePolicy& newSizing) {
 
-        // Calculate new larger hash table size
-        if (hashTableSizesIndex + 1 < NUMBER_OF_SIZES) {
-            // If there is an existing prime number in our list left use that
-            hashTableSizesIndex++;
-            newSize = hashTableSizes[hashTableSizesIndex];
-        } else {
-            // Otherwise we are out of prime numbers, simply begin doubling hash table size
-            newSize = 2 * hashTableSize;
-        }
+        // A rehash still in progress has to finish before the next one can start
+        migrate(oldSizing.size());
 
-        // Allocate the larger hash table
-        Bucket<K, V>* newTable = new Bucket<K, V> [newSize];
+        stats().rehashed();
+        unsigned long long started = statisticsClock();
 
-        // Iterate over all of the items in the current hash table and copy them to the new larger
-        // hash table, using the new hash index
-        for (unsigned int i = 0; i < hashTableSize; i++) {
+        oldSizing = sizing;
+        oldTable = table;
+        migrateIndex = 0;
+        sizing = newSizing;
 
-            Bucket<K, V>* fromCurrent = &table[i];
-            Bucket<K, V>* fromPrev = &table[i];
-            Bucket<K, V>* temp = nullptr;
+        // Allocate the larger hash table
+        table = allocateTable(sizing.size());
 
-            // Iterate over all of the items in one linked list
-            while (fromCurrent != nullptr) {
+        stats().rehashWorked(statisticsClock() - started);
 
-                // Get the new index into the hash table
-                unsigned int newIndex = HashGenerator::chooseBucket(*fromCurrent->key) % newSize;
+        if (RehashPolicy::BUCKETS_PER_STEP == 0) {
+            migrate(oldSizing.size());
+        }
+    }
 
-                if (newTable[newIndex].key == nullptr) {
+    // Move up to count buckets of the old table into the current table
+    void migrate(unsigned int count) {
 
-                    if (fromPrev == fromCurrent) {
-                        // Case 1: Copying from the first bucket, to the first bucket
-                        newTable[newIndex].key = fromCurrent->key;
-                        newTable[newIndex].value = fromCurrent->value;
-                    } else {
-                        // Case 2: Copying from 2nd+ item in list, to the first bucket
+        if (oldTable == nullptr) {
+            return;
+        }
 
-                        // Save pointer to bucket
-                        temp = fromCurrent;
+        unsigned long long started = statisticsClock();
 
-                        // Copy data
-                        newTable[newIndex].key = fromCurrent->key;
-                        newTable[newIndex].value = fromCurrent->value;
+        for (; count > 0 && migrateIndex < oldSizing.size(); count--, migrateIndex++) {
+            migrateBucket(migrateIndex);
+        }
 
-                        // Remove bucket from the "from" list
-                        fromPrev->next = fromCurrent->next;
+        // Now that we have moved all of our data over to the new hash table, cleanup the old
+        // table. Every bucket in it is empty now.
+        if (migrateIndex == oldSizing.size()) {
+            freeTable(oldTable);
+            oldTable = nullptr;
+        }
 
-                        // Delete the unneeded bucket
-                        delete temp;
-                    }
-                } else {
+        stats().rehashWorked(statisticsClock() - started);
+    }
 
-                    // Traverse to the end of the new list
-                    Bucket<K, V>* toCurrent = &newTable[newIndex];
-                    while (toCurrent->next != nullptr) {
-                        toCurrent = toCurrent->next;
-                    }
+    /**
+     * Move every item in one list of the old table to the current table, using the
+     * new hash index. Buckets from the 2nd+ item of the old list are relinked as
+     * they are into the 2nd+ position of the new lists, so their entries stay
+     * where they are. Only entries that land in (or come from) a bucket of the
+     * table itself are moved, never copied.
+     */
+    void migrateBucket(unsigned int i) {
 
-                    if (fromPrev == fromCurrent) {
-                        // Case 3: Copying from the first bucket, to the 2nd+ item in the list
-                        toCurrent->key = fromCurrent->key;
-                        toCurrent->value = fromCurrent->value;
-                    } else {
-                        // Case 4: Copying from the 2nd+ item in the list, to the 2nd+ item in the list
+        Bucket<K, V>* fromCurrent = &oldTable[i];
 
-                        // Save a pointer to the bucket
-                        temp = fromCurrent;
+        // Iterate over all of the items in one linked list
+        while (fromCurrent != nullptr) {
 
-                        // Allocate and append a new bucket
-                        toCurrent->next = new Bucket<K, V>();
+            Bucket<K, V>* fromNext = fromCurrent->next;
+            Bucket<K, V>* spare = (fromCurrent != &oldTable[i]) ? fromCurrent : nullptr;
 
-                        // Copy the data over
-                        toCurrent->key = fromCurrent->key;
-                        toCurrent->value = fromCurrent->value;
+            if (fromCurrent->occupied) {
 
-                        // Remove bucket from the "from" list
-                        fromPrev->next = fromCurrent->next;
+                // Get the new index into the hash table
+                unsigned int newIndex = sizing.index(hashOf(*fromCurrent));
+                Bucket<K, V>* to = &table[newIndex];
 
-                        // Delete the unneeded bucket
-                        delete temp;
+                if (!to->occupied) {
+                    // Case 1: The first bucket of the new list is empty, fill it
+                    to->moveFrom(*fromCurrent);
+                } else {
+                    // Case 2: Link a bucket in right behind the first bucket of the new list
+                    if (spare == nullptr) {
+                        spare = createBucket(allocator);
+                        spare->moveFrom(*fromCurrent);
                     }
+                    spare->next = to->next;
+                    to->next = spare;
+                    spare = nullptr;
                 }
+            }
 
-                // Update the current and next pointers for the next loop iteration
-                fromPrev = fromCurrent;
-                fromCurrent = fromCurrent->next;
+            // Delete any bucket from the old list that was not reused
+            if (spare != nullptr) {
+                allocator.destroy(spare);
             }
+
+            fromCurrent = fromNext;
         }
 
-        // Now that we have copied all of our data over to the new hash table,
-        // cleanup the old table, and set the new size.
-        hashTableSize = newSize;
-        Bucket<K, V>* temp = table;
-        table = newTable;
-        delete temp;
+        oldTable[i].occupied = false;
+        oldTable[i].next = nullptr;
+    }
+
+    // How many keys getBatch and findMany have in flight at once. Enough to cover the memory
+    // latency, without running out of the cache lines the processor can be waiting on at once.
+    static const size_t BATCH_SIZE = 16;
 
+    /**
+     * The statistics are a private base class rather than a member, so that
+     * NoHashStatistics, which is empty, takes no space at all. Lookups are
+     * counted too, so findBucket, like get and contains, isn't const.
+     */
+    Statistics& stats(void) {
+        return *this;
     }
 
+    const Statistics& stats(void) const {
+        return *this;
+    }
+
+    static const bool RELEASE_IN_BULK = Allocator::RELEASES_IN_BULK && std::is_trivially_destructible<K>::value
+                    && std::is_trivially_destructible<V>::value;
+
+    // Ordered so that the 4 byte members share 8 byte words, and an empty Allocator fits in the padding at the end
     const float rehashThreshold;
-    unsigned int hashTableSizesIndex;
-    unsigned int hashTableSize;
-    unsigned int size;
+    unsigned int entryCount;
+    SizePolicy sizing;
     Bucket<K, V>* table;
-    const int hashTableSizes[NUMBER_OF_SIZES];
+    SizePolicy oldSizing;           // Size of the table being moved out of during a rehash
+    Bucket<K, V>* oldTable;         // nullptr unless a rehash is in progress
+    unsigned int migrateIndex;      // Buckets of oldTable below this have been moved already
+    Allocator allocator;
 };
 
 } /* namespace homebrew */
@@ -0,0 +1,356 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef HASHTABLESNAPSHOT_H
+#define HASHTABLESNAPSHOT_H
+
+#include "HashGenerator.h"
+#include "HashSizePolicy.h"
+#include "HashTable.h"
+
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mjl {
+namespace homebrew {
+
+/**
+ * A snapshot is a HashTable written out as one flat image that can be
+ * mmap'd and searched in place. It holds no pointers, only offsets from the
+ * start of the file, so it doesn't matter where it gets mapped:
+ *
+ *     HashTableSnapshotHeader   padded to SNAPSHOT_ALIGNMENT bytes
+ *     uint64_t offsets[bucketCount + 1]
+ *     SnapshotEntry<K, V> entries[entryCount]
+ *
+ * The entries of bucket b are entries[offsets[b]] up to entries[offsets[b + 1]],
+ * and a key's bucket is snapshotBucket(hash of key, bucketCount). There is one
+ * bucket per entry, so a lookup is one read from offsets and, usually, one
+ * read of a single entry.
+ *
+ * Keys and values are copied byte for byte, so both have to be trivially
+ * copyable, and a snapshot can only be read by a program with the same
+ * types, hash generator and byte order. The header records enough to detect
+ * the mistakes that can be detected, and a checksum of everything after it.
+ */
+
+#define SNAPSHOT_MAGIC "MJLHASH"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_ALIGNMENT 64
+
+struct HashTableSnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t keySize;
+    uint32_t valueSize;
+    uint32_t entrySize;
+    uint64_t entryCount;
+    uint64_t bucketCount;
+    uint64_t offsetsOffset;         // Where offsets starts, in bytes from the start of the file
+    uint64_t entriesOffset;         // Where entries starts
+    uint64_t fileSize;
+    uint64_t hashCheck;             // Hash of the first key, catches a change of hash function
+    uint64_t checksum;              // hashBytes of offsets, then of entries
+};
+
+template<typename K, typename V> struct SnapshotEntry {
+    K key;
+    V value;
+};
+
+// Fastrange over the hash, mixed first in case the hash generator leaves the upper bits weak
+inline uint64_t snapshotBucket(size_t hash, uint64_t bucketCount) {
+    return multiplyHigh((uint64_t) hash * 0x9e3779b97f4a7c15ull, bucketCount);
+}
+
+inline uint64_t snapshotAlign(uint64_t offset) {
+    return (offset + SNAPSHOT_ALIGNMENT - 1) & ~(uint64_t) (SNAPSHOT_ALIGNMENT - 1);
+}
+
+/**
+ * Write every entry of table to a snapshot file at path, replacing the file if
+ * it exists. The snapshot is written to path.tmp and renamed to path once it
+ * is on disk, so a MappedHashTable that has the old file open keeps reading
+ * the old snapshot, and a crash leaves either the old or the new one. Throws
+ * std::runtime_error if the file can't be written.
+ */
+template<typename K, typename V, typename HashGenerator, typename SizePolicy, typename RehashPolicy,
+                typename Allocator, typename Statistics> void writeSnapshot(
+                const HashTable<K, V, HashGenerator, SizePolicy, RehashPolicy, Allocator, Statistics>& table,
+                const char* path) {
+
+    static_assert(std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value,
+                    "Snapshots copy keys and values byte for byte");
+    static_assert(alignof(SnapshotEntry<K, V>) <= SNAPSHOT_ALIGNMENT, "Entries would be misaligned");
+
+    uint64_t entryCount = std::distance(table.begin(), table.end());
+    uint64_t bucketCount = (entryCount > 0) ? entryCount : 1;
+
+    // Count the entries of each bucket, and turn the counts into where each bucket starts
+    std::vector<uint64_t> offsets(bucketCount + 1, 0);
+    for (auto entry : table) {
+        offsets[snapshotBucket(HashOf<HashGenerator, K>::hash(entry.first), bucketCount) + 1]++;
+    }
+    for (uint64_t b = 0; b < bucketCount; b++) {
+        offsets[b + 1] += offsets[b];
+    }
+
+    // Value initialized, so the padding inside entries is zero and the checksum repeatable
+    std::vector<SnapshotEntry<K, V>> entries(entryCount);
+    std::vector<uint64_t> next(offsets.begin(), offsets.end() - 1);
+    for (auto entry : table) {
+        SnapshotEntry<K, V>& to = entries[next[snapshotBucket(HashOf<HashGenerator, K>::hash(entry.first),
+                                                              bucketCount)]++];
+        to.key = entry.first;
+        to.value = entry.second;
+    }
+
+    HashTableSnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.keySize = sizeof(K);
+    header.valueSize = sizeof(V);
+    header.entrySize = sizeof(SnapshotEntry<K, V>);
+    header.entryCount = entryCount;
+    header.bucketCount = bucketCount;
+    header.offsetsOffset = snapshotAlign(sizeof(header));
+    header.entriesOffset = snapshotAlign(header.offsetsOffset + offsets.size() * sizeof(uint64_t));
+    header.fileSize = header.entriesOffset + entries.size() * sizeof(SnapshotEntry<K, V>);
+    header.hashCheck = (entryCount > 0) ? HashOf<HashGenerator, K>::hash(entries[0].key) : 0;
+    header.checksum = hashBytes(entries.data(), entries.size() * sizeof(SnapshotEntry<K, V>),
+                                hashBytes(offsets.data(), offsets.size() * sizeof(uint64_t)));
+
+    // Write beside the old snapshot and rename over it, so that it is never seen half written
+    std::string temporaryPath = std::string(path) + ".tmp";
+    FILE* file = fopen(temporaryPath.c_str(), "wb");
+    if (file == nullptr) {
+        throw std::runtime_error(std::string("Could not create snapshot ") + temporaryPath);
+    }
+
+    static const char padding[SNAPSHOT_ALIGNMENT] = { 0 };
+    size_t headerPadding = header.offsetsOffset - sizeof(header);
+    size_t offsetsPadding = header.entriesOffset - header.offsetsOffset - offsets.size() * sizeof(uint64_t);
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1
+                    && fwrite(padding, 1, headerPadding, file) == headerPadding
+                    && fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), file) == offsets.size()
+                    && fwrite(padding, 1, offsetsPadding, file) == offsetsPadding
+                    && (entries.empty()
+                                    || fwrite(entries.data(), sizeof(SnapshotEntry<K, V>), entries.size(), file)
+                                                    == entries.size());
+    written = written && fflush(file) == 0 && fsync(fileno(file)) == 0;
+
+    if (fclose(file) != 0 || !written || rename(temporaryPath.c_str(), path) != 0) {
+        remove(temporaryPath.c_str());
+        throw std::runtime_error(std::string("Could not write snapshot ") + path);
+    }
+}
+
+/**
+ * A read-only view of a snapshot file. The file is mmap'd and searched where
+ * it lies, nothing is copied or rebuilt, so opening even a large snapshot
+ * only costs the page faults of the lookups that follow. Verifying the
+ * checksum reads the whole file once; it can be skipped for files that are
+ * trusted.
+ *
+ * The constructor throws std::runtime_error if the file can't be mapped or is
+ * not a snapshot of this K, V and HashGenerator. get throws std::out_of_range
+ * for keys that are not there, like HashTable.
+ */
+template<typename K, typename V, typename HashGenerator = DefaultHashGenerator<K>> class MappedHashTable {
+ public:
+
+    explicit MappedHashTable(const char* path, bool verifyChecksum = true)
+                    : mapping(nullptr),
+                      mappingSize(0),
+                      header(nullptr),
+                      offsets(nullptr),
+                      entries(nullptr) {
+
+        static_assert(std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value,
+                        "Snapshots copy keys and values byte for byte");
+
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error(std::string("Could not open snapshot ") + path);
+        }
+
+        struct stat status;
+        if (fstat(fd, &status) != 0 || (size_t) status.st_size < sizeof(HashTableSnapshotHeader)) {
+            close(fd);
+            throw std::runtime_error(std::string("Snapshot is too short: ") + path);
+        }
+
+        mappingSize = (size_t) status.st_size;
+        mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            mapping = nullptr;
+            throw std::runtime_error(std::string("Could not map snapshot ") + path);
+        }
+
+        const unsigned char* base = static_cast<const unsigned char*>(mapping);
+        header = reinterpret_cast<const HashTableSnapshotHeader*>(base);
+        offsets = reinterpret_cast<const uint64_t*>(base + header->offsetsOffset);
+        entries = reinterpret_cast<const SnapshotEntry<K, V>*>(base + header->entriesOffset);
+
+        const char* problem = check(verifyChecksum);
+        if (problem != nullptr) {
+            unmap();
+            throw std::runtime_error(std::string(problem) + ": " + path);
+        }
+    }
+
+    MappedHashTable(const MappedHashTable& from) = delete;
+    MappedHashTable& operator=(const MappedHashTable& from) = delete;
+
+    MappedHashTable(MappedHashTable&& from) noexcept
+                    : mapping(from.mapping),
+                      mappingSize(from.mappingSize),
+                      header(from.header),
+                      offsets(from.offsets),
+                      entries(from.entries) {
+        from.mapping = nullptr;
+    }
+
+    MappedHashTable& operator=(MappedHashTable&& from) noexcept {
+        if (this != &from) {
+            unmap();
+            mapping = from.mapping;
+            mappingSize = from.mappingSize;
+            header = from.header;
+            offsets = from.offsets;
+            entries = from.entries;
+            from.mapping = nullptr;
+        }
+        return *this;
+    }
+
+    ~MappedHashTable() {
+        unmap();
+    }
+
+    const V& get(const K& key) const {
+
+        const SnapshotEntry<K, V>* found = find(key);
+
+        if (found == nullptr) {
+            throw std::out_of_range("Tried to get entry that does not exist.");
+        }
+
+        return found->value;
+    }
+
+    bool contains(const K& key) const {
+        return find(key) != nullptr;
+    }
+
+    size_t size(void) const {
+        return (size_t) header->entryCount;
+    }
+
+ private:
+
+    const SnapshotEntry<K, V>* find(const K& key) const {
+
+        uint64_t b = snapshotBucket(HashOf<HashGenerator, K>::hash(key), header->bucketCount);
+
+        for (uint64_t i = offsets[b]; i < offsets[b + 1]; i++) {
+            if (entries[i].key == key) {
+                return &entries[i];
+            }
+        }
+
+        return nullptr;
+    }
+
+    // What is wrong with the mapped file, or nullptr if it can be used
+    const char* check(bool verifyChecksum) const {
+
+        if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0
+                        || header->version != SNAPSHOT_VERSION) {
+            return "Not a snapshot, or a snapshot of another version";
+        }
+        if (header->keySize != sizeof(K) || header->valueSize != sizeof(V)
+                        || header->entrySize != sizeof(SnapshotEntry<K, V>)) {
+            return "Snapshot was written for different key or value types";
+        }
+
+        // The sections have to be where they would have been written, which also keeps them in the file
+        uint64_t offsetsBytes = (header->bucketCount + 1) * sizeof(uint64_t);
+        if (header->bucketCount == 0 || header->bucketCount > mappingSize / sizeof(uint64_t)
+                        || header->entryCount > mappingSize / sizeof(SnapshotEntry<K, V>)
+                        || header->offsetsOffset != snapshotAlign(sizeof(HashTableSnapshotHeader))
+                        || header->entriesOffset != snapshotAlign(header->offsetsOffset + offsetsBytes)
+                        || header->fileSize != header->entriesOffset + header->entryCount * sizeof(SnapshotEntry<K, V>)
+                        || header->fileSize != mappingSize) {
+            return "Snapshot is truncated or corrupt";
+        }
+
+        if (header->entryCount > 0 && HashOf<HashGenerator, K>::hash(entries[0].key) != header->hashCheck) {
+            return "Snapshot was written with a different hash function";
+        }
+
+        if (verifyChecksum) {
+            uint64_t checksum = hashBytes(entries, header->entryCount * sizeof(SnapshotEntry<K, V>),
+                                          hashBytes(offsets, offsetsBytes));
+            if (checksum != header->checksum) {
+                return "Snapshot checksum does not match";
+            }
+        }
+
+        // Without the checksum, at least check where the last bucket ends
+        if (!verifyChecksum && offsets[header->bucketCount] != header->entryCount) {
+            return "Snapshot is truncated or corrupt";
+        }
+
+        return nullptr;
+    }
+
+    void unmap(void) {
+        if (mapping != nullptr) {
+            munmap(mapping, mappingSize);
+            mapping = nullptr;
+        }
+    }
+
+    void* mapping;
+    size_t mappingSize;
+    const HashTableSnapshotHeader* header;
+    const uint64_t* offsets;
+    const SnapshotEntry<K, V>* entries;
+};
+
+} /* namespace homebrew */
+} /* namespace mjl */
+
+#endif /* HASHTABLESNAPSHOT_H */
@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "HashTable.h"
+#include "HashTableSnapshot.h"
+#include "HashTableSnapshot_test.h"
+
+#include <iostream>
+#include <stdexcept>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace std;
+using namespace mjl::homebrew;
+
+static const char* SNAPSHOT_PATH = "/tmp/HashTableSnapshot_test.snapshot";
+
+// A plain old data value, like the ones kept in snapshots
+struct Position {
+    double x;
+    double y;
+    uint32_t flags;
+};
+
+// Every key of the table must be in the view with the same value, and nothing else
+static bool matchesTable(HashTable<uint64_t, Position>& table, MappedHashTable<uint64_t, Position>& view,
+                         uint64_t keyRange) {
+
+    for (uint64_t key = 0; key < keyRange; key++) {
+
+        bool expected = table.contains(key);
+
+        if (view.contains(key) != expected) {
+            cerr << "Key " << key << " should " << (expected ? "" : "not ") << "be in the snapshot.\n";
+            return false;
+        }
+        if (expected && (view.get(key).x != table.get(key).x || view.get(key).flags != table.get(key).flags)) {
+            cerr << "Key " << key << " has the wrong value in the snapshot.\n";
+            return false;
+        }
+    }
+
+    try {
+        view.get(keyRange + 1);
+        cerr << "Getting a missing key from a snapshot did not throw.\n";
+        return false;
+    } catch (std::out_of_range&) {
+    }
+
+    return true;
+}
+
+// Opening path must throw, because the file is not a usable snapshot
+static bool openFails(const char* path, bool verifyChecksum) {
+    try {
+        MappedHashTable<uint64_t, Position> view(path, verifyChecksum);
+    } catch (std::runtime_error& error) {
+        cout << "Rejected as expected: " << error.what() << "\n";
+        return true;
+    }
+    cerr << "Opened a broken snapshot without complaint.\n";
+    return false;
+}
+
+bool runHashTableSnapshotTests(void) {
+    const uint64_t TEST_SIZE = 20000;
+
+    HashTable<uint64_t, Position> table;
+    for (uint64_t i = 0; i < TEST_SIZE; i++) {
+        // Spread the keys out, and leave some gaps
+        if (i % 7 != 3) {
+            Position position = { i * 0.5, i * 0.25, (uint32_t) i };
+            table.insert(i * 3, position);
+        }
+    }
+
+    cout << "Writing and mapping a snapshot of " << TEST_SIZE << " entries.\n";
+    writeSnapshot(table, SNAPSHOT_PATH);
+    {
+        MappedHashTable<uint64_t, Position> view(SNAPSHOT_PATH);
+        if (view.size() != TEST_SIZE - TEST_SIZE / 7 - (TEST_SIZE % 7 > 3)) {
+            cerr << "Snapshot has " << view.size() << " entries.\n";
+            return false;
+        }
+        if (!matchesTable(table, view, 3 * TEST_SIZE)) {
+            return false;
+        }
+
+        // The view can be moved without remapping
+        MappedHashTable<uint64_t, Position> moved(std::move(view));
+        if (!matchesTable(table, moved, 3 * TEST_SIZE)) {
+            return false;
+        }
+
+        // Writing a new snapshot replaces the file, and the view keeps the old one
+        cout << "Replacing a snapshot that is mapped.\n";
+        HashTable<uint64_t, Position> other;
+        writeSnapshot(other, SNAPSHOT_PATH);
+        if (!matchesTable(table, moved, 3 * TEST_SIZE)) {
+            return false;
+        }
+    }
+
+    cout << "Snapshot of an empty table.\n";
+    HashTable<uint64_t, Position> empty;
+    writeSnapshot(empty, SNAPSHOT_PATH);
+    {
+        MappedHashTable<uint64_t, Position> view(SNAPSHOT_PATH);
+        if (view.size() != 0 || !matchesTable(empty, view, 100)) {
+            return false;
+        }
+    }
+
+    cout << "Detecting broken snapshots.\n";
+    writeSnapshot(table, SNAPSHOT_PATH);
+
+    // Flip a byte in the middle of the entries
+    FILE* file = fopen(SNAPSHOT_PATH, "r+b");
+    fseek(file, -100, SEEK_END);
+    int byte = fgetc(file);
+    fseek(file, -100, SEEK_END);
+    fputc(byte ^ 0x40, file);
+    fclose(file);
+    if (!openFails(SNAPSHOT_PATH, true)) {
+        return false;
+    }
+
+    // Cut the file short
+    if (truncate(SNAPSHOT_PATH, 1000) != 0 || !openFails(SNAPSHOT_PATH, false)) {
+        return false;
+    }
+
+    // Something that is not a snapshot at all
+    if (!openFails("/dev/null", false) || !openFails("/nonexistent/snapshot", false)) {
+        return false;
+    }
+
+    // The right file, read with the wrong types
+    writeSnapshot(table, SNAPSHOT_PATH);
+    try {
+        MappedHashTable<uint64_t, uint64_t> wrongTypes(SNAPSHOT_PATH);
+        cerr << "Opened a snapshot with the wrong value type.\n";
+        return false;
+    } catch (std::runtime_error& error) {
+        cout << "Rejected as expected: " << error.what() << "\n";
+    }
+
+    remove(SNAPSHOT_PATH);
+
+    return true;
+}
@@ -0,0 +1,772 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "Benchmark.h"
+#include "ConcurrentHashTable.h"
+#include "CuckooHashTable.h"
+#include "HashSet.h"
+#include "HashTable.h"
+#include "HashTable_benchmark.h"
+#include "HashTableSnapshot.h"
+#include "OpenAddressingHashTable.h"
+#include "PackedHashTable.h"
+#include "PoolAllocator.h"
+#include "RcuHashTable.h"
+#include "RobinHoodHashTable.h"
+#include "SwissHashTable.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <malloc.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace mjl::homebrew;
+
+static const int BENCHMARK_SIZE = 1000000;
+
+// Keys that are in the table, and keys that are guaranteed not to be (odd vs. even)
+static vector<int> makeKeys(int count, int parity) {
+    vector<int> keys;
+    srand(1234);
+    for (int i = 0; i < count; i++) {
+        keys.push_back((rand() & ~1) | parity);
+    }
+    return keys;
+}
+
+static double nanosecondsPerOperation(chrono::steady_clock::time_point start, int operations) {
+    chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count() / operations;
+}
+
+// Gives std::unordered_map the get/insert/contains interface so it can be benchmarked the same way
+template<typename K, typename V> class UnorderedMapAdapter {
+ public:
+    V& get(const K& key) {
+        return map.at(key);
+    }
+
+    bool contains(const K& key) {
+        return map.find(key) != map.end();
+    }
+
+    void insert(const K& key, const V& value) {
+        map[key] = value;
+    }
+
+ private:
+    unordered_map<K, V> map;
+};
+
+/**
+ * Insert, hit and miss cost for any table with the get/insert/remove interface.
+ * Switching the table being measured only requires changing the template
+ * parameter. Small tables are looked up repeatedly so that every measurement
+ * covers the same number of lookups.
+ */
+template<typename Table> static void benchmarkTable(const char* name, int count = BENCHMARK_SIZE) {
+    vector<int> hitKeys = makeKeys(count, 0);
+    vector<int> missKeys = makeKeys(count, 1);
+    int rounds = BENCHMARK_SIZE / count;
+    Table table;
+    long long checksum = 0;
+
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < count; i++) {
+        table.insert(hitKeys[i], i);
+    }
+    double insertCost = nanosecondsPerOperation(start, count);
+
+    start = chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        for (int i = 0; i < count; i++) {
+            checksum += table.get(hitKeys[i]);
+        }
+    }
+    double hitCost = nanosecondsPerOperation(start, rounds * count);
+
+    start = chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        for (int i = 0; i < count; i++) {
+            checksum += table.contains(missKeys[i]);
+        }
+    }
+    double missCost = nanosecondsPerOperation(start, rounds * count);
+
+    cout << name << ": insert " << insertCost << " ns, hit " << hitCost << " ns, miss " << missCost
+                    << " ns (checksum " << checksum << ")\n";
+}
+
+/**
+ * std::string keys with 1 KB std::string values, inserted by copy, by move
+ * and with emplace, then overwritten by move. Reports the time and the number
+ * of allocations per entry.
+ */
+template<typename Table> static void benchmarkStringEntries(const char* name, int count) {
+    vector<string> keys;
+    vector<string> values;
+    keys.reserve(count);
+    values.reserve(count);
+    for (int i = 0; i < count; i++) {
+        keys.push_back("key number " + to_string(i * 7919));
+        values.push_back(string(1024, (char) ('a' + i % 26)));
+    }
+
+    Table copied;
+    unsigned long long allocationsBefore = allocationCount.load();
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < count; i++) {
+        copied.insert(keys[i], values[i]);
+    }
+    double copyCost = nanosecondsPerOperation(start, count);
+    double copyAllocations = (double) (allocationCount.load() - allocationsBefore) / count;
+
+    Table emplaced;
+    allocationsBefore = allocationCount.load();
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < count; i++) {
+        emplaced.emplace(keys[i], 1024, (char) ('a' + i % 26));
+    }
+    double emplaceCost = nanosecondsPerOperation(start, count);
+    double emplaceAllocations = (double) (allocationCount.load() - allocationsBefore) / count;
+
+    vector<string> movedKeys(keys);
+    vector<string> movedValues(values);
+    Table moved;
+    allocationsBefore = allocationCount.load();
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < count; i++) {
+        moved.insert(std::move(movedKeys[i]), std::move(movedValues[i]));
+    }
+    double moveCost = nanosecondsPerOperation(start, count);
+    double moveAllocations = (double) (allocationCount.load() - allocationsBefore) / count;
+
+    allocationsBefore = allocationCount.load();
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < count; i++) {
+        moved.insert(keys[i], std::move(values[i]));
+    }
+    double replaceCost = nanosecondsPerOperation(start, count);
+    double replaceAllocations = (double) (allocationCount.load() - allocationsBefore) / count;
+
+    cout << "  " << name << ": copy " << copyCost << " ns / " << copyAllocations << " allocs, emplace " << emplaceCost
+                    << " ns / " << emplaceAllocations << " allocs, move " << moveCost << " ns / " << moveAllocations
+                    << " allocs, replace by move " << replaceCost << " ns / " << replaceAllocations << " allocs\n";
+}
+
+/**
+ * Look up random keys in a table far larger than the last level cache, one
+ * get() at a time and then with getBatch, for a few batch sizes.
+ */
+template<typename K> static void benchmarkBatchLookups(const char* name, const vector<K>& keys) {
+    int count = (int) keys.size();
+    HashTable<K, int> table;
+    for (int i = 0; i < count; i++) {
+        table.insert(keys[i], i);
+    }
+
+    // Look the keys up in a different order than they were inserted in
+    int lookups = 2 * 1000 * 1000;
+    vector<K> lookupKeys(lookups);
+    srand(42);
+    for (int i = 0; i < lookups; i++) {
+        lookupKeys[i] = keys[rand() % count];
+    }
+
+    long long checksum = 0;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < lookups; i++) {
+        checksum += table.get(lookupKeys[i]);
+    }
+    cout << "  " << name << ", get(): " << nanosecondsPerOperation(start, lookups) << " ns";
+
+    for (int batchSize : { 32, 256 }) {
+        vector<int*> values(batchSize);
+        start = chrono::steady_clock::now();
+        for (int i = 0; i + batchSize <= lookups; i += batchSize) {
+            table.getBatch(&lookupKeys[i], batchSize, values.data());
+            for (int j = 0; j < batchSize; j++) {
+                checksum += *values[j];
+            }
+        }
+        cout << ", getBatch(" << batchSize << "): " << nanosecondsPerOperation(start, lookups) << " ns";
+    }
+    cout << " (checksum " << checksum << ")\n";
+}
+
+/**
+ * The time to load a table from a snapshot of count entries: inserting one by
+ * one, after reserve, and with the range constructor.
+ */
+static void benchmarkColdStart(int count) {
+    vector<int> keys = makeKeys(count, 0);
+    vector<pair<int, int>> entries;
+    entries.reserve(count);
+    for (int i = 0; i < count; i++) {
+        entries.push_back(make_pair(keys[i], i));
+    }
+
+    {
+        auto start = chrono::steady_clock::now();
+        HashTable<int, int> table;
+        for (const pair<int, int>& entry : entries) {
+            table.insert(entry.first, entry.second);
+        }
+        cout << "  insert: " << nanosecondsPerOperation(start, count) * count / 1e6 << " ms\n";
+    }
+    {
+        auto start = chrono::steady_clock::now();
+        HashTable<int, int> table;
+        table.reserve(count);
+        for (const pair<int, int>& entry : entries) {
+            table.insert(entry.first, entry.second);
+        }
+        cout << "  reserve, then insert: " << nanosecondsPerOperation(start, count) * count / 1e6 << " ms\n";
+    }
+    {
+        auto start = chrono::steady_clock::now();
+        HashTable<int, int> table(entries.begin(), entries.end());
+        cout << "  range constructor: " << nanosecondsPerOperation(start, count) * count / 1e6 << " ms\n";
+    }
+    {
+        auto start = chrono::steady_clock::now();
+        unordered_map<int, int> table(entries.begin(), entries.end());
+        cout << "  std::unordered_map range constructor: " << nanosecondsPerOperation(start, count) * count / 1e6
+                        << " ms\n";
+    }
+}
+
+/**
+ * Restarting with a table of count entries: rebuilding it with insert, against
+ * mapping a snapshot of it. Both then serve the same random lookups. The
+ * snapshot file was just written, so it is in the page cache.
+ */
+static void benchmarkSnapshotRestart(int count) {
+    struct Record {
+        uint64_t id;
+        double score;
+        uint32_t flags;
+    };
+    const char* path = "/tmp/HashTable_benchmark.snapshot";
+    const int lookups = 1000 * 1000;
+
+    vector<int> keys = makeKeys(count, 0);
+    vector<pair<uint64_t, Record>> entries;
+    entries.reserve(count);
+    for (int i = 0; i < count; i++) {
+        Record record = { (uint64_t) i, i * 0.5, (uint32_t) i };
+        entries.push_back(make_pair((uint64_t) keys[i], record));
+    }
+
+    vector<uint64_t> lookupKeys(lookups);
+    srand(42);
+    for (int i = 0; i < lookups; i++) {
+        lookupKeys[i] = entries[rand() % count].first;
+    }
+
+    long long checksum = 0;
+    auto start = chrono::steady_clock::now();
+    {
+        HashTable<uint64_t, Record> table;
+        for (const pair<uint64_t, Record>& entry : entries) {
+            table.insert(entry.first, entry.second);
+        }
+        double buildTime = nanosecondsPerOperation(start, count) * count / 1e6;
+        for (int i = 0; i < lookups; i++) {
+            checksum += table.get(lookupKeys[i]).flags;
+        }
+        cout << "  insert loop: " << buildTime << " ms, with " << lookups << " lookups "
+                        << nanosecondsPerOperation(start, count) * count / 1e6 << " ms\n";
+
+        start = chrono::steady_clock::now();
+        writeSnapshot(table, path);
+        cout << "  writing the snapshot: " << nanosecondsPerOperation(start, count) * count / 1e6 << " ms\n";
+    }
+
+    for (bool verify : { true, false }) {
+        start = chrono::steady_clock::now();
+        MappedHashTable<uint64_t, Record> view(path, verify);
+        double openTime = nanosecondsPerOperation(start, count) * count / 1e6;
+        for (int i = 0; i < lookups; i++) {
+            checksum += view.get(lookupKeys[i]).flags;
+        }
+        cout << "  mapped snapshot" << (verify ? ", checksum verified" : "") << ": " << openTime << " ms, with "
+                        << lookups << " lookups " << nanosecondsPerOperation(start, count) * count / 1e6 << " ms\n";
+    }
+
+    cout << "  (checksum " << checksum << ")\n";
+    remove(path);
+}
+
+/**
+ * Looking up tokens of a text buffer in a HashTable<std::string, int>, by
+ * building a std::string for each one, and as a StringSlice of the buffer.
+ */
+static void benchmarkTransparentLookups(int count) {
+    string buffer;
+    vector<pair<size_t, size_t>> tokens;
+    HashTable<string, int> table;
+    for (int i = 0; i < count; i++) {
+        // Long enough not to fit in the std::string small string buffer
+        string key = "identifier_number_" + to_string(i * 7919);
+        table.insert(key, i);
+        tokens.push_back(make_pair(buffer.size(), key.size()));
+        buffer += key + " ";
+    }
+
+    int lookups = 10 * count;
+    long long checksum = 0;
+    unsigned long long allocationsBefore = allocationCount.load();
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < lookups; i++) {
+        const pair<size_t, size_t>& token = tokens[i % count];
+        checksum += table.get(string(buffer.data() + token.first, token.second));
+    }
+    double temporaryCost = nanosecondsPerOperation(start, lookups);
+    double temporaryAllocations = (double) (allocationCount.load() - allocationsBefore) / lookups;
+
+    allocationsBefore = allocationCount.load();
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < lookups; i++) {
+        const pair<size_t, size_t>& token = tokens[i % count];
+        checksum += table.get(StringSlice(buffer.data() + token.first, token.second));
+    }
+    double sliceCost = nanosecondsPerOperation(start, lookups);
+    double sliceAllocations = (double) (allocationCount.load() - allocationsBefore) / lookups;
+
+    cout << "  temporary std::string: " << temporaryCost << " ns / " << temporaryAllocations
+                    << " allocs, StringSlice: " << sliceCost << " ns / " << sliceAllocations << " allocs (checksum "
+                    << checksum << ")\n";
+}
+
+/**
+ * A Robin Hood table grown past a million slots and then filled to exactly
+ * the given load, with the insert, hit and miss cost there and the probe
+ * lengths that go with it.
+ */
+static void benchmarkRobinHoodLoad(float load) {
+    vector<int> hitKeys = makeKeys(4 * BENCHMARK_SIZE, 0);
+    vector<int> missKeys = makeKeys(BENCHMARK_SIZE, 1);
+    RobinHoodHashTable<int, int> table(0.95f);
+
+    // Keep going past a growth if the load is already too high after a million entries
+    int count = 0;
+    while (count < BENCHMARK_SIZE || table.loadFactor() < load || table.loadFactor() > load + 0.01f) {
+        table.insert(hitKeys[count], count);
+        count++;
+    }
+
+    // Time the inserts at this load by removing and putting back the most recent ones
+    int measured = BENCHMARK_SIZE / 10;
+    for (int i = count - measured; i < count; i++) {
+        table.remove(hitKeys[i]);
+    }
+    auto start = chrono::steady_clock::now();
+    for (int i = count - measured; i < count; i++) {
+        table.insert(hitKeys[i], i);
+    }
+    double insertCost = nanosecondsPerOperation(start, measured);
+
+    long long checksum = 0;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < BENCHMARK_SIZE; i++) {
+        checksum += table.get(hitKeys[i]);
+    }
+    double hitCost = nanosecondsPerOperation(start, BENCHMARK_SIZE);
+
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < BENCHMARK_SIZE; i++) {
+        checksum += table.contains(missKeys[i]);
+    }
+    double missCost = nanosecondsPerOperation(start, BENCHMARK_SIZE);
+
+    cout << "  load " << table.loadFactor() << ": insert " << insertCost << " ns, hit " << hitCost << " ns, miss "
+                    << missCost << " ns, mean probe " << table.meanProbeLength() << ", max probe "
+                    << table.maxProbeLength() << " (checksum " << checksum << ")\n";
+}
+
+// The reduction HashTable used before size policies existed: a real division on every lookup
+class PlainModuloSizePolicy : public PrimeSizePolicy {
+ public:
+    unsigned int index(size_t hash) const {
+        return (unsigned int) (hash % size());
+    }
+};
+
+// Per-lookup cost of each size policy, in a table that fits in cache and one that does not
+static void benchmarkSizePolicies(int count) {
+    cout << "Size policies, " << count << " int keys\n";
+    benchmarkTable<HashTable<int, int, DefaultHashGenerator<int>, PlainModuloSizePolicy>>("  prime, modulo",
+                                                                                           count);
+    benchmarkTable<HashTable<int, int, DefaultHashGenerator<int>, PrimeSizePolicy>>("  prime, magic divisor",
+                                                                                     count);
+    benchmarkTable<HashTable<int, int, DefaultHashGenerator<int>, PowerOfTwoSizePolicy>>("  power of two, mask",
+                                                                                          count);
+    benchmarkTable<HashTable<int, int, DefaultHashGenerator<int>, FastRangeSizePolicy>>("  fastrange", count);
+}
+
+// What counting costs. With NoHashStatistics the table should be no bigger and no slower than it ever was.
+static void benchmarkStatistics(void) {
+    typedef HashTable<int, int> Uncounted;
+    typedef HashTable<int, int, DefaultHashGenerator<int>, PrimeSizePolicy, StopTheWorldRehashPolicy,
+                    NewDeleteAllocator, CountingHashStatistics> Counted;
+
+    cout << "Statistics policy, " << BENCHMARK_SIZE << " int keys\n";
+    cout << "  table object: " << sizeof(Uncounted) << " bytes uncounted, " << sizeof(Counted) << " bytes counted\n";
+    benchmarkTable<Uncounted>("  NoHashStatistics");
+    benchmarkTable<Counted>("  CountingHashStatistics");
+}
+
+/**
+ * Time every single insert into a growing table and report the latency
+ * percentiles. With a stop-the-world rehash the inserts that trigger a rehash
+ * show up as the tail.
+ */
+template<typename Table> static void benchmarkInsertLatency(const char* name, int count) {
+    vector<int> keys = makeKeys(count, 0);
+    vector<double> latencies(count);
+    Table table;
+
+    for (int i = 0; i < count; i++) {
+        auto start = chrono::steady_clock::now();
+        table.insert(keys[i], i);
+        latencies[i] = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+    }
+
+    sort(latencies.begin(), latencies.end());
+    cout << name << ": p50 " << latencies[count / 2] << " ns, p99 " << latencies[count * 99LL / 100]
+                    << " ns, p999 " << latencies[count * 999LL / 1000] << " ns, max " << latencies[count - 1]
+                    << " ns\n";
+}
+
+/**
+ * Time every single lookup of count keys, hits and misses alternating, in a
+ * table of count entries and report the latency percentiles. The clock
+ * itself adds a few tens of nanoseconds to every lookup.
+ */
+template<typename Table> static void benchmarkLookupLatency(const char* name, int count) {
+    vector<int> hitKeys = makeKeys(count, 0);
+    vector<int> missKeys = makeKeys(count, 1);
+    vector<double> latencies(2 * count);
+    Table table;
+    long long checksum = 0;
+
+    for (int i = 0; i < count; i++) {
+        table.insert(hitKeys[i], i);
+    }
+
+    // Look the keys up in a different order than they were inserted in
+    random_shuffle(hitKeys.begin(), hitKeys.end());
+    for (int i = 0; i < count; i++) {
+        auto start = chrono::steady_clock::now();
+        checksum += table.contains(hitKeys[i]);
+        auto middle = chrono::steady_clock::now();
+        checksum += table.contains(missKeys[i]);
+        auto end = chrono::steady_clock::now();
+        latencies[2 * i] = chrono::duration<double, nano>(middle - start).count();
+        latencies[2 * i + 1] = chrono::duration<double, nano>(end - middle).count();
+    }
+
+    int lookups = 2 * count;
+    sort(latencies.begin(), latencies.end());
+    cout << name << ": p50 " << latencies[lookups / 2] << " ns, p99 " << latencies[lookups * 99LL / 100]
+                    << " ns, p999 " << latencies[lookups * 999LL / 1000] << " ns, p9999 "
+                    << latencies[lookups * 9999LL / 10000] << " ns, max " << latencies[lookups - 1]
+                    << " ns (checksum " << checksum << ")\n";
+}
+
+// How the tables are shared between threads today: one HashTable behind one mutex
+template<typename K, typename V> class GlobalMutexHashTable {
+ public:
+    V get(const K& key) {
+        lock_guard<mutex> lock(theMutex);
+        return table.get(key);
+    }
+
+    void insert(const K& key, const V& value) {
+        lock_guard<mutex> lock(theMutex);
+        table.insert(key, value);
+    }
+
+ private:
+    mutex theMutex;
+    HashTable<K, V> table;
+};
+
+/**
+ * Total throughput of threadCount threads each doing operationsPerThread
+ * random gets and inserts on a table prefilled with BENCHMARK_SIZE keys.
+ * writePercent of the operations are inserts.
+ */
+template<typename Table> static double concurrentThroughput(Table& table, unsigned int threadCount,
+                                                            int writePercent) {
+    const int operationsPerThread = 500000;
+    vector<thread> threads;
+
+    auto start = chrono::steady_clock::now();
+    for (unsigned int t = 0; t < threadCount; t++) {
+        threads.push_back(thread([&table, t, writePercent, operationsPerThread]() {
+            uint64_t random = 88172645463325252ULL + t;
+            for (int i = 0; i < operationsPerThread; i++) {
+                // xorshift, rand() takes a lock of its own
+                random ^= random << 13;
+                random ^= random >> 7;
+                random ^= random << 17;
+                int key = (int) (random % BENCHMARK_SIZE);
+                if ((int) (random >> 40) % 100 < writePercent) {
+                    table.insert(key, i);
+                } else {
+                    table.get(key);
+                }
+            }
+        }));
+    }
+    for (unsigned int t = 0; t < threads.size(); t++) {
+        threads[t].join();
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    return threadCount * operationsPerThread / elapsed.count() / 1e6;
+}
+
+template<typename Table> static void benchmarkConcurrentTable(const char* name,
+                                                              const vector<int>& writePercents = { 0, 10, 50 }) {
+    unsigned int maxThreads = max(thread::hardware_concurrency(), 1u);
+    Table table;
+
+    for (int key = 0; key < BENCHMARK_SIZE; key++) {
+        table.insert(key, key);
+    }
+
+    for (int writePercent : writePercents) {
+        cout << "  " << name << ", " << writePercent << "% writes, million operations/s:";
+        for (unsigned int threadCount = 1;; threadCount *= 2) {
+            threadCount = min(threadCount, maxThreads);
+            cout << " " << threadCount << " threads " << concurrentThroughput(table, threadCount, writePercent);
+            if (threadCount == maxThreads) {
+                break;
+            }
+        }
+        cout << "\n";
+    }
+}
+
+/**
+ * Insert, then remove half, then reinsert, and report the allocator calls and the memory the process
+ * kept. Each table runs in a child process, so the resident set size isn't polluted by the others.
+ */
+template<typename Table> static void benchmarkAllocations(const char* name, int count) {
+    cout.flush();
+    pid_t child = fork();
+    if (child != 0) {
+        int status = 0;
+        waitpid(child, &status, 0);
+        return;
+    }
+
+    // Hand the memory freed by earlier benchmarks back to the kernel, so it isn't reused unseen
+    malloc_trim(0);
+    long rssBefore = residentSetKilobytes();
+    unsigned long long allocationsBefore = allocationCount.load();
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    {
+        Table table;
+        for (int i = 0; i < count; i++) {
+            table.insert(i, i);
+        }
+        for (int i = 0; i < count; i += 2) {
+            table.remove(i);
+        }
+        for (int i = 0; i < count; i += 2) {
+            table.insert(i, i);
+        }
+        long rssFull = residentSetKilobytes();
+        unsigned long long allocations = allocationCount.load() - allocationsBefore;
+        double ns = nanosecondsPerOperation(start, 2 * count);
+        cout << "  " << name << ": " << allocations << " allocations, " << (rssFull - rssBefore) << " KB RSS, "
+                        << ns << " ns/op";
+    }
+    malloc_trim(0);
+    cout << ", " << (residentSetKilobytes() - rssBefore) << " KB RSS after destroy\n";
+    cout.flush();
+    _exit(0);
+}
+
+// Add key to a map or a set
+template<typename Table> static void addKey(Table& table, int key) {
+    table.insert(key, key);
+}
+
+template<typename K, typename HashGenerator, bool Packed> static void addKey(HashSet<K, HashGenerator, Packed>& set,
+                int key) {
+    set.insert(key);
+}
+
+// Visit every key of a map or a set
+template<typename Table> static long long sumKeys(const Table& table) {
+    long long sum = 0;
+    for (auto it = table.cbegin(); it != table.cend(); ++it) {
+        sum += it.key();
+    }
+    return sum;
+}
+
+template<typename K, typename HashGenerator, bool Packed> static long long sumKeys(
+                const HashSet<K, HashGenerator, Packed>& set) {
+    long long sum = 0;
+    for (auto it = set.cbegin(); it != set.cend(); ++it) {
+        sum += *it;
+    }
+    return sum;
+}
+
+/**
+ * Bytes of resident memory per entry of a table of count int keys, and the
+ * time a full scan over it takes per entry. Run in a child process, like
+ * benchmarkAllocations, so nothing else is in the heap.
+ */
+template<typename Table> static void benchmarkMemoryPerEntry(const char* name, int count) {
+    cout.flush();
+    pid_t child = fork();
+    if (child != 0) {
+        int status = 0;
+        waitpid(child, &status, 0);
+        return;
+    }
+
+    vector<int> keys = makeKeys(count, 0);
+    malloc_trim(0);
+    long rssBefore = residentSetKilobytes();
+    {
+        Table table;
+        for (int key : keys) {
+            addKey(table, key);
+        }
+        long rssFull = residentSetKilobytes();
+
+        long long checksum = 0;
+        int rounds = 10;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (int round = 0; round < rounds; round++) {
+            checksum += sumKeys(table);
+        }
+        double scanCost = nanosecondsPerOperation(start, rounds * count);
+
+        cout << "  " << name << ": " << (rssFull - rssBefore) * 1024.0 / count << " bytes per entry, scan "
+                        << scanCost << " ns per entry (checksum " << checksum << ")\n";
+    }
+    cout.flush();
+    _exit(0);
+}
+
+void runHashTableBenchmarks(void) {
+    cout << "Hash table benchmarks, " << BENCHMARK_SIZE << " int keys\n";
+    benchmarkTable<HashTable<int, int>>("HashTable");
+    benchmarkTable<OpenAddressingHashTable<int, int>>("OpenAddressingHashTable");
+    benchmarkTable<RobinHoodHashTable<int, int>>("RobinHoodHashTable");
+    benchmarkTable<PackedHashTable<int, int>>("PackedHashTable");
+    benchmarkTable<CuckooHashTable<int, int>>("CuckooHashTable");
+    benchmarkTable<SwissHashTable<int, int>>("SwissHashTable (" SWISS_GROUP_NAME ")");
+    benchmarkTable<UnorderedMapAdapter<int, int>>("std::unordered_map");
+
+    cout << "RobinHoodHashTable by load factor\n";
+    benchmarkRobinHoodLoad(0.5f);
+    benchmarkRobinHoodLoad(0.75f);
+    benchmarkRobinHoodLoad(0.9f);
+
+    benchmarkSizePolicies(1000);
+    benchmarkSizePolicies(BENCHMARK_SIZE);
+
+    benchmarkStatistics();
+
+    cout << "Insert latency, " << 4 * BENCHMARK_SIZE << " int keys\n";
+    benchmarkInsertLatency<HashTable<int, int>>("  stop the world rehash", 4 * BENCHMARK_SIZE);
+    benchmarkInsertLatency<HashTable<int, int, DefaultHashGenerator<int>, PrimeSizePolicy, IncrementalRehashPolicy<>>>(
+                    "  incremental rehash", 4 * BENCHMARK_SIZE);
+
+    cout << "Lookup latency, " << BENCHMARK_SIZE << " int keys, hits and misses\n";
+    benchmarkLookupLatency<HashTable<int, int>>("  HashTable", BENCHMARK_SIZE);
+    benchmarkLookupLatency<CuckooHashTable<int, int>>("  CuckooHashTable", BENCHMARK_SIZE);
+    {
+        HashTable<int, int> chained;
+        for (int key : makeKeys(BENCHMARK_SIZE, 0)) {
+            chained.insert(key, key);
+        }
+        cout << "  longest HashTable chain " << chained.occupancyHistogram().size() - 1
+                        << " entries, a CuckooHashTable lookup reads at most 2 buckets\n";
+    }
+
+    cout << "Allocator, " << BENCHMARK_SIZE << " inserts, " << BENCHMARK_SIZE / 2 << " removes and reinserts\n";
+    benchmarkAllocations<HashTable<int, int>>("new/delete", BENCHMARK_SIZE);
+    benchmarkAllocations<HashTable<int, int, DefaultHashGenerator<int>, PrimeSizePolicy, StopTheWorldRehashPolicy,
+                    PoolAllocator>>("PoolAllocator", BENCHMARK_SIZE);
+
+    cout << "Memory per entry, " << BENCHMARK_SIZE << " int keys\n";
+    benchmarkMemoryPerEntry<HashTable<int, int>>("HashTable<int, int>", BENCHMARK_SIZE);
+    benchmarkMemoryPerEntry<PackedHashTable<int, int>>("PackedHashTable<int, int>", BENCHMARK_SIZE);
+    benchmarkMemoryPerEntry<HashSet<int, DefaultHashGenerator<int>, false>>("chained HashSet<int>",
+                                                                             BENCHMARK_SIZE);
+    benchmarkMemoryPerEntry<HashSet<int>>("packed HashSet<int>", BENCHMARK_SIZE);
+
+    cout << "Cold start, " << 10 * BENCHMARK_SIZE << " int entries\n";
+    benchmarkColdStart(10 * BENCHMARK_SIZE);
+
+    cout << "Restart from a snapshot, " << 10 * BENCHMARK_SIZE << " uint64_t keys\n";
+    benchmarkSnapshotRestart(10 * BENCHMARK_SIZE);
+
+    cout << "Batched lookups, tables larger than the last level cache\n";
+    {
+        vector<int> intKeys = makeKeys(16 * BENCHMARK_SIZE, 0);
+        benchmarkBatchLookups("16M int keys", intKeys);
+    }
+    {
+        vector<int> intKeys = makeKeys(4 * BENCHMARK_SIZE, 0);
+        vector<string> stringKeys;
+        for (int key : intKeys) {
+            stringKeys.push_back("key number " + to_string(key));
+        }
+        benchmarkBatchLookups("4M string keys", stringKeys);
+    }
+
+    cout << "Looking up string tokens, " << BENCHMARK_SIZE / 10 << " keys\n";
+    benchmarkTransparentLookups(BENCHMARK_SIZE / 10);
+
+    cout << "String keys with 1 KB values, " << BENCHMARK_SIZE / 10 << " entries\n";
+    benchmarkStringEntries<HashTable<string, string>>("HashTable", BENCHMARK_SIZE / 10);
+
+    cout << "Concurrent throughput, " << BENCHMARK_SIZE << " int keys\n";
+    benchmarkConcurrentTable<GlobalMutexHashTable<int, int>>("HashTable with a global mutex");
+    benchmarkConcurrentTable<ConcurrentHashTable<int, int>>("ConcurrentHashTable");
+
+    cout << "Read scaling, " << BENCHMARK_SIZE << " int keys\n";
+    benchmarkConcurrentTable<ConcurrentHashTable<int, int>>("ConcurrentHashTable", { 0, 1 });
+    benchmarkConcurrentTable<RcuHashTable<int, int>>("RcuHashTable", { 0, 1 });
+}
@@ -23,15 +23,153 @@
 
 #include <iostream>
 #include <list>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include <stdlib.h>
 
 using namespace std;
 using namespace mjl::homebrew;
 
+// A value that counts how often it gets copied, to check that entries are moved rather than copied
+class CopyCounter {
+ public:
+    CopyCounter(int theId)
+                    : id(theId) {
+    }
+    CopyCounter(const CopyCounter& from)
+                    : id(from.id) {
+        copies++;
+    }
+    CopyCounter(CopyCounter&& from) noexcept
+                    : id(from.id) {
+    }
+    CopyCounter& operator=(const CopyCounter& from) {
+        id = from.id;
+        copies++;
+        return *this;
+    }
+    CopyCounter& operator=(CopyCounter&& from) noexcept {
+        id = from.id;
+        return *this;
+    }
+    int id;
+    static int copies;
+};
+
+int CopyCounter::copies = 0;
+
+// The worst possible hash, which puts every key in the same chain
+class ConstantHashGenerator {
+ public:
+    static size_t hash(const int& k) {
+        return 42;
+    }
+};
+
+// Insert, read back and remove enough random keys to grow through many sizes of the table
+template<typename Table> static bool testRandomKeys(const char* name) {
+    Table myHash;
+    unordered_map<int, int> stdHash;
+
+    cout << "Testing " << name << "\n";
+    srand(1234);
+    for (int i = 0; i < 100000; i++) {
+        int key = rand() % 200000;
+        myHash.insert(key, i);
+        stdHash[key] = i;
+
+        // Remove now and then, so some removes land in a table that is being rehashed
+        if (i % 3 == 0) {
+            key = rand() % 200000;
+            if (myHash.remove(key) != (stdHash.erase(key) == 1)) {
+                cerr << name << " remove(" << key << ") returned the wrong result.\n";
+                return false;
+            }
+        }
+    }
+
+    // A copy made at this point may be in the middle of a rehash
+    Table copy(myHash);
+
+    // Iterating has to visit the part of the old table that hasn't been moved yet too
+    size_t visited = 0;
+    for (auto entry : myHash) {
+        auto expected = stdHash.find(entry.first);
+        if (expected == stdHash.end() || expected->second != entry.second) {
+            cerr << name << " iterated over the wrong entry " << entry.first << ".\n";
+            return false;
+        }
+        visited++;
+    }
+    if (visited != stdHash.size()) {
+        cerr << name << " iterated over " << visited << " entries, expected " << stdHash.size() << ".\n";
+        return false;
+    }
+
+    // So may the batched lookups, which do only one step of it per batch
+    int keys[100];
+    int* values[100];
+    bool found[100];
+    for (int first = 0; first < 200000; first += 100) {
+        size_t expectedCount = 0;
+        for (int i = 0; i < 100; i++) {
+            keys[i] = first + i;
+            expectedCount += stdHash.count(first + i);
+        }
+        if (myHash.getBatch(keys, 100, values) != expectedCount || copy.findMany(keys, 100, found) != expectedCount) {
+            cerr << name << " batch lookup of keys " << first << " and up found the wrong number of keys.\n";
+            return false;
+        }
+        for (int i = 0; i < 100; i++) {
+            bool expected = stdHash.find(keys[i]) != stdHash.end();
+            if (found[i] != expected || (values[i] != nullptr) != expected
+                            || (expected && *values[i] != stdHash[keys[i]])) {
+                cerr << name << " batch lookup of key " << keys[i] << " returned the wrong result.\n";
+                return false;
+            }
+        }
+    }
+
+    for (int key = 0; key < 200000; key++) {
+        bool expected = stdHash.find(key) != stdHash.end();
+        if (myHash.contains(key) != expected || copy.contains(key) != expected) {
+            cerr << name << " contains(" << key << ") returned the wrong result.\n";
+            return false;
+        }
+        if (expected && (myHash.get(key) != stdHash[key] || copy.get(key) != stdHash[key])) {
+            cerr << name << " has the wrong value for entry " << key << ".\n";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// The precomputed magic divisor has to give exactly the same answer as a real modulo
+static bool testPrimeSizePolicyModulo(void) {
+    PrimeSizePolicy sizing;
+
+    cout << "Testing PrimeSizePolicy magic divisor against modulo\n";
+    for (int step = 0; step < 20; step++) {
+        srand(1234);
+        for (int i = 0; i < 100000; i++) {
+            size_t hash = ((size_t) rand() << 31) ^ rand();
+            uint32_t folded = (uint32_t) ((uint64_t) hash ^ ((uint64_t) hash >> 32));
+            if (sizing.index(hash) != folded % sizing.size()) {
+                cerr << "Magic divisor for " << sizing.size() << " is wrong for " << folded << ".\n";
+                return false;
+            }
+        }
+        sizing.grow();
+    }
+
+    return true;
+}
+
 bool runHashTableTests() {
     bool testResult = false;
     const int TEST_SIZE = 100;
@@ -119,6 +257,228 @@ bool runHashTableTests() {
     }
     cout << "\n";
 
+    // Enough random keys to walk the whole HASH_TABLE_SIZES list, so every rehash case is hit
+    cout << "Testing rehash with random keys\n";
+    HashTable<int, int> myHash5;
+    unordered_map<int, int> stdHash2;
+    srand(1234);
+    for (int i = 0; i < 100000; i++) {
+        int key = rand();
+        myHash5.insert(key, i);
+        stdHash2[key] = i;
+    }
+    for (auto it = stdHash2.begin(); it != stdHash2.end(); it++) {
+        if (myHash5.get(it->first) != it->second) {
+            cerr << "Entry " << it->first << " has the wrong value after rehash.\n";
+            return false;
+        }
+    }
+    for (auto it = stdHash2.begin(); it != stdHash2.end(); it++) {
+        if (myHash5.remove(it->first) != true) {
+            cerr << "Entry " << it->first << " could not be removed after rehash.\n";
+            return false;
+        }
+    }
+    if (myHash5.remove(1) != false) {
+        cerr << "Removed an entry from an empty hash table.\n";
+        return false;
+    }
+
+    if (!testPrimeSizePolicyModulo()
+                    || !testRandomKeys<HashTable<int, int, DefaultHashGenerator<int>, PrimeSizePolicy>>(
+                                    "PrimeSizePolicy")
+                    || !testRandomKeys<HashTable<int, int, DefaultHashGenerator<int>, PowerOfTwoSizePolicy>>(
+                                    "PowerOfTwoSizePolicy")
+                    || !testRandomKeys<HashTable<int, int, DefaultHashGenerator<int>, FastRangeSizePolicy>>(
+                                    "FastRangeSizePolicy")
+                    || !testRandomKeys<HashTable<int, int, DefaultHashGenerator<int>, PrimeSizePolicy,
+                                    IncrementalRehashPolicy<1>>>("IncrementalRehashPolicy<1>")
+                    || !testRandomKeys<HashTable<int, int, DefaultHashGenerator<int>, PowerOfTwoSizePolicy,
+                                    IncrementalRehashPolicy<>>>("IncrementalRehashPolicy<>")
+                    || !testRandomKeys<HashTable<int, int, DefaultHashGenerator<int>, PrimeSizePolicy,
+                                    IncrementalRehashPolicy<>, PoolAllocator>>("PoolAllocator")) {
+        return false;
+    }
+
+    // Strings have destructors, so the pool can't simply be dropped without visiting every entry
+    cout << "Testing PoolAllocator with string keys and values, and clear()\n";
+    HashTable<string, string, DefaultHashGenerator<string>, PrimeSizePolicy, StopTheWorldRehashPolicy,
+                    PoolAllocator> stringHash;
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < 10000; i++) {
+            stringHash.insert(to_string(i), string(i % 100, 'x'));
+        }
+        for (int i = 0; i < 10000; i += 2) {
+            stringHash.remove(to_string(i));
+        }
+        for (int i = 0; i < 10000; i++) {
+            if (stringHash.contains(to_string(i)) != (i % 2 == 1)) {
+                cerr << "String key " << i << " is wrong in PoolAllocator hash table.\n";
+                return false;
+            }
+        }
+        HashTable<string, string, DefaultHashGenerator<string>, PrimeSizePolicy, StopTheWorldRehashPolicy,
+                        PoolAllocator> moved(std::move(stringHash));
+        stringHash = std::move(moved);
+        stringHash.clear();
+        if (stringHash.contains("1")) {
+            cerr << "clear() left entries behind.\n";
+            return false;
+        }
+    }
+
+    // const char* and StringSlice keys are looked up without ever becoming a std::string
+    cout << "Testing lookups with const char* and StringSlice keys\n";
+    HashTable<string, int> names;
+    names.insert("alpha", 1);
+    names.insert("beta", 2);
+    names.insert("a rather long key that will not fit in a small string buffer", 3);
+    const char* buffer = "key=beta;next=gamma";
+    if (names.get("alpha") != 1 || names.get(StringSlice(buffer + 4, 4)) != 2
+                    || names.get("a rather long key that will not fit in a small string buffer") != 3
+                    || names.contains(StringSlice(buffer + 4, 3)) || names.contains("gamma")) {
+        cerr << "Transparent lookup found the wrong entries.\n";
+        return false;
+    }
+    try {
+        names.get(StringSlice(buffer + 14, 5));
+        cerr << "Getting a missing StringSlice key did not throw.\n";
+        return false;
+    } catch (std::out_of_range&) {
+    }
+    if (!names.remove(StringSlice(buffer + 4, 4)) || names.remove("beta") || names.contains(string("beta"))) {
+        cerr << "Transparent remove did not work.\n";
+        return false;
+    }
+
+    // A table built from a range in one go, with a repeated key whose last value has to win
+    cout << "Testing reserve, range construction and iterators\n";
+    vector<pair<int, int>> entries;
+    for (int i = 0; i < 50000; i++) {
+        entries.push_back(make_pair(i, -i));
+    }
+    entries.push_back(make_pair(7, 7));
+    const HashTable<int, int> built(entries.begin(), entries.end());
+    long long keySum = 0;
+    size_t builtCount = 0;
+    for (HashTable<int, int>::const_iterator it = built.begin(); it != built.end(); ++it) {
+        if (it.value() != (it.key() == 7 ? 7 : -it.key())) {
+            cerr << "Range constructed table has value " << it.value() << " for key " << it.key() << ".\n";
+            return false;
+        }
+        keySum += it.key();
+        builtCount++;
+    }
+    if (builtCount != 50000 || keySum != 50000LL * 49999 / 2) {
+        cerr << "Iterating over the range constructed table visited " << builtCount << " entries.\n";
+        return false;
+    }
+
+    // Values can be changed through an iterator
+    HashTable<int, int, DefaultHashGenerator<int>, PowerOfTwoSizePolicy, IncrementalRehashPolicy<>> reserved;
+    reserved.reserve(100000);
+    for (int i = 0; i < 100000; i++) {
+        reserved.insert(i, i);
+    }
+    for (auto entry : reserved) {
+        entry.second *= 2;
+    }
+    for (int i = 0; i < 100000; i++) {
+        if (reserved.get(i) != 2 * i) {
+            cerr << "Reserved table has the wrong value for key " << i << ".\n";
+            return false;
+        }
+    }
+
+    // Rvalues, emplace and try_emplace must never copy a value, not even while the table grows
+    cout << "Testing move insert, emplace and try_emplace\n";
+    HashTable<int, CopyCounter> copyHash;
+    for (int i = 0; i < 10000; i++) {
+        copyHash.insert(i, CopyCounter(i));
+        copyHash.emplace(i + 10000, i + 10000);
+        if (!copyHash.try_emplace(i + 20000, i + 20000)) {
+            cerr << "try_emplace did not insert key " << i + 20000 << ".\n";
+            return false;
+        }
+    }
+    copyHash.insert(0, CopyCounter(100));
+    copyHash.emplace(1, 101);
+    if (copyHash.try_emplace(2, 102)) {
+        cerr << "try_emplace replaced an existing key.\n";
+        return false;
+    }
+    if (CopyCounter::copies != 0) {
+        cerr << "Values were copied " << CopyCounter::copies << " times.\n";
+        return false;
+    }
+    for (int i = 0; i < 30000; i++) {
+        int expected = (i == 0 || i == 1) ? i + 100 : i;
+        if (copyHash.get(i).id != expected) {
+            cerr << "Key " << i << " has value " << copyHash.get(i).id << ", expected " << expected << ".\n";
+            return false;
+        }
+    }
+
+    // A value that can't be copied at all only needs the moving and emplacing half of the interface
+    HashTable<string, unique_ptr<string>> uniqueHash;
+    for (int i = 0; i < 1000; i++) {
+        uniqueHash.insert(to_string(i), unique_ptr<string>(new string(to_string(i))));
+        uniqueHash.try_emplace(to_string(i));
+    }
+    uniqueHash.emplace("0", new string("replaced"));
+    uniqueHash.remove("1");
+    if (*uniqueHash.get("0") != "replaced" || uniqueHash.get("2") == nullptr || *uniqueHash.get("999") != "999"
+                    || uniqueHash.contains("1")) {
+        cerr << "Hash table with unique_ptr values has the wrong contents.\n";
+        return false;
+    }
+
+    // Every lookup is counted, and a bad hash shows up as long chain walks and a lopsided histogram
+    cout << "Testing CountingHashStatistics and occupancyHistogram\n";
+    HashTable<int, int, DefaultHashGenerator<int>, PrimeSizePolicy, StopTheWorldRehashPolicy, NewDeleteAllocator,
+                    CountingHashStatistics> countedHash;
+    HashTable<int, int, ConstantHashGenerator, PrimeSizePolicy, StopTheWorldRehashPolicy, NewDeleteAllocator,
+                    CountingHashStatistics> badHash;
+    for (int i = 0; i < 1000; i++) {
+        countedHash.insert(i, i);
+        badHash.insert(i, i);
+    }
+    const CountingHashStatistics& counted = countedHash.statistics();
+    unsigned long long insertLookups = counted.lookups;
+    for (int i = 0; i < 2000; i++) {
+        countedHash.contains(i);
+        badHash.contains(i);
+    }
+    if (counted.lookups != insertLookups + 2000 || counted.hits != 1000 || counted.misses != counted.lookups - 1000
+                    || counted.rehashes == 0 || counted.allocatedBytes == 0) {
+        cerr << "Counted " << counted.lookups << " lookups, " << counted.hits << " hits, " << counted.misses
+                        << " misses and " << counted.rehashes << " rehashes.\n";
+        return false;
+    }
+    if (badHash.statistics().meanChainSteps() < 100 * counted.meanChainSteps()) {
+        cerr << "A constant hash walks " << badHash.statistics().meanChainSteps()
+                        << " buckets per lookup, a good one " << counted.meanChainSteps() << ".\n";
+        return false;
+    }
+    vector<unsigned int> histogram = badHash.occupancyHistogram();
+    if (countedHash.size() != 1000 || histogram.size() != 1001 || histogram[1000] != 1
+                    || histogram[0] != badHash.bucketCount() - 1) {
+        cerr << "Occupancy histogram of a constant hash is wrong.\n";
+        return false;
+    }
+    unsigned int chains = 0;
+    unsigned int histogramEntries = 0;
+    histogram = countedHash.occupancyHistogram();
+    for (unsigned int i = 0; i < histogram.size(); i++) {
+        chains += histogram[i];
+        histogramEntries += i * histogram[i];
+    }
+    if (chains != countedHash.bucketCount() || histogramEntries != countedHash.size()) {
+        cerr << "Occupancy histogram counts " << histogramEntries << " entries in " << chains << " chains.\n";
+        return false;
+    }
+    countedHash.printStatistics(cout);
+
     /*
      Tested:
      HashTable() : hashTableSize(initialHashTableSize), size(0), table(new Bucket<K, V>[initialHashTableSize])
@@ -129,7 +489,7 @@ bool runHashTableTests() {
      void commonDelete(void)
      virtual ~HashTable()
      static unsigned int chooseBucket(const int& k)
-     Bucket(void) : key(nullptr), value(nullptr), next(nullptr)
+     Bucket(void) : next(nullptr), occupied(false)
      HashTable(const HashTable& from)
      HashTable& operator=(const HashTable& from)
      void commonCopy(HashTable& to, const HashTable& from)
@@ -139,7 +499,6 @@ bool runHashTableTests() {
 
      Not Tested:
 
-     Bucket(const K& theKey, const V& theValue)
      static unsigned int chooseBucket(const K& k)
 
      */
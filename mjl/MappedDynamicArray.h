@@ -0,0 +1,468 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef MAPPEDDYNAMICARRAY_H
+#define MAPPEDDYNAMICARRAY_H
+
+#include "DynamicArray.h"
+#include "DynamicArrayGrowthPolicy.h"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mjl {
+namespace homebrew {
+
+/*********************
+ * Table of contents *
+ *********************
+ *
+ * MappedAccess enum
+ *
+ * MappedDynamicArray<T, GrowthPolicy> class
+ *
+ *     MappedDynamicArray(const char* thePath, bool theReadOnly)
+ *     MappedDynamicArray(MappedDynamicArray&& from)
+ *     MappedDynamicArray& operator=(MappedDynamicArray&& from)
+ *     ~MappedDynamicArray()
+ *
+ *     iterator begin(void)
+ *     iterator end(void)
+ *     const_iterator begin(void) const
+ *     const_iterator end(void) const
+ *     const_iterator cbegin(void) const
+ *     const_iterator cend(void) const
+ *     T* data(void)
+ *     const T* data(void) const
+ *     T& operator[](unsigned int i)
+ *     const T& operator[](unsigned int i) const
+ *     void append(const T& data)
+ *     void push_back(const T& data)
+ *     T& emplace_back(Args&&... args)
+ *     void append(InputIterator start, InputIterator end)
+ *     void reserve(unsigned int count)
+ *     unsigned int size(void) const
+ *     unsigned int capacity(void) const
+ *     void clear(void)
+ *     void flush(void)
+ *     void adviseAccess(MappedAccess access)
+ *     bool isReadOnly(void) const
+ *
+ */
+
+/**
+ * How the array is going to be read, which decides how much of the file the
+ * kernel reads at a time (see madvise). MAPPED_NORMAL reads some pages on
+ * either side of the one that is needed, MAPPED_SEQUENTIAL reads far ahead,
+ * and MAPPED_RANDOM reads only the page that is needed.
+ */
+enum MappedAccess {
+    MAPPED_NORMAL,
+    MAPPED_SEQUENTIAL,
+    MAPPED_RANDOM
+};
+
+/**
+ * A DynamicArray whose elements live in a file, mapped into memory with
+ * mmap, so it can be larger than RAM and still be there after the program
+ * exits. The kernel reads pages of the file in as they are touched and
+ * writes changed ones back whenever it likes, so only the parts of the array
+ * in use take up memory.
+ *
+ * The file is nothing but the elements, byte for byte, with no header, so
+ * T has to be trivially copyable and a file can only be read by a program
+ * with the same T and byte order. Any existing file of Ts can be opened,
+ * and appending adds to the end of it.
+ *
+ * Appending past the capacity grows the file with ftruncate and the mapping
+ * with mremap, by the GrowthPolicy and rounded up to whole pages. While the
+ * array is open the file can be longer than the elements. flush() and the
+ * destructor cut it back to them, and flush() also waits until everything
+ * is on disk (msync and fsync). Without a flush a crash can lose recent
+ * changes, or leave the file with unused capacity at its end.
+ *
+ * An array opened read only can't be changed: appending, reserving or
+ * clearing throws std::logic_error, and writing to an element through a
+ * non-const reference crashes like any write to read-only memory. The
+ * constructor, and anything that grows or flushes the file, throws
+ * std::runtime_error if the file can't be opened, mapped or written.
+ * Running out of disk space while filling in pages that ftruncate added
+ * raises SIGBUS, as it does for any shared file mapping.
+ *
+ * This is Linux only (mremap). An array can be moved, but not copied.
+ */
+template<typename T, typename GrowthPolicy = DoublingGrowthPolicy> class MappedDynamicArray {
+ public:
+    static_assert(std::is_trivially_copyable<T>::value, "The elements are stored in the file byte for byte");
+
+    typedef DynamicArrayIterator<T> iterator;
+    typedef DynamicArrayIterator<const T> const_iterator;
+
+    // Open the file at thePath, creating it unless theReadOnly, with the elements already in it
+    explicit MappedDynamicArray(const char* thePath, bool theReadOnly = false)
+                    : fd(-1),
+                      array(nullptr),
+                      theSize(0),
+                      theCapacity(0),
+                      mappingSize(0),
+                      readOnly(theReadOnly),
+                      access(MAPPED_NORMAL),
+                      path(thePath) {
+
+        fd = open(thePath, readOnly ? O_RDONLY : O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Could not open mapped array " + path);
+        }
+
+        struct stat status;
+        if (fstat(fd, &status) != 0) {
+            close(fd);
+            throw std::runtime_error("Could not open mapped array " + path);
+        }
+
+        size_t bytes = (size_t) status.st_size;
+        if (bytes % sizeof(T) != 0 || bytes / sizeof(T) > std::numeric_limits<unsigned int>::max()) {
+            close(fd);
+            throw std::runtime_error("File is not a whole number of elements, or too many: " + path);
+        }
+
+        if (bytes > 0) {
+            mappingSize = roundUpToPage(bytes);
+            void* mapping = mmap(nullptr, mappingSize, readOnly ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED,
+                            fd, 0);
+            if (mapping == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("Could not map mapped array " + path);
+            }
+            array = static_cast<T*>(mapping);
+        }
+
+        theSize = (unsigned int) (bytes / sizeof(T));
+        theCapacity = theSize;
+    }
+
+    MappedDynamicArray(const MappedDynamicArray& from) = delete;
+    MappedDynamicArray& operator=(const MappedDynamicArray& from) = delete;
+
+    MappedDynamicArray(MappedDynamicArray&& from) noexcept
+                    : fd(from.fd),
+                      array(from.array),
+                      theSize(from.theSize),
+                      theCapacity(from.theCapacity),
+                      mappingSize(from.mappingSize),
+                      readOnly(from.readOnly),
+                      access(from.access),
+                      path(std::move(from.path)) {
+        from.forget();
+    }
+
+    MappedDynamicArray& operator=(MappedDynamicArray&& from) noexcept {
+        if (this != &from) {
+            closeFile();
+            fd = from.fd;
+            array = from.array;
+            theSize = from.theSize;
+            theCapacity = from.theCapacity;
+            mappingSize = from.mappingSize;
+            readOnly = from.readOnly;
+            access = from.access;
+            path = std::move(from.path);
+            from.forget();
+        }
+        return *this;
+    }
+
+    // Cut the file back to the elements and unmap it, without waiting for the disk
+    virtual ~MappedDynamicArray() {
+        closeFile();
+    }
+
+    iterator begin(void) {
+        return iterator(array);
+    }
+
+    iterator end(void) {
+        return iterator(array + theSize);
+    }
+
+    const_iterator begin(void) const {
+        return const_iterator(array);
+    }
+
+    const_iterator end(void) const {
+        return const_iterator(array + theSize);
+    }
+
+    const_iterator cbegin(void) const {
+        return begin();
+    }
+
+    const_iterator cend(void) const {
+        return end();
+    }
+
+    // The elements are contiguous, starting here. nullptr while the file is empty.
+    T* data(void) {
+        return array;
+    }
+
+    const T* data(void) const {
+        return array;
+    }
+
+    T& operator[](unsigned int i) {
+        return array[i];
+    }
+
+    const T& operator[](unsigned int i) const {
+        return array[i];
+    }
+
+    void append(const T& data) {
+        emplace_back(data);
+    }
+
+    void push_back(const T& data) {
+        emplace_back(data);
+    }
+
+    /**
+     * Construct a new element at the end and return it. The arguments may
+     * refer to elements of the array itself, which growing can move.
+     */
+    template<typename... Args> T& emplace_back(Args&&... args) {
+
+        if (theSize == theCapacity) {
+            T pending(std::forward<Args>(args)...);
+            grow(nextCapacity());
+            new (&array[theSize]) T(pending);
+            return array[theSize++];
+        }
+
+        new (&array[theSize]) T(std::forward<Args>(args)...);
+        return array[theSize++];
+    }
+
+    /**
+     * Append copies of the elements from start up to (but not including)
+     * end. As with DynamicArray, the file grows at most once when the length
+     * of the range is known up front, and the range must not come from the
+     * array itself.
+     */
+    template<typename InputIterator> void append(InputIterator start, InputIterator end) {
+        appendRange(start, end, typename std::iterator_traits<InputIterator>::iterator_category());
+    }
+
+    // Make room for count elements in total, so appending up to there never grows the file
+    void reserve(unsigned int count) {
+        if (count > theCapacity) {
+            grow(count);
+        }
+    }
+
+    unsigned int size(void) const {
+        return theSize;
+    }
+
+    unsigned int capacity(void) const {
+        return theCapacity;
+    }
+
+    // Forget every element. The file is emptied at the next flush, or when the array is destroyed.
+    void clear(void) {
+        checkWritable();
+        theSize = 0;
+    }
+
+    /**
+     * Cut the file back to the elements and wait until they are on disk. The
+     * capacity drops to the size, so the next append grows the file again.
+     * Does nothing for an array opened read only.
+     */
+    void flush(void) {
+
+        if (readOnly) {
+            return;
+        }
+
+        if (!trim() || (array != nullptr && msync(array, mappingSize, MS_SYNC) != 0) || fsync(fd) != 0) {
+            throw std::runtime_error("Could not flush mapped array " + path);
+        }
+    }
+
+    /**
+     * Tell the kernel how the array is going to be read. Reading at random
+     * from a file much larger than memory is many times faster with
+     * MAPPED_RANDOM, which stops every page fault from reading the pages
+     * around it too. The advice holds for the life of the array, as it grows.
+     */
+    void adviseAccess(MappedAccess newAccess) {
+        access = newAccess;
+        applyAdvice();
+    }
+
+    bool isReadOnly(void) const {
+        return readOnly;
+    }
+
+ private:
+
+    template<typename InputIterator> void appendRange(InputIterator start, InputIterator end,
+                    std::input_iterator_tag) {
+        for (; start != end; ++start) {
+            emplace_back(*start);
+        }
+    }
+
+    template<typename ForwardIterator> void appendRange(ForwardIterator start, ForwardIterator end,
+                    std::forward_iterator_tag) {
+
+        unsigned int needed = theSize + (unsigned int) std::distance(start, end);
+        if (needed > theCapacity) {
+            grow(std::max(needed, nextCapacity()));
+        }
+
+        for (; start != end; ++start) {
+            new (&array[theSize]) T(*start);
+            theSize++;
+        }
+    }
+
+    unsigned int nextCapacity(void) const {
+        return (theCapacity == 0) ? 1 : GrowthPolicy::grow(theCapacity);
+    }
+
+    // Grow the file and its mapping to at least newCapacity elements, and use all of the last page
+    void grow(unsigned int newCapacity) {
+
+        checkWritable();
+
+        size_t newMappingSize = roundUpToPage((size_t) newCapacity * sizeof(T));
+        size_t wholePages = std::min(newMappingSize / sizeof(T), (size_t) std::numeric_limits<unsigned int>::max());
+
+        if (ftruncate(fd, (off_t) (wholePages * sizeof(T))) != 0) {
+            throw std::runtime_error("Could not grow mapped array " + path);
+        }
+
+        void* mapping;
+        if (array == nullptr) {
+            mapping = mmap(nullptr, newMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        } else {
+            mapping = mremap(array, mappingSize, newMappingSize, MREMAP_MAYMOVE);
+        }
+        // The file is left longer than the capacity, until the next flush cuts it back
+        if (mapping == MAP_FAILED) {
+            throw std::runtime_error("Could not map mapped array " + path);
+        }
+
+        array = static_cast<T*>(mapping);
+        mappingSize = newMappingSize;
+        theCapacity = (unsigned int) wholePages;
+        applyAdvice();
+    }
+
+    void applyAdvice(void) {
+        static const int advice[] = { MADV_NORMAL, MADV_SEQUENTIAL, MADV_RANDOM };
+        if (array != nullptr) {
+            madvise(array, mappingSize, advice[access]);
+        }
+    }
+
+    // Cut the file and the mapping back to the elements. Shrinking a mapping never moves it.
+    bool trim(void) {
+
+        size_t bytes = (size_t) theSize * sizeof(T);
+        if (ftruncate(fd, (off_t) bytes) != 0) {
+            return false;
+        }
+
+        size_t newMappingSize = roundUpToPage(bytes);
+        if (newMappingSize == 0) {
+            munmap(array, mappingSize);
+            array = nullptr;
+        } else if (newMappingSize < mappingSize) {
+            mremap(array, mappingSize, newMappingSize, 0);
+        }
+
+        mappingSize = newMappingSize;
+        theCapacity = theSize;
+        return true;
+    }
+
+    void checkWritable(void) const {
+        if (readOnly) {
+            throw std::logic_error("Tried to change mapped array " + path + ", which was opened read only.");
+        }
+    }
+
+    void closeFile(void) {
+        if (fd < 0) {
+            return;
+        }
+        if (!readOnly) {
+            trim();
+        }
+        if (array != nullptr) {
+            munmap(array, mappingSize);
+        }
+        close(fd);
+        forget();
+    }
+
+    void forget(void) {
+        fd = -1;
+        array = nullptr;
+        theSize = 0;
+        theCapacity = 0;
+        mappingSize = 0;
+    }
+
+    static size_t roundUpToPage(size_t bytes) {
+        static const size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+        return (bytes + pageSize - 1) & ~(pageSize - 1);
+    }
+
+    int fd;
+    T* array;
+    unsigned int theSize;						// How many elements is the array holding
+    unsigned int theCapacity;					// How many elements fit in the file before it has to grow
+    size_t mappingSize;                         // Bytes mapped, the file's length rounded up to a page
+    bool readOnly;
+    MappedAccess access;
+    std::string path;
+};
+
+}    // end namespace homebrew
+}    // end namespace mjl
+
+#endif // MAPPEDDYNAMICARRAY_H
@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "MappedDynamicArray.h"
+#include "MappedDynamicArray_test.h"
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+using namespace std;
+using namespace mjl::homebrew;
+
+static const char* ARRAY_PATH = "/tmp/MappedDynamicArray_test.array";
+
+// A plain old data element, like the ones kept in mapped arrays
+struct Sample {
+    uint64_t time;
+    double value;
+};
+
+static long long fileSize(const char* path) {
+    struct stat status;
+    return (stat(path, &status) == 0) ? (long long) status.st_size : -1;
+}
+
+// The array must hold samples 0 up to count, as appended by runMappedDynamicArrayTests
+static bool holdsSamples(const MappedDynamicArray<Sample>& array, unsigned int count) {
+
+    if (array.size() != count) {
+        cerr << "Mapped array has " << array.size() << " elements, expected " << count << ".\n";
+        return false;
+    }
+    for (unsigned int i = 0; i < count; i++) {
+        if (array[i].time != i || array[i].value != i * 0.5) {
+            cerr << "Element " << i << " of the mapped array has the wrong value.\n";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool runMappedDynamicArrayTests(void) {
+    const unsigned int TEST_SIZE = 100000;
+
+    remove(ARRAY_PATH);
+
+    cout << "Testing MappedDynamicArray appending, then reopening the file\n";
+    {
+        MappedDynamicArray<Sample> array(ARRAY_PATH);
+        if (array.size() != 0 || array.data() != nullptr || array.begin() != array.end()) {
+            cerr << "A new mapped array should be empty.\n";
+            return false;
+        }
+        for (unsigned int i = 0; i < TEST_SIZE; i++) {
+            Sample sample = { i, i * 0.5 };
+            array.push_back(sample);
+        }
+        if (!holdsSamples(array, TEST_SIZE) || fileSize(ARRAY_PATH) < (long long) (TEST_SIZE * sizeof(Sample))) {
+            return false;
+        }
+    }
+    if (fileSize(ARRAY_PATH) != (long long) (TEST_SIZE * sizeof(Sample))) {
+        cerr << "Closing the mapped array left the file " << fileSize(ARRAY_PATH) << " bytes long.\n";
+        return false;
+    }
+    {
+        MappedDynamicArray<Sample> array(ARRAY_PATH);
+        if (!holdsSamples(array, TEST_SIZE)) {
+            return false;
+        }
+
+        cout << "Testing MappedDynamicArray flush, while a reader has the file open\n";
+        Sample sample = { TEST_SIZE, TEST_SIZE * 0.5 };
+        array.emplace_back(sample);
+        array.flush();
+        if (array.capacity() != TEST_SIZE + 1
+                        || fileSize(ARRAY_PATH) != (long long) ((TEST_SIZE + 1) * sizeof(Sample))) {
+            cerr << "flush didn't cut the file back to the elements.\n";
+            return false;
+        }
+
+        // Both map the same file, so the reader sees what is written afterwards
+        MappedDynamicArray<Sample> reader(ARRAY_PATH, true);
+        array[0].value = -1.0;
+        if (!reader.isReadOnly() || reader.size() != TEST_SIZE + 1 || reader[0].value != -1.0
+                        || reader[TEST_SIZE].time != TEST_SIZE) {
+            cerr << "A read only mapped array doesn't see the flushed elements.\n";
+            return false;
+        }
+        array[0].value = 0.0;
+
+        try {
+            reader.push_back(sample);
+            cerr << "Appending to a read only mapped array didn't throw.\n";
+            return false;
+        } catch (std::logic_error&) {
+        }
+
+        // The reader can be moved without remapping
+        MappedDynamicArray<Sample> moved(std::move(reader));
+        if (moved.size() != TEST_SIZE + 1 || reader.size() != 0 || moved[TEST_SIZE].value != TEST_SIZE * 0.5) {
+            cerr << "Moved mapped array has the wrong contents.\n";
+            return false;
+        }
+    }
+
+    cout << "Testing MappedDynamicArray iterators, ranges and clear\n";
+    {
+        // Any file that is a whole number of elements opens, whatever was written to it
+        MappedDynamicArray<uint32_t> numbers(ARRAY_PATH);
+        if (numbers.size() != (TEST_SIZE + 1) * sizeof(Sample) / sizeof(uint32_t)) {
+            cerr << "The file opened as uint32_ts has the wrong size.\n";
+            return false;
+        }
+        numbers.clear();
+
+        vector<uint32_t> source(5000);
+        iota(source.begin(), source.end(), 0);
+        numbers.append(source.begin(), source.end());
+        sort(numbers.begin(), numbers.end(), greater<uint32_t>());
+
+        // Appending its own elements, while the file grows under them
+        while (numbers.size() < 20000) {
+            numbers.push_back(numbers[numbers.size() - 1]);
+        }
+        const MappedDynamicArray<uint32_t>& constNumbers = numbers;
+        if (accumulate(constNumbers.cbegin(), constNumbers.cend(), 0ULL) != 4999ULL * 5000 / 2
+                        || numbers[0] != 4999 || numbers[19999] != 0) {
+            cerr << "Sorting or appending to a mapped array went wrong.\n";
+            return false;
+        }
+
+        numbers.flush();
+        if (fileSize(ARRAY_PATH) != 20000 * sizeof(uint32_t)) {
+            cerr << "Flushed file should be 20000 uint32_ts long.\n";
+            return false;
+        }
+        numbers.clear();
+        numbers.flush();
+        if (fileSize(ARRAY_PATH) != 0 || numbers.data() != nullptr || numbers.capacity() != 0) {
+            cerr << "Flushing a cleared mapped array should empty the file.\n";
+            return false;
+        }
+    }
+
+    cout << "Testing MappedDynamicArray rejects files it can't use\n";
+    FILE* file = fopen(ARRAY_PATH, "wb");
+    fputs("abc", file);
+    fclose(file);
+    const char* unusable[] = { ARRAY_PATH, "/nonexistent/directory/array" };
+    for (const char* path : unusable) {
+        try {
+            MappedDynamicArray<uint32_t> numbers(path);
+            cerr << "Opened " << path << " without complaint.\n";
+            return false;
+        } catch (std::runtime_error& error) {
+            cout << "Rejected as expected: " << error.what() << "\n";
+        }
+    }
+
+    remove(ARRAY_PATH);
+
+    return true;
+}
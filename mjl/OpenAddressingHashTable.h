@@ -0,0 +1,381 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef OPENADDRESSINGHASHTABLE_H
+#define OPENADDRESSINGHASHTABLE_H
+
+#include "HashTable.h"
+
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+namespace mjl {
+namespace homebrew {
+
+/**
+ * A single slot of an OpenAddressingHashTable. The key and value live inline
+ * in the slot, so the whole table is one contiguous array and a lookup only
+ * touches the slots it probes. The storage for the key and value is raw, and
+ * is only constructed while the slot is OCCUPIED.
+ */
+template<typename K, typename V> struct OpenAddressingSlot {
+ public:
+    enum State : unsigned char {
+        EMPTY,
+        OCCUPIED,
+        DELETED
+    };
+
+    OpenAddressingSlot(void)
+                    : state(EMPTY) {
+    }
+
+    K& key(void) {
+        return *reinterpret_cast<K*>(keyStorage);
+    }
+
+    const K& key(void) const {
+        return *reinterpret_cast<const K*>(keyStorage);
+    }
+
+    V& value(void) {
+        return *reinterpret_cast<V*>(valueStorage);
+    }
+
+    const V& value(void) const {
+        return *reinterpret_cast<const V*>(valueStorage);
+    }
+
+    State state;
+    alignas(K) unsigned char keyStorage[sizeof(K)];
+    alignas(V) unsigned char valueStorage[sizeof(V)];
+};
+
+/**
+ * This is an open addressing (linear probing) alternative to HashTable. It has
+ * the same get/insert/remove interface so code can switch between the two by
+ * changing a single template parameter.
+ *
+ * Removing an entry leaves a DELETED marker (tombstone) behind, so that probe
+ * sequences running through the slot are not cut short. Tombstones count
+ * towards the load of the table. When the load crosses maxLoadFactor the table
+ * is rebuilt; it grows if it is mostly full of live entries, otherwise it is
+ * rebuilt at the same size which simply clears out the tombstones.
+ */
+template<typename K, typename V, typename HashGenerator = DefaultHashGenerator<K>,
+                typename SizePolicy = PrimeSizePolicy> class OpenAddressingHashTable {
+ public:
+
+    typedef OpenAddressingSlot<K, V> Slot;
+
+    // Default constructor
+    OpenAddressingHashTable()
+                    : maxLoadFactor(0.7f),
+                      sizing(),
+                      hashTableSize(sizing.size()),
+                      size(0),
+                      used(0),
+                      table(new Slot[sizing.size()]) {
+    }
+
+    // Copy constructor
+    OpenAddressingHashTable(const OpenAddressingHashTable& from)
+                    : maxLoadFactor(0.7f),
+                      sizing(from.sizing),
+                      hashTableSize(from.hashTableSize),
+                      size(0),
+                      used(0),
+                      table(new Slot[from.hashTableSize]) {
+        commonCopy(from);
+    }
+
+    // Move constructor
+    OpenAddressingHashTable(OpenAddressingHashTable&& from) noexcept
+                    : maxLoadFactor(0.7f),
+                      sizing(from.sizing),
+                      hashTableSize(from.hashTableSize),
+                      size(from.size),
+                      used(from.used),
+                      table(from.table) {
+        from.table = nullptr;
+    }
+
+    // Assignment operator
+    OpenAddressingHashTable& operator=(const OpenAddressingHashTable& from) {
+
+        if (this == &from) {
+            return *this;
+        }
+
+        commonDelete();
+        sizing = from.sizing;
+        hashTableSize = from.hashTableSize;
+        size = 0;
+        used = 0;
+        table = new Slot[from.hashTableSize];
+        commonCopy(from);
+        return *this;
+    }
+
+    // Move assignment operator
+    OpenAddressingHashTable& operator=(OpenAddressingHashTable&& from) noexcept {
+
+        if (this == &from) {
+            return *this;
+        }
+
+        commonDelete();
+
+        sizing = from.sizing;
+        hashTableSize = from.hashTableSize;
+        size = from.size;
+        used = from.used;
+        table = from.table;
+
+        from.table = nullptr;
+
+        return *this;
+    }
+
+    // Destructor
+    virtual ~OpenAddressingHashTable() {
+        commonDelete();
+    }
+
+    V& get(const K& key) {
+
+        unsigned int index = findSlot(key);
+
+        if (index == hashTableSize) {
+            throw std::out_of_range("Tried to get entry that does not exist.");
+        }
+
+        return table[index].value();
+    }
+
+    bool contains(const K& key) {
+        return findSlot(key) != hashTableSize;
+    }
+
+    // Will delete any element that is already there and insert new one
+    void insert(const K& key, const V& value) {
+
+        unsigned int index = selectBucket(key);
+        unsigned int firstDeleted = hashTableSize;
+
+        // Probe until we either find the key or reach an empty slot. Remember the first
+        // tombstone along the way, since the key can be stored there if it is not found.
+        for (unsigned int probes = 0; probes < hashTableSize; probes++) {
+
+            Slot& slot = table[index];
+
+            if (slot.state == Slot::EMPTY) {
+                break;
+            } else if (slot.state == Slot::DELETED) {
+                if (firstDeleted == hashTableSize) {
+                    firstDeleted = index;
+                }
+            } else if (slot.key() == key) {
+                slot.value() = value;
+                return;
+            }
+
+            index = nextSlot(index);
+        }
+
+        if (firstDeleted != hashTableSize) {
+            // Reusing a tombstone does not change the load of the table
+            constructSlot(table[firstDeleted], key, value);
+            size++;
+            return;
+        }
+
+        float newLoadFactor = (used + 1.0) / hashTableSize;
+
+        if (newLoadFactor < maxLoadFactor) {
+            constructSlot(table[index], key, value);
+            size++;
+            used++;
+        } else {
+            rehash();
+            insert(key, value);
+        }
+    }
+
+    bool remove(const K& key) {
+
+        unsigned int index = findSlot(key);
+
+        if (index == hashTableSize) {
+            return false;
+        }
+
+        destroySlot(table[index]);
+        size--;
+
+        // If the slot after this one is empty no probe sequence continues through this slot,
+        // so it (and any tombstones right before it) can go back to being empty.
+        if (table[nextSlot(index)].state == Slot::EMPTY) {
+            while (table[index].state == Slot::DELETED) {
+                table[index].state = Slot::EMPTY;
+                used--;
+                index = previousSlot(index);
+            }
+        }
+
+        return true;
+    }
+
+ private:
+
+    unsigned int findSlot(const K& key) const {
+
+        unsigned int index = selectBucket(key);
+
+        for (unsigned int probes = 0; probes < hashTableSize; probes++) {
+
+            const Slot& slot = table[index];
+
+            if (slot.state == Slot::EMPTY) {
+                break;
+            } else if (slot.state == Slot::OCCUPIED && slot.key() == key) {
+                return index;
+            }
+
+            index = nextSlot(index);
+        }
+
+        return hashTableSize;
+    }
+
+    void constructSlot(Slot& slot, const K& key, const V& value) {
+        new (slot.keyStorage) K(key);
+        new (slot.valueStorage) V(value);
+        slot.state = Slot::OCCUPIED;
+    }
+
+    void destroySlot(Slot& slot) {
+        slot.key().~K();
+        slot.value().~V();
+        slot.state = Slot::DELETED;
+    }
+
+    void commonCopy(const OpenAddressingHashTable& from) {
+
+        // Both tables have the same size, so every entry can go to the same slot and all
+        // of the probe sequences stay intact. Tombstones do not need to be copied.
+        for (unsigned int i = 0; i < from.hashTableSize; i++) {
+            if (from.table[i].state == Slot::OCCUPIED) {
+                constructSlot(table[i], from.table[i].key(), from.table[i].value());
+            } else {
+                table[i].state = from.table[i].state;
+            }
+        }
+
+        size = from.size;
+        used = from.used;
+    }
+
+    void commonDelete(void) {
+
+        // If the object has been moved (via move constructor or move assignment
+        // operator) then there's no need to delete the memory here.
+        if (table == nullptr) {
+            return;
+        }
+
+        for (unsigned int i = 0; i < hashTableSize; i++) {
+            if (table[i].state == Slot::OCCUPIED) {
+                destroySlot(table[i]);
+            }
+        }
+
+        delete[] table;
+    }
+
+    /**
+     * Use the default hashing function, or the user-defined version, and let
+     * the size policy reduce the hash to a slot index.
+     */
+    unsigned int selectBucket(const K& k) const {
+        return sizing.index(HashOf<HashGenerator, K>::hash(k));
+    }
+
+    unsigned int nextSlot(unsigned int index) const {
+        return (index + 1 == hashTableSize) ? 0 : index + 1;
+    }
+
+    unsigned int previousSlot(unsigned int index) const {
+        return (index == 0) ? hashTableSize - 1 : index - 1;
+    }
+
+    void rehash(void) {
+
+        // Only grow the table when it is at least half full of live entries, otherwise the
+        // load is mostly tombstones and rebuilding at the same size is enough.
+        if (size * 2 >= used) {
+            sizing.grow();
+        }
+
+        Slot* oldTable = table;
+        unsigned int oldSize = hashTableSize;
+
+        hashTableSize = sizing.size();
+        table = new Slot[hashTableSize];
+        used = size;
+
+        // Move every live entry into the new table. There are no tombstones in the new table
+        // so the first empty slot found is always the right place.
+        for (unsigned int i = 0; i < oldSize; i++) {
+
+            if (oldTable[i].state != Slot::OCCUPIED) {
+                continue;
+            }
+
+            unsigned int index = selectBucket(oldTable[i].key());
+            while (table[index].state == Slot::OCCUPIED) {
+                index = nextSlot(index);
+            }
+
+            new (table[index].keyStorage) K(std::move(oldTable[i].key()));
+            new (table[index].valueStorage) V(std::move(oldTable[i].value()));
+            table[index].state = Slot::OCCUPIED;
+
+            oldTable[i].key().~K();
+            oldTable[i].value().~V();
+        }
+
+        delete[] oldTable;
+    }
+
+    const float maxLoadFactor;
+    SizePolicy sizing;
+    unsigned int hashTableSize;     // Same as sizing.size(), kept here for the probing loops
+    unsigned int size;
+    unsigned int used;              // Live entries plus tombstones
+    Slot* table;
+};
+
+} /* namespace homebrew */
+} /* namespace mjl */
+
+#endif /* OPENADDRESSINGHASHTABLE_H */
@@ -0,0 +1,597 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef PACKEDHASHTABLE_H
+#define PACKEDHASHTABLE_H
+
+#include "HashGenerator.h"
+#include "HashSizePolicy.h"
+
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include <stdlib.h>
+
+namespace mjl {
+namespace homebrew {
+
+// The value of an entry that has none, like the entries of a HashSet
+struct NoValue {
+};
+
+/**
+ * Keys small and plain enough to be stored in a bare array, copied byte for
+ * byte. Floating point numbers are not: the empty key, every bit set, is a
+ * NaN, which never compares equal to anything, itself included.
+ */
+template<typename K> struct IsPackedKey : std::integral_constant<bool,
+                std::is_trivially_copyable<K>::value && sizeof(K) <= 8 && !std::is_floating_point<K>::value> {
+};
+
+/**
+ * The key a PackedHashTable reserves to mark an empty slot: every bit set,
+ * which is -1 for signed numbers and the largest value for unsigned ones.
+ * Tables whose keys can take that value supply their own EmptyKey class with
+ * a static value() function instead.
+ */
+template<typename K> class DefaultEmptyKey {
+ public:
+    static K value(void) {
+        K key;
+        memset(&key, 0xff, sizeof(key));
+        return key;
+    }
+};
+
+// The value array of a PackedHashTable, which is raw memory since the values are trivially copyable
+template<typename V> class PackedValues {
+ public:
+    PackedValues(void)
+                    : values(nullptr) {
+    }
+
+    void allocate(unsigned int count) {
+        values = static_cast<V*>(malloc(count * sizeof(V)));
+        if (values == nullptr) {
+            throw std::bad_alloc();
+        }
+    }
+
+    void release(void) {
+        free(values);
+        values = nullptr;
+    }
+
+    void copy(const PackedValues& from, unsigned int count) {
+        memcpy(values, from.values, count * sizeof(V));
+    }
+
+    V& operator[](unsigned int index) {
+        return values[index];
+    }
+
+    const V& operator[](unsigned int index) const {
+        return values[index];
+    }
+
+    V* values;
+};
+
+// A set has no values, so it doesn't get an array of them either
+template<> class PackedValues<NoValue> {
+ public:
+    void allocate(unsigned int count) {
+    }
+
+    void release(void) {
+    }
+
+    void copy(const PackedValues& from, unsigned int count) {
+    }
+
+    NoValue& operator[](unsigned int index) {
+        return none;
+    }
+
+    const NoValue& operator[](unsigned int index) const {
+        return none;
+    }
+
+    NoValue none;
+};
+
+/**
+ * A linear probing hash table for small, trivially copyable keys and values,
+ * like a map from 32 bit ids to 32 bit values. Keys and values are stored in
+ * two parallel arrays, nothing else: one key value (see DefaultEmptyKey) is
+ * reserved to mark empty slots, so there are no per-entry flags, pointers or
+ * stored hashes, and no allocations besides the two arrays. An int to int
+ * entry takes 8 bytes per slot, where a HashTable bucket takes 24 and every
+ * collision allocates another.
+ *
+ * The empty key itself can't be inserted (insert throws
+ * std::invalid_argument), and is never found.
+ *
+ * Removing an entry moves later entries of the same run back into the gap
+ * (Knuth's algorithm R), so there are no tombstones.
+ *
+ * Iterating walks the key array from front to back. Any insert or remove
+ * invalidates the iterators.
+ */
+template<typename K, typename V, typename HashGenerator = DefaultHashGenerator<K>,
+                typename EmptyKey = DefaultEmptyKey<K>, typename SizePolicy = PrimeSizePolicy> class PackedHashTable {
+ public:
+    static_assert(IsPackedKey<K>::value,
+                    "PackedHashTable keys must be trivially copyable, at most 8 bytes and not floating point");
+    static_assert(std::is_trivially_copyable<V>::value, "PackedHashTable values must be trivially copyable");
+
+    // Default constructor, maxLoadFactor has to be above 0 and below 1 or it throws std::invalid_argument
+    explicit PackedHashTable(float theMaxLoadFactor = 0.75f)
+                    : maxLoadFactor(checkLoadFactor(theMaxLoadFactor)),
+                      sizing(),
+                      hashTableSize(sizing.size()),
+                      entryCount(0),
+                      emptyKey(EmptyKey::value()),
+                      keys(nullptr) {
+        allocateArrays(hashTableSize, keys, values);
+    }
+
+    // Copy constructor
+    PackedHashTable(const PackedHashTable& from)
+                    : maxLoadFactor(from.maxLoadFactor),
+                      sizing(from.sizing),
+                      hashTableSize(from.hashTableSize),
+                      entryCount(from.entryCount),
+                      emptyKey(from.emptyKey),
+                      keys(nullptr) {
+        allocateArrays(hashTableSize, keys, values);
+        commonCopy(from);
+    }
+
+    // Move constructor
+    PackedHashTable(PackedHashTable&& from) noexcept
+                    : maxLoadFactor(from.maxLoadFactor),
+                      sizing(from.sizing),
+                      hashTableSize(from.hashTableSize),
+                      entryCount(from.entryCount),
+                      emptyKey(from.emptyKey),
+                      keys(from.keys),
+                      values(from.values) {
+        from.keys = nullptr;
+        from.values = PackedValues<V>();
+    }
+
+    // Assignment operator
+    PackedHashTable& operator=(const PackedHashTable& from) {
+
+        if (this == &from) {
+            return *this;
+        }
+
+        // Allocate first, so the table is left as it was if that fails
+        K* newKeys = nullptr;
+        PackedValues<V> newValues;
+        allocateArrays(from.hashTableSize, newKeys, newValues);
+
+        commonDelete();
+        maxLoadFactor = from.maxLoadFactor;
+        sizing = from.sizing;
+        hashTableSize = from.hashTableSize;
+        entryCount = from.entryCount;
+        keys = newKeys;
+        values = newValues;
+        commonCopy(from);
+        return *this;
+    }
+
+    // Move assignment operator
+    PackedHashTable& operator=(PackedHashTable&& from) noexcept {
+
+        if (this == &from) {
+            return *this;
+        }
+
+        commonDelete();
+
+        maxLoadFactor = from.maxLoadFactor;
+        sizing = from.sizing;
+        hashTableSize = from.hashTableSize;
+        entryCount = from.entryCount;
+        keys = from.keys;
+        values = from.values;
+
+        from.keys = nullptr;
+        from.values = PackedValues<V>();
+
+        return *this;
+    }
+
+    // Destructor
+    virtual ~PackedHashTable() {
+        commonDelete();
+    }
+
+    /**
+     * Forward iterator over the entries. *it is a pair of references to the
+     * key and value, which are also available as it.key() and it.value().
+     */
+    template<bool IsConst> class Iterator {
+     public:
+        typedef typename std::conditional<IsConst, const PackedHashTable, PackedHashTable>::type Owner;
+        typedef typename std::conditional<IsConst, const V, V>::type Value;
+
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::pair<const K&, Value&> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef value_type reference;
+        typedef void pointer;
+
+        // The end iterator
+        Iterator(void)
+                        : owner(nullptr),
+                          index(0) {
+        }
+
+        // Iterators can be turned into const_iterators, but not the other way around
+        template<bool WasConst, typename = typename std::enable_if<IsConst && !WasConst>::type> Iterator(
+                        const Iterator<WasConst>& from)
+                        : owner(from.owner),
+                          index(from.index) {
+        }
+
+        const K& key(void) const {
+            return owner->keys[index];
+        }
+
+        Value& value(void) const {
+            return owner->values[index];
+        }
+
+        reference operator*(void) const {
+            return reference(key(), value());
+        }
+
+        Iterator& operator++(void) {
+            index++;
+            skipEmpty();
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator before(*this);
+            ++(*this);
+            return before;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return owner == other.owner && index == other.index;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+
+     private:
+        friend class PackedHashTable;
+        template<bool> friend class Iterator;
+
+        // The first entry of theOwner
+        explicit Iterator(Owner* theOwner)
+                        : owner(theOwner),
+                          index(0) {
+            skipEmpty();
+        }
+
+        // Move to the next occupied slot at or after index, or become the end iterator
+        void skipEmpty(void) {
+            for (; index < owner->hashTableSize; index++) {
+                if (!(owner->keys[index] == owner->emptyKey)) {
+                    return;
+                }
+            }
+            owner = nullptr;
+            index = 0;
+        }
+
+        Owner* owner;
+        unsigned int index;
+    };
+
+    typedef Iterator<false> iterator;
+    typedef Iterator<true> const_iterator;
+
+    iterator begin(void) {
+        return iterator(this);
+    }
+
+    iterator end(void) {
+        return iterator();
+    }
+
+    const_iterator begin(void) const {
+        return const_iterator(this);
+    }
+
+    const_iterator end(void) const {
+        return const_iterator();
+    }
+
+    const_iterator cbegin(void) const {
+        return const_iterator(this);
+    }
+
+    const_iterator cend(void) const {
+        return const_iterator();
+    }
+
+    V& get(const K& key) {
+
+        unsigned int index = findSlot(key);
+
+        if (index == hashTableSize) {
+            throw std::out_of_range("Tried to get entry that does not exist.");
+        }
+
+        return values[index];
+    }
+
+    bool contains(const K& key) const {
+        return findSlot(key) != hashTableSize;
+    }
+
+    // Will replace any value that is already there with the new one
+    void insert(const K& key, const V& value) {
+
+        unsigned int index = findSlot(key);
+
+        if (index != hashTableSize) {
+            values[index] = value;
+            return;
+        }
+
+        new (&values[insertNew(key)]) V(value);
+    }
+
+    /**
+     * Construct the value from valueArgs, but only if key is not in the table
+     * yet. Returns true if the value was inserted.
+     */
+    template<typename... ValueArgs> bool try_emplace(const K& key, ValueArgs&&... valueArgs) {
+
+        if (findSlot(key) != hashTableSize) {
+            return false;
+        }
+
+        new (&values[insertNew(key)]) V(std::forward<ValueArgs>(valueArgs)...);
+        return true;
+    }
+
+    bool remove(const K& key) {
+
+        unsigned int gap = findSlot(key);
+
+        if (gap == hashTableSize) {
+            return false;
+        }
+
+        keys[gap] = emptyKey;
+        entryCount--;
+
+        // Pull back every later entry of the run that would no longer be found past the gap, which
+        // is every one whose own slot does not lie (cyclically) in between the gap and where it is
+        for (unsigned int index = nextSlot(gap); !(keys[index] == emptyKey); index = nextSlot(index)) {
+
+            unsigned int home = selectBucket(keys[index]);
+            bool staysPut = (gap <= index) ? (gap < home && home <= index) : (gap < home || home <= index);
+
+            if (!staysPut) {
+                keys[gap] = keys[index];
+                values[gap] = values[index];
+                keys[index] = emptyKey;
+                gap = index;
+            }
+        }
+
+        return true;
+    }
+
+    unsigned int size(void) const {
+        return entryCount;
+    }
+
+    // Number of slots
+    unsigned int bucketCount(void) const {
+        return hashTableSize;
+    }
+
+    float loadFactor(void) const {
+        return (float) entryCount / hashTableSize;
+    }
+
+    // Grow the table, once, to a size that holds n entries without another rehash
+    void reserve(size_t n) {
+
+        SizePolicy target = sizing;
+        while ((double) n / target.size() >= maxLoadFactor) {
+            target.grow();
+        }
+
+        if (target.size() != hashTableSize) {
+            rehashTo(target);
+        }
+    }
+
+ private:
+
+    // The slot holding key, or hashTableSize if there is none
+    unsigned int findSlot(const K& key) const {
+
+        // The empty key would match every empty slot
+        if (key == emptyKey) {
+            return hashTableSize;
+        }
+
+        for (unsigned int index = selectBucket(key); !(keys[index] == emptyKey); index = nextSlot(index)) {
+            if (keys[index] == key) {
+                return index;
+            }
+        }
+
+        return hashTableSize;
+    }
+
+    // Store a key that is known not to be in the table yet, and return its slot for the value
+    unsigned int insertNew(const K& key) {
+
+        if (key == emptyKey) {
+            throw std::invalid_argument("Tried to insert the key reserved for empty slots.");
+        }
+
+        float newLoadFactor = (entryCount + 1.0) / hashTableSize;
+
+        if (newLoadFactor >= maxLoadFactor) {
+            SizePolicy larger = sizing;
+            larger.grow();
+            rehashTo(larger);
+        }
+
+        entryCount++;
+        return place(key);
+    }
+
+    // Put key in the first empty slot of its run
+    unsigned int place(const K& key) {
+
+        unsigned int index = selectBucket(key);
+
+        while (!(keys[index] == emptyKey)) {
+            index = nextSlot(index);
+        }
+
+        keys[index] = key;
+        return index;
+    }
+
+    // Allocate both arrays into newKeys and newValues, with every slot empty. If either fails, neither is kept.
+    void allocateArrays(unsigned int count, K*& newKeys, PackedValues<V>& newValues) const {
+
+        K* allocatedKeys = static_cast<K*>(malloc(count * sizeof(K)));
+        if (allocatedKeys == nullptr) {
+            throw std::bad_alloc();
+        }
+
+        for (unsigned int i = 0; i < count; i++) {
+            allocatedKeys[i] = emptyKey;
+        }
+
+        try {
+            newValues.allocate(count);
+        } catch (...) {
+            free(allocatedKeys);
+            throw;
+        }
+        newKeys = allocatedKeys;
+    }
+
+    void commonCopy(const PackedHashTable& from) {
+
+        // Both tables have the same size, so every entry can go to the same slot
+        memcpy(keys, from.keys, hashTableSize * sizeof(K));
+        values.copy(from.values, hashTableSize);
+    }
+
+    void commonDelete(void) {
+
+        // If the object has been moved (via move constructor or move assignment
+        // operator) then there's no need to delete the memory here.
+        if (keys == nullptr) {
+            return;
+        }
+
+        free(keys);
+        values.release();
+    }
+
+    /**
+     * Use the default hashing function, or the user-defined version, and let
+     * the size policy reduce the hash to a slot index.
+     */
+    unsigned int selectBucket(const K& k) const {
+        return sizing.index(HashOf<HashGenerator, K>::hash(k));
+    }
+
+    // A full table has no empty slot to end a probe, so it has to grow before it gets there
+    static float checkLoadFactor(float theMaxLoadFactor) {
+        if (!(theMaxLoadFactor > 0.0f && theMaxLoadFactor < 1.0f)) {
+            throw std::invalid_argument("A PackedHashTable's maximum load factor has to be above 0 and below 1.");
+        }
+        return theMaxLoadFactor;
+    }
+
+    unsigned int nextSlot(unsigned int index) const {
+        return (index + 1 == hashTableSize) ? 0 : index + 1;
+    }
+
+    void rehashTo(const SizePolicy& newSizing) {
+
+        // Allocate first, so the table is left as it was if that fails. Nothing after it can throw.
+        K* newKeys = nullptr;
+        PackedValues<V> newValues;
+        allocateArrays(newSizing.size(), newKeys, newValues);
+
+        K* oldKeys = keys;
+        PackedValues<V> oldValues = values;
+        unsigned int oldSize = hashTableSize;
+
+        keys = newKeys;
+        values = newValues;
+        sizing = newSizing;
+        hashTableSize = sizing.size();
+
+        // Every entry has to be placed all over again in the new table
+        for (unsigned int i = 0; i < oldSize; i++) {
+            if (!(oldKeys[i] == emptyKey)) {
+                new (&values[place(oldKeys[i])]) V(oldValues[i]);
+            }
+        }
+
+        free(oldKeys);
+        oldValues.release();
+    }
+
+    float maxLoadFactor;
+    SizePolicy sizing;
+    unsigned int hashTableSize;     // Same as sizing.size(), kept here for the probing loops
+    unsigned int entryCount;
+    K emptyKey;                     // EmptyKey::value(), kept here so it isn't rebuilt for every slot
+    K* keys;
+    PackedValues<V> values;
+};
+
+} /* namespace homebrew */
+} /* namespace mjl */
+
+#endif /* PACKEDHASHTABLE_H */
@@ -0,0 +1,328 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef PARALLELALGORITHMS_H
+#define PARALLELALGORITHMS_H
+
+#include "DynamicArray.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+namespace mjl {
+namespace homebrew {
+
+/*********************
+ * Table of contents *
+ *********************
+ *
+ * void parallelForEach(DynamicArray<T>& array, Function function, ThreadPool& pool, size_t grain)
+ * void parallelTransform(const DynamicArray<T>& input, DynamicArray<U>& output, Function function,
+ *                 ThreadPool& pool, size_t grain)
+ * Result parallelReduce(const DynamicArray<T>& array, Result initial, BinaryOperation operation,
+ *                 ThreadPool& pool, size_t grain)
+ * void parallelInclusiveScan(const DynamicArray<T>& input, DynamicArray<T>& output, BinaryOperation operation,
+ *                 ThreadPool& pool, size_t grain)
+ * void parallelSort(DynamicArray<T>& array, Compare less, ThreadPool& pool, size_t grain)
+ *
+ * Every algorithm runs on ThreadPool::instance() unless it is given a pool.
+ * The array is cut into chunks of grain elements, and each chunk is one task
+ * for the pool, so the grain trades how evenly the work spreads against how
+ * much each task costs to hand out. An array of no more than grain elements
+ * is handled on the calling thread. The operations given to reduce and scan
+ * have to be associative, since the chunks are combined in a different
+ * grouping than a left to right loop would use, but they are always combined
+ * in order, so they don't have to be commutative.
+ */
+
+const size_t DEFAULT_GRAIN_SIZE = 16384;
+
+// How many chunks of grain elements it takes to cover count elements
+inline size_t chunkCount(size_t count, size_t grain) {
+    if (grain == 0) {
+        throw std::invalid_argument("The grain size has to be at least one element.");
+    }
+    return (count + grain - 1) / grain;
+}
+
+// Call function(element) on every element
+template<typename T, typename GrowthPolicy, typename StoragePolicy, typename Function> void parallelForEach(
+                DynamicArray<T, GrowthPolicy, StoragePolicy>& array, Function function,
+                ThreadPool& pool = ThreadPool::instance(), size_t grain = DEFAULT_GRAIN_SIZE) {
+
+    T* elements = array.data();
+    size_t count = array.size();
+
+    pool.run(chunkCount(count, grain), [&](size_t chunk) {
+        size_t end = std::min(count, (chunk + 1) * grain);
+        for (size_t i = chunk * grain; i < end; i++) {
+            function(elements[i]);
+        }
+    });
+}
+
+/**
+ * Set output[i] to function(input[i]) for every element. The output has to
+ * hold as many elements as the input already; it may be the input itself.
+ */
+template<typename T, typename GrowthPolicy, typename StoragePolicy, typename U, typename OutputGrowthPolicy,
+                typename OutputStoragePolicy, typename Function>
+void parallelTransform(const DynamicArray<T, GrowthPolicy, StoragePolicy>& input,
+                DynamicArray<U, OutputGrowthPolicy, OutputStoragePolicy>& output, Function function,
+                ThreadPool& pool = ThreadPool::instance(), size_t grain = DEFAULT_GRAIN_SIZE) {
+
+    if (output.size() != input.size()) {
+        throw std::invalid_argument("parallelTransform needs an output array the same size as its input.");
+    }
+
+    const T* from = input.data();
+    U* to = output.data();
+    size_t count = input.size();
+
+    pool.run(chunkCount(count, grain), [&](size_t chunk) {
+        size_t end = std::min(count, (chunk + 1) * grain);
+        for (size_t i = chunk * grain; i < end; i++) {
+            to[i] = function(from[i]);
+        }
+    });
+}
+
+/**
+ * Combine initial and every element with operation, which is std::plus by
+ * default. Each chunk is combined on its own, starting from its first
+ * element converted to Result, and then the chunk results are combined in
+ * order onto initial. So operation is called both with an element and with
+ * another Result on its right; a wider Result, like unsigned long long for
+ * a sum of unsigned ints, keeps the total from overflowing.
+ */
+template<typename T, typename GrowthPolicy, typename StoragePolicy, typename Result,
+                typename BinaryOperation = std::plus<Result>>
+Result parallelReduce(const DynamicArray<T, GrowthPolicy, StoragePolicy>& array, Result initial,
+                BinaryOperation operation = BinaryOperation(), ThreadPool& pool = ThreadPool::instance(),
+                size_t grain = DEFAULT_GRAIN_SIZE) {
+
+    const T* elements = array.data();
+    size_t count = array.size();
+    size_t chunks = chunkCount(count, grain);
+
+    // Not a std::vector, which for bool packs neighbouring chunks' results into one word the threads race on
+    DynamicArray<Result> partials;
+    partials.reserve((unsigned int) chunks);
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+        partials.push_back(Result(elements[chunk * grain]));
+    }
+
+    pool.run(chunks, [&](size_t chunk) {
+        size_t end = std::min(count, (chunk + 1) * grain);
+        Result partial = partials[chunk];
+        for (size_t i = chunk * grain + 1; i < end; i++) {
+            partial = operation(partial, elements[i]);
+        }
+        partials[chunk] = partial;
+    });
+
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+        initial = operation(initial, partials[chunk]);
+    }
+    return initial;
+}
+
+/**
+ * Set output[i] to input[0] combined with every element up to and including
+ * input[i], with operation (std::plus by default). The output has to hold as
+ * many elements as the input already; it may be the input itself.
+ *
+ * It takes two passes: the first reduces every chunk on its own, then the
+ * chunk totals are scanned on the calling thread, and the second pass scans
+ * each chunk starting from the total of the chunks before it.
+ */
+template<typename T, typename GrowthPolicy, typename StoragePolicy, typename OutputGrowthPolicy,
+                typename OutputStoragePolicy, typename BinaryOperation = std::plus<T>>
+void parallelInclusiveScan(const DynamicArray<T, GrowthPolicy, StoragePolicy>& input,
+                DynamicArray<T, OutputGrowthPolicy, OutputStoragePolicy>& output,
+                BinaryOperation operation = BinaryOperation(), ThreadPool& pool = ThreadPool::instance(),
+                size_t grain = DEFAULT_GRAIN_SIZE) {
+
+    if (output.size() != input.size()) {
+        throw std::invalid_argument("parallelInclusiveScan needs an output array the same size as its input.");
+    }
+
+    const T* from = input.data();
+    T* to = output.data();
+    size_t count = input.size();
+    size_t chunks = chunkCount(count, grain);
+
+    if (chunks <= 1) {
+        for (size_t i = 0; i < count; i++) {
+            to[i] = (i == 0) ? from[0] : operation(to[i - 1], from[i]);
+        }
+        return;
+    }
+
+    // The last chunk's total is never needed, so it isn't computed. Not a std::vector, as in parallelReduce.
+    DynamicArray<T> totals;
+    totals.reserve((unsigned int) (chunks - 1));
+    for (size_t chunk = 0; chunk + 1 < chunks; chunk++) {
+        totals.push_back(from[chunk * grain]);
+    }
+
+    pool.run(chunks - 1, [&](size_t chunk) {
+        size_t end = (chunk + 1) * grain;
+        T total = totals[chunk];
+        for (size_t i = chunk * grain + 1; i < end; i++) {
+            total = operation(total, from[i]);
+        }
+        totals[chunk] = total;
+    });
+
+    for (size_t chunk = 1; chunk + 1 < chunks; chunk++) {
+        totals[chunk] = operation(totals[chunk - 1], totals[chunk]);
+    }
+
+    pool.run(chunks, [&](size_t chunk) {
+        size_t start = chunk * grain;
+        size_t end = std::min(count, start + grain);
+        T running = (chunk == 0) ? from[start] : operation(totals[chunk - 1], from[start]);
+        to[start] = running;
+        for (size_t i = start + 1; i < end; i++) {
+            running = operation(running, from[i]);
+            to[i] = running;
+        }
+    });
+}
+
+/**
+ * Merge the sorted runs [from + starts[r], from + starts[r + 1]) in pairs
+ * into to, so that to holds half as many sorted runs, and update starts to
+ * match. A lone last run is moved over as it is.
+ *
+ * Each pair is cut into pieces that merge on their own: the left run is cut
+ * evenly, and the right run is cut where the first element of each left
+ * piece would go. Everything in a piece is then no greater than everything
+ * in the pieces after it, so the pieces can be merged side by side, and the
+ * last rounds, with only a pair or two of runs left, still use every thread.
+ */
+template<typename T, typename Compare> void mergeRunsInParallel(T* from, T* to, std::vector<size_t>& starts,
+                Compare& less, ThreadPool& pool, size_t grain) {
+
+    struct Piece {
+        size_t leftStart, leftEnd, rightStart, rightEnd;
+        size_t out;
+    };
+
+    std::vector<Piece> pieces;
+    std::vector<size_t> mergedStarts;
+
+    size_t runs = starts.size() - 1;
+    for (size_t run = 0; run < runs; run += 2) {
+        size_t left = starts[run];
+        size_t middle = starts[run + 1];
+        size_t right = (run + 1 < runs) ? starts[run + 2] : middle;
+        size_t cuts = std::min(chunkCount(right - left, grain), (size_t) pool.threadCount());
+
+        mergedStarts.push_back(left);
+
+        size_t leftStart = left;
+        size_t rightStart = middle;
+        for (size_t cut = 1; cut <= cuts; cut++) {
+            size_t leftEnd = middle;
+            size_t rightEnd = right;
+            if (cut < cuts) {
+                leftEnd = left + (middle - left) * cut / cuts;
+                rightEnd = std::lower_bound(from + rightStart, from + right, from[leftEnd], less) - from;
+            }
+            pieces.push_back(Piece { leftStart, leftEnd, rightStart, rightEnd, leftStart + (rightStart - middle) });
+            leftStart = leftEnd;
+            rightStart = rightEnd;
+        }
+    }
+    mergedStarts.push_back(starts.back());
+
+    pool.run(pieces.size(), [&](size_t i) {
+        const Piece& piece = pieces[i];
+        std::merge(std::make_move_iterator(from + piece.leftStart), std::make_move_iterator(from + piece.leftEnd),
+                        std::make_move_iterator(from + piece.rightStart),
+                        std::make_move_iterator(from + piece.rightEnd), to + piece.out, less);
+    });
+
+    starts.swap(mergedStarts);
+}
+
+/**
+ * Sort the array with less (std::less by default). The array is cut into
+ * one run per thread (or fewer, so that no run is shorter than the grain),
+ * every run is sorted with std::sort at the same time, and then the runs
+ * are merged in pairs, in parallel, until one is left. Merging goes back and
+ * forth between the array and a buffer of the same size, so the elements
+ * have to be move constructible and move assignable. Like std::sort, the
+ * order of equal elements isn't kept.
+ */
+template<typename T, typename GrowthPolicy, typename StoragePolicy, typename Compare = std::less<T>> void parallelSort(
+                DynamicArray<T, GrowthPolicy, StoragePolicy>& array, Compare less = Compare(),
+                ThreadPool& pool = ThreadPool::instance(), size_t grain = DEFAULT_GRAIN_SIZE) {
+
+    T* elements = array.data();
+    size_t count = array.size();
+    size_t runs = std::min(chunkCount(count, grain), (size_t) pool.threadCount());
+
+    if (runs <= 1) {
+        std::sort(elements, elements + count, less);
+        return;
+    }
+
+    std::vector<size_t> starts;
+    for (size_t run = 0; run <= runs; run++) {
+        starts.push_back(count * run / runs);
+    }
+
+    pool.run(runs, [&](size_t run) {
+        std::sort(elements + starts[run], elements + starts[run + 1], less);
+    });
+
+    // A DynamicArray has data() for every T, where std::vector<bool> has none
+    DynamicArray<T> buffer;
+    buffer.append(std::make_move_iterator(elements), std::make_move_iterator(elements + count));
+    T* from = buffer.data();
+    T* to = elements;
+
+    while (starts.size() > 2) {
+        mergeRunsInParallel(from, to, starts, less, pool, grain);
+        std::swap(from, to);
+    }
+
+    // After an even number of rounds the sorted elements are in the buffer
+    if (from != elements) {
+        pool.run(chunkCount(count, grain), [&](size_t chunk) {
+            size_t end = std::min(count, (chunk + 1) * grain);
+            std::move(from + chunk * grain, from + end, elements + chunk * grain);
+        });
+    }
+}
+
+} /* namespace homebrew */
+} /* namespace mjl */
+
+#endif /* PARALLELALGORITHMS_H */
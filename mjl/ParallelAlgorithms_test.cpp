@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "ParallelAlgorithms.h"
+#include "ParallelAlgorithms_test.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+
+using namespace std;
+using namespace mjl::homebrew;
+
+static DynamicArray<int> randomArray(unsigned int count) {
+    DynamicArray<int> array;
+    for (unsigned int i = 0; i < count; i++) {
+        array.push_back(rand() % 1000 - 500);
+    }
+    return array;
+}
+
+static bool testThreadPool(void) {
+
+    cout << "Testing ThreadPool runs every task once, nested batches and exceptions\n";
+
+    ThreadPool pool(4);
+    if (pool.threadCount() != 4 || ThreadPool(1).threadCount() != 1) {
+        cerr << "ThreadPool(4) has " << pool.threadCount() << " threads.\n";
+        return false;
+    }
+
+    vector<atomic<int>> runs(1000);
+    for (atomic<int>& count : runs) {
+        count.store(0);
+    }
+    pool.run(runs.size(), [&](size_t i) {
+        runs[i]++;
+    });
+    for (size_t i = 0; i < runs.size(); i++) {
+        if (runs[i].load() != 1) {
+            cerr << "Task " << i << " ran " << runs[i].load() << " times.\n";
+            return false;
+        }
+    }
+
+    // Every task starts a batch of its own on the same pool, which mustn't wait on the workers it is tying up
+    atomic<int> innerRuns(0);
+    pool.run(16, [&](size_t) {
+        pool.run(16, [&](size_t) {
+            innerRuns++;
+        });
+    });
+    if (innerRuns.load() != 256) {
+        cerr << "Nested batches ran " << innerRuns.load() << " tasks, expected 256.\n";
+        return false;
+    }
+
+    bool threw = false;
+    try {
+        pool.run(100, [](size_t i) {
+            if (i == 37) {
+                throw runtime_error("task 37");
+            }
+        });
+    } catch (runtime_error& e) {
+        threw = (string(e.what()) == "task 37");
+    }
+    if (!threw) {
+        cerr << "An exception thrown by a task should come out of run().\n";
+        return false;
+    }
+
+    atomic<int> afterwards(0);
+    pool.run(10, [&](size_t) {
+        afterwards++;
+    });
+    if (afterwards.load() != 10) {
+        cerr << "The pool should keep working after a task threw.\n";
+        return false;
+    }
+
+    try {
+        ThreadPool empty(0);
+        cerr << "A ThreadPool with no threads should not be constructible.\n";
+        return false;
+    } catch (invalid_argument&) {
+    }
+
+    return true;
+}
+
+// Runs every algorithm over arrays of several sizes, cut into chunks of several grain sizes, on the given pool
+static bool testAlgorithms(ThreadPool& pool) {
+
+    cout << "Testing parallel algorithms with " << pool.threadCount() << " threads\n";
+
+    const unsigned int sizes[] = { 0, 1, 2, 5, 100, 1000, 100003 };
+    const size_t grains[] = { 1, 7, 1000, DEFAULT_GRAIN_SIZE };
+
+    for (unsigned int size : sizes) {
+        for (size_t grain : grains) {
+            DynamicArray<int> array = randomArray(size);
+            vector<int> expected(array.begin(), array.end());
+
+            sort(expected.begin(), expected.end());
+            parallelSort(array, less<int>(), pool, grain);
+            if (!equal(expected.begin(), expected.end(), array.begin())) {
+                cerr << "parallelSort of " << size << " elements with grain " << grain << " is out of order.\n";
+                return false;
+            }
+
+            shuffle(expected.begin(), expected.end(), default_random_engine(size));
+            DynamicArray<int> shuffled;
+            for (int value : expected) {
+                shuffled.push_back(value);
+            }
+            parallelSort(shuffled, greater<int>(), pool, grain);
+            if (!is_sorted(shuffled.begin(), shuffled.end(), greater<int>()) || shuffled.size() != size) {
+                cerr << "parallelSort with greater<int> didn't sort " << size << " elements in descending order.\n";
+                return false;
+            }
+
+            long long sum = 0;
+            for (int value : expected) {
+                sum += value;
+            }
+            if (parallelReduce(array, 1000, plus<int>(), pool, grain) != sum + 1000) {
+                cerr << "parallelReduce of " << size << " elements with grain " << grain << " has the wrong sum.\n";
+                return false;
+            }
+
+            DynamicArray<long long> doubled(size, 0);
+            parallelTransform(array, doubled, [](int value) {
+                return 2 * (long long) value;
+            }, pool, grain);
+            DynamicArray<int> scanned(array);
+            parallelInclusiveScan(scanned, scanned, plus<int>(), pool, grain);
+            long long running = 0;
+            for (unsigned int i = 0; i < size; i++) {
+                running += array[i];
+                if (doubled[i] != 2 * (long long) array[i] || scanned[i] != running) {
+                    cerr << "Element " << i << " of " << size << " with grain " << grain
+                                    << " was transformed or scanned wrong.\n";
+                    return false;
+                }
+            }
+
+            DynamicArray<int> before(array);
+            parallelForEach(array, [](int& value) {
+                value = -value;
+            }, pool, grain);
+            for (unsigned int i = 0; i < size; i++) {
+                if (array[i] != -before[i]) {
+                    cerr << "parallelForEach didn't visit each of " << size << " elements exactly once.\n";
+                    return false;
+                }
+            }
+        }
+    }
+
+    // Concatenation is associative but not commutative, so the chunks have to be combined in order
+    DynamicArray<string> letters;
+    string alphabet;
+    for (unsigned int i = 0; i < 1000; i++) {
+        letters.push_back(string(1, 'a' + i % 26));
+        alphabet += letters[i];
+    }
+    if (parallelReduce(letters, string(">"), plus<string>(), pool, 7) != ">" + alphabet) {
+        cerr << "parallelReduce combined the chunks out of order.\n";
+        return false;
+    }
+    DynamicArray<string> prefixes(letters.size(), string());
+    parallelInclusiveScan(letters, prefixes, plus<string>(), pool, 7);
+    if (prefixes[999] != alphabet || prefixes[500] != alphabet.substr(0, 501)) {
+        cerr << "parallelInclusiveScan combined the chunks out of order.\n";
+        return false;
+    }
+
+    // Strings are sorted by moving them through the merge buffer, so each one has to come out exactly once
+    DynamicArray<string> words;
+    for (unsigned int i = 0; i < 5000; i++) {
+        words.push_back(to_string(rand()));
+    }
+    vector<string> sortedWords(words.begin(), words.end());
+    sort(sortedWords.begin(), sortedWords.end());
+    parallelSort(words, less<string>(), pool, 100);
+    if (!equal(sortedWords.begin(), sortedWords.end(), words.begin())) {
+        cerr << "parallelSort of strings lost or duplicated elements.\n";
+        return false;
+    }
+
+    // Every chunk's result gets a slot of its own; bools packed into shared words would race
+    DynamicArray<bool> flags(20000, false);
+    flags[12345] = true;
+    DynamicArray<bool> anySoFar(flags.size(), false);
+    parallelInclusiveScan(flags, anySoFar, logical_or<bool>(), pool, 1);
+    if (parallelReduce(flags, false, logical_or<bool>(), pool, 1) != true
+                    || parallelReduce(flags, true, logical_and<bool>(), pool, 1) != false
+                    || anySoFar[12344] || !anySoFar[12345] || !anySoFar[19999]) {
+        cerr << "parallelReduce or parallelInclusiveScan of bools is wrong.\n";
+        return false;
+    }
+    for (unsigned int i = 0; i < flags.size(); i++) {
+        flags[i] = (i % 3 == 0);
+    }
+    parallelSort(flags, less<bool>(), pool, 100);
+    if (!is_sorted(flags.begin(), flags.end()) || flags[13332] || !flags[13333]) {
+        cerr << "parallelSort of bools is wrong.\n";
+        return false;
+    }
+
+    try {
+        DynamicArray<int> tooSmall(3, 0);
+        parallelTransform(letters, tooSmall, [](const string& letter) {
+            return (int) letter.size();
+        }, pool);
+        cerr << "parallelTransform should refuse an output of a different size.\n";
+        return false;
+    } catch (invalid_argument&) {
+    }
+
+    return true;
+}
+
+bool runParallelAlgorithmsTests(void) {
+
+    srand(4321);
+
+    if (!testThreadPool()) {
+        return false;
+    }
+
+    ThreadPool single(1);
+    if (!testAlgorithms(single)) {
+        return false;
+    }
+
+    ThreadPool several(4);
+    if (!testAlgorithms(several)) {
+        return false;
+    }
+
+    // The shared pool, with the default arguments
+    DynamicArray<int> array = randomArray(50000);
+    parallelSort(array);
+    int sum = accumulate(array.begin(), array.end(), 0);
+    if (!is_sorted(array.begin(), array.end()) || parallelReduce(array, 0) != sum) {
+        cerr << "The algorithms on ThreadPool::instance() gave the wrong results.\n";
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef POOLALLOCATOR_H
+#define POOLALLOCATOR_H
+
+#include <new>
+#include <utility>
+
+#include <stddef.h>
+
+namespace mjl {
+namespace homebrew {
+
+/*********************
+ * Table of contents *
+ *********************
+ *
+ * An allocator creates and destroys the small objects a data structure is
+ * made of (list nodes, keys, values). Every allocator has the same interface:
+ *
+ *     T* create<T>(args...)            Allocate and construct a T
+ *     void destroy(T* object)          Destruct and free a T
+ *     void releaseAll(void)            Free everything at once, without destructing
+ *     static const bool RELEASES_IN_BULK  Whether releaseAll does anything
+ *
+ * NewDeleteAllocator   Every object is its own new / delete
+ * PoolAllocator        Objects are carved out of large slabs
+ */
+
+class NewDeleteAllocator {
+ public:
+    static const bool RELEASES_IN_BULK = false;
+
+    template<typename T, typename ... Args> T* create(Args&&... args) {
+        return new T(std::forward<Args>(args)...);
+    }
+
+    template<typename T> void destroy(T* object) {
+        delete object;
+    }
+
+    void releaseAll(void) {
+    }
+};
+
+/**
+ * Carves small objects out of large slabs instead of calling malloc for each
+ * one. Objects are grouped by size, rounded up to a multiple of 8 bytes, and
+ * every size has its own list of freed objects which are reused before any new
+ * memory is carved off a slab. Objects of more than MAX_POOLED_SIZE bytes, or
+ * that need more than 8 byte alignment, are simply new'd and deleted.
+ *
+ * Nothing is returned to the system until the allocator is destroyed or
+ * releaseAll is called, which frees every slab in one go. Objects that were
+ * still alive are not destructed by releaseAll, so it is only the right thing
+ * to do after destroying them, or for trivially destructible objects.
+ *
+ * An allocator is not shared, each data structure owns its own. It can be
+ * moved, along with everything it has allocated, but not copied.
+ */
+class PoolAllocator {
+ public:
+    static const bool RELEASES_IN_BULK = true;
+
+    PoolAllocator()
+                    : slabs(nullptr),
+                      slabNext(nullptr),
+                      slabEnd(nullptr),
+                      freeLists { } {
+    }
+
+    PoolAllocator(const PoolAllocator& from) = delete;
+    PoolAllocator& operator=(const PoolAllocator& from) = delete;
+
+    PoolAllocator(PoolAllocator&& from) noexcept
+                    : slabs(nullptr),
+                      slabNext(nullptr),
+                      slabEnd(nullptr),
+                      freeLists { } {
+        takeFrom(from);
+    }
+
+    PoolAllocator& operator=(PoolAllocator&& from) noexcept {
+        if (this != &from) {
+            releaseAll();
+            takeFrom(from);
+        }
+        return *this;
+    }
+
+    virtual ~PoolAllocator() {
+        releaseAll();
+    }
+
+    template<typename T, typename ... Args> T* create(Args&&... args) {
+        void* memory = allocate(sizeof(T), alignof(T));
+        try {
+            return new (memory) T(std::forward<Args>(args)...);
+        } catch (...) {
+            deallocate(memory, sizeof(T), alignof(T));
+            throw;
+        }
+    }
+
+    template<typename T> void destroy(T* object) {
+        object->~T();
+        deallocate(object, sizeof(T), alignof(T));
+    }
+
+    void releaseAll(void) {
+        while (slabs != nullptr) {
+            Slab* next = slabs->next;
+            ::operator delete(slabs);
+            slabs = next;
+        }
+
+        slabNext = nullptr;
+        slabEnd = nullptr;
+        for (unsigned int i = 0; i < SIZE_CLASSES; i++) {
+            freeLists[i] = nullptr;
+        }
+    }
+
+ private:
+
+    static const size_t GRANULARITY = 8;
+    static const size_t MAX_POOLED_SIZE = 256;
+    static const size_t SIZE_CLASSES = MAX_POOLED_SIZE / GRANULARITY;
+    static const size_t SLAB_SIZE = 64 * 1024;
+
+    // A freed object, linked into the free list of its size
+    struct FreeObject {
+        FreeObject* next;
+    };
+
+    // Slabs are linked together through a header at their start
+    struct Slab {
+        Slab* next;
+        double alignment;       // Keeps the first object after the header 8 byte aligned
+    };
+
+    static bool isPooled(size_t size, size_t alignment) {
+        return size <= MAX_POOLED_SIZE && alignment <= GRANULARITY;
+    }
+
+    static unsigned int sizeClass(size_t size) {
+        return (unsigned int) ((size + GRANULARITY - 1) / GRANULARITY - 1);
+    }
+
+    void* allocate(size_t size, size_t alignment) {
+
+        if (!isPooled(size, alignment)) {
+            return ::operator new(size);
+        }
+
+        unsigned int index = sizeClass(size);
+        size_t roundedSize = (index + 1) * GRANULARITY;
+
+        // Reuse a freed object of the same size if there is one
+        if (freeLists[index] != nullptr) {
+            FreeObject* object = freeLists[index];
+            freeLists[index] = object->next;
+            return object;
+        }
+
+        // Otherwise carve a new one off the current slab, starting a new slab if it is full
+        if (slabNext == nullptr || (size_t) (slabEnd - slabNext) < roundedSize) {
+            Slab* slab = static_cast<Slab*>(::operator new(SLAB_SIZE));
+            slab->next = slabs;
+            slabs = slab;
+            slabNext = reinterpret_cast<char*>(slab) + sizeof(Slab);
+            slabEnd = reinterpret_cast<char*>(slab) + SLAB_SIZE;
+        }
+
+        void* object = slabNext;
+        slabNext += roundedSize;
+        return object;
+    }
+
+    void deallocate(void* memory, size_t size, size_t alignment) {
+
+        if (!isPooled(size, alignment)) {
+            ::operator delete(memory);
+            return;
+        }
+
+        unsigned int index = sizeClass(size);
+        FreeObject* object = static_cast<FreeObject*>(memory);
+        object->next = freeLists[index];
+        freeLists[index] = object;
+    }
+
+    void takeFrom(PoolAllocator& from) {
+        slabs = from.slabs;
+        slabNext = from.slabNext;
+        slabEnd = from.slabEnd;
+        for (unsigned int i = 0; i < SIZE_CLASSES; i++) {
+            freeLists[i] = from.freeLists[i];
+            from.freeLists[i] = nullptr;
+        }
+        from.slabs = nullptr;
+        from.slabNext = nullptr;
+        from.slabEnd = nullptr;
+    }
+
+    Slab* slabs;
+    char* slabNext;             // Next unused byte of the newest slab
+    char* slabEnd;
+    FreeObject* freeLists[SIZE_CLASSES];
+};
+
+} /* namespace homebrew */
+} /* namespace mjl */
+
+#endif /* POOLALLOCATOR_H */
@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef RCUHASHTABLE_H
+#define RCUHASHTABLE_H
+
+#include "EpochReclamation.h"
+#include "HashGenerator.h"
+#include "HashSizePolicy.h"
+
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+
+namespace mjl {
+namespace homebrew {
+
+/**
+ * A hash table for read mostly data that is shared between threads (in the
+ * style of RCU, read-copy-update). Readers never take a lock and never write
+ * to the table; they follow atomically published pointers, and only announce
+ * themselves to the EpochDomain so that nothing they may be looking at is
+ * deleted under them.
+ *
+ * Writers take a mutex, so there is only ever one at a time, and never change
+ * anything a reader may be looking at in a way the reader can notice:
+ *
+ *     - insert of a new key links a fully built node in at the front of a list
+ *     - insert of an existing key swaps in a pointer to a new value
+ *     - remove unlinks the node; readers already on it can still walk past it
+ *     - rehash builds a complete new table and publishes it in one store
+ *
+ * Whatever was unlinked or replaced is retired to the EpochDomain, and deleted
+ * once no reader can still see it.
+ */
+template<typename K, typename V, typename HashGenerator = DefaultHashGenerator<K>,
+                typename SizePolicy = PrimeSizePolicy> class RcuHashTable {
+ public:
+
+    RcuHashTable()
+                    : maxLoadFactor(1.0f),
+                      size(0),
+                      table(new Table(SizePolicy())) {
+    }
+
+    // Readers may hold on to the table at any moment, so it is neither copied nor moved
+    RcuHashTable(const RcuHashTable& from) = delete;
+    RcuHashTable& operator=(const RcuHashTable& from) = delete;
+
+    // Nobody may be reading a table that is being destroyed
+    virtual ~RcuHashTable() {
+        Table* current = table.load();
+        for (unsigned int i = 0; i < current->sizing.size(); i++) {
+            Node* node = current->buckets[i].load();
+            while (node != nullptr) {
+                Node* next = node->next.load();
+                deleteNodeAndValue(node);
+                node = next;
+            }
+        }
+        delete current;
+    }
+
+    V get(const K& key) const {
+        EpochGuard guard;
+        Node* node = findNode(key, HashOf<HashGenerator, K>::hash(key));
+
+        if (node == nullptr) {
+            throw std::out_of_range("Tried to get entry that does not exist.");
+        }
+
+        return *node->value.load(std::memory_order_seq_cst);
+    }
+
+    bool contains(const K& key) const {
+        EpochGuard guard;
+        return findNode(key, HashOf<HashGenerator, K>::hash(key)) != nullptr;
+    }
+
+    // Will delete any element that is already there and insert new one
+    void insert(const K& key, const V& value) {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        size_t hash = HashOf<HashGenerator, K>::hash(key);
+        Node* node = findNode(key, hash);
+
+        if (node != nullptr) {
+            V* oldValue = node->value.exchange(new V(value), std::memory_order_seq_cst);
+            EpochDomain::instance().retire(oldValue, deleteValue);
+            return;
+        }
+
+        if ((size + 1.0) / table.load()->sizing.size() > maxLoadFactor) {
+            rehash();
+        }
+
+        Table* current = table.load(std::memory_order_relaxed);
+        std::atomic<Node*>& first = current->buckets[current->sizing.index(hash)];
+        first.store(new Node(key, hash, new V(value), first.load(std::memory_order_relaxed)),
+                    std::memory_order_seq_cst);
+        size++;
+    }
+
+    bool remove(const K& key) {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        size_t hash = HashOf<HashGenerator, K>::hash(key);
+        Table* current = table.load(std::memory_order_relaxed);
+        std::atomic<Node*>* link = &current->buckets[current->sizing.index(hash)];
+
+        for (Node* node = link->load(); node != nullptr; node = link->load()) {
+            if (node->hash == hash && node->key == key) {
+                // Readers already on this node still see its next pointer, so they can walk on
+                link->store(node->next.load(std::memory_order_relaxed), std::memory_order_seq_cst);
+                EpochDomain::instance().retire(node, deleteNodeAndValue);
+                size--;
+                return true;
+            }
+            link = &node->next;
+        }
+
+        return false;
+    }
+
+ private:
+
+    struct Node {
+        Node(const K& theKey, size_t theHash, V* theValue, Node* theNext)
+                        : key(theKey),
+                          hash(theHash),
+                          value(theValue),
+                          next(theNext) {
+        }
+        const K key;
+        const size_t hash;
+        std::atomic<V*> value;
+        std::atomic<Node*> next;
+    };
+
+    struct Table {
+        explicit Table(const SizePolicy& theSizing)
+                        : sizing(theSizing),
+                          buckets(new std::atomic<Node*>[theSizing.size()]) {
+            for (unsigned int i = 0; i < sizing.size(); i++) {
+                buckets[i].store(nullptr, std::memory_order_relaxed);
+            }
+        }
+        ~Table() {
+            delete[] buckets;
+        }
+        SizePolicy sizing;
+        std::atomic<Node*>* buckets;
+    };
+
+    static void deleteValue(void* value) {
+        delete static_cast<V*>(value);
+    }
+
+    static void deleteNodeAndValue(void* node) {
+        delete static_cast<Node*>(node)->value.load();
+        delete static_cast<Node*>(node);
+    }
+
+    // The nodes of a replaced table, but not their values, which the new table took over
+    static void deleteTableAndNodes(void* theTable) {
+        Table* oldTable = static_cast<Table*>(theTable);
+        for (unsigned int i = 0; i < oldTable->sizing.size(); i++) {
+            Node* node = oldTable->buckets[i].load();
+            while (node != nullptr) {
+                Node* next = node->next.load();
+                delete node;
+                node = next;
+            }
+        }
+        delete oldTable;
+    }
+
+    Node* findNode(const K& key, size_t hash) const {
+        Table* current = table.load(std::memory_order_seq_cst);
+        Node* node = current->buckets[current->sizing.index(hash)].load(std::memory_order_seq_cst);
+
+        while (node != nullptr) {
+            // The cached hash rejects most mismatches without comparing keys
+            if (node->hash == hash && node->key == key) {
+                return node;
+            }
+            node = node->next.load(std::memory_order_seq_cst);
+        }
+
+        return nullptr;
+    }
+
+    /**
+     * Nodes in the current table cannot be relinked, readers may be walking
+     * them. Instead build a larger table out of new nodes (which take over
+     * the values), publish it, and retire the old table and its nodes.
+     */
+    void rehash(void) {
+        Table* oldTable = table.load(std::memory_order_relaxed);
+        SizePolicy newSizing = oldTable->sizing;
+        newSizing.grow();
+        Table* newTable = new Table(newSizing);
+
+        for (unsigned int i = 0; i < oldTable->sizing.size(); i++) {
+            for (Node* node = oldTable->buckets[i].load(); node != nullptr; node = node->next.load()) {
+                std::atomic<Node*>& first = newTable->buckets[newSizing.index(node->hash)];
+                first.store(new Node(node->key, node->hash, node->value.load(), first.load(std::memory_order_relaxed)),
+                            std::memory_order_relaxed);
+            }
+        }
+
+        table.store(newTable, std::memory_order_seq_cst);
+
+        // One retire for the whole old table, however many nodes it has, keeps the retired list short
+        EpochDomain::instance().retire(oldTable, deleteTableAndNodes);
+    }
+
+    const float maxLoadFactor;
+    unsigned int size;              // Only touched by writers
+    std::mutex writerMutex;
+    std::atomic<Table*> table;
+};
+
+} /* namespace homebrew */
+} /* namespace mjl */
+
+#endif /* RCUHASHTABLE_H */
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "RcuHashTable.h"
+#include "RcuHashTable_test.h"
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace mjl::homebrew;
+
+static const int READER_COUNT = 4;
+static const int STABLE_KEYS = 1000;
+static const int CHURN_KEYS = 20000;
+
+/**
+ * Readers run lock free lookups while a writer inserts, overwrites and removes
+ * keys, and grows the table through many rehashes. Build with
+ * "make tsan" to run this under ThreadSanitizer.
+ *
+ * Keys below STABLE_KEYS are never removed and their value always encodes the
+ * key, so a reader must always find them with a matching value. Other keys
+ * come and go, but whenever a reader finds one its value must match too.
+ */
+bool runRcuHashTableTests(void) {
+    RcuHashTable<int, int> table;
+    atomic<bool> writerDone(false);
+    atomic<int> errors(0);
+    vector<thread> readers;
+
+    for (int key = 0; key < STABLE_KEYS; key++) {
+        table.insert(key, key * 10);
+    }
+
+    cout << "Reading from " << READER_COUNT << " threads while one thread writes.\n";
+    for (int t = 0; t < READER_COUNT; t++) {
+        readers.push_back(thread([&table, &writerDone, &errors, t]() {
+            unsigned int random = t + 1;
+            while (!writerDone) {
+                random = random * 1103515245 + 12345;
+                int key = (int) ((random >> 8) % (STABLE_KEYS + CHURN_KEYS));
+                try {
+                    int value = table.get(key);
+                    if (value / 10 != key) {
+                        errors++;
+                    }
+                } catch (std::out_of_range&) {
+                    if (key < STABLE_KEYS) {
+                        errors++;
+                    }
+                }
+            }
+        }));
+    }
+
+    for (int round = 0; round < 3; round++) {
+        for (int key = STABLE_KEYS; key < STABLE_KEYS + CHURN_KEYS; key++) {
+            table.insert(key, key * 10);
+        }
+        for (int key = 0; key < STABLE_KEYS + CHURN_KEYS; key += 3) {
+            table.insert(key, key * 10 + round);
+        }
+        for (int key = STABLE_KEYS; key < STABLE_KEYS + CHURN_KEYS; key += 2) {
+            table.remove(key);
+        }
+    }
+
+    writerDone = true;
+    for (unsigned int t = 0; t < readers.size(); t++) {
+        readers[t].join();
+    }
+
+    if (errors != 0) {
+        cerr << "Readers saw " << errors << " missing or wrong values.\n";
+        return false;
+    }
+
+    for (int key = 0; key < STABLE_KEYS + CHURN_KEYS; key++) {
+        bool expected = key < STABLE_KEYS || (key - STABLE_KEYS) % 2 != 0;
+        if (table.contains(key) != expected) {
+            cerr << "Key " << key << " was " << (expected ? "lost" : "not removed") << ".\n";
+            return false;
+        }
+        if (expected && table.get(key) / 10 != key) {
+            cerr << "Key " << key << " has the wrong value.\n";
+            return false;
+        }
+    }
+
+    if (table.remove(-1) != false) {
+        cerr << "Removed a key that was never inserted.\n";
+        return false;
+    }
+
+    EpochDomain::instance().reclaim();
+
+    return true;
+}
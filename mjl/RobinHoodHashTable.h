@@ -0,0 +1,398 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef ROBINHOODHASHTABLE_H
+#define ROBINHOODHASHTABLE_H
+
+#include "HashGenerator.h"
+#include "HashSizePolicy.h"
+
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+namespace mjl {
+namespace homebrew {
+
+/**
+ * A single slot of a RobinHoodHashTable. probeLength is how far the entry sits
+ * from the slot its hash selects, plus one: 1 for an entry in its own slot, 2
+ * for one that was pushed one slot along, and so on. 0 means the slot is
+ * empty. The key and value storage is only constructed while it is not.
+ */
+template<typename K, typename V> struct RobinHoodSlot {
+ public:
+    RobinHoodSlot(void)
+                    : probeLength(0) {
+    }
+
+    K& key(void) {
+        return *reinterpret_cast<K*>(keyStorage);
+    }
+
+    const K& key(void) const {
+        return *reinterpret_cast<const K*>(keyStorage);
+    }
+
+    V& value(void) {
+        return *reinterpret_cast<V*>(valueStorage);
+    }
+
+    const V& value(void) const {
+        return *reinterpret_cast<const V*>(valueStorage);
+    }
+
+    unsigned int probeLength;
+    alignas(K) unsigned char keyStorage[sizeof(K)];
+    alignas(V) unsigned char valueStorage[sizeof(V)];
+};
+
+/**
+ * A linear probing hash table using Robin Hood hashing, with the same
+ * get/insert/remove interface as HashTable.
+ *
+ * While an entry is being inserted it takes the slot of any entry it passes
+ * that is closer to its own slot than the new entry is ("takes from the
+ * rich"), and that entry continues the search instead. This keeps the probe
+ * lengths of all entries close together, so even a table that is 90% full
+ * has short worst case probes. It also means a lookup can stop as soon as it
+ * reaches an entry closer to home than the key it is looking for would be.
+ *
+ * Removing an entry shifts the entries after it back by one slot, until one
+ * that is already in its own slot (or an empty slot) is reached. So there
+ * are no tombstones, and a table that sees many removes never has to be
+ * rebuilt to clean them out.
+ *
+ * The load factor the table grows at is chosen when it is constructed.
+ * maxProbeLength, meanProbeLength and loadFactor show how well that is going.
+ */
+template<typename K, typename V, typename HashGenerator = DefaultHashGenerator<K>,
+                typename SizePolicy = PrimeSizePolicy> class RobinHoodHashTable {
+ public:
+
+    typedef RobinHoodSlot<K, V> Slot;
+
+    // Default constructor, maxLoadFactor has to be above 0 and below 1 or it throws std::invalid_argument
+    explicit RobinHoodHashTable(float theMaxLoadFactor = 0.9f)
+                    : maxLoadFactor(checkLoadFactor(theMaxLoadFactor)),
+                      sizing(),
+                      hashTableSize(sizing.size()),
+                      size(0),
+                      table(new Slot[sizing.size()]) {
+    }
+
+    // Copy constructor
+    RobinHoodHashTable(const RobinHoodHashTable& from)
+                    : maxLoadFactor(from.maxLoadFactor),
+                      sizing(from.sizing),
+                      hashTableSize(from.hashTableSize),
+                      size(0),
+                      table(new Slot[from.hashTableSize]) {
+        commonCopy(from);
+    }
+
+    // Move constructor
+    RobinHoodHashTable(RobinHoodHashTable&& from) noexcept
+                    : maxLoadFactor(from.maxLoadFactor),
+                      sizing(from.sizing),
+                      hashTableSize(from.hashTableSize),
+                      size(from.size),
+                      table(from.table) {
+        from.table = nullptr;
+    }
+
+    // Assignment operator
+    RobinHoodHashTable& operator=(const RobinHoodHashTable& from) {
+
+        if (this == &from) {
+            return *this;
+        }
+
+        commonDelete();
+        maxLoadFactor = from.maxLoadFactor;
+        sizing = from.sizing;
+        hashTableSize = from.hashTableSize;
+        size = 0;
+        table = new Slot[from.hashTableSize];
+        commonCopy(from);
+        return *this;
+    }
+
+    // Move assignment operator
+    RobinHoodHashTable& operator=(RobinHoodHashTable&& from) noexcept {
+
+        if (this == &from) {
+            return *this;
+        }
+
+        commonDelete();
+
+        maxLoadFactor = from.maxLoadFactor;
+        sizing = from.sizing;
+        hashTableSize = from.hashTableSize;
+        size = from.size;
+        table = from.table;
+
+        from.table = nullptr;
+
+        return *this;
+    }
+
+    // Destructor
+    virtual ~RobinHoodHashTable() {
+        commonDelete();
+    }
+
+    V& get(const K& key) {
+
+        unsigned int index = findSlot(key);
+
+        if (index == hashTableSize) {
+            throw std::out_of_range("Tried to get entry that does not exist.");
+        }
+
+        return table[index].value();
+    }
+
+    bool contains(const K& key) {
+        return findSlot(key) != hashTableSize;
+    }
+
+    // Will replace any value that is already there with a copy of the new one
+    void insert(const K& key, const V& value) {
+
+        unsigned int index = findSlot(key);
+
+        if (index != hashTableSize) {
+            table[index].value() = value;
+            return;
+        }
+
+        float newLoadFactor = (size + 1.0) / hashTableSize;
+
+        if (newLoadFactor >= maxLoadFactor) {
+            rehash();
+        }
+
+        K carriedKey(key);
+        V carriedValue(value);
+        place(carriedKey, carriedValue);
+        size++;
+    }
+
+    bool remove(const K& key) {
+
+        unsigned int index = findSlot(key);
+
+        if (index == hashTableSize) {
+            return false;
+        }
+
+        table[index].key().~K();
+        table[index].value().~V();
+        table[index].probeLength = 0;
+        size--;
+
+        // Backward shift: pull every following entry that is not in its own slot one step
+        // closer to it, which closes the gap without leaving a tombstone
+        unsigned int next = nextSlot(index);
+        while (table[next].probeLength > 1) {
+            new (table[index].keyStorage) K(std::move(table[next].key()));
+            new (table[index].valueStorage) V(std::move(table[next].value()));
+            table[index].probeLength = table[next].probeLength - 1;
+
+            table[next].key().~K();
+            table[next].value().~V();
+            table[next].probeLength = 0;
+
+            index = next;
+            next = nextSlot(next);
+        }
+
+        return true;
+    }
+
+    // The longest probe of any entry, 1 if every entry is in its own slot (0 if there are none)
+    unsigned int maxProbeLength(void) const {
+
+        unsigned int longest = 0;
+
+        for (unsigned int i = 0; i < hashTableSize; i++) {
+            if (table[i].probeLength > longest) {
+                longest = table[i].probeLength;
+            }
+        }
+
+        return longest;
+    }
+
+    // The average number of slots a successful lookup looks at
+    double meanProbeLength(void) const {
+
+        unsigned long long total = 0;
+
+        for (unsigned int i = 0; i < hashTableSize; i++) {
+            total += table[i].probeLength;
+        }
+
+        return (size == 0) ? 0.0 : (double) total / size;
+    }
+
+    float loadFactor(void) const {
+        return (float) size / hashTableSize;
+    }
+
+ private:
+
+    unsigned int findSlot(const K& key) const {
+
+        unsigned int index = selectBucket(key);
+
+        // Every entry passed on the way is at least as far from home as key would be. Once
+        // one is closer (or the slot is empty) key would have taken its place on insert.
+        for (unsigned int probeLength = 1; table[index].probeLength >= probeLength; probeLength++) {
+
+            if (table[index].key() == key) {
+                return index;
+            }
+
+            index = nextSlot(index);
+        }
+
+        return hashTableSize;
+    }
+
+    /**
+     * Put an entry that is not in the table yet into it. Whenever the entry
+     * passes one that is closer to its own slot, the two trade places and the
+     * search continues for the entry that was displaced. The carried key and
+     * value are left moved from.
+     */
+    void place(K& carriedKey, V& carriedValue) {
+
+        unsigned int index = selectBucket(carriedKey);
+        unsigned int probeLength = 1;
+
+        while (table[index].probeLength != 0) {
+
+            if (table[index].probeLength < probeLength) {
+                std::swap(table[index].key(), carriedKey);
+                std::swap(table[index].value(), carriedValue);
+                std::swap(table[index].probeLength, probeLength);
+            }
+
+            index = nextSlot(index);
+            probeLength++;
+        }
+
+        new (table[index].keyStorage) K(std::move(carriedKey));
+        new (table[index].valueStorage) V(std::move(carriedValue));
+        table[index].probeLength = probeLength;
+    }
+
+    void commonCopy(const RobinHoodHashTable& from) {
+
+        // Both tables have the same size, so every entry can go to the same slot
+        for (unsigned int i = 0; i < from.hashTableSize; i++) {
+            if (from.table[i].probeLength != 0) {
+                new (table[i].keyStorage) K(from.table[i].key());
+                new (table[i].valueStorage) V(from.table[i].value());
+                table[i].probeLength = from.table[i].probeLength;
+            }
+        }
+
+        size = from.size;
+    }
+
+    void commonDelete(void) {
+
+        // If the object has been moved (via move constructor or move assignment
+        // operator) then there's no need to delete the memory here.
+        if (table == nullptr) {
+            return;
+        }
+
+        for (unsigned int i = 0; i < hashTableSize; i++) {
+            if (table[i].probeLength != 0) {
+                table[i].key().~K();
+                table[i].value().~V();
+            }
+        }
+
+        delete[] table;
+    }
+
+    /**
+     * Use the default hashing function, or the user-defined version, and let
+     * the size policy reduce the hash to a slot index.
+     */
+    unsigned int selectBucket(const K& k) const {
+        return sizing.index(HashOf<HashGenerator, K>::hash(k));
+    }
+
+    // A full table has no empty slot to end a probe, so it has to grow before it gets there
+    static float checkLoadFactor(float theMaxLoadFactor) {
+        if (!(theMaxLoadFactor > 0.0f && theMaxLoadFactor < 1.0f)) {
+            throw std::invalid_argument("A RobinHoodHashTable's maximum load factor has to be above 0 and below 1.");
+        }
+        return theMaxLoadFactor;
+    }
+
+    unsigned int nextSlot(unsigned int index) const {
+        return (index + 1 == hashTableSize) ? 0 : index + 1;
+    }
+
+    void rehash(void) {
+
+        Slot* oldTable = table;
+        unsigned int oldSize = hashTableSize;
+
+        sizing.grow();
+        hashTableSize = sizing.size();
+        table = new Slot[hashTableSize];
+
+        // Move every entry into the new table, where they have to be placed all over again
+        for (unsigned int i = 0; i < oldSize; i++) {
+
+            if (oldTable[i].probeLength == 0) {
+                continue;
+            }
+
+            place(oldTable[i].key(), oldTable[i].value());
+
+            oldTable[i].key().~K();
+            oldTable[i].value().~V();
+        }
+
+        delete[] oldTable;
+    }
+
+    float maxLoadFactor;
+    SizePolicy sizing;
+    unsigned int hashTableSize;     // Same as sizing.size(), kept here for the probing loops
+    unsigned int size;
+    Slot* table;
+};
+
+} /* namespace homebrew */
+} /* namespace mjl */
+
+#endif /* ROBINHOODHASHTABLE_H */
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "RobinHoodHashTable.h"
+#include "RobinHoodHashTable_test.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include <stdlib.h>
+
+using namespace std;
+using namespace mjl::homebrew;
+
+// Every key in the reference map must be found with the same value, and a
+// handful of keys known to be absent must not be found.
+static bool matchesReference(RobinHoodHashTable<int, int>& table, unordered_map<int, int>& reference,
+                             int keyRange) {
+
+    for (int key = 0; key < keyRange; key++) {
+
+        bool expected = reference.find(key) != reference.end();
+        bool found = true;
+        int value = 0;
+
+        try {
+            value = table.get(key);
+        } catch (std::out_of_range&) {
+            found = false;
+        }
+
+        if (found != expected || table.contains(key) != expected) {
+            cerr << "Key " << key << " was " << (found ? "" : "not ") << "found but should "
+                            << (expected ? "" : "not ") << "have been.\n";
+            return false;
+        }
+        if (found && value != reference[key]) {
+            cerr << "Key " << key << " has value " << value << " but should be " << reference[key] << ".\n";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool runRobinHoodHashTableTests(void) {
+    const int TEST_SIZE = 1000;
+    const int KEY_RANGE = 2000;
+
+    RobinHoodHashTable<int, int> myHash;
+    unordered_map<int, int> stdHash;
+
+    cout << "Inserting " << TEST_SIZE << " entries into Robin Hood hash table.\n";
+    for (int i = 0; i < TEST_SIZE; i++) {
+        myHash.insert(i, i * 3);
+        stdHash[i] = i * 3;
+    }
+    if (!matchesReference(myHash, stdHash, KEY_RANGE)) {
+        return false;
+    }
+
+    cout << "Replacing the value of existing entries.\n";
+    for (int i = 0; i < TEST_SIZE; i += 7) {
+        myHash.insert(i, -i);
+        stdHash[i] = -i;
+    }
+    if (!matchesReference(myHash, stdHash, KEY_RANGE)) {
+        return false;
+    }
+
+    cout << "Removing every other entry, and entries that are not there.\n";
+    for (int i = 0; i < KEY_RANGE; i += 2) {
+        bool removed = myHash.remove(i);
+        bool expected = stdHash.erase(i) == 1;
+        if (removed != expected) {
+            cerr << "remove(" << i << ") returned " << removed << " but should be " << expected << ".\n";
+            return false;
+        }
+    }
+    if (!matchesReference(myHash, stdHash, KEY_RANGE)) {
+        return false;
+    }
+
+    // A table kept nearly full while entries come and go, so removes shift long runs back
+    cout << "Mixed random inserts and removes at 95% load.\n";
+    RobinHoodHashTable<int, int> fullHash(0.95f);
+    unordered_map<int, int> fullStdHash;
+    srand(1234);
+    for (int i = 0; i < 100000; i++) {
+        int key = rand() % KEY_RANGE;
+        if (rand() % 2 == 0) {
+            fullHash.insert(key, i);
+            fullStdHash[key] = i;
+        } else {
+            fullHash.remove(key);
+            fullStdHash.erase(key);
+        }
+    }
+    if (!matchesReference(fullHash, fullStdHash, KEY_RANGE)) {
+        return false;
+    }
+
+    cout << "Checking probe length statistics.\n";
+    RobinHoodHashTable<int, int, DefaultHashGenerator<int>, PowerOfTwoSizePolicy> statsHash(0.9f);
+    if (statsHash.maxProbeLength() != 0 || statsHash.meanProbeLength() != 0.0 || statsHash.loadFactor() != 0.0f) {
+        cerr << "An empty table has probe statistics.\n";
+        return false;
+    }
+    for (int i = 0; i < 100000; i++) {
+        statsHash.insert(i, i);
+    }
+    cout << "100000 entries: load factor " << statsHash.loadFactor() << ", mean probe length "
+                    << statsHash.meanProbeLength() << ", max probe length " << statsHash.maxProbeLength() << "\n";
+    if (statsHash.loadFactor() <= 0.45f || statsHash.loadFactor() >= 0.9f || statsHash.meanProbeLength() < 1.0
+                    || statsHash.meanProbeLength() > statsHash.maxProbeLength()
+                    || statsHash.maxProbeLength() > 64) {
+        cerr << "Probe statistics are out of range.\n";
+        return false;
+    }
+
+    cout << "Testing string keys\n";
+    RobinHoodHashTable<string, string> stringHash;
+    for (int i = 0; i < 1000; i++) {
+        stringHash.insert(to_string(i), string(i % 50, 'x'));
+    }
+    for (int i = 0; i < 1000; i += 3) {
+        stringHash.remove(to_string(i));
+    }
+    for (int i = 0; i < 1000; i++) {
+        if (stringHash.contains(to_string(i)) != (i % 3 != 0)
+                        || (i % 3 != 0 && stringHash.get(to_string(i)) != string(i % 50, 'x'))) {
+            cerr << "String key " << i << " is wrong.\n";
+            return false;
+        }
+    }
+
+    cout << "Testing copy constructor and assignment operator\n";
+    RobinHoodHashTable<int, int> myHash2(myHash);
+    if (!matchesReference(myHash2, stdHash, KEY_RANGE)) {
+        return false;
+    }
+    RobinHoodHashTable<int, int> myHash3;
+    myHash3 = myHash2;
+    if (!matchesReference(myHash3, stdHash, KEY_RANGE)) {
+        return false;
+    }
+
+    cout << "Testing move constructor and move assignment operator\n";
+    RobinHoodHashTable<int, int> myHash4(std::move(myHash2));
+    if (!matchesReference(myHash4, stdHash, KEY_RANGE)) {
+        return false;
+    }
+    RobinHoodHashTable<int, int> myHash5;
+    myHash5 = std::move(myHash3);
+    if (!matchesReference(myHash5, stdHash, KEY_RANGE)) {
+        return false;
+    }
+
+    cout << "Testing maximum load factors that would let the table fill up\n";
+    float badLoadFactors[] = { 1.0f, 1.5f, 0.0f, -0.5f };
+    for (float loadFactor : badLoadFactors) {
+        try {
+            RobinHoodHashTable<int, int> full(loadFactor);
+            cerr << "A maximum load factor of " << loadFactor << " was accepted.\n";
+            return false;
+        } catch (std::invalid_argument&) {
+        }
+    }
+
+    return true;
+}
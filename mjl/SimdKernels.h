@@ -0,0 +1,1081 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+#include "DynamicArray.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MJL_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+namespace mjl {
+namespace homebrew {
+
+/*********************
+ * Table of contents *
+ *********************
+ *
+ * SimdLevel supportedSimdLevel(void)
+ * const char* simdLevelName(SimdLevel level)
+ *
+ * unsigned int simdFind(const DynamicArray<T>& array, T value, SimdLevel level)
+ * unsigned int simdCount(const DynamicArray<T>& array, T value, SimdLevel level)
+ * std::pair<T, T> simdMinMax(const DynamicArray<T>& array, SimdLevel level)
+ * SimdSum<T>::type simdSum(const DynamicArray<T>& array, SimdLevel level)
+ * void simdFilter(const DynamicArray<T>& input, SimdComparison comparison, T value, DynamicArray<T>& output,
+ *                 SimdLevel level)
+ *
+ * Search and filter kernels for arrays of arithmetic types. Every kernel
+ * runs at the best instruction set the CPU has (supportedSimdLevel()), which
+ * is found once at run time, so one build runs at full speed everywhere.
+ * Passing a lower level forces that one instead, which is how the tests and
+ * the benchmark compare them; asking for a level the CPU doesn't have throws
+ * std::invalid_argument.
+ *
+ * int and float have SSE4.2, AVX2 and AVX-512 kernels. Every other
+ * arithmetic type runs the plain loops at any level.
+ */
+
+enum SimdLevel {
+    SIMD_SCALAR,
+    SIMD_SSE42,
+    SIMD_AVX2,
+    SIMD_AVX512
+};
+
+// Which elements simdFilter keeps: those where (element comparison value) is true
+enum SimdComparison {
+    SIMD_EQUAL,
+    SIMD_NOT_EQUAL,
+    SIMD_LESS,
+    SIMD_LESS_EQUAL,
+    SIMD_GREATER,
+    SIMD_GREATER_EQUAL
+};
+
+// What simdSum adds up in: 64 bits for integers, so that a sum of ints doesn't overflow, and T itself otherwise
+template<typename T, bool Integral = std::is_integral<T>::value, bool Signed = std::is_signed<T>::value>
+struct SimdSum {
+    typedef T type;
+};
+
+template<typename T> struct SimdSum<T, true, true> {
+    typedef long long type;
+};
+
+template<typename T> struct SimdSum<T, true, false> {
+    typedef unsigned long long type;
+};
+
+inline SimdLevel detectSimdLevel(void) {
+#ifdef MJL_SIMD_X86
+    // These also check that the operating system saves the wider registers
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return SIMD_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return SIMD_AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+        return SIMD_SSE42;
+    }
+#endif
+    return SIMD_SCALAR;
+}
+
+// The best level this CPU can run, found the first time it is asked for
+inline SimdLevel supportedSimdLevel(void) {
+    static const SimdLevel level = detectSimdLevel();
+    return level;
+}
+
+inline const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+    case SIMD_SSE42:
+        return "SSE4.2";
+    case SIMD_AVX2:
+        return "AVX2";
+    case SIMD_AVX512:
+        return "AVX-512";
+    default:
+        return "scalar";
+    }
+}
+
+inline void checkSimdLevel(SimdLevel level) {
+    if (level > supportedSimdLevel()) {
+        throw std::invalid_argument(std::string("This CPU can't run ") + simdLevelName(level) + " kernels.");
+    }
+}
+
+template<SimdComparison Comparison, typename T> inline bool simdCompare(T element, T value) {
+    switch (Comparison) {
+    case SIMD_EQUAL:
+        return element == value;
+    case SIMD_NOT_EQUAL:
+        return element != value;
+    case SIMD_LESS:
+        return element < value;
+    case SIMD_LESS_EQUAL:
+        return element <= value;
+    case SIMD_GREATER:
+        return element > value;
+    default:
+        return element >= value;
+    }
+}
+
+/*
+ * The plain loops, for every arithmetic type. They also finish off the last
+ * few elements that don't fill a whole vector in the vector kernels.
+ */
+
+template<typename T> unsigned int scalarFind(const T* elements, unsigned int start, unsigned int count, T value) {
+    for (unsigned int i = start; i < count; i++) {
+        if (elements[i] == value) {
+            return i;
+        }
+    }
+    return count;
+}
+
+template<typename T> unsigned int scalarCount(const T* elements, unsigned int start, unsigned int count, T value) {
+    unsigned int found = 0;
+    for (unsigned int i = start; i < count; i++) {
+        found += (elements[i] == value);
+    }
+    return found;
+}
+
+template<typename T> std::pair<T, T> scalarMinMax(const T* elements, unsigned int count) {
+    T lowest = elements[0];
+    T highest = elements[0];
+    for (unsigned int i = 1; i < count; i++) {
+        lowest = std::min(lowest, elements[i]);
+        highest = std::max(highest, elements[i]);
+    }
+    return std::make_pair(lowest, highest);
+}
+
+template<typename T> typename SimdSum<T>::type scalarSum(const T* elements, unsigned int start, unsigned int count) {
+    typename SimdSum<T>::type sum = 0;
+    for (unsigned int i = start; i < count; i++) {
+        sum += elements[i];
+    }
+    return sum;
+}
+
+// Append the elements from start on that pass the comparison to output
+template<SimdComparison Comparison, typename T, typename Output> void scalarFilter(const T* elements,
+                unsigned int start, unsigned int count, T value, Output& output) {
+    for (unsigned int i = start; i < count; i++) {
+        if (simdCompare<Comparison>(elements[i], value)) {
+            output.push_back(elements[i]);
+        }
+    }
+}
+
+template<typename T, typename Output> void scalarFilter(const T* elements, unsigned int count,
+                SimdComparison comparison, T value, Output& output) {
+    switch (comparison) {
+    case SIMD_EQUAL:
+        return scalarFilter<SIMD_EQUAL>(elements, 0, count, value, output);
+    case SIMD_NOT_EQUAL:
+        return scalarFilter<SIMD_NOT_EQUAL>(elements, 0, count, value, output);
+    case SIMD_LESS:
+        return scalarFilter<SIMD_LESS>(elements, 0, count, value, output);
+    case SIMD_LESS_EQUAL:
+        return scalarFilter<SIMD_LESS_EQUAL>(elements, 0, count, value, output);
+    case SIMD_GREATER:
+        return scalarFilter<SIMD_GREATER>(elements, 0, count, value, output);
+    default:
+        return scalarFilter<SIMD_GREATER_EQUAL>(elements, 0, count, value, output);
+    }
+}
+
+// The kernels for a type without vector kernels are the plain loops at every level
+template<typename T> struct SimdKernels {
+    static unsigned int find(const T* elements, unsigned int count, T value, SimdLevel) {
+        return scalarFind(elements, 0, count, value);
+    }
+
+    static unsigned int countOf(const T* elements, unsigned int count, T value, SimdLevel) {
+        return scalarCount(elements, 0, count, value);
+    }
+
+    static std::pair<T, T> minMax(const T* elements, unsigned int count, SimdLevel) {
+        return scalarMinMax(elements, count);
+    }
+
+    static typename SimdSum<T>::type sum(const T* elements, unsigned int count, SimdLevel) {
+        return scalarSum(elements, 0, count);
+    }
+
+    template<typename Output> static void filter(const T* elements, unsigned int count, SimdComparison comparison,
+                    T value, Output& output, SimdLevel) {
+        scalarFilter(elements, count, comparison, value, output);
+    }
+};
+
+#ifdef MJL_SIMD_X86
+
+/*
+ * The vector types only ever pass between functions compiled for them (see
+ * the kernels below), but GCC warns about them all the same, and GCC 12
+ * warns about the deliberately undefined inputs inside its own AVX-512
+ * intrinsics.
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+
+#define MJL_TARGET_SSE42 __attribute__((target("sse4.2,popcnt")))
+#define MJL_TARGET_AVX2 __attribute__((target("avx2,popcnt")))
+#define MJL_TARGET_AVX512 __attribute__((target("avx512f,popcnt")))
+
+/*
+ * The vector operations the kernels are written in, one class per
+ * instruction set and element type. A comparison gives a bit mask with one
+ * bit per lane, lowest lane first. compressStore writes the lanes picked by
+ * a mask next to each other at out, and may write up to a whole vector past
+ * them.
+ */
+template<typename T> struct Sse42Operations;
+template<typename T> struct Avx2Operations;
+template<typename T> struct Avx512Operations;
+
+// A table, for every 4 bit mask, of the byte shuffle that moves the picked 32 bit lanes to the front
+struct Sse42CompressTable {
+    Sse42CompressTable() {
+        for (unsigned int mask = 0; mask < 16; mask++) {
+            unsigned int out = 0;
+            for (unsigned int lane = 0; lane < 4; lane++) {
+                if (mask & (1 << lane)) {
+                    for (unsigned int byte = 0; byte < 4; byte++) {
+                        shuffles[mask][out * 4 + byte] = (unsigned char) (lane * 4 + byte);
+                    }
+                    out++;
+                }
+            }
+            for (; out < 4; out++) {
+                for (unsigned int byte = 0; byte < 4; byte++) {
+                    shuffles[mask][out * 4 + byte] = 0x80;
+                }
+            }
+        }
+    }
+
+    static const Sse42CompressTable& instance(void) {
+        static const Sse42CompressTable table;
+        return table;
+    }
+
+    alignas(16) unsigned char shuffles[16][16];
+};
+
+// A table, for every 8 bit mask, of the lane permutation that moves the picked lanes to the front
+struct Avx2CompressTable {
+    Avx2CompressTable() {
+        for (unsigned int mask = 0; mask < 256; mask++) {
+            unsigned int out = 0;
+            for (unsigned int lane = 0; lane < 8; lane++) {
+                if (mask & (1 << lane)) {
+                    permutations[mask][out++] = lane;
+                }
+            }
+            for (; out < 8; out++) {
+                permutations[mask][out] = 0;
+            }
+        }
+    }
+
+    static const Avx2CompressTable& instance(void) {
+        static const Avx2CompressTable table;
+        return table;
+    }
+
+    alignas(32) unsigned int permutations[256][8];
+};
+
+template<> struct Sse42Operations<int> {
+    typedef __m128i Vector;
+    typedef __m128i SumVector;
+    static const unsigned int LANES = 4;
+
+    MJL_TARGET_SSE42 static Vector load(const int* elements) {
+        return _mm_loadu_si128((const __m128i*) elements);
+    }
+
+    MJL_TARGET_SSE42 static Vector broadcast(int value) {
+        return _mm_set1_epi32(value);
+    }
+
+    MJL_TARGET_SSE42 static unsigned int lanes(Vector mask) {
+        return (unsigned int) _mm_movemask_ps(_mm_castsi128_ps(mask));
+    }
+
+    template<SimdComparison Comparison> MJL_TARGET_SSE42 static unsigned int compare(Vector a, Vector b) {
+        switch (Comparison) {
+        case SIMD_EQUAL:
+            return lanes(_mm_cmpeq_epi32(a, b));
+        case SIMD_NOT_EQUAL:
+            return lanes(_mm_cmpeq_epi32(a, b)) ^ 0xF;
+        case SIMD_LESS:
+            return lanes(_mm_cmplt_epi32(a, b));
+        case SIMD_LESS_EQUAL:
+            return lanes(_mm_cmpgt_epi32(a, b)) ^ 0xF;
+        case SIMD_GREATER:
+            return lanes(_mm_cmpgt_epi32(a, b));
+        default:
+            return lanes(_mm_cmplt_epi32(a, b)) ^ 0xF;
+        }
+    }
+
+    MJL_TARGET_SSE42 static Vector min(Vector a, Vector b) {
+        return _mm_min_epi32(a, b);
+    }
+
+    MJL_TARGET_SSE42 static Vector max(Vector a, Vector b) {
+        return _mm_max_epi32(a, b);
+    }
+
+    MJL_TARGET_SSE42 static void store(int* out, Vector v) {
+        _mm_storeu_si128((__m128i*) out, v);
+    }
+
+    // The sum is kept in 64 bit lanes, so each vector of ints is widened in two halves
+    MJL_TARGET_SSE42 static SumVector zeroSum(void) {
+        return _mm_setzero_si128();
+    }
+
+    MJL_TARGET_SSE42 static SumVector add(SumVector sum, Vector v) {
+        sum = _mm_add_epi64(sum, _mm_cvtepi32_epi64(v));
+        return _mm_add_epi64(sum, _mm_cvtepi32_epi64(_mm_srli_si128(v, 8)));
+    }
+
+    MJL_TARGET_SSE42 static SumVector add(SumVector a, SumVector b, SumVector c, SumVector d) {
+        return _mm_add_epi64(_mm_add_epi64(a, b), _mm_add_epi64(c, d));
+    }
+
+    MJL_TARGET_SSE42 static long long total(SumVector sum) {
+        long long lanes[2];
+        _mm_storeu_si128((__m128i*) lanes, sum);
+        return lanes[0] + lanes[1];
+    }
+
+    MJL_TARGET_SSE42 static unsigned int compressStore(int* out, Vector v, unsigned int mask) {
+        Vector shuffle = _mm_load_si128((const __m128i*) Sse42CompressTable::instance().shuffles[mask]);
+        _mm_storeu_si128((__m128i*) out, _mm_shuffle_epi8(v, shuffle));
+        return (unsigned int) __builtin_popcount(mask);
+    }
+};
+
+template<> struct Sse42Operations<float> {
+    typedef __m128 Vector;
+    typedef __m128 SumVector;
+    static const unsigned int LANES = 4;
+
+    MJL_TARGET_SSE42 static Vector load(const float* elements) {
+        return _mm_loadu_ps(elements);
+    }
+
+    MJL_TARGET_SSE42 static Vector broadcast(float value) {
+        return _mm_set1_ps(value);
+    }
+
+    // The comparisons are false for a NaN, except for not equal, like the plain ones
+    template<SimdComparison Comparison> MJL_TARGET_SSE42 static unsigned int compare(Vector a, Vector b) {
+        switch (Comparison) {
+        case SIMD_EQUAL:
+            return (unsigned int) _mm_movemask_ps(_mm_cmpeq_ps(a, b));
+        case SIMD_NOT_EQUAL:
+            return (unsigned int) _mm_movemask_ps(_mm_cmpneq_ps(a, b));
+        case SIMD_LESS:
+            return (unsigned int) _mm_movemask_ps(_mm_cmplt_ps(a, b));
+        case SIMD_LESS_EQUAL:
+            return (unsigned int) _mm_movemask_ps(_mm_cmple_ps(a, b));
+        case SIMD_GREATER:
+            return (unsigned int) _mm_movemask_ps(_mm_cmpgt_ps(a, b));
+        default:
+            return (unsigned int) _mm_movemask_ps(_mm_cmpge_ps(a, b));
+        }
+    }
+
+    MJL_TARGET_SSE42 static Vector min(Vector a, Vector b) {
+        return _mm_min_ps(a, b);
+    }
+
+    MJL_TARGET_SSE42 static Vector max(Vector a, Vector b) {
+        return _mm_max_ps(a, b);
+    }
+
+    MJL_TARGET_SSE42 static void store(float* out, Vector v) {
+        _mm_storeu_ps(out, v);
+    }
+
+    MJL_TARGET_SSE42 static SumVector zeroSum(void) {
+        return _mm_setzero_ps();
+    }
+
+    MJL_TARGET_SSE42 static SumVector add(SumVector sum, Vector v) {
+        return _mm_add_ps(sum, v);
+    }
+
+    MJL_TARGET_SSE42 static SumVector add(SumVector a, SumVector b, SumVector c, SumVector d) {
+        return _mm_add_ps(_mm_add_ps(a, b), _mm_add_ps(c, d));
+    }
+
+    MJL_TARGET_SSE42 static float total(SumVector sum) {
+        float lanes[4];
+        _mm_storeu_ps(lanes, sum);
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+
+    MJL_TARGET_SSE42 static unsigned int compressStore(float* out, Vector v, unsigned int mask) {
+        __m128i shuffle = _mm_load_si128((const __m128i*) Sse42CompressTable::instance().shuffles[mask]);
+        _mm_storeu_si128((__m128i*) out, _mm_shuffle_epi8(_mm_castps_si128(v), shuffle));
+        return (unsigned int) __builtin_popcount(mask);
+    }
+};
+
+template<> struct Avx2Operations<int> {
+    typedef __m256i Vector;
+    typedef __m256i SumVector;
+    static const unsigned int LANES = 8;
+
+    MJL_TARGET_AVX2 static Vector load(const int* elements) {
+        return _mm256_loadu_si256((const __m256i*) elements);
+    }
+
+    MJL_TARGET_AVX2 static Vector broadcast(int value) {
+        return _mm256_set1_epi32(value);
+    }
+
+    MJL_TARGET_AVX2 static unsigned int lanes(Vector mask) {
+        return (unsigned int) _mm256_movemask_ps(_mm256_castsi256_ps(mask));
+    }
+
+    // AVX2 only compares for equal and greater, so the others are those with the operands swapped or negated
+    template<SimdComparison Comparison> MJL_TARGET_AVX2 static unsigned int compare(Vector a, Vector b) {
+        switch (Comparison) {
+        case SIMD_EQUAL:
+            return lanes(_mm256_cmpeq_epi32(a, b));
+        case SIMD_NOT_EQUAL:
+            return lanes(_mm256_cmpeq_epi32(a, b)) ^ 0xFF;
+        case SIMD_LESS:
+            return lanes(_mm256_cmpgt_epi32(b, a));
+        case SIMD_LESS_EQUAL:
+            return lanes(_mm256_cmpgt_epi32(a, b)) ^ 0xFF;
+        case SIMD_GREATER:
+            return lanes(_mm256_cmpgt_epi32(a, b));
+        default:
+            return lanes(_mm256_cmpgt_epi32(b, a)) ^ 0xFF;
+        }
+    }
+
+    MJL_TARGET_AVX2 static Vector min(Vector a, Vector b) {
+        return _mm256_min_epi32(a, b);
+    }
+
+    MJL_TARGET_AVX2 static Vector max(Vector a, Vector b) {
+        return _mm256_max_epi32(a, b);
+    }
+
+    MJL_TARGET_AVX2 static void store(int* out, Vector v) {
+        _mm256_storeu_si256((__m256i*) out, v);
+    }
+
+    MJL_TARGET_AVX2 static SumVector zeroSum(void) {
+        return _mm256_setzero_si256();
+    }
+
+    MJL_TARGET_AVX2 static SumVector add(SumVector sum, Vector v) {
+        sum = _mm256_add_epi64(sum, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+        return _mm256_add_epi64(sum, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+    }
+
+    MJL_TARGET_AVX2 static SumVector add(SumVector a, SumVector b, SumVector c, SumVector d) {
+        return _mm256_add_epi64(_mm256_add_epi64(a, b), _mm256_add_epi64(c, d));
+    }
+
+    MJL_TARGET_AVX2 static long long total(SumVector sum) {
+        long long lanes[4];
+        _mm256_storeu_si256((__m256i*) lanes, sum);
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+
+    MJL_TARGET_AVX2 static unsigned int compressStore(int* out, Vector v, unsigned int mask) {
+        __m256i permutation = _mm256_load_si256((const __m256i*) Avx2CompressTable::instance().permutations[mask]);
+        _mm256_storeu_si256((__m256i*) out, _mm256_permutevar8x32_epi32(v, permutation));
+        return (unsigned int) __builtin_popcount(mask);
+    }
+};
+
+template<> struct Avx2Operations<float> {
+    typedef __m256 Vector;
+    typedef __m256 SumVector;
+    static const unsigned int LANES = 8;
+
+    MJL_TARGET_AVX2 static Vector load(const float* elements) {
+        return _mm256_loadu_ps(elements);
+    }
+
+    MJL_TARGET_AVX2 static Vector broadcast(float value) {
+        return _mm256_set1_ps(value);
+    }
+
+    template<SimdComparison Comparison> MJL_TARGET_AVX2 static unsigned int compare(Vector a, Vector b) {
+        switch (Comparison) {
+        case SIMD_EQUAL:
+            return (unsigned int) _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_EQ_OQ));
+        case SIMD_NOT_EQUAL:
+            return (unsigned int) _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_NEQ_UQ));
+        case SIMD_LESS:
+            return (unsigned int) _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ));
+        case SIMD_LESS_EQUAL:
+            return (unsigned int) _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LE_OQ));
+        case SIMD_GREATER:
+            return (unsigned int) _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GT_OQ));
+        default:
+            return (unsigned int) _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GE_OQ));
+        }
+    }
+
+    MJL_TARGET_AVX2 static Vector min(Vector a, Vector b) {
+        return _mm256_min_ps(a, b);
+    }
+
+    MJL_TARGET_AVX2 static Vector max(Vector a, Vector b) {
+        return _mm256_max_ps(a, b);
+    }
+
+    MJL_TARGET_AVX2 static void store(float* out, Vector v) {
+        _mm256_storeu_ps(out, v);
+    }
+
+    MJL_TARGET_AVX2 static SumVector zeroSum(void) {
+        return _mm256_setzero_ps();
+    }
+
+    MJL_TARGET_AVX2 static SumVector add(SumVector sum, Vector v) {
+        return _mm256_add_ps(sum, v);
+    }
+
+    MJL_TARGET_AVX2 static SumVector add(SumVector a, SumVector b, SumVector c, SumVector d) {
+        return _mm256_add_ps(_mm256_add_ps(a, b), _mm256_add_ps(c, d));
+    }
+
+    MJL_TARGET_AVX2 static float total(SumVector sum) {
+        float lanes[8];
+        _mm256_storeu_ps(lanes, sum);
+        return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+    }
+
+    MJL_TARGET_AVX2 static unsigned int compressStore(float* out, Vector v, unsigned int mask) {
+        __m256i permutation = _mm256_load_si256((const __m256i*) Avx2CompressTable::instance().permutations[mask]);
+        _mm256_storeu_ps(out, _mm256_permutevar8x32_ps(v, permutation));
+        return (unsigned int) __builtin_popcount(mask);
+    }
+};
+
+template<> struct Avx512Operations<int> {
+    typedef __m512i Vector;
+    typedef __m512i SumVector;
+    static const unsigned int LANES = 16;
+
+    MJL_TARGET_AVX512 static Vector load(const int* elements) {
+        return _mm512_loadu_si512((const void*) elements);
+    }
+
+    MJL_TARGET_AVX512 static Vector broadcast(int value) {
+        return _mm512_set1_epi32(value);
+    }
+
+    // AVX-512 compares straight into a mask register
+    template<SimdComparison Comparison> MJL_TARGET_AVX512 static unsigned int compare(Vector a, Vector b) {
+        switch (Comparison) {
+        case SIMD_EQUAL:
+            return _mm512_cmp_epi32_mask(a, b, _MM_CMPINT_EQ);
+        case SIMD_NOT_EQUAL:
+            return _mm512_cmp_epi32_mask(a, b, _MM_CMPINT_NE);
+        case SIMD_LESS:
+            return _mm512_cmp_epi32_mask(a, b, _MM_CMPINT_LT);
+        case SIMD_LESS_EQUAL:
+            return _mm512_cmp_epi32_mask(a, b, _MM_CMPINT_LE);
+        case SIMD_GREATER:
+            return _mm512_cmp_epi32_mask(a, b, _MM_CMPINT_NLE);
+        default:
+            return _mm512_cmp_epi32_mask(a, b, _MM_CMPINT_NLT);
+        }
+    }
+
+    MJL_TARGET_AVX512 static Vector min(Vector a, Vector b) {
+        return _mm512_min_epi32(a, b);
+    }
+
+    MJL_TARGET_AVX512 static Vector max(Vector a, Vector b) {
+        return _mm512_max_epi32(a, b);
+    }
+
+    MJL_TARGET_AVX512 static void store(int* out, Vector v) {
+        _mm512_storeu_si512((void*) out, v);
+    }
+
+    MJL_TARGET_AVX512 static SumVector zeroSum(void) {
+        return _mm512_setzero_si512();
+    }
+
+    MJL_TARGET_AVX512 static SumVector add(SumVector sum, Vector v) {
+        sum = _mm512_add_epi64(sum, _mm512_cvtepi32_epi64(_mm512_castsi512_si256(v)));
+        return _mm512_add_epi64(sum, _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(v, 1)));
+    }
+
+    MJL_TARGET_AVX512 static SumVector add(SumVector a, SumVector b, SumVector c, SumVector d) {
+        return _mm512_add_epi64(_mm512_add_epi64(a, b), _mm512_add_epi64(c, d));
+    }
+
+    MJL_TARGET_AVX512 static long long total(SumVector sum) {
+        return _mm512_reduce_add_epi64(sum);
+    }
+
+    // AVX-512 compresses in a register. Compressing straight into memory is much slower on some processors.
+    MJL_TARGET_AVX512 static unsigned int compressStore(int* out, Vector v, unsigned int mask) {
+        _mm512_storeu_si512((void*) out, _mm512_maskz_compress_epi32((__mmask16) mask, v));
+        return (unsigned int) __builtin_popcount(mask);
+    }
+};
+
+template<> struct Avx512Operations<float> {
+    typedef __m512 Vector;
+    typedef __m512 SumVector;
+    static const unsigned int LANES = 16;
+
+    MJL_TARGET_AVX512 static Vector load(const float* elements) {
+        return _mm512_loadu_ps(elements);
+    }
+
+    MJL_TARGET_AVX512 static Vector broadcast(float value) {
+        return _mm512_set1_ps(value);
+    }
+
+    template<SimdComparison Comparison> MJL_TARGET_AVX512 static unsigned int compare(Vector a, Vector b) {
+        switch (Comparison) {
+        case SIMD_EQUAL:
+            return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ);
+        case SIMD_NOT_EQUAL:
+            return _mm512_cmp_ps_mask(a, b, _CMP_NEQ_UQ);
+        case SIMD_LESS:
+            return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ);
+        case SIMD_LESS_EQUAL:
+            return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ);
+        case SIMD_GREATER:
+            return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ);
+        default:
+            return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ);
+        }
+    }
+
+    MJL_TARGET_AVX512 static Vector min(Vector a, Vector b) {
+        return _mm512_min_ps(a, b);
+    }
+
+    MJL_TARGET_AVX512 static Vector max(Vector a, Vector b) {
+        return _mm512_max_ps(a, b);
+    }
+
+    MJL_TARGET_AVX512 static void store(float* out, Vector v) {
+        _mm512_storeu_ps(out, v);
+    }
+
+    MJL_TARGET_AVX512 static SumVector zeroSum(void) {
+        return _mm512_setzero_ps();
+    }
+
+    MJL_TARGET_AVX512 static SumVector add(SumVector sum, Vector v) {
+        return _mm512_add_ps(sum, v);
+    }
+
+    MJL_TARGET_AVX512 static SumVector add(SumVector a, SumVector b, SumVector c, SumVector d) {
+        return _mm512_add_ps(_mm512_add_ps(a, b), _mm512_add_ps(c, d));
+    }
+
+    MJL_TARGET_AVX512 static float total(SumVector sum) {
+        return _mm512_reduce_add_ps(sum);
+    }
+
+    MJL_TARGET_AVX512 static unsigned int compressStore(float* out, Vector v, unsigned int mask) {
+        _mm512_storeu_ps(out, _mm512_maskz_compress_ps((__mmask16) mask, v));
+        return (unsigned int) __builtin_popcount(mask);
+    }
+};
+
+/*
+ * The kernels, written once over the operations above. They are always
+ * inlined into a function compiled for the instruction set of the
+ * operations (the entry points below), so the vectors never cross a
+ * function call that isn't compiled for them.
+ */
+
+#define MJL_KERNEL inline __attribute__((always_inline))
+
+template<typename Operations, typename T> MJL_KERNEL unsigned int vectorFind(const T* elements, unsigned int count,
+                T value) {
+    typename Operations::Vector wanted = Operations::broadcast(value);
+    unsigned int i = 0;
+    for (; i + Operations::LANES <= count; i += Operations::LANES) {
+        unsigned int mask = Operations::template compare<SIMD_EQUAL>(Operations::load(elements + i), wanted);
+        if (mask != 0) {
+            return i + (unsigned int) __builtin_ctz(mask);
+        }
+    }
+    return scalarFind(elements, i, count, value);
+}
+
+template<typename Operations, typename T> MJL_KERNEL unsigned int vectorCount(const T* elements, unsigned int count,
+                T value) {
+    typename Operations::Vector wanted = Operations::broadcast(value);
+    unsigned int found = 0;
+    unsigned int i = 0;
+    for (; i + Operations::LANES <= count; i += Operations::LANES) {
+        unsigned int mask = Operations::template compare<SIMD_EQUAL>(Operations::load(elements + i), wanted);
+        found += (unsigned int) __builtin_popcount(mask);
+    }
+    return found + scalarCount(elements, i, count, value);
+}
+
+/**
+ * The last few elements are covered by one more vector that ends at the end
+ * of the array and so overlaps the one before it, which doesn't matter to a
+ * minimum or a maximum.
+ */
+template<typename Operations, typename T> MJL_KERNEL std::pair<T, T> vectorMinMax(const T* elements,
+                unsigned int count) {
+    const unsigned int lanes = Operations::LANES;
+    if (count < lanes) {
+        return scalarMinMax(elements, count);
+    }
+
+    typename Operations::Vector lowest = Operations::load(elements);
+    typename Operations::Vector highest = lowest;
+    for (unsigned int i = lanes; i + lanes <= count; i += lanes) {
+        typename Operations::Vector v = Operations::load(elements + i);
+        lowest = Operations::min(lowest, v);
+        highest = Operations::max(highest, v);
+    }
+    typename Operations::Vector last = Operations::load(elements + count - lanes);
+    lowest = Operations::min(lowest, last);
+    highest = Operations::max(highest, last);
+
+    T lowestLanes[lanes];
+    T highestLanes[lanes];
+    Operations::store(lowestLanes, lowest);
+    Operations::store(highestLanes, highest);
+    std::pair<T, T> result = std::make_pair(lowestLanes[0], highestLanes[0]);
+    for (unsigned int lane = 1; lane < lanes; lane++) {
+        result.first = std::min(result.first, lowestLanes[lane]);
+        result.second = std::max(result.second, highestLanes[lane]);
+    }
+    return result;
+}
+
+// Four sums side by side, so that each addition doesn't wait for the one before it
+template<typename Operations, typename T> MJL_KERNEL typename SimdSum<T>::type vectorSum(const T* elements,
+                unsigned int count) {
+    const unsigned int lanes = Operations::LANES;
+    typename Operations::SumVector sum0 = Operations::zeroSum();
+    typename Operations::SumVector sum1 = sum0, sum2 = sum0, sum3 = sum0;
+
+    unsigned int i = 0;
+    for (; i + 4 * lanes <= count; i += 4 * lanes) {
+        sum0 = Operations::add(sum0, Operations::load(elements + i));
+        sum1 = Operations::add(sum1, Operations::load(elements + i + lanes));
+        sum2 = Operations::add(sum2, Operations::load(elements + i + 2 * lanes));
+        sum3 = Operations::add(sum3, Operations::load(elements + i + 3 * lanes));
+    }
+    for (; i + lanes <= count; i += lanes) {
+        sum0 = Operations::add(sum0, Operations::load(elements + i));
+    }
+    return Operations::total(Operations::add(sum0, sum1, sum2, sum3)) + scalarSum(elements, i, count);
+}
+
+/**
+ * The elements that pass are packed into a small buffer on the stack, a
+ * vector at a time, and the buffer is appended to the output whenever it
+ * fills up. That way the output grows a block at a time instead of being
+ * checked for room after every element.
+ */
+template<typename Operations, SimdComparison Comparison, typename T, typename Output> MJL_KERNEL void vectorFilter(
+                const T* elements, unsigned int count, T value, Output& output) {
+    const unsigned int lanes = Operations::LANES;
+    const unsigned int blockSize = 1024;
+    T block[blockSize + lanes];
+    unsigned int blockCount = 0;
+
+    typename Operations::Vector wanted = Operations::broadcast(value);
+    unsigned int i = 0;
+    for (; i + lanes <= count; i += lanes) {
+        typename Operations::Vector v = Operations::load(elements + i);
+        blockCount += Operations::compressStore(block + blockCount, v,
+                        Operations::template compare<Comparison>(v, wanted));
+        if (blockCount >= blockSize) {
+            output.append(block, block + blockCount);
+            blockCount = 0;
+        }
+    }
+    output.append(block, block + blockCount);
+    scalarFilter<Comparison>(elements, i, count, value, output);
+}
+
+template<typename Operations, typename T, typename Output> MJL_KERNEL void vectorFilter(const T* elements,
+                unsigned int count, SimdComparison comparison, T value, Output& output) {
+    switch (comparison) {
+    case SIMD_EQUAL:
+        return vectorFilter<Operations, SIMD_EQUAL>(elements, count, value, output);
+    case SIMD_NOT_EQUAL:
+        return vectorFilter<Operations, SIMD_NOT_EQUAL>(elements, count, value, output);
+    case SIMD_LESS:
+        return vectorFilter<Operations, SIMD_LESS>(elements, count, value, output);
+    case SIMD_LESS_EQUAL:
+        return vectorFilter<Operations, SIMD_LESS_EQUAL>(elements, count, value, output);
+    case SIMD_GREATER:
+        return vectorFilter<Operations, SIMD_GREATER>(elements, count, value, output);
+    default:
+        return vectorFilter<Operations, SIMD_GREATER_EQUAL>(elements, count, value, output);
+    }
+}
+
+#undef MJL_KERNEL
+
+/*
+ * The entry points, one per kernel and instruction set, each compiled for
+ * its instruction set so the kernel inlined into it can use it.
+ */
+template<typename T> MJL_TARGET_SSE42 unsigned int sse42Find(const T* elements, unsigned int count, T value) {
+    return vectorFind<Sse42Operations<T>>(elements, count, value);
+}
+
+template<typename T> MJL_TARGET_SSE42 unsigned int sse42Count(const T* elements, unsigned int count, T value) {
+    return vectorCount<Sse42Operations<T>>(elements, count, value);
+}
+
+template<typename T> MJL_TARGET_SSE42 std::pair<T, T> sse42MinMax(const T* elements, unsigned int count) {
+    return vectorMinMax<Sse42Operations<T>>(elements, count);
+}
+
+template<typename T> MJL_TARGET_SSE42 typename SimdSum<T>::type sse42Sum(const T* elements, unsigned int count) {
+    return vectorSum<Sse42Operations<T>>(elements, count);
+}
+
+template<typename T, typename Output> MJL_TARGET_SSE42 void sse42Filter(const T* elements, unsigned int count,
+                SimdComparison comparison, T value, Output& output) {
+    vectorFilter<Sse42Operations<T>>(elements, count, comparison, value, output);
+}
+
+template<typename T> MJL_TARGET_AVX2 unsigned int avx2Find(const T* elements, unsigned int count, T value) {
+    return vectorFind<Avx2Operations<T>>(elements, count, value);
+}
+
+template<typename T> MJL_TARGET_AVX2 unsigned int avx2Count(const T* elements, unsigned int count, T value) {
+    return vectorCount<Avx2Operations<T>>(elements, count, value);
+}
+
+template<typename T> MJL_TARGET_AVX2 std::pair<T, T> avx2MinMax(const T* elements, unsigned int count) {
+    return vectorMinMax<Avx2Operations<T>>(elements, count);
+}
+
+template<typename T> MJL_TARGET_AVX2 typename SimdSum<T>::type avx2Sum(const T* elements, unsigned int count) {
+    return vectorSum<Avx2Operations<T>>(elements, count);
+}
+
+template<typename T, typename Output> MJL_TARGET_AVX2 void avx2Filter(const T* elements, unsigned int count,
+                SimdComparison comparison, T value, Output& output) {
+    vectorFilter<Avx2Operations<T>>(elements, count, comparison, value, output);
+}
+
+template<typename T> MJL_TARGET_AVX512 unsigned int avx512Find(const T* elements, unsigned int count, T value) {
+    return vectorFind<Avx512Operations<T>>(elements, count, value);
+}
+
+template<typename T> MJL_TARGET_AVX512 unsigned int avx512Count(const T* elements, unsigned int count, T value) {
+    return vectorCount<Avx512Operations<T>>(elements, count, value);
+}
+
+template<typename T> MJL_TARGET_AVX512 std::pair<T, T> avx512MinMax(const T* elements, unsigned int count) {
+    return vectorMinMax<Avx512Operations<T>>(elements, count);
+}
+
+template<typename T> MJL_TARGET_AVX512 typename SimdSum<T>::type avx512Sum(const T* elements, unsigned int count) {
+    return vectorSum<Avx512Operations<T>>(elements, count);
+}
+
+template<typename T, typename Output> MJL_TARGET_AVX512 void avx512Filter(const T* elements, unsigned int count,
+                SimdComparison comparison, T value, Output& output) {
+    vectorFilter<Avx512Operations<T>>(elements, count, comparison, value, output);
+}
+
+#pragma GCC diagnostic pop
+
+// The kernels for the types with vector kernels pick the entry point for the level
+template<typename T> struct VectorKernels {
+    static unsigned int find(const T* elements, unsigned int count, T value, SimdLevel level) {
+        switch (level) {
+        case SIMD_AVX512:
+            return avx512Find(elements, count, value);
+        case SIMD_AVX2:
+            return avx2Find(elements, count, value);
+        case SIMD_SSE42:
+            return sse42Find(elements, count, value);
+        default:
+            return scalarFind(elements, 0, count, value);
+        }
+    }
+
+    static unsigned int countOf(const T* elements, unsigned int count, T value, SimdLevel level) {
+        switch (level) {
+        case SIMD_AVX512:
+            return avx512Count(elements, count, value);
+        case SIMD_AVX2:
+            return avx2Count(elements, count, value);
+        case SIMD_SSE42:
+            return sse42Count(elements, count, value);
+        default:
+            return scalarCount(elements, 0, count, value);
+        }
+    }
+
+    static std::pair<T, T> minMax(const T* elements, unsigned int count, SimdLevel level) {
+        switch (level) {
+        case SIMD_AVX512:
+            return avx512MinMax(elements, count);
+        case SIMD_AVX2:
+            return avx2MinMax(elements, count);
+        case SIMD_SSE42:
+            return sse42MinMax(elements, count);
+        default:
+            return scalarMinMax(elements, count);
+        }
+    }
+
+    static typename SimdSum<T>::type sum(const T* elements, unsigned int count, SimdLevel level) {
+        switch (level) {
+        case SIMD_AVX512:
+            return avx512Sum(elements, count);
+        case SIMD_AVX2:
+            return avx2Sum(elements, count);
+        case SIMD_SSE42:
+            return sse42Sum(elements, count);
+        default:
+            return scalarSum(elements, 0, count);
+        }
+    }
+
+    template<typename Output> static void filter(const T* elements, unsigned int count, SimdComparison comparison,
+                    T value, Output& output, SimdLevel level) {
+        switch (level) {
+        case SIMD_AVX512:
+            return avx512Filter(elements, count, comparison, value, output);
+        case SIMD_AVX2:
+            return avx2Filter(elements, count, comparison, value, output);
+        case SIMD_SSE42:
+            return sse42Filter(elements, count, comparison, value, output);
+        default:
+            return scalarFilter(elements, count, comparison, value, output);
+        }
+    }
+};
+
+template<> struct SimdKernels<int> : VectorKernels<int> {
+};
+
+template<> struct SimdKernels<float> : VectorKernels<float> {
+};
+
+#endif // MJL_SIMD_X86
+
+// The index of the first element equal to value, or the size of the array if there isn't one
+template<typename T, typename GrowthPolicy, typename StoragePolicy> unsigned int simdFind(
+                const DynamicArray<T, GrowthPolicy, StoragePolicy>& array, T value,
+                SimdLevel level = supportedSimdLevel()) {
+    static_assert(std::is_arithmetic<T>::value, "The SIMD kernels are for arrays of numbers");
+    checkSimdLevel(level);
+    return SimdKernels<T>::find(array.data(), array.size(), value, level);
+}
+
+// How many elements are equal to value
+template<typename T, typename GrowthPolicy, typename StoragePolicy> unsigned int simdCount(
+                const DynamicArray<T, GrowthPolicy, StoragePolicy>& array, T value,
+                SimdLevel level = supportedSimdLevel()) {
+    static_assert(std::is_arithmetic<T>::value, "The SIMD kernels are for arrays of numbers");
+    checkSimdLevel(level);
+    return SimdKernels<T>::countOf(array.data(), array.size(), value, level);
+}
+
+// The smallest and the largest element. Which one a NaN loses to is up to the instruction set.
+template<typename T, typename GrowthPolicy, typename StoragePolicy> std::pair<T, T> simdMinMax(
+                const DynamicArray<T, GrowthPolicy, StoragePolicy>& array, SimdLevel level = supportedSimdLevel()) {
+    static_assert(std::is_arithmetic<T>::value, "The SIMD kernels are for arrays of numbers");
+    checkSimdLevel(level);
+    if (array.size() == 0) {
+        throw std::out_of_range("Tried to get entry that does not exist.");
+    }
+    return SimdKernels<T>::minMax(array.data(), array.size(), level);
+}
+
+/**
+ * The sum of every element. The vector kernels add up several lanes side by
+ * side and add the lanes together at the end, so a sum of floats can round
+ * differently than adding them up from left to right would.
+ */
+template<typename T, typename GrowthPolicy, typename StoragePolicy> typename SimdSum<T>::type simdSum(
+                const DynamicArray<T, GrowthPolicy, StoragePolicy>& array, SimdLevel level = supportedSimdLevel()) {
+    static_assert(std::is_arithmetic<T>::value, "The SIMD kernels are for arrays of numbers");
+    checkSimdLevel(level);
+    return SimdKernels<T>::sum(array.data(), array.size(), level);
+}
+
+// Append every element of input that passes (element comparison value) to output, in order
+template<typename T, typename GrowthPolicy, typename StoragePolicy, typename OutputGrowthPolicy,
+                typename OutputStoragePolicy> void simdFilter(const DynamicArray<T, GrowthPolicy, StoragePolicy>& input,
+                SimdComparison comparison, T value, DynamicArray<T, OutputGrowthPolicy, OutputStoragePolicy>& output,
+                SimdLevel level = supportedSimdLevel()) {
+    static_assert(std::is_arithmetic<T>::value, "The SIMD kernels are for arrays of numbers");
+    checkSimdLevel(level);
+    if (&output == (const void*) &input) {
+        throw std::invalid_argument("simdFilter can't filter an array into itself.");
+    }
+    SimdKernels<T>::filter(input.data(), input.size(), comparison, value, output, level);
+}
+
+} /* namespace homebrew */
+} /* namespace mjl */
+
+#endif /* SIMD_KERNELS_H */
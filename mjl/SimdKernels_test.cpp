@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "SimdKernels.h"
+#include "SimdKernels_test.h"
+
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include <stdlib.h>
+
+using namespace std;
+using namespace mjl::homebrew;
+
+static const SimdComparison comparisons[] = { SIMD_EQUAL, SIMD_NOT_EQUAL, SIMD_LESS, SIMD_LESS_EQUAL, SIMD_GREATER,
+    SIMD_GREATER_EQUAL };
+
+// What simdCompare works out, spelled out again so the test doesn't trust the code it is testing
+template<typename T> static bool passes(T element, SimdComparison comparison, T value) {
+    switch (comparison) {
+    case SIMD_EQUAL:
+        return element == value;
+    case SIMD_NOT_EQUAL:
+        return element != value;
+    case SIMD_LESS:
+        return element < value;
+    case SIMD_LESS_EQUAL:
+        return element <= value;
+    case SIMD_GREATER:
+        return element > value;
+    default:
+        return element >= value;
+    }
+}
+
+/**
+ * Run every kernel at the given level over arrays of small whole numbers,
+ * whose sums are exact even in floats, at lengths around each vector width,
+ * and check them against plain loops.
+ */
+template<typename T> static bool testKernels(const char* typeName, SimdLevel level) {
+
+    cout << "Testing SIMD kernels for " << typeName << " at " << simdLevelName(level) << "\n";
+
+    const unsigned int lengths[] = { 0, 1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 64, 100, 1000, 4099 };
+
+    for (unsigned int length : lengths) {
+        DynamicArray<T> array;
+        vector<T> copy;
+        for (unsigned int i = 0; i < length; i++) {
+            array.push_back((T) (rand() % 101 - 50));
+            copy.push_back(array[i]);
+        }
+
+        for (int wanted = -60; wanted <= 60; wanted += 7) {
+            T value = (T) wanted;
+            unsigned int first = length;
+            unsigned int found = 0;
+            for (unsigned int i = 0; i < length; i++) {
+                if (copy[i] == value) {
+                    first = (found == 0) ? i : first;
+                    found++;
+                }
+            }
+            if (simdFind(array, value, level) != first || simdCount(array, value, level) != found) {
+                cerr << "find or count of " << wanted << " in " << length << " elements: got "
+                                << simdFind(array, value, level) << " and " << simdCount(array, value, level)
+                                << ", expected " << first << " and " << found << ".\n";
+                return false;
+            }
+
+            for (SimdComparison comparison : comparisons) {
+                DynamicArray<T> filtered;
+                filtered.push_back((T) 99);
+                simdFilter(array, comparison, value, filtered, level);
+
+                vector<T> expected(1, (T) 99);
+                for (T element : copy) {
+                    if (passes(element, comparison, value)) {
+                        expected.push_back(element);
+                    }
+                }
+                if (filtered.size() != expected.size()) {
+                    cerr << "Filter " << comparison << " against " << wanted << " kept " << filtered.size() - 1
+                                    << " of " << length << " elements, expected " << expected.size() - 1 << ".\n";
+                    return false;
+                }
+                for (unsigned int i = 0; i < expected.size(); i++) {
+                    if (filtered[i] != expected[i]) {
+                        cerr << "Filter " << comparison << " against " << wanted << " put " << filtered[i]
+                                        << " at " << i << ", expected " << expected[i] << ".\n";
+                        return false;
+                    }
+                }
+            }
+        }
+
+        typename SimdSum<T>::type sum = 0;
+        for (T element : copy) {
+            sum += element;
+        }
+        if (simdSum(array, level) != sum) {
+            cerr << "Sum of " << length << " elements is " << simdSum(array, level) << ", expected " << sum << ".\n";
+            return false;
+        }
+
+        if (length > 0) {
+            T lowest = copy[0], highest = copy[0];
+            for (T element : copy) {
+                lowest = min(lowest, element);
+                highest = max(highest, element);
+            }
+            pair<T, T> minMax = simdMinMax(array, level);
+            if (minMax.first != lowest || minMax.second != highest) {
+                cerr << "minmax of " << length << " elements is " << minMax.first << ", " << minMax.second
+                                << ", expected " << lowest << ", " << highest << ".\n";
+                return false;
+            }
+        }
+    }
+
+    // The extremes of the type, in the last lane of a vector and in the leftovers after the last vector
+    for (unsigned int length : { 16u, 35u }) {
+        DynamicArray<T> array(length, (T) 0);
+        array[length - 1] = numeric_limits<T>::lowest();
+        array[length / 2] = numeric_limits<T>::max();
+        pair<T, T> minMax = simdMinMax(array, level);
+        if (minMax.first != numeric_limits<T>::lowest() || minMax.second != numeric_limits<T>::max()
+                        || simdFind(array, numeric_limits<T>::lowest(), level) != length - 1) {
+            cerr << "The extremes of " << typeName << " got lost in " << length << " elements.\n";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool testEdgeCases(void) {
+
+    cout << "Testing SIMD kernel edge cases\n";
+
+    // A sum of ints is kept in 64 bits at every level
+    DynamicArray<int> large(1000, numeric_limits<int>::max());
+    for (int level = SIMD_SCALAR; level <= supportedSimdLevel(); level++) {
+        if (simdSum(large, (SimdLevel) level) != 1000LL * numeric_limits<int>::max()) {
+            cerr << "A sum of ints overflowed at " << simdLevelName((SimdLevel) level) << ".\n";
+            return false;
+        }
+    }
+
+    // A NaN is only ever not equal
+    DynamicArray<float> withNan(40, 1.0f);
+    withNan[21] = numeric_limits<float>::quiet_NaN();
+    for (int level = SIMD_SCALAR; level <= supportedSimdLevel(); level++) {
+        DynamicArray<float> notEqual, lessEqual;
+        simdFilter(withNan, SIMD_NOT_EQUAL, 1.0f, notEqual, (SimdLevel) level);
+        simdFilter(withNan, SIMD_LESS_EQUAL, 1.0f, lessEqual, (SimdLevel) level);
+        if (notEqual.size() != 1 || notEqual[0] == notEqual[0] || lessEqual.size() != 39
+                        || simdCount(withNan, numeric_limits<float>::quiet_NaN(), (SimdLevel) level) != 0) {
+            cerr << "NaN was compared wrong at " << simdLevelName((SimdLevel) level) << ".\n";
+            return false;
+        }
+    }
+
+    DynamicArray<int> empty;
+    try {
+        simdMinMax(empty);
+        cerr << "simdMinMax of an empty array should throw.\n";
+        return false;
+    } catch (out_of_range&) {
+    }
+
+    try {
+        simdFilter(large, SIMD_EQUAL, 1, large);
+        cerr << "simdFilter into its own input should throw.\n";
+        return false;
+    } catch (invalid_argument&) {
+    }
+
+    if (supportedSimdLevel() < SIMD_AVX512) {
+        try {
+            simdSum(large, SIMD_AVX512);
+            cerr << "Asking for a level the CPU doesn't have should throw.\n";
+            return false;
+        } catch (invalid_argument&) {
+        }
+    }
+
+    return true;
+}
+
+bool runSimdKernelsTests(void) {
+
+    srand(2718);
+    cout << "This CPU runs " << simdLevelName(supportedSimdLevel()) << " kernels\n";
+
+    for (int level = SIMD_SCALAR; level <= supportedSimdLevel(); level++) {
+        if (!testKernels<int>("int", (SimdLevel) level) || !testKernels<float>("float", (SimdLevel) level)) {
+            return false;
+        }
+    }
+
+    // Types without vector kernels take the plain loops at any level
+    if (!testKernels<double>("double", supportedSimdLevel()) || !testKernels<short>("short", supportedSimdLevel())
+                    || !testKernels<long long>("long long", supportedSimdLevel())) {
+        return false;
+    }
+
+    return testEdgeCases();
+}
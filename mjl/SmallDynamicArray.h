@@ -0,0 +1,418 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef SMALL_DYNAMIC_ARRAY_H
+#define SMALL_DYNAMIC_ARRAY_H
+
+#include "DynamicArray.h"
+#include "DynamicArrayGrowthPolicy.h"
+#include "DynamicArrayStoragePolicy.h"
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace mjl {
+namespace homebrew {
+
+/*********************
+ * Table of contents *
+ *********************
+ *
+ * SmallDynamicArray<T, N, GrowthPolicy, StoragePolicy> class
+ *
+ *     SmallDynamicArray()
+ *     SmallDynamicArray(unsigned int count, const T& data)
+ *     SmallDynamicArray(const SmallDynamicArray& from)
+ *     SmallDynamicArray(SmallDynamicArray&& from)
+ *     SmallDynamicArray& operator=(const SmallDynamicArray& from)
+ *     SmallDynamicArray& operator=(SmallDynamicArray&& from)
+ *     virtual ~SmallDynamicArray()
+ *
+ *     iterator begin(void)
+ *     iterator end(void)
+ *     const_iterator begin(void) const
+ *     const_iterator end(void) const
+ *     T* data(void)
+ *     const T* data(void) const
+ *     T& operator[](unsigned int i)
+ *     const T& operator[](unsigned int i) const
+ *     void append(const T& data)
+ *     void append(T&& data)
+ *     void push_back(const T& data)
+ *     void push_back(T&& data)
+ *     T& emplace_back(Args&&... args)
+ *     void reserve(unsigned int count)
+ *     unsigned int size(void) const
+ *     unsigned int capacity(void) const
+ *     bool isSmall(void) const
+ *     void clear(void)
+ *
+ */
+
+/**
+ * A DynamicArray that keeps its first N elements inside the object itself,
+ * and only allocates once it holds more than that. An array that never
+ * grows past N elements never touches the heap at all, which makes short
+ * lived arrays of a few elements as cheap as a local variable.
+ *
+ * Past N elements it grows like a DynamicArray (see DynamicArrayGrowthPolicy.h
+ * and IsTriviallyRelocatable in DynamicArray.h), in storage from StoragePolicy
+ * (see DynamicArrayStoragePolicy.h), and stays on the heap until
+ * it is destroyed, even if it is cleared. Moving a small array moves its
+ * elements one by one, since there is no block to hand over.
+ */
+template<typename T, unsigned int N, typename GrowthPolicy = DoublingGrowthPolicy,
+                typename StoragePolicy = MallocStorage> class SmallDynamicArray {
+ public:
+    static_assert(N > 0, "A SmallDynamicArray with no inline elements is just a DynamicArray");
+    static_assert(alignof(T) <= StoragePolicy::ALIGNMENT, "The storage policy can't align storage for T");
+
+    typedef T* iterator;
+    typedef const T* const_iterator;
+
+    SmallDynamicArray()
+                    : array(inlineElements()),
+                      theSize(0),
+                      theCapacity(N) {
+    }
+
+    // Initialize count copies of data
+    SmallDynamicArray(unsigned int count, const T& data)
+                    : array(inlineElements()),
+                      theSize(0),
+                      theCapacity(N) {
+
+        reserve(count);
+
+        for (unsigned int i = 0; i < count; i++) {
+            push_back(data);
+        }
+    }
+
+    // Copy constructor
+    SmallDynamicArray(const SmallDynamicArray& from)
+                    : array(inlineElements()),
+                      theSize(0),
+                      theCapacity(N) {
+
+        reserve(from.theSize);
+
+        for (unsigned int i = 0; i < from.theSize; i++) {
+            push_back(from.array[i]);
+        }
+    }
+
+    // Move constructor
+    SmallDynamicArray(SmallDynamicArray&& from) noexcept(std::is_nothrow_move_constructible<T>::value)
+                    : array(inlineElements()),
+                      theSize(0),
+                      theCapacity(N) {
+        takeFrom(from);
+    }
+
+    // Copy assignment operator
+    SmallDynamicArray& operator=(const SmallDynamicArray& from) {
+
+        if (this == &from) {
+            return *this;
+        }
+
+        // Keep the storage if it is large enough already
+        clear();
+        reserve(from.theSize);
+
+        for (unsigned int i = 0; i < from.theSize; i++) {
+            push_back(from.array[i]);
+        }
+
+        return *this;
+    }
+
+    // Move assignment operator
+    SmallDynamicArray& operator=(SmallDynamicArray&& from) noexcept(std::is_nothrow_move_constructible<T>::value) {
+
+        if (this == &from) {
+            return *this;
+        }
+
+        commonDelete();
+        array = inlineElements();
+        theCapacity = N;
+        takeFrom(from);
+
+        return *this;
+    }
+
+    virtual ~SmallDynamicArray() {
+        commonDelete();
+    }
+
+    iterator begin(void) {
+        return array;
+    }
+
+    iterator end(void) {
+        return array + theSize;
+    }
+
+    const_iterator begin(void) const {
+        return array;
+    }
+
+    const_iterator end(void) const {
+        return array + theSize;
+    }
+
+    // Points at the inline buffer while the array is small, and at the heap storage after it spills
+    T* data(void) {
+        return array;
+    }
+
+    const T* data(void) const {
+        return array;
+    }
+
+    T& operator[](unsigned int i) {
+        return array[i];
+    }
+
+    const T& operator[](unsigned int i) const {
+        return array[i];
+    }
+
+    void append(const T& data) {
+        emplace_back(data);
+    }
+
+    void append(T&& data) {
+        emplace_back(std::move(data));
+    }
+
+    void push_back(const T& data) {
+        emplace_back(data);
+    }
+
+    void push_back(T&& data) {
+        emplace_back(std::move(data));
+    }
+
+    /**
+     * Construct a new element at the end from whatever arguments its
+     * constructor takes, and return it. The arguments may refer to elements
+     * of the array itself.
+     */
+    template<typename... Args> T& emplace_back(Args&&... args) {
+
+        if (theSize == theCapacity) {
+            return growAndEmplace(GrowthPolicy::grow(theCapacity), std::forward<Args>(args)...);
+        }
+
+        new (&array[theSize]) T(std::forward<Args>(args)...);
+        return array[theSize++];
+    }
+
+    // Make room for count elements in total, so appending up to there never reallocates
+    void reserve(unsigned int count) {
+
+        if (count <= theCapacity) {
+            return;
+        }
+
+        T* newArray = allocate(count);
+
+        try {
+            relocateTo(newArray);
+        } catch (...) {
+            StoragePolicy::deallocate(newArray, (size_t) count * sizeof(T));
+            throw;
+        }
+
+        theCapacity = count;
+    }
+
+    unsigned int size(void) const {
+        return theSize;
+    }
+
+    unsigned int capacity(void) const {
+        return theCapacity;
+    }
+
+    // Whether the elements are still stored inside the object
+    bool isSmall(void) const {
+        return array == inlineElements();
+    }
+
+    // Destroy every element, but keep the storage for reuse
+    void clear(void) {
+        destroyElements();
+        theSize = 0;
+    }
+
+ private:
+
+    T* inlineElements(void) {
+        return reinterpret_cast<T*>(inlineStorage);
+    }
+
+    const T* inlineElements(void) const {
+        return reinterpret_cast<const T*>(inlineStorage);
+    }
+
+    /**
+     * Grow to newCapacity and append an element. The new element is built in
+     * the new storage first, because the arguments may refer to elements
+     * that are about to move. A trivially relocatable array already on the
+     * heap is simply reallocated, with the new element built on the side.
+     */
+    template<typename... Args> T& growAndEmplace(unsigned int newCapacity, Args&&... args) {
+
+        if (IsTriviallyRelocatable<T>::value && !isSmall()) {
+
+            alignas(T) unsigned char pending[sizeof(T)];
+            T* element = new (pending) T(std::forward<Args>(args)...);
+
+            T* newArray;
+            try {
+                newArray = static_cast<T*>(StoragePolicy::reallocate(array, (size_t) theCapacity * sizeof(T),
+                                (size_t) newCapacity * sizeof(T), (size_t) theSize * sizeof(T)));
+            } catch (...) {
+                element->~T();
+                throw;
+            }
+
+            array = newArray;
+            theCapacity = newCapacity;
+            memcpy(static_cast<void*>(&array[theSize]), pending, sizeof(T));
+            return array[theSize++];
+        }
+
+        T* newArray = allocate(newCapacity);
+
+        try {
+            new (&newArray[theSize]) T(std::forward<Args>(args)...);
+        } catch (...) {
+            StoragePolicy::deallocate(newArray, (size_t) newCapacity * sizeof(T));
+            throw;
+        }
+
+        try {
+            relocateTo(newArray);
+        } catch (...) {
+            newArray[theSize].~T();
+            StoragePolicy::deallocate(newArray, (size_t) newCapacity * sizeof(T));
+            throw;
+        }
+
+        theCapacity = newCapacity;
+        return array[theSize++];
+    }
+
+    static T* allocate(unsigned int count) {
+        return static_cast<T*>(StoragePolicy::allocate((size_t) count * sizeof(T)));
+    }
+
+    // Move every element into newArray, and free the old storage if it was on the heap
+    void relocateTo(T* newArray) {
+        relocateElements(array, newArray, theSize);
+        freeStorage();
+        array = newArray;
+    }
+
+    /**
+     * Move count elements to new storage and end the old ones. Trivially
+     * relocatable elements are copied byte for byte and the old bytes simply
+     * forgotten. Others are move constructed and then destroyed, or copied if
+     * their move constructor might throw, so if anything throws the old
+     * elements are left as they were.
+     */
+    static void relocateElements(T* from, T* to, unsigned int count) {
+
+        if (IsTriviallyRelocatable<T>::value) {
+            memcpy(static_cast<void*>(to), static_cast<const void*>(from), (size_t) count * sizeof(T));
+            return;
+        }
+
+        unsigned int i = 0;
+
+        try {
+            for (; i < count; i++) {
+                new (&to[i]) T(std::move_if_noexcept(from[i]));
+            }
+        } catch (...) {
+            while (i > 0) {
+                to[--i].~T();
+            }
+            throw;
+        }
+
+        for (i = 0; i < count; i++) {
+            from[i].~T();
+        }
+    }
+
+    // Take the elements of from, which is left empty and small. This array must be empty and small.
+    void takeFrom(SmallDynamicArray& from) {
+
+        if (from.isSmall()) {
+            relocateElements(from.array, array, from.theSize);
+        } else {
+            array = from.array;
+            theCapacity = from.theCapacity;
+            from.array = from.inlineElements();
+            from.theCapacity = N;
+        }
+
+        theSize = from.theSize;
+        from.theSize = 0;
+    }
+
+    void destroyElements(void) {
+        for (unsigned int i = 0; i < theSize; i++) {
+            array[i].~T();
+        }
+    }
+
+    void freeStorage(void) {
+        if (!isSmall()) {
+            StoragePolicy::deallocate(array, (size_t) theCapacity * sizeof(T));
+        }
+    }
+
+    void commonDelete(void) {
+        destroyElements();
+        freeStorage();
+    }
+
+    T* array;                   // Either inlineStorage or a heap block
+    unsigned int theSize;       // How many elements is the array holding
+    unsigned int theCapacity;   // How many elements can be held without resizing
+    alignas(T) unsigned char inlineStorage[N * sizeof(T)];
+};
+
+}    // end namespace homebrew
+}    // end namespace mjl
+
+#endif // SMALL_DYNAMIC_ARRAY_H
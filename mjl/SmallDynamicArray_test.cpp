@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "SmallDynamicArray.h"
+#include "SmallDynamicArray_test.h"
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+using namespace std;
+using namespace mjl::homebrew;
+
+// A unique_ptr only holds a pointer, so its bytes can be moved like any other pointer
+namespace mjl {
+namespace homebrew {
+template<> struct IsTriviallyRelocatable<unique_ptr<string>> : std::true_type {
+};
+}
+}
+
+// Counts the elements alive, to check that moving between inline storage and the heap leaves nothing behind
+class LiveCounter {
+ public:
+    LiveCounter(int theId)
+                    : id(theId) {
+        live++;
+    }
+    LiveCounter(const LiveCounter& from)
+                    : id(from.id) {
+        live++;
+    }
+    LiveCounter(LiveCounter&& from) noexcept
+                    : id(from.id) {
+        live++;
+    }
+    ~LiveCounter() {
+        live--;
+    }
+    LiveCounter& operator=(const LiveCounter& from) {
+        id = from.id;
+        return *this;
+    }
+    int id;
+    static int live;
+};
+
+int LiveCounter::live = 0;
+
+// Element i of every array in these tests holds i
+template<typename Array> static bool holdsSequence(const char* what, const Array& array, unsigned int count) {
+
+    if (array.size() != count) {
+        cerr << what << " holds " << array.size() << " elements, expected " << count << ".\n";
+        return false;
+    }
+
+    int expected = 0;
+    for (auto it = array.begin(); it != array.end(); ++it) {
+        if (*it != expected) {
+            cerr << what << " element " << expected << " is " << *it << ".\n";
+            return false;
+        }
+        expected++;
+    }
+
+    return true;
+}
+
+bool runSmallDynamicArrayTests(void) {
+
+    cout << "Testing SmallDynamicArray stays inline up to N elements\n";
+    SmallDynamicArray<int, 16> small;
+    for (int i = 0; i < 16; i++) {
+        small.append(i);
+        if (!small.isSmall() || small.capacity() != 16) {
+            cerr << "SmallDynamicArray left its inline storage at " << i + 1 << " elements.\n";
+            return false;
+        }
+    }
+    if (!holdsSequence("Inline array", small, 16)) {
+        return false;
+    }
+
+    cout << "Testing SmallDynamicArray spills to the heap\n";
+    SmallDynamicArray<int, 16> large(small);
+    for (int i = 16; i < 1000; i++) {
+        large.push_back(i);
+    }
+    if (large.isSmall() || !holdsSequence("Spilled array", large, 1000) || !holdsSequence("Copy", small, 16)) {
+        return false;
+    }
+
+    cout << "Testing SmallDynamicArray copy and move, small and spilled\n";
+    SmallDynamicArray<int, 16> movedSmall(std::move(small));
+    SmallDynamicArray<int, 16> movedLarge(std::move(large));
+    if (!holdsSequence("Moved inline array", movedSmall, 16) || !holdsSequence("Moved heap array", movedLarge, 1000)
+                    || small.size() != 0 || large.size() != 0 || !large.isSmall()) {
+        return false;
+    }
+    small = movedLarge;
+    large = std::move(movedSmall);
+    movedLarge.clear();
+    if (!holdsSequence("Copy assigned array", small, 1000) || !holdsSequence("Move assigned array", large, 16)
+                    || !large.isSmall() || movedLarge.size() != 0) {
+        return false;
+    }
+
+    cout << "Testing SmallDynamicArray destroys exactly what it constructs\n";
+    {
+        SmallDynamicArray<LiveCounter, 4> counters;
+        for (int i = 0; i < 3; i++) {
+            counters.emplace_back(i);
+        }
+        SmallDynamicArray<LiveCounter, 4> inlineMove(std::move(counters));
+        for (int i = 0; i < 100; i++) {
+            counters.emplace_back(i);
+        }
+        SmallDynamicArray<LiveCounter, 4> heapMove(std::move(counters));
+        counters = inlineMove;
+        if (LiveCounter::live != 106 || heapMove[99].id != 99 || counters[2].id != 2) {
+            cerr << LiveCounter::live << " elements alive, expected 106.\n";
+            return false;
+        }
+    }
+    if (LiveCounter::live != 0) {
+        cerr << LiveCounter::live << " elements were never destroyed.\n";
+        return false;
+    }
+
+    // Appending an element of the array itself, right as it leaves its inline storage
+    cout << "Testing SmallDynamicArray appending its own elements\n";
+    SmallDynamicArray<string, 2> strings;
+    strings.push_back(string(100, 'x'));
+    while (strings.size() < 100) {
+        strings.push_back(strings[0]);
+    }
+    for (unsigned int i = 0; i < strings.size(); i++) {
+        if (strings[i] != string(100, 'x')) {
+            cerr << "Appending an element to its own array corrupted element " << i << ".\n";
+            return false;
+        }
+    }
+
+    cout << "Testing SmallDynamicArray of trivially relocatable unique_ptrs\n";
+    SmallDynamicArray<unique_ptr<string>, 8> pointers;
+    for (int i = 0; i < 1000; i++) {
+        pointers.emplace_back(new string(to_string(i)));
+    }
+    SmallDynamicArray<unique_ptr<string>, 8> movedPointers(std::move(pointers));
+    for (int i = 0; i < 1000; i++) {
+        if (*movedPointers[i] != to_string(i)) {
+            cerr << "unique_ptr " << i << " points to the wrong value.\n";
+            return false;
+        }
+    }
+
+    SmallDynamicArray<int, 4> filled(3, 7);
+    SmallDynamicArray<int, 4, OneAndAHalfGrowthPolicy> reserved;
+    reserved.reserve(100);
+    if (filled.size() != 3 || filled[2] != 7 || !filled.isSmall() || reserved.capacity() != 100
+                    || reserved.isSmall()) {
+        cerr << "Count constructor or reserve is wrong.\n";
+        return false;
+    }
+
+    // AlignedStorage can't realloc, so a spilled array of ints grows by copying instead
+    cout << "Testing SmallDynamicArray with another storage policy\n";
+    SmallDynamicArray<int, 4, DoublingGrowthPolicy, CacheLineAlignedStorage> aligned;
+    for (int i = 0; i < 1000; i++) {
+        aligned.push_back(i);
+    }
+    if (!holdsSequence("Cache line aligned array", aligned, 1000)
+                    || reinterpret_cast<uintptr_t>(aligned.data()) % 64 != 0) {
+        cerr << "Cache line aligned array is misaligned.\n";
+        return false;
+    }
+
+    return true;
+}
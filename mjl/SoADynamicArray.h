@@ -0,0 +1,397 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef SOA_DYNAMIC_ARRAY_H
+#define SOA_DYNAMIC_ARRAY_H
+
+#include "DynamicArray.h"
+#include "DynamicArrayGrowthPolicy.h"
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <stdlib.h>
+
+namespace mjl {
+namespace homebrew {
+
+/*********************
+ * Table of contents *
+ *********************
+ *
+ * ArraySpan<T> class
+ *
+ *     ArraySpan(T* theElements, size_t theCount)
+ *     T* data(void) const
+ *     size_t size(void) const
+ *     T& operator[](size_t i) const
+ *     T* begin(void) const
+ *     T* end(void) const
+ *
+ * SoADynamicArray<Fields...> class
+ *
+ *     SoADynamicArray()
+ *     SoADynamicArray(const SoADynamicArray& from)
+ *     SoADynamicArray(SoADynamicArray&& from)
+ *     SoADynamicArray& operator=(const SoADynamicArray& from)
+ *     SoADynamicArray& operator=(SoADynamicArray&& from)
+ *     virtual ~SoADynamicArray()
+ *
+ *     reference operator[](unsigned int i)
+ *     const_reference operator[](unsigned int i) const
+ *     value_type row(unsigned int i) const
+ *     ColumnType<Column>& get<Column>(unsigned int i)
+ *     const ColumnType<Column>& get<Column>(unsigned int i) const
+ *     ArraySpan<ColumnType<Column>> column<Column>(void)
+ *     ArraySpan<const ColumnType<Column>> column<Column>(void) const
+ *     void append(Fields... values)
+ *     void push_back(const value_type& values)
+ *     void reserve(unsigned int count)
+ *     unsigned int size(void) const
+ *     unsigned int capacity(void) const
+ *     void clear(void)
+ *
+ */
+
+// A view of count elements in a row, starting at elements. It doesn't own them.
+template<typename T> class ArraySpan {
+ public:
+    typedef T* iterator;
+
+    ArraySpan(T* theElements, size_t theCount)
+                    : elements(theElements),
+                      count(theCount) {
+    }
+
+    T* data(void) const {
+        return elements;
+    }
+
+    size_t size(void) const {
+        return count;
+    }
+
+    T& operator[](size_t i) const {
+        return elements[i];
+    }
+
+    T* begin(void) const {
+        return elements;
+    }
+
+    T* end(void) const {
+        return elements + count;
+    }
+
+ private:
+    T* elements;
+    size_t count;
+};
+
+// All of a list of conditions hold when shifting the list by a true doesn't change it
+template<bool... Conditions> struct SoAConditions {
+};
+
+/**
+ * An array of rows, each made of one value of every type in Fields, that is
+ * stored one column at a time: every field has its own contiguous array, and
+ * row i is element i of each of them. A pass that only looks at one or two
+ * fields then reads nothing but those fields, instead of dragging whole rows
+ * through the cache, and a column can be handed to a loop the compiler
+ * vectorizes (or to hand written SIMD) through column<Column>().
+ *
+ * Rows are appended and indexed like a DynamicArray. soa[i] is a tuple of
+ * references to the fields of row i, so std::get<1>(soa[i]) = x writes a
+ * field, and std::tie(a, b) = soa[i] reads a row. get<Column>(i) goes to a
+ * single field directly.
+ *
+ * Every column starts on a cache line (COLUMN_ALIGNMENT), which is enough
+ * for aligned loads of any vector width up to 512 bits. All the columns
+ * share one capacity, which grows like a DynamicArray with the default
+ * growth policy. Fields have to be nothrow movable, so that growing can move
+ * every column without having to undo anything halfway through.
+ */
+template<typename... Fields> class SoADynamicArray {
+ public:
+    static const size_t COLUMN_ALIGNMENT = 64;
+
+    static_assert(sizeof...(Fields) > 0, "A SoADynamicArray needs at least one field");
+    static_assert(std::is_same<SoAConditions<true, std::is_nothrow_move_constructible<Fields>::value...>,
+                    SoAConditions<std::is_nothrow_move_constructible<Fields>::value..., true>>::value,
+                    "Every field has to be nothrow move constructible");
+    static_assert(std::is_same<SoAConditions<true, (alignof(Fields) <= COLUMN_ALIGNMENT)...>,
+                    SoAConditions<(alignof(Fields) <= COLUMN_ALIGNMENT)..., true>>::value,
+                    "A field can't need more alignment than a column starts with");
+
+
+    typedef std::tuple<Fields...> value_type;
+    typedef std::tuple<Fields&...> reference;
+    typedef std::tuple<const Fields&...> const_reference;
+
+    template<size_t Column> using ColumnType = typename std::tuple_element<Column, value_type>::type;
+
+    SoADynamicArray()
+                    : columns(),
+                      theSize(0),
+                      theCapacity(0) {
+    }
+
+    // Copy constructor
+    SoADynamicArray(const SoADynamicArray& from)
+                    : columns(),
+                      theSize(0),
+                      theCapacity(0) {
+
+        reserve(from.theSize);
+
+        for (unsigned int i = 0; i < from.theSize; i++) {
+            push_back(from.row(i));
+        }
+    }
+
+    // Move constructor
+    SoADynamicArray(SoADynamicArray&& from) noexcept
+                    : columns(from.columns),
+                      theSize(from.theSize),
+                      theCapacity(from.theCapacity) {
+        from.columns = std::tuple<Fields*...>();
+        from.theSize = 0;
+        from.theCapacity = 0;
+    }
+
+    // Copy assignment operator
+    SoADynamicArray& operator=(const SoADynamicArray& from) {
+
+        if (this == &from) {
+            return *this;
+        }
+
+        // Keep the storage if it is large enough already
+        clear();
+        reserve(from.theSize);
+
+        for (unsigned int i = 0; i < from.theSize; i++) {
+            push_back(from.row(i));
+        }
+
+        return *this;
+    }
+
+    // Move assignment operator
+    SoADynamicArray& operator=(SoADynamicArray&& from) noexcept {
+
+        if (this == &from) {
+            return *this;
+        }
+
+        commonDelete();
+
+        columns = from.columns;
+        theSize = from.theSize;
+        theCapacity = from.theCapacity;
+
+        from.columns = std::tuple<Fields*...>();
+        from.theSize = 0;
+        from.theCapacity = 0;
+
+        return *this;
+    }
+
+    virtual ~SoADynamicArray() {
+        commonDelete();
+    }
+
+    reference operator[](unsigned int i) {
+        return rowReference<reference>(*this, i, Indices());
+    }
+
+    const_reference operator[](unsigned int i) const {
+        return rowReference<const_reference>(*this, i, Indices());
+    }
+
+    // A copy of row i
+    value_type row(unsigned int i) const {
+        return rowReference<value_type>(*this, i, Indices());
+    }
+
+    template<size_t Column> ColumnType<Column>& get(unsigned int i) {
+        return std::get<Column>(columns)[i];
+    }
+
+    template<size_t Column> const ColumnType<Column>& get(unsigned int i) const {
+        return std::get<Column>(columns)[i];
+    }
+
+    // Every value of one field, in row order, aligned to COLUMN_ALIGNMENT. Appending past capacity invalidates it.
+    template<size_t Column> ArraySpan<ColumnType<Column>> column(void) {
+        return ArraySpan<ColumnType<Column>>(std::get<Column>(columns), theSize);
+    }
+
+    template<size_t Column> ArraySpan<const ColumnType<Column>> column(void) const {
+        return ArraySpan<const ColumnType<Column>>(std::get<Column>(columns), theSize);
+    }
+
+    /**
+     * Append a row. The values are taken by value, so they may come from
+     * the array itself, and are moved into the columns once there is room,
+     * which can't fail.
+     */
+    void append(Fields... values) {
+
+        if (theSize == theCapacity) {
+            reallocate(nextCapacity(), Indices());
+        }
+
+        constructRow(Indices(), values...);
+        theSize++;
+    }
+
+    void push_back(const value_type& values) {
+        appendTuple(values, Indices());
+    }
+
+    // Make room for count rows in total, so appending up to there never reallocates
+    void reserve(unsigned int count) {
+        if (count > theCapacity) {
+            reallocate(count, Indices());
+        }
+    }
+
+    unsigned int size(void) const {
+        return theSize;
+    }
+
+    unsigned int capacity(void) const {
+        return theCapacity;
+    }
+
+    // Destroy every row, but keep the columns for reuse
+    void clear(void) {
+        destroyRows(Indices());
+        theSize = 0;
+    }
+
+ private:
+    typedef std::index_sequence_for<Fields...> Indices;
+
+    unsigned int nextCapacity(void) const {
+        return (theCapacity < initialArrayCapacity) ? initialArrayCapacity : DoublingGrowthPolicy::grow(theCapacity);
+    }
+
+    template<typename Row, typename Array, size_t... I> static Row rowReference(Array& array, unsigned int i,
+                    std::index_sequence<I...>) {
+        return Row(std::get<I>(array.columns)[i]...);
+    }
+
+    template<size_t... I> void appendTuple(const value_type& values, std::index_sequence<I...>) {
+        append(std::get<I>(values)...);
+    }
+
+    // Move each value into the next free slot of its column. The braces are there to do it in order.
+    template<size_t... I> void constructRow(std::index_sequence<I...>, Fields&... values) {
+        int constructed[] = { (new (&std::get<I>(columns)[theSize]) Fields(std::move(values)), 0)... };
+        (void) constructed;
+    }
+
+    /**
+     * Allocate every new column before touching the old ones, so that if
+     * one allocation fails the array is left as it was. Moving the rows
+     * over can't fail.
+     */
+    template<size_t... I> void reallocate(unsigned int newCapacity, std::index_sequence<I...>) {
+
+        std::tuple<Fields*...> newColumns;
+        try {
+            int allocated[] = { (std::get<I>(newColumns) = allocateColumn<Fields>(newCapacity), 0)... };
+            (void) allocated;
+        } catch (...) {
+            int freed[] = { (free(std::get<I>(newColumns)), 0)... };
+            (void) freed;
+            throw;
+        }
+
+        int relocated[] = { (relocateColumn(std::get<I>(columns), std::get<I>(newColumns), theSize,
+                        IsTriviallyRelocatable<Fields>()), 0)... };
+        (void) relocated;
+
+        columns = newColumns;
+        theCapacity = newCapacity;
+    }
+
+    template<typename T> static T* allocateColumn(unsigned int count) {
+        void* memory = nullptr;
+        if (posix_memalign(&memory, COLUMN_ALIGNMENT, (size_t) count * sizeof(T)) != 0) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(memory);
+    }
+
+    // Move count elements from one column to another, and free the old one
+    template<typename T> static void relocateColumn(T* from, T* to, unsigned int count, std::true_type) {
+        if (count > 0) {
+            memcpy(static_cast<void*>(to), static_cast<const void*>(from), (size_t) count * sizeof(T));
+        }
+        free(from);
+    }
+
+    template<typename T> static void relocateColumn(T* from, T* to, unsigned int count, std::false_type) {
+        for (unsigned int i = 0; i < count; i++) {
+            new (&to[i]) T(std::move(from[i]));
+            from[i].~T();
+        }
+        free(from);
+    }
+
+    template<size_t... I> void destroyRows(std::index_sequence<I...>) {
+        int destroyed[] = { (destroyColumn(std::get<I>(columns), theSize), 0)... };
+        (void) destroyed;
+    }
+
+    template<typename T> static void destroyColumn(T* column, unsigned int count) {
+        for (unsigned int i = 0; i < count; i++) {
+            column[i].~T();
+        }
+    }
+
+    template<size_t... I> void freeColumns(std::index_sequence<I...>) {
+        int freed[] = { (free(std::get<I>(columns)), 0)... };
+        (void) freed;
+    }
+
+    void commonDelete(void) {
+        destroyRows(Indices());
+        freeColumns(Indices());
+    }
+
+    std::tuple<Fields*...> columns;             // One array per field, all with room for theCapacity values
+    unsigned int theSize;                       // How many rows is the array holding
+    unsigned int theCapacity;                   // How many rows can be held without resizing
+    static const unsigned int initialArrayCapacity = 8;
+};
+
+} /* namespace homebrew */
+} /* namespace mjl */
+
+#endif /* SOA_DYNAMIC_ARRAY_H */
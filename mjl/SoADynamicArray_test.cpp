@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "SoADynamicArray.h"
+#include "SoADynamicArray_test.h"
+
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <utility>
+
+#include <stdint.h>
+
+using namespace std;
+using namespace mjl::homebrew;
+
+typedef SoADynamicArray<unsigned int, double, string, char> Rows;
+
+static bool testAppendAndIndex(void) {
+
+    cout << "Testing SoADynamicArray append and row indexing\n";
+
+    Rows rows;
+    for (unsigned int i = 0; i < 1000; i++) {
+        rows.append(i, i * 0.5, "row " + to_string(i), (char) ('a' + i % 26));
+    }
+    if (rows.size() != 1000 || rows.capacity() < 1000) {
+        cerr << "SoADynamicArray has " << rows.size() << " rows after 1000 appends.\n";
+        return false;
+    }
+
+    for (unsigned int i = 0; i < rows.size(); i++) {
+        unsigned int id;
+        double half;
+        string name;
+        char letter;
+        tie(id, half, name, letter) = rows[i];
+        if (id != i || half != i * 0.5 || name != "row " + to_string(i) || letter != (char) ('a' + i % 26)
+                        || rows.get<2>(i) != name || get<0>(rows.row(i)) != i) {
+            cerr << "Row " << i << " doesn't hold what was appended.\n";
+            return false;
+        }
+    }
+
+    // Writing through a row reference changes the column
+    get<1>(rows[10]) = -1.0;
+    rows.get<2>(11) = "changed";
+    if (rows.column<1>()[10] != -1.0 || get<2>(rows[11]) != "changed") {
+        cerr << "Writes through a row didn't reach the columns.\n";
+        return false;
+    }
+
+    // The values are copied before the columns grow, so a row can be appended from the array itself
+    Rows self;
+    self.append(7, 3.5, "first", 'x');
+    for (unsigned int i = 0; i < 100; i++) {
+        self.append(self.get<0>(0), self.get<1>(0), self.get<2>(0), self.get<3>(0));
+    }
+    self.push_back(self.row(50));
+    if (self.size() != 102 || self.get<2>(101) != "first" || self.get<0>(101) != 7) {
+        cerr << "Appending a row from the array itself gave the wrong row.\n";
+        return false;
+    }
+
+    return true;
+}
+
+static bool testColumns(void) {
+
+    cout << "Testing SoADynamicArray columns are contiguous and aligned\n";
+
+    SoADynamicArray<char, uint64_t, float> soa;
+    for (unsigned int i = 0; i < 5000; i++) {
+        soa.append((char) i, (uint64_t) i * 3, (float) i);
+    }
+
+    ArraySpan<uint64_t> wide = soa.column<1>();
+    ArraySpan<char> narrow = soa.column<0>();
+    if (wide.size() != 5000 || &wide[1] != wide.data() + 1 || wide.end() - wide.begin() != 5000) {
+        cerr << "A column span doesn't cover the rows.\n";
+        return false;
+    }
+    const size_t alignment = Rows::COLUMN_ALIGNMENT;
+    if ((uintptr_t) wide.data() % alignment != 0 || (uintptr_t) narrow.data() % alignment != 0
+                    || (uintptr_t) soa.column<2>().data() % alignment != 0) {
+        cerr << "Columns should start on a cache line.\n";
+        return false;
+    }
+
+    uint64_t sum = 0;
+    for (uint64_t value : wide) {
+        sum += value;
+    }
+    if (sum != 3ULL * 4999 * 5000 / 2) {
+        cerr << "Summing a column gave " << sum << ".\n";
+        return false;
+    }
+
+    const SoADynamicArray<char, uint64_t, float>& constSoa = soa;
+    ArraySpan<const float> floats = constSoa.column<2>();
+    if (floats[4999] != 4999.0f || get<1>(constSoa[2]) != 6) {
+        cerr << "Reading a const SoADynamicArray gave the wrong values.\n";
+        return false;
+    }
+
+    return true;
+}
+
+static bool testCopyAndMove(void) {
+
+    cout << "Testing SoADynamicArray copy, move and clear\n";
+
+    Rows rows;
+    rows.reserve(100);
+    if (rows.capacity() != 100 || rows.size() != 0) {
+        cerr << "reserve(100) gave a capacity of " << rows.capacity() << ".\n";
+        return false;
+    }
+    for (unsigned int i = 0; i < 50; i++) {
+        rows.append(i, 0.0, string(40, 'a' + i % 26), 'z');
+    }
+
+    Rows copy(rows);
+    Rows assigned;
+    assigned.append(1, 1.0, "overwritten", 'o');
+    assigned = copy;
+    Rows moved(std::move(copy));
+    Rows moveAssigned;
+    moveAssigned = std::move(moved);
+
+    if (copy.size() != 0 || moved.size() != 0 || assigned.size() != 50 || moveAssigned.size() != 50) {
+        cerr << "Copying or moving a SoADynamicArray lost rows.\n";
+        return false;
+    }
+    for (unsigned int i = 0; i < 50; i++) {
+        if (assigned.row(i) != rows.row(i) || moveAssigned.row(i) != rows.row(i)) {
+            cerr << "Row " << i << " wasn't copied or moved intact.\n";
+            return false;
+        }
+    }
+
+    unsigned int capacity = rows.capacity();
+    rows.clear();
+    rows.append(5, 5.0, "again", 'a');
+    if (rows.size() != 1 || rows.capacity() != capacity || rows.get<2>(0) != "again") {
+        cerr << "clear() should keep the columns and let rows be appended again.\n";
+        return false;
+    }
+
+    return true;
+}
+
+bool runSoADynamicArrayTests(void) {
+
+    if (!testAppendAndIndex()) {
+        return false;
+    }
+
+    if (!testColumns()) {
+        return false;
+    }
+
+    if (!testCopyAndMove()) {
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,481 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef SWISSHASHTABLE_H
+#define SWISSHASHTABLE_H
+
+#include "HashTable.h"
+
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+#include <stdint.h>
+#include <string.h>
+
+// The group width is chosen at compile time from the instruction set the
+// compiler is allowed to use. Define HASHTABLE_NO_SIMD to force the scalar
+// fallback (e.g. for testing it on a machine that has SSE2).
+#if defined(__AVX2__) && !defined(HASHTABLE_NO_SIMD)
+#include <immintrin.h>
+#define SWISS_GROUP_AVX2
+#define SWISS_GROUP_NAME "AVX2"
+#elif defined(__SSE2__) && !defined(HASHTABLE_NO_SIMD)
+#include <emmintrin.h>
+#define SWISS_GROUP_SSE2
+#define SWISS_GROUP_NAME "SSE2"
+#else
+#define SWISS_GROUP_SCALAR
+#define SWISS_GROUP_NAME "scalar"
+#endif
+
+namespace mjl {
+namespace homebrew {
+
+/**
+ * Every slot in a SwissHashTable has one control byte. A control byte is
+ * either EMPTY, DELETED, or the lower 7 bits of the hash of the key stored in
+ * the slot. The special values have their high bit set, so they can never be
+ * mistaken for a hash.
+ */
+static const signed char SWISS_EMPTY = -128;     // 0b10000000
+static const signed char SWISS_DELETED = -2;     // 0b11111110
+
+/**
+ * A group is a run of consecutive control bytes which are checked all at
+ * once. Each function returns a bitmask with bit i set if control byte i of
+ * the group matches.
+ */
+struct SwissGroup {
+#if defined(SWISS_GROUP_AVX2)
+    static const unsigned int WIDTH = 32;
+
+    explicit SwissGroup(const signed char* control)
+                    : bytes(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(control))) {
+    }
+
+    uint32_t match(signed char hash) const {
+        return (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_set1_epi8(hash), bytes));
+    }
+
+    uint32_t matchEmpty(void) const {
+        return (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_set1_epi8(SWISS_EMPTY), bytes));
+    }
+
+    // EMPTY and DELETED are the only control bytes with the high bit set
+    uint32_t matchEmptyOrDeleted(void) const {
+        return (uint32_t) _mm256_movemask_epi8(bytes);
+    }
+
+    __m256i bytes;
+#elif defined(SWISS_GROUP_SSE2)
+    static const unsigned int WIDTH = 16;
+
+    explicit SwissGroup(const signed char* control)
+                    : bytes(_mm_loadu_si128(reinterpret_cast<const __m128i*>(control))) {
+    }
+
+    uint32_t match(signed char hash) const {
+        return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(hash), bytes));
+    }
+
+    uint32_t matchEmpty(void) const {
+        return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(SWISS_EMPTY), bytes));
+    }
+
+    // EMPTY and DELETED are the only control bytes with the high bit set
+    uint32_t matchEmptyOrDeleted(void) const {
+        return (uint32_t) _mm_movemask_epi8(bytes);
+    }
+
+    __m128i bytes;
+#else
+    static const unsigned int WIDTH = 16;
+
+    explicit SwissGroup(const signed char* control) {
+        memcpy(bytes, control, WIDTH);
+    }
+
+    uint32_t match(signed char hash) const {
+        uint32_t mask = 0;
+        for (unsigned int i = 0; i < WIDTH; i++) {
+            mask |= (uint32_t) (bytes[i] == hash) << i;
+        }
+        return mask;
+    }
+
+    uint32_t matchEmpty(void) const {
+        return match(SWISS_EMPTY);
+    }
+
+    uint32_t matchEmptyOrDeleted(void) const {
+        uint32_t mask = 0;
+        for (unsigned int i = 0; i < WIDTH; i++) {
+            mask |= (uint32_t) (bytes[i] < 0) << i;
+        }
+        return mask;
+    }
+
+    signed char bytes[WIDTH];
+#endif
+};
+
+/**
+ * Storage for one key and value in a SwissHashTable. Whether the storage is
+ * constructed is recorded in the control bytes, not in the slot itself.
+ */
+template<typename K, typename V> struct SwissSlot {
+ public:
+    K& key(void) {
+        return *reinterpret_cast<K*>(keyStorage);
+    }
+
+    V& value(void) {
+        return *reinterpret_cast<V*>(valueStorage);
+    }
+
+    alignas(K) unsigned char keyStorage[sizeof(K)];
+    alignas(V) unsigned char valueStorage[sizeof(V)];
+};
+
+/**
+ * This is a "Swiss table" style alternative to HashTable, with the same
+ * get/insert/remove interface.
+ *
+ * The hash of a key is split in two. The upper bits (h1) select the group
+ * where probing starts, and the lower 7 bits (h2) are stored in the control
+ * byte of the slot the key ends up in. A lookup compares h2 against a whole
+ * group of control bytes with a single SIMD compare, and only the slots whose
+ * control byte matches have their key compared. Groups are probed in
+ * triangular order until a group with an EMPTY control byte is seen.
+ *
+ * The capacity is always a power of two number of groups, and the table is
+ * allowed to fill up to 7/8 of its capacity (tombstones included).
+ */
+template<typename K, typename V, typename HashGenerator = DefaultHashGenerator<K>> class SwissHashTable {
+ public:
+
+    typedef SwissSlot<K, V> Slot;
+
+    // Default constructor
+    SwissHashTable()
+                    : capacity(0),
+                      size(0),
+                      growthLeft(0),
+                      control(nullptr),
+                      slots(nullptr) {
+        allocate(SwissGroup::WIDTH);
+    }
+
+    // Copy constructor
+    SwissHashTable(const SwissHashTable& from)
+                    : capacity(0),
+                      size(0),
+                      growthLeft(0),
+                      control(nullptr),
+                      slots(nullptr) {
+        commonCopy(from);
+    }
+
+    // Move constructor
+    SwissHashTable(SwissHashTable&& from) noexcept
+                    : capacity(from.capacity),
+                      size(from.size),
+                      growthLeft(from.growthLeft),
+                      control(from.control),
+                      slots(from.slots) {
+        from.control = nullptr;
+        from.slots = nullptr;
+    }
+
+    // Assignment operator
+    SwissHashTable& operator=(const SwissHashTable& from) {
+
+        if (this == &from) {
+            return *this;
+        }
+
+        commonDelete();
+        commonCopy(from);
+        return *this;
+    }
+
+    // Move assignment operator
+    SwissHashTable& operator=(SwissHashTable&& from) noexcept {
+
+        if (this == &from) {
+            return *this;
+        }
+
+        commonDelete();
+
+        capacity = from.capacity;
+        size = from.size;
+        growthLeft = from.growthLeft;
+        control = from.control;
+        slots = from.slots;
+
+        from.control = nullptr;
+        from.slots = nullptr;
+
+        return *this;
+    }
+
+    // Destructor
+    virtual ~SwissHashTable() {
+        commonDelete();
+    }
+
+    V& get(const K& key) {
+
+        unsigned int index = findSlot(key);
+
+        if (index == capacity) {
+            throw std::out_of_range("Tried to get entry that does not exist.");
+        }
+
+        return slots[index].value();
+    }
+
+    bool contains(const K& key) {
+        return findSlot(key) != capacity;
+    }
+
+    // Will delete any element that is already there and insert new one
+    void insert(const K& key, const V& value) {
+
+        uint64_t hash = hashOf(key);
+        unsigned int index = findSlot(key, hash);
+
+        if (index != capacity) {
+            slots[index].value() = value;
+            return;
+        }
+
+        index = findInsertSlot(hash);
+
+        // Only filling an EMPTY slot uses up growth, reusing a tombstone does not
+        if (growthLeft == 0 && control[index] == SWISS_EMPTY) {
+            rehash();
+            index = findInsertSlot(hash);
+        }
+
+        if (control[index] == SWISS_EMPTY) {
+            growthLeft--;
+        }
+
+        new (slots[index].keyStorage) K(key);
+        new (slots[index].valueStorage) V(value);
+        control[index] = h2(hash);
+        size++;
+    }
+
+    bool remove(const K& key) {
+
+        unsigned int index = findSlot(key);
+
+        if (index == capacity) {
+            return false;
+        }
+
+        slots[index].key().~K();
+        slots[index].value().~V();
+        size--;
+
+        // Probing stops at the first group with an EMPTY control byte. If this slot's group
+        // already has one then no probe sequence continues past it, and the slot can simply
+        // go back to being EMPTY. Otherwise a tombstone has to be left behind.
+        unsigned int groupStart = index - index % SwissGroup::WIDTH;
+        if (SwissGroup(control + groupStart).matchEmpty() != 0) {
+            control[index] = SWISS_EMPTY;
+            growthLeft++;
+        } else {
+            control[index] = SWISS_DELETED;
+        }
+
+        return true;
+    }
+
+ private:
+
+    /**
+     * A user supplied hash generator may not mix its bits well, but both the
+     * group index and the 7 bit control byte need well mixed bits. One extra
+     * multiply makes sure of that.
+     */
+    static uint64_t hashOf(const K& key) {
+        uint64_t h = (uint64_t) HashOf<HashGenerator, K>::hash(key) * 0x9E3779B97F4A7C15ULL;
+        return h ^ (h >> 32);
+    }
+
+    static signed char h2(uint64_t hash) {
+        return (signed char) (hash & 0x7F);
+    }
+
+    unsigned int firstGroup(uint64_t hash) const {
+        return (unsigned int) (hash >> 7) & (capacity / SwissGroup::WIDTH - 1);
+    }
+
+    unsigned int findSlot(const K& key) const {
+        return findSlot(key, hashOf(key));
+    }
+
+    unsigned int findSlot(const K& key, uint64_t hash) const {
+
+        unsigned int groupMask = capacity / SwissGroup::WIDTH - 1;
+        unsigned int group = firstGroup(hash);
+        signed char tag = h2(hash);
+
+        for (unsigned int step = 1; step <= groupMask + 1; step++) {
+
+            unsigned int groupStart = group * SwissGroup::WIDTH;
+            SwissGroup g(control + groupStart);
+
+            // Only the slots whose control byte matches the hash are compared to the key
+            for (uint32_t match = g.match(tag); match != 0; match &= match - 1) {
+                unsigned int index = groupStart + __builtin_ctz(match);
+                if (slots[index].key() == key) {
+                    return index;
+                }
+            }
+
+            if (g.matchEmpty() != 0) {
+                break;
+            }
+
+            group = (group + step) & groupMask;
+        }
+
+        return capacity;
+    }
+
+    // The first EMPTY or DELETED slot along the probe sequence of hash
+    unsigned int findInsertSlot(uint64_t hash) const {
+
+        unsigned int groupMask = capacity / SwissGroup::WIDTH - 1;
+        unsigned int group = firstGroup(hash);
+
+        for (unsigned int step = 1;; step++) {
+
+            unsigned int groupStart = group * SwissGroup::WIDTH;
+            uint32_t available = SwissGroup(control + groupStart).matchEmptyOrDeleted();
+
+            if (available != 0) {
+                return groupStart + __builtin_ctz(available);
+            }
+
+            group = (group + step) & groupMask;
+        }
+    }
+
+    void allocate(unsigned int newCapacity) {
+        capacity = newCapacity;
+        growthLeft = newCapacity - newCapacity / 8;
+        control = new signed char[newCapacity];
+        memset(control, SWISS_EMPTY, newCapacity);
+        slots = new Slot[newCapacity];
+    }
+
+    void commonCopy(const SwissHashTable& from) {
+
+        allocate(from.capacity);
+
+        // Both tables have the same capacity, so every entry can go to the same slot and all
+        // of the probe sequences stay intact.
+        for (unsigned int i = 0; i < from.capacity; i++) {
+            if (from.control[i] >= 0) {
+                new (slots[i].keyStorage) K(from.slots[i].key());
+                new (slots[i].valueStorage) V(from.slots[i].value());
+            }
+        }
+
+        memcpy(control, from.control, from.capacity);
+        size = from.size;
+        growthLeft = from.growthLeft;
+    }
+
+    void commonDelete(void) {
+
+        // If the object has been moved (via move constructor or move assignment
+        // operator) then there's no need to delete the memory here.
+        if (control == nullptr) {
+            return;
+        }
+
+        for (unsigned int i = 0; i < capacity; i++) {
+            if (control[i] >= 0) {
+                slots[i].key().~K();
+                slots[i].value().~V();
+            }
+        }
+
+        delete[] control;
+        delete[] slots;
+    }
+
+    void rehash(void) {
+
+        unsigned int oldCapacity = capacity;
+        signed char* oldControl = control;
+        Slot* oldSlots = slots;
+
+        // Grow when the table is at least half full of live entries, otherwise most of the
+        // load is tombstones and rebuilding at the same capacity is enough.
+        unsigned int newCapacity = oldCapacity;
+        if (size * 2 >= oldCapacity - oldCapacity / 8) {
+            newCapacity = oldCapacity * 2;
+        }
+
+        allocate(newCapacity);
+
+        for (unsigned int i = 0; i < oldCapacity; i++) {
+
+            if (oldControl[i] < 0) {
+                continue;
+            }
+
+            uint64_t hash = hashOf(oldSlots[i].key());
+            unsigned int index = findInsertSlot(hash);
+
+            new (slots[index].keyStorage) K(std::move(oldSlots[i].key()));
+            new (slots[index].valueStorage) V(std::move(oldSlots[i].value()));
+            control[index] = h2(hash);
+            growthLeft--;
+
+            oldSlots[i].key().~K();
+            oldSlots[i].value().~V();
+        }
+
+        delete[] oldControl;
+        delete[] oldSlots;
+    }
+
+    unsigned int capacity;
+    unsigned int size;
+    unsigned int growthLeft;        // How many more EMPTY slots can be filled before a rehash
+    signed char* control;
+    Slot* slots;
+};
+
+} /* namespace homebrew */
+} /* namespace mjl */
+
+#endif /* SWISSHASHTABLE_H */
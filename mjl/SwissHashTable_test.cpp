@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "SwissHashTable.h"
+#include "SwissHashTable_test.h"
+
+#include <iostream>
+#include <unordered_map>
+
+#include <stdlib.h>
+
+using namespace std;
+using namespace mjl::homebrew;
+
+// Every key in the reference map must be found with the same value, and a
+// handful of keys known to be absent must not be found.
+static bool matchesReference(SwissHashTable<int, int>& table, unordered_map<int, int>& reference,
+                             int keyRange) {
+
+    for (int key = 0; key < keyRange; key++) {
+
+        bool expected = reference.find(key) != reference.end();
+        bool found = true;
+        int value = 0;
+
+        try {
+            value = table.get(key);
+        } catch (std::out_of_range&) {
+            found = false;
+        }
+
+        if (found != expected || table.contains(key) != expected) {
+            cerr << "Key " << key << " was " << (found ? "" : "not ") << "found but should "
+                            << (expected ? "" : "not ") << "have been.\n";
+            return false;
+        }
+        if (found && value != reference[key]) {
+            cerr << "Key " << key << " has value " << value << " but should be " << reference[key] << ".\n";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool runSwissHashTableTests(void) {
+    const int TEST_SIZE = 1000;
+    const int KEY_RANGE = 2000;
+
+    SwissHashTable<int, int> myHash;
+    unordered_map<int, int> stdHash;
+
+    cout << "Inserting " << TEST_SIZE << " entries into Swiss hash table.\n";
+    for (int i = 0; i < TEST_SIZE; i++) {
+        myHash.insert(i, i * 3);
+        stdHash[i] = i * 3;
+    }
+    if (!matchesReference(myHash, stdHash, KEY_RANGE)) {
+        return false;
+    }
+
+    cout << "Replacing the value of existing entries.\n";
+    for (int i = 0; i < TEST_SIZE; i += 7) {
+        myHash.insert(i, -i);
+        stdHash[i] = -i;
+    }
+    if (!matchesReference(myHash, stdHash, KEY_RANGE)) {
+        return false;
+    }
+
+    cout << "Removing every other entry, and entries that are not there.\n";
+    for (int i = 0; i < KEY_RANGE; i += 2) {
+        bool removed = myHash.remove(i);
+        bool expected = stdHash.erase(i) == 1;
+        if (removed != expected) {
+            cerr << "remove(" << i << ") returned " << removed << " but should be " << expected << ".\n";
+            return false;
+        }
+    }
+    if (!matchesReference(myHash, stdHash, KEY_RANGE)) {
+        return false;
+    }
+
+    // Churn through many insert/remove pairs so the table fills up with tombstones and has to
+    // clean them out while probe sequences still need to pass through them.
+    cout << "Mixed random inserts and removes.\n";
+    srand(1234);
+    for (int i = 0; i < 50000; i++) {
+        int key = rand() % KEY_RANGE;
+        if (rand() % 2 == 0) {
+            myHash.insert(key, i);
+            stdHash[key] = i;
+        } else {
+            myHash.remove(key);
+            stdHash.erase(key);
+        }
+    }
+    if (!matchesReference(myHash, stdHash, KEY_RANGE)) {
+        return false;
+    }
+
+    cout << "Testing copy constructor and assignment operator\n";
+    SwissHashTable<int, int> myHash2(myHash);
+    if (!matchesReference(myHash2, stdHash, KEY_RANGE)) {
+        return false;
+    }
+    SwissHashTable<int, int> myHash3;
+    myHash3 = myHash2;
+    if (!matchesReference(myHash3, stdHash, KEY_RANGE)) {
+        return false;
+    }
+
+    cout << "Testing move constructor and move assignment operator\n";
+    SwissHashTable<int, int> myHash4(std::move(myHash2));
+    if (!matchesReference(myHash4, stdHash, KEY_RANGE)) {
+        return false;
+    }
+    SwissHashTable<int, int> myHash5;
+    myHash5 = std::move(myHash3);
+    if (!matchesReference(myHash5, stdHash, KEY_RANGE)) {
+        return false;
+    }
+
+    return true;
+}
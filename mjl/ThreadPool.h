@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2018 Marcus Larwill
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace mjl {
+namespace homebrew {
+
+/**
+ * A fixed set of worker threads that split up batches of tasks. A batch is
+ * run with run(count, task), which calls task(i) for every i from 0 up to
+ * count and returns once they have all finished.
+ *
+ * The thread that calls run() works on the batch as well, so a pool of N
+ * threads has N - 1 workers, and a pool of one thread just runs everything
+ * on the caller. Tasks are handed out one at a time from a shared counter,
+ * so a thread that finishes early takes more of them instead of waiting on
+ * a fixed share. Because the caller never sits idle while its batch has
+ * tasks left, run() can also be called from inside a task.
+ *
+ * ThreadPool::instance() is a pool with one thread per hardware thread,
+ * shared by everything that doesn't bring its own.
+ */
+class ThreadPool {
+ public:
+
+    explicit ThreadPool(unsigned int threads = defaultThreadCount())
+                    : stopping(false) {
+
+        if (threads == 0) {
+            throw std::invalid_argument("A ThreadPool needs at least one thread.");
+        }
+
+        for (unsigned int i = 1; i < threads; i++) {
+            workers.emplace_back([this] {
+                work();
+            });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopping = true;
+        }
+        wakeup.notify_all();
+
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    static ThreadPool& instance(void) {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    static unsigned int defaultThreadCount(void) {
+        unsigned int threads = std::thread::hardware_concurrency();
+        return (threads == 0) ? 1 : threads;
+    }
+
+    // How many threads work on a batch, counting the one that calls run()
+    unsigned int threadCount(void) const {
+        return (unsigned int) workers.size() + 1;
+    }
+
+    /**
+     * Call task(i) for every i from 0 up to count, spread over the pool, and
+     * return when all of them are done. If a task throws, the tasks that
+     * haven't started yet are skipped, and the first exception is rethrown
+     * here once the ones already running have finished.
+     */
+    template<typename Task> void run(size_t count, const Task& task) {
+
+        if (count == 0) {
+            return;
+        }
+
+        if (count == 1 || workers.empty()) {
+            for (size_t i = 0; i < count; i++) {
+                task(i);
+            }
+            return;
+        }
+
+        // A worker can pick up its copy of the batch after every task is done and run() has returned,
+        // so the batch is shared and the task is only ever called for an index that is still to do.
+        std::shared_ptr<Batch> batch = std::make_shared<Batch>(count, [&task](size_t i) {
+            task(i);
+        });
+
+        size_t helpers = std::min(count - 1, workers.size());
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            for (size_t i = 0; i < helpers; i++) {
+                queue.push_back(batch);
+            }
+        }
+        if (helpers == 1) {
+            wakeup.notify_one();
+        } else {
+            wakeup.notify_all();
+        }
+
+        batch->work();
+
+        std::unique_lock<std::mutex> lock(batch->doneMutex);
+        batch->done.wait(lock, [&batch] {
+            return batch->remaining == 0;
+        });
+
+        if (batch->error) {
+            std::rethrow_exception(batch->error);
+        }
+    }
+
+ private:
+
+    struct Batch {
+        Batch(size_t theCount, std::function<void(size_t)>&& theTask)
+                        : count(theCount),
+                          task(std::move(theTask)),
+                          next(0),
+                          failed(false),
+                          remaining(theCount) {
+        }
+
+        // Take tasks until there are none left
+        void work(void) {
+            size_t i;
+            while ((i = next.fetch_add(1, std::memory_order_relaxed)) < count) {
+                if (!failed.load(std::memory_order_relaxed)) {
+                    try {
+                        task(i);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(doneMutex);
+                        if (!error) {
+                            error = std::current_exception();
+                        }
+                        failed.store(true, std::memory_order_relaxed);
+                    }
+                }
+
+                std::lock_guard<std::mutex> lock(doneMutex);
+                if (--remaining == 0) {
+                    done.notify_all();
+                }
+            }
+        }
+
+        const size_t count;
+        std::function<void(size_t)> task;
+        std::atomic<size_t> next;                   // The next task to hand out
+        std::atomic<bool> failed;                   // Set once a task has thrown, to skip the rest
+
+        std::mutex doneMutex;                       // Guards remaining and error
+        std::condition_variable done;
+        size_t remaining;                           // Tasks not finished (or skipped) yet
+        std::exception_ptr error;
+    };
+
+    void work(void) {
+        while (true) {
+            std::shared_ptr<Batch> batch;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                wakeup.wait(lock, [this] {
+                    return stopping || !queue.empty();
+                });
+                if (queue.empty()) {
+                    return;
+                }
+                batch = std::move(queue.front());
+                queue.pop_front();
+            }
+            batch->work();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex queueMutex;                          // Guards queue and stopping
+    std::condition_variable wakeup;
+    std::deque<std::shared_ptr<Batch>> queue;       // One entry per worker asked to help with a batch
+    bool stopping;
+};
+
+} /* namespace homebrew */
+} /* namespace mjl */
+
+#endif /* THREADPOOL_H */
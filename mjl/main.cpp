@@ -19,12 +19,26 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
  * SOFTWARE.
  */
+#include "ConcurrentHashTable_test.h"
+#include "CuckooHashTable_test.h"
 #include "DynamicArray_test.h"
+#include "HashGenerator_test.h"
+#include "HashSet_test.h"
 #include "HashTable_test.h"
+#include "HashTableSnapshot_test.h"
+#include "MappedDynamicArray_test.h"
+#include "OpenAddressingHashTable_test.h"
+#include "ParallelAlgorithms_test.h"
 #include "Queue_test.h"
+#include "RcuHashTable_test.h"
 #include "RedBlackTree_test.h"
+#include "RobinHoodHashTable_test.h"
+#include "SimdKernels_test.h"
 #include "SinglyLinkedList_test.h"
+#include "SmallDynamicArray_test.h"
+#include "SoADynamicArray_test.h"
 #include "Stack_test.h"
+#include "SwissHashTable_test.h"
 
 int main() {
     bool status = false;
@@ -49,11 +63,81 @@ int main() {
         return -1;
     }
 
+    status = runSmallDynamicArrayTests();
+    if (status != true) {
+        return -1;
+    }
+
+    status = runSoADynamicArrayTests();
+    if (status != true) {
+        return -1;
+    }
+
+    status = runMappedDynamicArrayTests();
+    if (status != true) {
+        return -1;
+    }
+
+    status = runParallelAlgorithmsTests();
+    if (status != true) {
+        return -1;
+    }
+
+    status = runSimdKernelsTests();
+    if (status != true) {
+        return -1;
+    }
+
     status = runHashTableTests();
     if (status != true) {
         return -1;
     }
 
+    status = runHashTableSnapshotTests();
+    if (status != true) {
+        return -1;
+    }
+
+    status = runConcurrentHashTableTests();
+    if (status != true) {
+        return -1;
+    }
+
+    status = runHashGeneratorTests();
+    if (status != true) {
+        return -1;
+    }
+
+    status = runOpenAddressingHashTableTests();
+    if (status != true) {
+        return -1;
+    }
+
+    status = runSwissHashTableTests();
+    if (status != true) {
+        return -1;
+    }
+
+    status = runRcuHashTableTests();
+    if (status != true) {
+        return -1;
+    }
+
+    status = runRobinHoodHashTableTests();
+    if (status != true) {
+        return -1;
+    }
+
+    status = runCuckooHashTableTests();
+    if (status != true) {
+        return -1;
+    }
+
+    status = runHashSetTests();
+    if (status != true) {
+        return -1;
+    }
+
     status = runRedBlackTreeTests();
     if (status != true) {
         return -1;